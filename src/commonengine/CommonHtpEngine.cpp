@@ -4,6 +4,8 @@
 
 #include "SgSystem.h"
 #include "SgGameReader.h"
+#include "SgRandom.h"
+#include "SgTimer.h"
 
 #include "BoardUtil.hpp"
 #include "BitsetIterator.hpp"
@@ -12,6 +14,8 @@
 #include "CommonHtpEngine.hpp"
 #include "DfsSolver.hpp"
 #include "HexSgUtil.hpp"
+#include "ICECache.hpp"
+#include "IcePatternSet.hpp"
 #include "PatternState.hpp"
 #include "Resistance.hpp"
 #include "SwapCheck.hpp"
@@ -56,6 +60,10 @@ CommonHtpEngine::CommonHtpEngine(int boardsize)
                 &CommonHtpEngine::CmdComputeReversibleOnCell);
     RegisterCmd("compute-inferior-cell",
                 &CommonHtpEngine::CmdComputeInferiorOnCell);
+    RegisterCmd("ice-cache-stats", &CommonHtpEngine::CmdICECacheStats);
+    RegisterCmd("ice-cache-clear", &CommonHtpEngine::CmdICECacheClear);
+    RegisterCmd("ice-cache-capacity", &CommonHtpEngine::CmdICECacheCapacity);
+    RegisterCmd("ice-bench-match", &CommonHtpEngine::CmdICEBenchMatch);
     RegisterCmd("find-comb-decomp", &CommonHtpEngine::CmdFindCombDecomp);
     RegisterCmd("find-split-decomp", &CommonHtpEngine::CmdFindSplitDecomp);
     RegisterCmd("encode-pattern", &CommonHtpEngine::CmdEncodePattern);
@@ -105,6 +113,7 @@ void CommonHtpEngine::CmdAnalyzeCommands(HtpCommand& cmd)
         "inferior/Compute Fillin/compute-fillin %m\n"
         "inferior/Compute Reversible Cell/compute-reversible-cell %m\n"
         "inferior/Compute Inferior Cell/compute-inferior-cell %m\n"
+        "string/ICE Cache Stats/ice-cache-stats\n"
         "plist/Find Comb Decomp/find-comb-decomp %c\n"
         "plist/Find Split Decomp/find-split-decomp %c\n"
         "string/Encode Pattern/encode-pattern %P\n"
@@ -324,6 +333,104 @@ void CommonHtpEngine::CmdComputeInferiorOnCell(HtpCommand& cmd)
     cmd << '\n';
 }
 
+/** Outputs the counters of the shared ICE cache. */
+void CommonHtpEngine::CmdICECacheStats(HtpCommand& cmd)
+{
+    cmd.CheckArgNone();
+    cmd << '\n' << ICECache::Global().GetStatistics().ToString();
+}
+
+void CommonHtpEngine::CmdICECacheClear(HtpCommand& cmd)
+{
+    cmd.CheckArgNone();
+    ICECache::Global().Clear();
+}
+
+/** Sets the number of entries of the shared ICE cache; clears it. */
+void CommonHtpEngine::CmdICECacheCapacity(HtpCommand& cmd)
+{
+    cmd.CheckNuArg(1);
+    ICECache::Global().SetCapacity(cmd.ArgMin<std::size_t>(0, 0));
+}
+
+/** Times matching of the ICE patterns on random positions of the
+    current board size. Arguments: number of positions (default 100),
+    stones per position (default a third of the cells) and passes over
+    each position (default 10). A pass matches the fill-in, inferior,
+    strong-reversible and vulnerable patterns of both colors on every
+    empty cell. */
+void CommonHtpEngine::CmdICEBenchMatch(HtpCommand& cmd)
+{
+    cmd.CheckNuArgLessEqual(3);
+    const StoneBoard& board = m_game.Board();
+    const int cells = board.Width() * board.Height();
+    std::size_t positions = 100;
+    int stones = cells / 3;
+    std::size_t repeats = 10;
+    if (cmd.NuArg() >= 1)
+        positions = cmd.ArgMin<std::size_t>(0, 1);
+    if (cmd.NuArg() >= 2)
+        stones = cmd.ArgMinMax<int>(1, 0, cells);
+    if (cmd.NuArg() >= 3)
+        repeats = cmd.ArgMin<std::size_t>(2, 1);
+    IcePatternSet patterns;
+    patterns.LoadPatterns("ice-patterns.txt");
+    SgRandom random;
+    PatternHitBuffer hits;
+    std::size_t numHits = 0;
+    std::size_t numPatternHits = 0;
+    double elapsed = 0;
+    for (std::size_t i = 0; i < positions; ++i)
+    {
+        StoneBoard brd(board.Width(), board.Height());
+        for (int j = 0; j < stones; ++j)
+        {
+            std::vector<HexPoint> empty;
+            for (BitsetIterator p(brd.GetEmpty()); p; ++p)
+                empty.push_back(*p);
+            brd.PlayMove(brd.WhoseTurn(), empty[random.Int(empty.size())]);
+        }
+        PatternState pastate(brd);
+        pastate.Update();
+        const bitset_t consider = brd.GetEmpty();
+        SgTimer timer;
+        for (std::size_t r = 0; r < repeats; ++r)
+            for (BWIterator c; c; ++c)
+            {
+                const PatternState::MatchMode all = PatternState::MATCH_ALL;
+                numHits += pastate.MatchOnBoard(consider,
+                    patterns.HashedFillin(*c), all, hits).count();
+                numHits += pastate.MatchOnBoard(consider,
+                    patterns.HashedInferior(*c), all, hits).count();
+                numHits += pastate.MatchOnBoard(consider,
+                    patterns.HashedSReversible(*c), all, hits).count();
+                numHits += pastate.MatchOnBoard(consider,
+                    patterns.HashedVulnerable(*c), all, hits).count();
+            }
+        elapsed += timer.GetTime();
+        // Count the individual hits once, outside the timed loop
+        for (BWIterator c; c; ++c)
+        {
+            const HashedPatternSet* sets[] = { &patterns.HashedFillin(*c),
+                                               &patterns.HashedInferior(*c),
+                                               &patterns.HashedSReversible(*c),
+                                               &patterns.HashedVulnerable(*c) };
+            for (std::size_t k = 0; k < 4; ++k)
+            {
+                pastate.MatchOnBoard(consider, *sets[k], 
+                                     PatternState::MATCH_ALL, hits);
+                for (BitsetIterator p(consider); p; ++p)
+                    numPatternHits += hits.NumHits(*p);
+            }
+        }
+    }
+    const double passes = static_cast<double>(positions * repeats);
+    cmd << "passes " << positions * repeats << " cells-hit " << numHits
+        << " hits " << numPatternHits
+        << " total " << elapsed << "s per-pass "
+        << 1e6 * elapsed / passes << "us";
+}
+
 /** Tries to find a combinatorial decomposition of the board state.
     Outputs cells in the vc if there is a decomposition. */
 void CommonHtpEngine::CmdFindCombDecomp(HtpCommand& cmd)
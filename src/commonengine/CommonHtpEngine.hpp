@@ -36,6 +36,10 @@ public:
         - @link CmdComputeSReversible() @c compute-s-reversible @endlink
         - @link CmdComputeInferiorOnCell() @c compute-inferior-cell @endlink
 	- @link CmdComputeReversibleOnCell() @c compute-reversible-cell @endlink
+        - @link CmdICECacheStats() @c ice-cache-stats @endlink
+        - @link CmdICECacheClear() @c ice-cache-clear @endlink
+        - @link CmdICECacheCapacity() @c ice-cache-capacity @endlink
+        - @link CmdICEBenchMatch() @c ice-bench-match @endlink
         - @link CmdFindCombDecomp() @c find-comb-decomp @endlink
         - @link CmdFindSplitDecomp() @c find-split-decomp @endlink
         - @link CmdEncodePattern() @c encode-pattern @endlink
@@ -57,6 +61,10 @@ public:
     void CmdComputeSReversible(HtpCommand& cmd);
     void CmdComputeReversibleOnCell(HtpCommand& cmd);
     void CmdComputeInferiorOnCell(HtpCommand& cmd);
+    void CmdICECacheStats(HtpCommand& cmd);
+    void CmdICECacheClear(HtpCommand& cmd);
+    void CmdICECacheCapacity(HtpCommand& cmd);
+    void CmdICEBenchMatch(HtpCommand& cmd);
     void CmdFindCombDecomp(HtpCommand& cmd);
     void CmdFindSplitDecomp(HtpCommand& cmd);
     void CmdEncodePattern(HtpCommand& cmd);
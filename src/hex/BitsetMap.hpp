@@ -8,6 +8,7 @@
 #include "Hex.hpp"
 #include "BenzeneBitset.hpp"
 #include "BitsetIterator.hpp"
+#include "ObjectArena.hpp"
 
 _BEGIN_BENZENE_NAMESPACE_
 
@@ -49,6 +50,10 @@ private:
     void Destroy();
 };
 
+/** Map from unordered pairs of points to entries of type T.
+    Entries are owned by the map and come from an ObjectArena, so T
+    needs a Clear() method restoring its default state; Reset() frees
+    nothing individually. */
 template <class T>
 class BitsetUPairMap
 {
@@ -56,44 +61,101 @@ public:
     class Nbs : public BitsetMapBase<T>
     {
     public:
-        void Destroy(HexPoint x);
-        void Reset(HexPoint x);
         using BitsetMapBase<T>::At;
         using BitsetMapBase<T>::Entries;
         using BitsetMapBase<T>::ResetEntries;
     };
 
-    ~BitsetUPairMap();
+    typedef ObjectArena<T> Arena;
+
+    BitsetUPairMap();
+
     void Reset();
 
     const Nbs& operator[](HexPoint x) const;
-    T* Put(HexPoint x, HexPoint y, T* entry = new T());
+
+    /** Stores a new, empty entry for (x, y) and returns it. */
+    T* Put(HexPoint x, HexPoint y);
+
     void Delete(HexPoint x, HexPoint y, T* xy_entry);
     void Delete(HexPoint x, HexPoint y);
 
+    typename Arena::Statistics ArenaStatistics() const;
+
     class Backup
     {
     public:
         void Create(BitsetUPairMap& map);
         void Restore(BitsetUPairMap& map);
     private:
-        struct TEntry
+        struct Entry
         {
-            TEntry(HexPoint y, const T* t);
+            Entry(HexPoint x, HexPoint y, const T& t);
+            HexPoint x;
             HexPoint y;
-            T* t;
+            T t;
         };
-        struct NbsEntry
+        std::vector<Entry> data;
+    };
+
+    /** Undo log for the map.
+        While attached, the map records entry creation, deletion and
+        Reset(). Entries report their value before they first change
+        by calling SaveValue(); T::Touch() must do so, and is called
+        before an entry is deleted. Undo() replays the log backwards,
+        so entries get back both their values and their addresses. */
+    class Journal
+    {
+    public:
+        /** Records the current value of entry. */
+        void SaveValue(T* entry);
+
+    private:
+        friend class BitsetUPairMap;
+
+        enum Kind { PUT, PUT_REUSED, DELETE, VALUE, RESET };
+
+        struct Op
         {
-            NbsEntry(HexPoint x);
+            Op(Kind kind, HexPoint x, HexPoint y, T* entry,
+               std::size_t index);
+            Kind kind;
             HexPoint x;
-            std::vector<TEntry> entries;
+            HexPoint y;
+            T* entry;
+            /** Index into m_values or m_resets. */
+            std::size_t index;
+        };
+
+        struct ResetState
+        {
+            typename Arena::State arena;
+            /** PUT ops for the entries at the time of the reset, with
+                their values in m_values. */
+            std::vector<Op> entries;
         };
-        std::vector<NbsEntry> data;
+
+        std::vector<Op> m_ops;
+        std::vector<T> m_values;
+        std::vector<ResetState> m_resets;
     };
 
+    /** Starts recording changes in journal, or stops if it is 0. */
+    void SetJournal(Journal* journal);
+
+    /** Reverts all changes recorded in journal. */
+    void Undo(const Journal& journal);
+
 private:
     Nbs m_xmap[BITSETSIZE];
+
+    Arena m_arena;
+
+    Journal* m_journal;
+
+    void Link(HexPoint x, HexPoint y, T* entry);
+
+    void Unlink(HexPoint x, HexPoint y);
 };
 
 template <class T>
@@ -176,55 +238,79 @@ inline BitsetMap<T>::~BitsetMap()
 }
 
 template <class T>
-inline void BitsetUPairMap<T>::Nbs::Destroy(HexPoint x)
+inline BitsetUPairMap<T>::BitsetUPairMap()
+    : m_journal(0)
 {
-    for (BitsetIterator i(Entries()); i; ++i)
-    {
-        if (*i > x)
-            break;
-        delete At(*i);
-    }
 }
 
 template <class T>
-inline void BitsetUPairMap<T>::Nbs::Reset(HexPoint x)
+inline void BitsetUPairMap<T>::Reset()
 {
-    Destroy(x);
-    ResetEntries();
+    if (m_journal)
+    {
+        m_journal->m_resets.push_back(typename Journal::ResetState());
+        typename Journal::ResetState& state = m_journal->m_resets.back();
+        m_arena.GetState(state.arena);
+        for (int x = 0; x < BITSETSIZE; x++)
+            for (BitsetIterator y(m_xmap[x].Entries()); y && *y <= x; ++y)
+            {
+                state.entries.push_back(typename Journal::Op
+                    (Journal::VALUE, HexPoint(x), *y, m_xmap[x][*y],
+                     m_journal->m_values.size()));
+                m_journal->m_values.push_back(*m_xmap[x][*y]);
+            }
+        m_journal->m_ops.push_back(typename Journal::Op
+            (Journal::RESET, INVALID_POINT, INVALID_POINT, 0,
+             m_journal->m_resets.size() - 1));
+    }
+    for (int i = 0; i < BITSETSIZE; i++)
+        if (m_xmap[i].Entries().any())
+            m_xmap[i].ResetEntries();
+    m_arena.DeleteAll();
 }
 
 template <class T>
-inline BitsetUPairMap<T>::~BitsetUPairMap()
+inline const typename BitsetUPairMap<T>::Nbs& BitsetUPairMap<T>::operator[](HexPoint x) const
 {
-    for (int i = 0; i < BITSETSIZE; i++)
-        m_xmap[i].Destroy(HexPoint(i));
+    return m_xmap[x];
 }
 
 template <class T>
-inline void BitsetUPairMap<T>::Reset()
+inline T* BitsetUPairMap<T>::Put(HexPoint x, HexPoint y)
 {
-    for (int i = 0; i < BITSETSIZE; i++)
-        m_xmap[i].Reset(HexPoint(i));
+    BenzeneAssert(!m_xmap[x][y]);
+    const bool reused = m_arena.HasDeleted();
+    T* entry = m_arena.New();
+    if (m_journal)
+        m_journal->m_ops.push_back(typename Journal::Op
+            (reused ? Journal::PUT_REUSED : Journal::PUT, x, y, entry, 0));
+    Link(x, y, entry);
+    return entry;
 }
 
 template <class T>
-inline const typename BitsetUPairMap<T>::Nbs& BitsetUPairMap<T>::operator[](HexPoint x) const
+inline void BitsetUPairMap<T>::Delete(HexPoint x, HexPoint y, T* xy_entry)
 {
-    return m_xmap[x];
+    if (m_journal)
+    {
+        xy_entry->Touch();
+        m_journal->m_ops.push_back(typename Journal::Op
+            (Journal::DELETE, x, y, xy_entry, 0));
+    }
+    m_arena.Delete(xy_entry);
+    Unlink(x, y);
 }
 
 template <class T>
-inline T* BitsetUPairMap<T>::Put(HexPoint x, HexPoint y, T* entry)
+inline void BitsetUPairMap<T>::Link(HexPoint x, HexPoint y, T* entry)
 {
     m_xmap[x].Put(y, entry);
     m_xmap[y].Put(x, entry);
-    return entry;
 }
 
 template <class T>
-inline void BitsetUPairMap<T>::Delete(HexPoint x, HexPoint y, T* xy_entry)
+inline void BitsetUPairMap<T>::Unlink(HexPoint x, HexPoint y)
 {
-    delete xy_entry;
     m_xmap[x].Remove(y);
     m_xmap[y].Remove(x);
 }
@@ -238,14 +324,80 @@ inline void BitsetUPairMap<T>::Delete(HexPoint x, HexPoint y)
 }
 
 template <class T>
-inline BitsetUPairMap<T>::Backup::TEntry::TEntry(HexPoint y, const T* t)
-    : y(y), t(new T(*t))
+inline typename BitsetUPairMap<T>::Arena::Statistics
+BitsetUPairMap<T>::ArenaStatistics() const
+{
+    return m_arena.GetStatistics();
+}
+
+template <class T>
+inline void BitsetUPairMap<T>::SetJournal(Journal* journal)
+{
+    m_journal = journal;
+}
+
+template <class T>
+void BitsetUPairMap<T>::Undo(const Journal& journal)
+{
+    BenzeneAssert(m_journal != &journal);
+    typedef typename std::vector<typename Journal::Op>::const_reverse_iterator
+        OpIterator;
+    for (OpIterator op = journal.m_ops.rbegin();
+         op != journal.m_ops.rend(); ++op)
+    {
+        switch (op->kind)
+        {
+        case Journal::PUT:
+        case Journal::PUT_REUSED:
+            Unlink(op->x, op->y);
+            m_arena.UndoNew(op->entry, op->kind == Journal::PUT_REUSED);
+            break;
+        case Journal::DELETE:
+            m_arena.UndoDelete(op->entry);
+            Link(op->x, op->y, op->entry);
+            break;
+        case Journal::VALUE:
+            *op->entry = journal.m_values[op->index];
+            break;
+        case Journal::RESET:
+        {
+            const typename Journal::ResetState& state
+                = journal.m_resets[op->index];
+            for (int i = 0; i < BITSETSIZE; i++)
+                if (m_xmap[i].Entries().any())
+                    m_xmap[i].ResetEntries();
+            m_arena.SetState(state.arena);
+            for (std::size_t i = 0; i < state.entries.size(); ++i)
+            {
+                const typename Journal::Op& e = state.entries[i];
+                Link(e.x, e.y, e.entry);
+                *e.entry = journal.m_values[e.index];
+            }
+            break;
+        }
+        }
+    }
+}
+
+template <class T>
+inline BitsetUPairMap<T>::Journal::Op::Op(Kind kind, HexPoint x, HexPoint y,
+                                          T* entry, std::size_t index)
+    : kind(kind), x(x), y(y), entry(entry), index(index)
+{
+}
+
+template <class T>
+inline void BitsetUPairMap<T>::Journal::SaveValue(T* entry)
 {
+    m_ops.push_back(Op(VALUE, INVALID_POINT, INVALID_POINT, entry,
+                       m_values.size()));
+    m_values.push_back(*entry);
 }
 
 template <class T>
-inline BitsetUPairMap<T>::Backup::NbsEntry::NbsEntry(HexPoint x)
-    : x(x)
+inline BitsetUPairMap<T>::Backup::Entry::Entry(HexPoint x, HexPoint y,
+                                               const T& t)
+    : x(x), y(y), t(t)
 {
 }
 
@@ -257,10 +409,8 @@ inline void BitsetUPairMap<T>::Backup::Create(BitsetUPairMap& map)
         const Nbs& nbs = map[(HexPoint)x];
         if (nbs.Entries().none())
             continue;
-        NbsEntry entry((HexPoint)x);
-        for (BitsetIterator y(nbs.Entries()); *y <= x; ++y)
-            entry.entries.push_back(TEntry(*y, nbs[*y]));
-        data.push_back(entry);
+        for (BitsetIterator y(nbs.Entries()); y && *y <= x; ++y)
+            data.push_back(Entry((HexPoint)x, *y, *nbs[*y]));
     }
 }
 
@@ -268,11 +418,9 @@ template <class T>
 inline void BitsetUPairMap<T>::Backup::Restore(BitsetUPairMap& map)
 {
     map.Reset();
-    for (typename std::vector<NbsEntry>::iterator entry = data.begin();
-         entry != data.end(); ++entry)
-        for (typename std::vector<TEntry>::iterator i = entry->entries.begin();
-            i != entry->entries.end(); ++i)
-            map.Put(entry->x, i->y, i->t);
+    for (typename std::vector<Entry>::const_iterator i = data.begin();
+         i != data.end(); ++i)
+        *map.Put(i->x, i->y) = i->t;
 }
 
 //----------------------------------------------------------------------------
@@ -0,0 +1,133 @@
+//----------------------------------------------------------------------------
+/** @file CarrierMatrix.hpp */
+//----------------------------------------------------------------------------
+
+#ifndef CARRIERMATRIX_HPP
+#define CARRIERMATRIX_HPP
+
+#include <algorithm>
+#include <boost/cstdint.hpp>
+
+#include "Hex.hpp"
+#include "VCS.hpp"
+
+_BEGIN_BENZENE_NAMESPACE_
+
+//----------------------------------------------------------------------------
+
+/** Carriers of one list stored bit-sliced: bit i of Cell(c) is set if
+    the i-th carrier contains cell c. Sets of carriers are word masks,
+    so filtering a set by a cell is a single and instead of a copy of
+    the carriers that remain. Bit order is list order. Used by the
+    or-rules in VCOr() for lists of at most MAX_CARRIERS carriers. */
+class CarrierMatrix
+{
+public:
+    typedef boost::uint64_t Mask;
+
+    static const std::size_t MAX_CARRIERS = 64;
+
+    explicit CarrierMatrix(const CarrierList& carriers);
+
+    /** All carriers. */
+    Mask All() const;
+
+    /** Carriers not yet processed. */
+    Mask New() const;
+
+    const bitset_t& Carrier(std::size_t i) const;
+
+    /** Carriers containing cell c. */
+    Mask Cell(std::size_t c) const;
+
+    /** Carriers in set that are supersets of cells. */
+    Mask SupersetsOf(Mask set, const bitset_t& cells) const;
+
+    /** Intersection of the carriers in set; all cells if set is
+        empty. */
+    bitset_t Intersection(Mask set) const;
+
+    /** Index of the lowest carrier in set, which must not be
+        empty. */
+    static std::size_t First(Mask set);
+
+private:
+    std::size_t m_count;
+
+    Mask m_new;
+
+    bitset_t m_carriers[MAX_CARRIERS];
+
+    Mask m_cells[BITSETSIZE];
+};
+
+inline CarrierMatrix::CarrierMatrix(const CarrierList& carriers)
+    : m_count(0),
+      m_new(0)
+{
+    BenzeneAssert(static_cast<std::size_t>(carriers.Count())
+                  <= MAX_CARRIERS);
+    std::fill(m_cells, m_cells + BITSETSIZE, Mask(0));
+    for (CarrierList::Iterator i(carriers); i; ++i, ++m_count)
+    {
+        const Mask bit = Mask(1) << m_count;
+        m_carriers[m_count] = i.Carrier();
+        if (!i.Old())
+            m_new |= bit;
+        const bitset_t& carrier = i.Carrier();
+        for (std::size_t c = carrier._Find_first(); c < BITSETSIZE;
+             c = carrier._Find_next(c))
+            m_cells[c] |= bit;
+    }
+}
+
+inline CarrierMatrix::Mask CarrierMatrix::All() const
+{
+    return m_count == MAX_CARRIERS ? ~Mask(0) : (Mask(1) << m_count) - 1;
+}
+
+inline CarrierMatrix::Mask CarrierMatrix::New() const
+{
+    return m_new;
+}
+
+inline const bitset_t& CarrierMatrix::Carrier(std::size_t i) const
+{
+    return m_carriers[i];
+}
+
+inline CarrierMatrix::Mask CarrierMatrix::Cell(std::size_t c) const
+{
+    return m_cells[c];
+}
+
+inline CarrierMatrix::Mask CarrierMatrix::SupersetsOf(Mask set,
+                                                      const bitset_t& cells)
+    const
+{
+    for (std::size_t c = cells._Find_first(); set && c < BITSETSIZE;
+         c = cells._Find_next(c))
+        set &= m_cells[c];
+    return set;
+}
+
+inline bitset_t CarrierMatrix::Intersection(Mask set) const
+{
+    bitset_t result;
+    result.set();
+    for (; set; set &= set - 1)
+        result &= m_carriers[First(set)];
+    return result;
+}
+
+inline std::size_t CarrierMatrix::First(Mask set)
+{
+    BenzeneAssert(set);
+    return static_cast<std::size_t>(__builtin_ctzll(set));
+}
+
+//----------------------------------------------------------------------------
+
+_END_BENZENE_NAMESPACE_
+
+#endif // CARRIERMATRIX_HPP
@@ -61,8 +61,87 @@ void GroupBuilder::Build(const StoneBoard& brd, Groups& groups)
     {
         Group& g = groups.m_groups[i];
         g.m_nbs = groups.CaptainizeBitset(g.m_nbs);
-        for (BitsetIterator p(g.m_nbs); p; ++p)
-            g.m_nbs_index.push_back(groups.m_group_index[*p]);
+    }
+}
+
+/** A stone added next to a group of its color, or next to another
+    added stone of its color, joins it. Groups are then copied in
+    captain order; the captain of a merged group is the smallest
+    captain among its parts, so it takes the place of that part. */
+void GroupBuilder::Update(const StoneBoard& brd, const Groups& old,
+                          const bitset_t& added, Groups& groups)
+{
+    BenzeneAssert(&groups != &old);
+    // Captains in old of all groups that are merged, and the captain
+    // of the group each of them is merged into.
+    bitset_t parts;
+    HexPoint newCaptain[BITSETSIZE];
+    for (BitsetIterator p(added); p; ++p)
+    {
+        if (parts.test(*p))
+            continue;
+        BenzeneAssert(old.GetGroup(*p).Color() == EMPTY);
+        HexColor color = brd.GetColor(*p);
+        bitset_t comp;
+        comp.set(*p);
+        bitset_t frontier = comp;
+        while (frontier.any())
+        {
+            bitset_t next;
+            for (BitsetIterator q(frontier); q; ++q)
+                for (BitsetIterator n(old.m_groups[old.m_group_index[*q]]
+                                      .m_nbs - comp); n; ++n)
+                    if (old.GetGroup(*n).Color() == color
+                        || (added.test(*n) && brd.GetColor(*n) == color))
+                        next.set(*n);
+            comp |= next;
+            frontier = next;
+        }
+        HexPoint captain = static_cast<HexPoint>(comp._Find_first());
+        for (BitsetIterator q(comp); q; ++q)
+            newCaptain[*q] = captain;
+        parts |= comp;
+    }
+
+    groups.m_brd = const_cast<StoneBoard*>(&brd);
+    groups.m_groups.clear();
+    groups.m_groups.reserve(old.m_groups.size());
+    groups.m_group_index.resize(FIRST_INVALID);
+    for (std::size_t i = 0; i < old.m_groups.size(); ++i)
+    {
+        const Group& g = old.m_groups[i];
+        bitset_t members = g.m_members;
+        bitset_t nbs = g.m_nbs;
+        HexColor color = g.m_color;
+        if (parts.test(g.m_captain))
+        {
+            if (newCaptain[g.m_captain] != g.m_captain)
+                continue;
+            // First part of a merged group: collect all parts.
+            bitset_t comp;
+            for (BitsetIterator q(parts); q; ++q)
+                if (newCaptain[*q] == g.m_captain)
+                    comp.set(*q);
+            color = brd.GetColor(g.m_captain);
+            members.reset();
+            nbs.reset();
+            for (BitsetIterator q(comp); q; ++q)
+            {
+                const Group& part = old.m_groups[old.m_group_index[*q]];
+                members |= part.m_members;
+                nbs |= part.m_nbs;
+            }
+            nbs -= comp;
+        }
+        for (BitsetIterator q(nbs & parts); q; ++q)
+        {
+            nbs.reset(*q);
+            nbs.set(newCaptain[*q]);
+        }
+        for (BitsetIterator m(members); m; ++m)
+            groups.m_group_index[*m] = groups.m_groups.size();
+        groups.m_groups.push_back(Group(&groups, color, g.m_captain,
+                                        members, nbs));
     }
 }
 
@@ -128,11 +207,11 @@ void Group::ComputeColorsetNbs() const
     for (int cs = 0; cs < NUM_COLOR_SETS; ++cs) 
     {
         HexColorSet colorset = static_cast<HexColorSet>(cs);
-        for (std::size_t i = 0; i < m_nbs_index.size(); ++i)
+        for (BitsetIterator p(m_nbs); p; ++p)
         {
-            const Group* nb = &m_groups->m_groups[m_nbs_index[i]];
-            if (HexColorSetUtil::InSet(nb->Color(), colorset))
-                m_nbs_colorset[colorset].set(nb->Captain());
+            const Group& nb = m_groups->GetGroup(*p);
+            if (HexColorSetUtil::InSet(nb.Color(), colorset))
+                m_nbs_colorset[colorset].set(nb.Captain());
         }
     }
 }
@@ -69,11 +69,6 @@ private:
     /** Pointer to Groups object which this Group belongs. */
     const Groups* m_groups;
 
-    /** Indices of neighbouring groups in parent Groups's list of
-        groups. We don't use pointers because then it would be
-        difficult to copy a Groups object. */
-    std::vector<std::size_t> m_nbs_index;
-
     /** True if the colorset neighbours have been computed yet. */
     mutable bool m_colorsets_computed;
 
@@ -410,6 +405,13 @@ public:
     /** Computes Groups. */
     static void Build(const StoneBoard& brd, Groups& groups);
 
+    /** Computes in groups the Groups of brd from the Groups old of
+        the position before the stones in added were placed. Only
+        the groups around added are merged; the result is the same
+        as Build(brd, groups). */
+    static void Update(const StoneBoard& brd, const Groups& old,
+                       const bitset_t& added, Groups& groups);
+
 private:
 
 };
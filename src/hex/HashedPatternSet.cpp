@@ -9,7 +9,8 @@ using namespace benzene;
 //----------------------------------------------------------------------------
 
 HashedPatternSet::HashedPatternSet()
-    : m_godel_list(RingGodel::ValidGodels().size())
+    : m_godel_list(RingGodel::ValidGodels().size()),
+      m_godel_masks(RingGodel::ValidGodels().size())
 {
 }
 
@@ -41,6 +42,51 @@ void HashedPatternSet::Hash(const PatternSet& patterns)
             }
         }
     }
+    for (std::size_t h = 0; h < valid_godels.size(); ++h)
+        ComputeMasks(h);
+}
+
+/** Lays out the slice checks of PatternState::CheckRotatedSlices()
+    for each pattern of list index. A pattern matches if, for each
+    slice, no stone is on its empty cells and all its black and white
+    cells hold stones of that color. A pattern whose black or white
+    cells are not among its cells can never match; it gets masks that
+    no board passes. */
+void HashedPatternSet::ComputeMasks(std::size_t index)
+{
+    const RotatedPatternList& list = m_godel_list[index];
+    const std::size_t blocks = (list.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::vector<int>& masks = m_godel_masks[index];
+    masks.assign(blocks * BLOCK_INTS, 0);
+    for (std::size_t k = list.size(); k < blocks * BLOCK_SIZE; ++k)
+    {
+        int* m = &masks[(k / BLOCK_SIZE) * BLOCK_INTS + k % BLOCK_SIZE];
+        for (int i = 0; i < Pattern::NUM_SLICES; ++i, m += 3 * BLOCK_SIZE)
+            m[0] = m[BLOCK_SIZE] = m[2 * BLOCK_SIZE] = ~0;
+    }
+    for (std::size_t k = 0; k < list.size(); ++k)
+    {
+        const Pattern& pattern = *list[k].GetPattern();
+        if (pattern.Extension() <= 1)
+            continue;
+        const Pattern::slice_t* pat = pattern.GetData();
+        int* m = &masks[(k / BLOCK_SIZE) * BLOCK_INTS + k % BLOCK_SIZE];
+        for (int i = 0; i < Pattern::NUM_SLICES; ++i, m += 3 * BLOCK_SIZE)
+        {
+            const int j = (list[k].Angle() + i) % Pattern::NUM_SLICES;
+            const int cells = pat[j][Pattern::FEATURE_CELLS];
+            const int black = pat[j][Pattern::FEATURE_BLACK];
+            const int white = pat[j][Pattern::FEATURE_WHITE];
+            if ((black & ~cells) || (white & ~cells))
+            {
+                m[0] = m[BLOCK_SIZE] = m[2 * BLOCK_SIZE] = ~0;
+                continue;
+            }
+            m[0] = (cells - black - white) & cells;
+            m[BLOCK_SIZE] = black;
+            m[2 * BLOCK_SIZE] = white;
+        }
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -19,6 +19,10 @@ _BEGIN_BENZENE_NAMESPACE_
     to check if a set of patterns matches a cell extremely quickly;
     especially if the patterns have a max extension of one, since in
     that case no checking is actually required!
+
+    The slice masks of each list are also stored as a structure of
+    arrays, so that MatchBlock() can check the slices of BLOCK_SIZE
+    patterns at once with vector instructions.
 */
 class HashedPatternSet
 {
@@ -35,12 +39,108 @@ public:
     /** Returns list of rotated patterns for godel. */
     const RotatedPatternList& ListForGodel(const RingGodel& godel) const;
 
+    /** Number of patterns checked by MatchBlock(). */
+    static const int BLOCK_SIZE = 8;
+
+    /** Checks patterns [block * BLOCK_SIZE, (block + 1) * BLOCK_SIZE)
+        of ListForGodel(godel) against the black and white slice godels
+        of a cell whose ring godel is godel. Returns a mask with bit i
+        set if pattern block * BLOCK_SIZE + i matches. */
+    unsigned MatchBlock(const RingGodel& godel, std::size_t block,
+                        const int* black, const int* white) const;
+
 private:
+    /** Ints per block in m_godel_masks. */
+    static const int BLOCK_INTS = Pattern::NUM_SLICES * 3 * BLOCK_SIZE;
+
     /** Will contain a RotatedPatternList for each of
         RingGodel::ValidGodels(). */
     std::vector<RotatedPatternList> m_godel_list;
+
+    /** Slice masks of the patterns in m_godel_list, BLOCK_INTS per
+        block of BLOCK_SIZE patterns. For each board slice, a block
+        holds the cells that must be empty, black and white for each
+        pattern. Patterns with extension one need no check and have
+        empty masks; lanes past the end of the list never match. */
+    std::vector<std::vector<int> > m_godel_masks;
+
+    void ComputeMasks(std::size_t index);
 };
 
+inline unsigned HashedPatternSet::MatchBlock(const RingGodel& godel,
+                                             std::size_t block,
+                                             const int* black,
+                                             const int* white) const
+{
+    const std::size_t index = godel.Index();
+    const int* m = &m_godel_masks[index][block * BLOCK_INTS];
+    unsigned match;
+#if BENZENE_BITSET_SIMD && defined(__AVX2__)
+    __m256i fail = _mm256_setzero_si256();
+    for (int i = 0; i < Pattern::NUM_SLICES; ++i, m += 3 * BLOCK_SIZE)
+    {
+        const __m256i b = _mm256_set1_epi32(black[i]);
+        const __m256i w = _mm256_set1_epi32(white[i]);
+        const __m256i* v = reinterpret_cast<const __m256i*>(m);
+        fail = _mm256_or_si256(fail, _mm256_and_si256
+                               (_mm256_or_si256(b, w),
+                                _mm256_loadu_si256(v)));
+        fail = _mm256_or_si256(fail, _mm256_andnot_si256
+                               (b, _mm256_loadu_si256(v + 1)));
+        fail = _mm256_or_si256(fail, _mm256_andnot_si256
+                               (w, _mm256_loadu_si256(v + 2)));
+        const __m256i pass = _mm256_cmpeq_epi32(fail, _mm256_setzero_si256());
+        if (_mm256_testz_si256(pass, pass))
+            return 0;
+    }
+    match = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps
+        (_mm256_cmpeq_epi32(fail, _mm256_setzero_si256()))));
+#elif BENZENE_BITSET_SIMD
+    __m128i fail0 = _mm_setzero_si128();
+    __m128i fail1 = _mm_setzero_si128();
+    for (int i = 0; i < Pattern::NUM_SLICES; ++i, m += 3 * BLOCK_SIZE)
+    {
+        const __m128i b = _mm_set1_epi32(black[i]);
+        const __m128i w = _mm_set1_epi32(white[i]);
+        const __m128i bw = _mm_or_si128(b, w);
+        const __m128i* v = reinterpret_cast<const __m128i*>(m);
+        fail0 = _mm_or_si128(fail0, _mm_and_si128(bw, _mm_loadu_si128(v)));
+        fail1 = _mm_or_si128(fail1,
+                             _mm_and_si128(bw, _mm_loadu_si128(v + 1)));
+        fail0 = _mm_or_si128(fail0, _mm_andnot_si128
+                             (b, _mm_loadu_si128(v + 2)));
+        fail1 = _mm_or_si128(fail1, _mm_andnot_si128
+                             (b, _mm_loadu_si128(v + 3)));
+        fail0 = _mm_or_si128(fail0, _mm_andnot_si128
+                             (w, _mm_loadu_si128(v + 4)));
+        fail1 = _mm_or_si128(fail1, _mm_andnot_si128
+                             (w, _mm_loadu_si128(v + 5)));
+        const __m128i pass = _mm_or_si128
+            (_mm_cmpeq_epi32(fail0, _mm_setzero_si128()),
+             _mm_cmpeq_epi32(fail1, _mm_setzero_si128()));
+        if (_mm_testz_si128(pass, pass))
+            return 0;
+    }
+    const __m128i zero = _mm_setzero_si128();
+    match = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps
+                (_mm_cmpeq_epi32(fail0, zero))))
+        | static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps
+                (_mm_cmpeq_epi32(fail1, zero)))) << 4;
+#else
+    int fail[BLOCK_SIZE] = { 0 };
+    for (int i = 0; i < Pattern::NUM_SLICES; ++i, m += 3 * BLOCK_SIZE)
+        for (int j = 0; j < BLOCK_SIZE; ++j)
+            fail[j] |= ((black[i] | white[i]) & m[j])
+                | (~black[i] & m[BLOCK_SIZE + j])
+                | (~white[i] & m[2 * BLOCK_SIZE + j]);
+    match = 0;
+    for (int j = 0; j < BLOCK_SIZE; ++j)
+        if (fail[j] == 0)
+            match |= 1u << j;
+#endif
+    return match;
+}
+
 //----------------------------------------------------------------------------
 
 _END_BENZENE_NAMESPACE_
@@ -5,12 +5,18 @@
 #include "SgSystem.h"
 #include "SgTimer.h"
 
+#include <exception>
+#include <boost/thread.hpp>
+#include <boost/thread/barrier.hpp>
+
 #include "BitsetIterator.hpp"
 #include "BoardUtil.hpp"
 #include "Decompositions.hpp"
 #include "HexColor.hpp"
 #include "Groups.hpp"
 #include "PatternState.hpp"
+#include "VCCache.hpp"
+#include "VCPattern.hpp"
 #include "VCS.hpp"
 #include "HexBoard.hpp"
 #include "VCUtil.hpp"
@@ -19,6 +25,173 @@ using namespace benzene;
 
 //----------------------------------------------------------------------------
 
+/** Persistent helper thread used for VCBuilderParam::parallel_builds.
+    Builds the white connection set while the owning thread builds the
+    black one. Both builds only read the board, groups and pattern
+    state, apart from PatternState's match statistics, which are
+    atomic. */
+class HexBoard::VCBuildWorker
+{
+public:
+    VCBuildWorker();
+
+    ~VCBuildWorker();
+
+    /** Starts a from-scratch build of vcs on the helper thread. */
+    void StartBuild(VCS& vcs, VCBuilderParam& param,
+                    const Groups& groups, const PatternState& patterns);
+
+    /** Starts an incremental build of vcs on the helper thread. */
+    void StartBuild(VCS& vcs, VCBuilderParam& param,
+                    const Groups& oldGroups, const Groups& newGroups,
+                    const PatternState& patterns,
+                    bitset_t added[BLACK_AND_WHITE], bool use_changelog);
+
+    /** Blocks until the last started build is finished. Rethrows
+        the exception the build failed with, if any. */
+    void Wait();
+
+private:
+    /** Copyable object run in a boost::thread. */
+    class Thread
+    {
+    public:
+        Thread(VCBuildWorker& boss);
+
+        void operator()();
+
+    private:
+        VCBuildWorker& m_boss;
+    };
+
+    friend class Thread;
+
+    /** Arguments of the build to run. */
+    struct Job
+    {
+        VCS* vcs;
+        VCBuilderParam* param;
+        const Groups* oldGroups;
+        const Groups* newGroups;
+        const PatternState* patterns;
+        bitset_t* added;
+        bool use_changelog;
+    };
+
+    Job m_job;
+
+    /** Flag telling the thread to exit. */
+    bool m_quit;
+
+    /** Exception a failed build threw; null on success. */
+    std::exception_ptr m_error;
+
+    /** Thread blocks on this barrier until told to start. */
+    boost::barrier m_startWork;
+
+    /** Thread blocks on this barrier until the build is finished. */
+    boost::barrier m_workFinished;
+
+    boost::thread m_thread;
+
+    void Run();
+};
+
+HexBoard::VCBuildWorker::VCBuildWorker()
+    : m_quit(false),
+      m_startWork(2),
+      m_workFinished(2),
+      m_thread(Thread(*this))
+{
+}
+
+HexBoard::VCBuildWorker::~VCBuildWorker()
+{
+    m_quit = true;
+    m_startWork.wait();
+    m_thread.join();
+}
+
+HexBoard::VCBuildWorker::Thread::Thread(VCBuildWorker& boss)
+    : m_boss(boss)
+{
+}
+
+void HexBoard::VCBuildWorker::Thread::operator()()
+{
+    while (true)
+    {
+        m_boss.m_startWork.wait();
+        if (m_boss.m_quit)
+            break;
+        m_boss.Run();
+        m_boss.m_workFinished.wait();
+    }
+}
+
+void HexBoard::VCBuildWorker::Run()
+{
+    m_error = std::exception_ptr();
+    try
+    {
+        if (m_job.oldGroups)
+            m_job.vcs->Build(*m_job.param, *m_job.oldGroups,
+                             *m_job.newGroups, *m_job.patterns,
+                             m_job.added, m_job.use_changelog);
+        else
+            m_job.vcs->Build(*m_job.param, *m_job.newGroups,
+                             *m_job.patterns);
+    }
+    catch (...)
+    {
+        m_error = std::current_exception();
+    }
+}
+
+void HexBoard::VCBuildWorker::StartBuild(VCS& vcs, VCBuilderParam& param,
+                                         const Groups& groups,
+                                         const PatternState& patterns)
+{
+    m_job.vcs = &vcs;
+    m_job.param = &param;
+    m_job.oldGroups = 0;
+    m_job.newGroups = &groups;
+    m_job.patterns = &patterns;
+    m_job.added = 0;
+    m_job.use_changelog = false;
+    m_startWork.wait();
+}
+
+void HexBoard::VCBuildWorker::StartBuild(VCS& vcs, VCBuilderParam& param,
+                                         const Groups& oldGroups,
+                                         const Groups& newGroups,
+                                         const PatternState& patterns,
+                                         bitset_t added[BLACK_AND_WHITE],
+                                         bool use_changelog)
+{
+    m_job.vcs = &vcs;
+    m_job.param = &param;
+    m_job.oldGroups = &oldGroups;
+    m_job.newGroups = &newGroups;
+    m_job.patterns = &patterns;
+    m_job.added = added;
+    m_job.use_changelog = use_changelog;
+    m_startWork.wait();
+}
+
+void HexBoard::VCBuildWorker::Wait()
+{
+    m_workFinished.wait();
+    if (m_error)
+    {
+        std::exception_ptr error = m_error;
+        m_error = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+//----------------------------------------------------------------------------
+
 HexBoard::HexBoard(int width, int height, const ICEngine& ice,
                    VCBuilderParam& param)
     : m_brd(width, height), 
@@ -45,6 +218,7 @@ HexBoard::HexBoard(const HexBoard& other)
       m_groups(other.m_groups),
       m_patterns(m_brd),
       m_history(other.m_history),
+      m_history_inf(other.m_history_inf),
       m_inf(other.m_inf),
       m_use_vcs(other.m_use_vcs),
       m_use_ice(other.m_use_ice),
@@ -76,13 +250,82 @@ HexPoint HexBoard::ComputeInferiorCells(HexColor color_to_move,
 	  m_ice->ComputeInferiorCells(color_to_move, m_groups,
 				      m_patterns, inf, last_move,
 				      only_around_last_move);
-	IceUtil::Update(m_inf, inf);
+	UpdateInferiorCells(inf);
 	return reverser;
     }
 }
 
+HexBoard::VCBuildWorker& HexBoard::GetVCBuildWorker()
+{
+    if (!m_vc_worker)
+        m_vc_worker.reset(new VCBuildWorker());
+    // VCPattern builds its pattern lists and indexes lazily; do it
+    // here so that the two builds only read them.
+    if (m_builder_param.use_patterns)
+        for (BWIterator c; c; ++c)
+            VCPattern::GetIndex(Width(), Height(), *c);
+    return *m_vc_worker;
+}
+
+/** Loads the connections of each color from the VCCache if
+    possible, builds the others and stores them in the cache. */
+void HexBoard::BuildCachedVCs()
+{
+    VCCache& cache = VCCache::Global();
+    ZobristHash zobrist(Width(), Height());
+    zobrist.Compute(m_brd.GetColor(BLACK), m_brd.GetColor(WHITE));
+    const SgHashCode hash = zobrist.Hash();
+    const unsigned settings = m_builder_param.ResultSettings();
+    for (BWIterator c; c; ++c)
+    {
+        VCCache::DataPtr data = cache.Get(hash, *c, settings);
+        if (data)
+            m_cons[*c]->Load(m_builder_param, m_groups, m_patterns, *data);
+        else
+        {
+            m_cons[*c]->Build(m_builder_param, m_groups, m_patterns);
+            if (m_cons[*c]->IsPartial())
+                continue;
+            boost::shared_ptr<VCCacheData> built(new VCCacheData());
+            m_cons[*c]->Store(*built);
+            cache.Put(hash, *c, settings, built);
+        }
+    }
+}
+
 void HexBoard::BuildVCs()
 {
+    if (m_builder_param.use_cache)
+    {
+        BuildCachedVCs();
+        return;
+    }
+    if (m_builder_param.parallel_builds)
+    {
+        VCBuildWorker& worker = GetVCBuildWorker();
+        worker.StartBuild(*m_cons[WHITE], m_builder_param, m_groups,
+                          m_patterns);
+        // The white build uses m_groups and m_patterns, so it must be
+        // finished before an exception leaves this function
+        try
+        {
+            m_cons[BLACK]->Build(m_builder_param, m_groups, m_patterns);
+        }
+        catch (...)
+        {
+            // Report the first error only
+            try
+            {
+                worker.Wait();
+            }
+            catch (...)
+            {
+            }
+            throw;
+        }
+        worker.Wait();
+        return;
+    }
     for (BWIterator c; c; ++c)
         m_cons[*c]->Build(m_builder_param, m_groups, m_patterns);
 }
@@ -91,6 +334,31 @@ void HexBoard::BuildVCs(const Groups& oldGroups,
                         bitset_t added[BLACK_AND_WHITE], bool use_changelog)
 {
     BenzeneAssert((added[BLACK] & added[WHITE]).none());
+    if (m_builder_param.parallel_builds)
+    {
+        VCBuildWorker& worker = GetVCBuildWorker();
+        worker.StartBuild(*m_cons[WHITE], m_builder_param, oldGroups,
+                          m_groups, m_patterns, added, use_changelog);
+        try
+        {
+            m_cons[BLACK]->Build(m_builder_param, oldGroups, m_groups,
+                                 m_patterns, added, use_changelog);
+        }
+        catch (...)
+        {
+            // Report the first error only
+            try
+            {
+                worker.Wait();
+            }
+            catch (...)
+            {
+            }
+            throw;
+        }
+        worker.Wait();
+        return;
+    }
     for (BWIterator c; c; ++c)
         m_cons[*c]->Build(m_builder_param, oldGroups, m_groups,
 			  m_patterns, added, use_changelog);
@@ -128,6 +396,7 @@ void HexBoard::HandleVCDecomposition(HexColor color_to_move)
 			  << *c << ".\n" << m_brd.Write(fillin) << '\n';
             
                 AddStones(*c, fillin, color_to_move);
+                SaveInferiorCells();
                 m_inf.AddFillin(*c, fillin);
             
                 LogFine() << "After decomposition " << decompositions 
@@ -151,6 +420,7 @@ HexPoint HexBoard::ComputeAll(HexColor color_to_move, HexPoint last_move,
 
     m_patterns.Update();
     GroupBuilder::Build(m_brd, m_groups);
+    SaveInferiorCells();
     m_inf.Clear();
 
     Groups old_groups(m_groups);
@@ -195,8 +465,7 @@ void HexBoard::PlayMove(HexColor color, HexPoint cell)
 
     m_brd.PlayMove(color, cell);
     m_patterns.Update(cell);
-    Groups oldGroups(m_groups);
-    GroupBuilder::Build(m_brd, m_groups);
+    const Groups& oldGroups = SaveGroups();
 
     ComputeInferiorCells(!color);
 
@@ -222,15 +491,14 @@ void HexBoard::TryMove(HexColor color, HexPoint cell)
 
     m_brd.PlayMove(color, cell);
     m_patterns.Update(cell);
-    Groups oldGroups(m_groups);
-    GroupBuilder::Build(m_brd, m_groups);
+    const Groups& oldGroups = SaveGroups();
 
     if (m_use_ice) 
     {
         InferiorCells inf;
         m_ice->ComputeFillin(m_groups, m_patterns, inf, color,
 			     ICEngine::MONOCOLOR_USING_CAPTURED);
-        IceUtil::Update(m_inf, inf);
+        UpdateInferiorCells(inf);
     }
     
     if (m_use_vcs)
@@ -257,8 +525,7 @@ void HexBoard::PlayStones(HexColor color, const bitset_t& played,
 
     m_brd.AddColor(color, played);
     m_patterns.Update(played);
-    Groups oldGroups(m_groups);
-    GroupBuilder::Build(m_brd, m_groups);
+    const Groups& oldGroups = SaveGroups();
 
     ComputeInferiorCells(color_to_move);
 
@@ -294,7 +561,7 @@ void HexBoard::AddStones(HexColor color, const bitset_t& played,
     m_brd.AddColor(color, played);
     m_patterns.Update(played);
     Groups oldGroups(m_groups);
-    GroupBuilder::Build(m_brd, m_groups);
+    GroupBuilder::Update(m_brd, oldGroups, played, m_groups);
 
     ComputeInferiorCells(color_to_move);
 
@@ -326,7 +593,59 @@ void HexBoard::ClearHistory()
 
 void HexBoard::PushHistory(HexColor color, HexPoint cell)
 {
-    m_history.push_back(History(m_brd, m_groups, m_inf, color, cell));
+    m_history.push_back(History(m_brd, color, cell));
+    if (m_history_inf.size() < m_history.size())
+        m_history_inf.resize(m_history.size());
+}
+
+/** Slot of the last history entry in m_history_inf. */
+InferiorCells& HexBoard::SavedInferiorCells()
+{
+    BenzeneAssert(!m_history.empty());
+    return m_history_inf[m_history.size() - 1];
+}
+
+/** Moves the groups into the last history entry and updates them
+    with the stones added since. Returns the old groups. */
+const Groups& HexBoard::SaveGroups()
+{
+    BenzeneAssert(!m_history.empty());
+    History& hist = m_history.back();
+    std::swap(hist.groups, m_groups);
+    bitset_t added = (m_brd.GetBlack() | m_brd.GetWhite())
+        - (hist.black | hist.white);
+    GroupBuilder::Update(m_brd, hist.groups, added, m_groups);
+    return hist.groups;
+}
+
+/** Copies the inferior cells into the last history entry unless it
+    already holds them. Must be called before changing m_inf other
+    than through UpdateInferiorCells(). */
+void HexBoard::SaveInferiorCells()
+{
+    if (!m_history.empty() && !m_history.back().inf_saved)
+    {
+        SavedInferiorCells() = m_inf;
+        m_history.back().inf_saved = true;
+    }
+}
+
+/** Updates the inferior cells with inf, see IceUtil::Update(). The
+    first update after PushHistory() moves the old cells into the
+    history entry. */
+void HexBoard::UpdateInferiorCells(const InferiorCells& inf)
+{
+    if (!m_history.empty() && !m_history.back().inf_saved)
+    {
+        InferiorCells& saved = SavedInferiorCells();
+        saved.Swap(m_inf);
+        m_history.back().inf_saved = true;
+        m_inf.Clear();
+        for (BWIterator c; c; ++c)
+            m_inf.AddFillin(*c, saved.Fillin(*c));
+    }
+    // Keeps only the fillin of the old cells
+    IceUtil::Update(m_inf, inf);
 }
 
 /** Restores the old board position, backs up ice info, and reverts
@@ -335,38 +654,52 @@ void HexBoard::PopHistory()
 {
     BenzeneAssert(!m_history.empty());
 
-    History hist = m_history.back();
+    History& hist = m_history.back();
+
+    // Stones are only ever added, so the old black stones are
+    // disjoint from the current white ones.
+    m_brd.SetColor(BLACK, hist.black);
+    m_brd.SetColor(WHITE, hist.white);
+    m_brd.SetPlayed(hist.played);
+    // If the move did not change the inferior cells, it added no
+    // fillin to back up either.
+    if (hist.inf_saved)
+    {
+        InferiorCells& saved = SavedInferiorCells();
+        if (m_backup_ice_info && hist.last_played != INVALID_POINT)
+            AddBackupIceInfo(hist, saved);
+        m_inf.Swap(saved);
+    }
+    std::swap(m_groups, hist.groups);
     m_history.pop_back();
+    RevertVCs();
+}
+
+/** Cells that were not marked as inferior in the parent state and
+    are monocolor-filled after the move are marked as dominated by
+    the move in inf, the inferior cells of the parent state. */
+void HexBoard::AddBackupIceInfo(const History& hist,
+                                InferiorCells& inf) const
+{
+    // @warning : this may give wrong pruning if the fill was
+    // not monocolor
+    bitset_t a = m_brd.GetEmpty() - inf.All();
+    a &= m_inf.Fillin(hist.to_play);
 
-    m_brd.SetPosition(hist.board);
-    if (m_backup_ice_info && hist.last_played != INVALID_POINT)
+    for (BitsetIterator p(a); p; ++p)
+        inf.AddInferior(*p, hist.last_played);
+
+    if (m_brd.IsSelfRotation())
     {
-        // Cells that were not marked as inferior in parent state
-        // and are monocolor-filled are marked as dominated.
-        // @warning : this may give wrong pruning if the fill was
-        // not monocolor
-        bitset_t a = m_brd.GetEmpty() - hist.inf.All();
-        a &= m_inf.Fillin(hist.to_play);
-	
+        // In this case, the computation is done on only half of the
+        // board, and we want EndgameUtil::RemoveRotation to work
+        // properly, which forces to add the symetrical inferior.
+        HexPoint rot_last_played =
+            BoardUtil::Rotate(m_brd.Const(), hist.last_played);
         for (BitsetIterator p(a); p; ++p)
-            hist.inf.AddInferior(*p, hist.last_played);
-
-	if (m_brd.IsSelfRotation())
-	{
-	    // In this case, the computation is done on only half of the
-	    // board, and we want EndgameUtil::RemoveRotation to work
-	    // properly, which forces to add the symetrical inferior.
-	    HexPoint rot_last_played =
-	      BoardUtil::Rotate(m_brd.Const(), hist.last_played);
-	    for (BitsetIterator p(a); p; ++p)
-	        hist.inf.AddInferior
-		  (BoardUtil::Rotate(m_brd.Const(), *p), rot_last_played);
-	}
-		   
+            inf.AddInferior(BoardUtil::Rotate(m_brd.Const(), *p),
+                            rot_last_played);
     }
-    m_inf = hist.inf;
-    m_groups = hist.groups;
-    RevertVCs();
 }
 
 //----------------------------------------------------------------------------
@@ -151,17 +151,27 @@ public:
 
 private:
     
-    /** Stores state of the board. */
+    /** Undo record of one move.
+        Groups and inferior cells are swapped in when the move
+        replaces them, so they are never copied. The inferior cells
+        are kept in m_history_inf. */
     struct History
     {
-        /** Saved board state. */
-        StoneBoard board;
+        /** Stones of this board state. */
+        bitset_t black;
 
-        /** Groups on this board state. */
+        bitset_t white;
+
+        bitset_t played;
+
+        /** Groups on this board state; set by SaveGroups(). */
         Groups groups;
 
-        /** The inferior cell data for this state. */
-        InferiorCells inf;
+        /** Whether the inferior cell data for this state was moved
+            to m_history_inf by UpdateInferiorCells() or
+            SaveInferiorCells(). Otherwise the move did not change
+            the inferior cells. */
+        bool inf_saved;
 
         /** Color to play from this state. */
         HexColor to_play;
@@ -169,9 +179,10 @@ private:
         /** Move last played from this state. */
         HexPoint last_played;
 
-        History(const StoneBoard& b, const Groups& g, const InferiorCells& i, 
-                HexColor tp, HexPoint lp)
-            : board(b), groups(g), inf(i), to_play(tp), last_played(lp) 
+        History(const StoneBoard& b, HexColor tp, HexPoint lp)
+            : black(b.GetBlack()), white(b.GetWhite()),
+              played(b.GetPlayed()), inf_saved(false),
+              to_play(tp), last_played(lp)
         { }
     };
 
@@ -196,9 +207,21 @@ private:
     /** Connection sets for black and white. */
     boost::scoped_ptr<VCS> m_cons[BLACK_AND_WHITE];
 
+    class VCBuildWorker;
+
+    /** Helper thread for VCBuilderParam::parallel_builds.
+        Created on first use; not copied by the copy constructor. */
+    boost::scoped_ptr<VCBuildWorker> m_vc_worker;
+
     /** History stack. */
     std::vector<History> m_history;
 
+    /** Saved inferior cells of each entry of m_history. Never
+        shrinks, so that the sets are reused by later moves instead
+        of being built for each one; only entries with inf_saved
+        hold data. */
+    std::vector<InferiorCells> m_history_inf;
+
     /** The set of inferior cells for the current boardstate. */
     InferiorCells m_inf;
 
@@ -232,6 +255,10 @@ private:
 
     void RevertVCs();
 
+    void BuildCachedVCs();
+
+    VCBuildWorker& GetVCBuildWorker();
+
     void HandleVCDecomposition(HexColor color_to_move);
 
     void AddStones(HexColor color, const bitset_t& played,
@@ -242,6 +269,16 @@ private:
     void PushHistory(HexColor color, HexPoint cell);
 
     void PopHistory();
+
+    const Groups& SaveGroups();
+
+    InferiorCells& SavedInferiorCells();
+
+    void AddBackupIceInfo(const History& hist, InferiorCells& inf) const;
+
+    void SaveInferiorCells();
+
+    void UpdateInferiorCells(const InferiorCells& inf);
 };
 
 inline StoneBoard& HexBoard::GetPosition()
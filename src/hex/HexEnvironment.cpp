@@ -101,7 +101,9 @@ void HexEnvironmentCommands::ParamICE(HtpCommand& cmd)
 	    << "[bool] find_reversible "
             << ice.FindReversible() << '\n'
 	    << "[bool] use_s_reversible_as_reversible "
-            << ice.UseSReversibleAsReversible() << '\n';
+            << ice.UseSReversibleAsReversible() << '\n'
+            << "[bool] use_cache "
+            << ice.UseCache() << '\n';
     }
     else if (cmd.NuArg() == 2)
     {
@@ -122,6 +124,8 @@ void HexEnvironmentCommands::ParamICE(HtpCommand& cmd)
             ice.SetFindReversible(cmd.Arg<bool>(1));
 	else if (name == "use_s_reversible_as_reversible")
             ice.SetUseSReversibleAsReversible(cmd.Arg<bool>(1));
+        else if (name == "use_cache")
+            ice.SetUseCache(cmd.Arg<bool>(1));
         else
             throw HtpFailure() << "Unknown parameter: " << name;
     }
@@ -147,7 +151,17 @@ void HexEnvironmentCommands::ParamVC(HtpCommand& cmd)
             << "[bool] limit_fulls "
             << param.limit_fulls << '\n'
             << "[bool] limit_or "
-            << param.limit_or << '\n';
+            << param.limit_or << '\n'
+            << "[bool] parallel_builds "
+            << param.parallel_builds << '\n'
+            << "[bool] journal_undo "
+            << param.journal_undo << '\n'
+            << "[bool] use_cache "
+            << param.use_cache << '\n'
+            << "[string] max_build_usec "
+            << param.max_build_usec << '\n'
+            << "[string] max_rule_applications "
+            << param.max_rule_applications << '\n';
     }
     else if (cmd.NuArg() == 2)
     {
@@ -164,6 +178,16 @@ void HexEnvironmentCommands::ParamVC(HtpCommand& cmd)
             param.limit_fulls = cmd.Arg<bool>(1);
         else if (name == "limit_or")
             param.limit_or = cmd.Arg<bool>(1);
+        else if (name == "parallel_builds")
+            param.parallel_builds = cmd.Arg<bool>(1);
+        else if (name == "journal_undo")
+            param.journal_undo = cmd.Arg<bool>(1);
+        else if (name == "use_cache")
+            param.use_cache = cmd.Arg<bool>(1);
+        else if (name == "max_build_usec")
+            param.max_build_usec = cmd.ArgMin<std::size_t>(1, 0);
+        else if (name == "max_rule_applications")
+            param.max_rule_applications = cmd.ArgMin<std::size_t>(1, 0);
         else
             throw HtpFailure() << "Unknown parameter: " << name;
     }
@@ -0,0 +1,249 @@
+//----------------------------------------------------------------------------
+/** @file HexPointDigraph.cpp */
+//----------------------------------------------------------------------------
+
+#include <utility>
+
+#include "BitsetIterator.hpp"
+#include "HexPointDigraph.hpp"
+
+using namespace benzene;
+
+//----------------------------------------------------------------------------
+
+bitset_t Digraph<HexPoint>::Sources() const
+{
+    bitset_t ret;
+    for (BitsetIterator x(m_vertices); x; ++x)
+        if (m_out[*x].any() && m_in[*x].none())
+            ret.set(*x);
+    return ret;
+}
+
+bitset_t Digraph<HexPoint>::Sinks() const
+{
+    bitset_t ret;
+    for (BitsetIterator x(m_vertices); x; ++x)
+        if (m_out[*x].none() && m_in[*x].any())
+            ret.set(*x);
+    return ret;
+}
+
+void Digraph<HexPoint>::Transpose(Digraph<HexPoint>& out) const
+{
+    out.Clear();
+    out.m_vertices = m_vertices;
+    for (BitsetIterator x(m_vertices); x; ++x)
+    {
+        out.m_out[*x] = m_in[*x];
+        out.m_in[*x] = m_out[*x];
+    }
+}
+
+/** Warshall's algorithm; the inner loop over the sources of an edge
+    into k is one bitset union per source. */
+void Digraph<HexPoint>::TransitiveClosure(Digraph<HexPoint>& out) const
+{
+    out.Clear();
+    out.m_vertices = m_vertices;
+    for (BitsetIterator x(m_vertices); x; ++x)
+        out.m_out[*x] = m_out[*x];
+    for (BitsetIterator k(m_vertices); k; ++k)
+    {
+        const bitset_t reach = out.m_out[*k];
+        for (BitsetIterator i(m_vertices); i; ++i)
+            if (out.m_out[*i].test(*k))
+                out.m_out[*i] |= reach;
+    }
+    for (BitsetIterator x(m_vertices); x; ++x)
+        for (BitsetIterator y(out.m_out[*x]); y; ++y)
+            out.m_in[*y].set(*x);
+}
+
+bitset_t Digraph<HexPoint>::OutSet(const bitset_t& source) const
+{
+    bitset_t ret;
+    for (BitsetIterator x(source & m_vertices); x; ++x)
+        ret |= m_out[*x];
+    return ret;
+}
+
+bitset_t Digraph<HexPoint>::InSet(const bitset_t& target) const
+{
+    bitset_t ret;
+    for (BitsetIterator x(target & m_vertices); x; ++x)
+        ret |= m_in[*x];
+    return ret;
+}
+
+//----------------------------------------------------------------------------
+
+bool Digraph<HexPoint>::DFS(HexPoint p, bitset_t& visited,
+                            const bitset_t& killing,
+                            HexPoint* stack, std::size_t& size) const
+{
+    return RowDFS(m_out, p, m_vertices, visited, killing, stack, size);
+}
+
+bool Digraph<HexPoint>::DFS(HexPoint p, const bitset_t& vertices,
+                            bitset_t& visited, const bitset_t& killing,
+                            HexPoint* stack, std::size_t& size) const
+{
+    return RowDFS(m_out, p, vertices, visited, killing, stack, size);
+}
+
+bool Digraph<HexPoint>::TransposedDFS(HexPoint p, const bitset_t& vertices,
+                                      bitset_t& visited,
+                                      const bitset_t& killing,
+                                      HexPoint* stack,
+                                      std::size_t& size) const
+{
+    return RowDFS(m_in, p, vertices, visited, killing, stack, size);
+}
+
+/** Depth-first search along rows, which is m_out or m_in. */
+bool Digraph<HexPoint>::RowDFS(const bitset_t* rows, HexPoint p,
+                               const bitset_t& vertices, bitset_t& visited,
+                               const bitset_t& killing, HexPoint* stack,
+                               std::size_t& size)
+{
+    bool stopped = false;
+    visited.set(p);
+    for (BitsetIterator it(rows[p] & vertices); it; ++it)
+    {
+        if (visited.test(*it))
+            continue;
+        if (killing.test(*it)
+            || RowDFS(rows, *it, vertices, visited, killing, stack, size))
+        {
+            stopped = true;
+            break;
+        }
+    }
+    stack[size++] = p;
+    return stopped;
+}
+
+bitset_t Digraph<HexPoint>::FindTwoCycles() const
+{
+    bitset_t ret;
+    for (BitsetIterator x(m_vertices); x; ++x)
+        if ((m_out[*x] & m_in[*x]).any())
+            ret.set(*x);
+    return ret;
+}
+
+bitset_t Digraph<HexPoint>::FindCycles() const
+{
+    std::vector<bitset_t> comp;
+    FindStronglyConnectedComponents(comp);
+    bitset_t ret;
+    for (std::size_t i = 0; i < comp.size(); ++i)
+        if (comp[i].count() > 1)
+            ret |= comp[i];
+    for (BitsetIterator x(m_vertices - ret); x; ++x)
+        if (m_out[*x].test(*x))
+            ret.set(*x);
+    return ret;
+}
+
+/** Kosaraju's algorithm. The second pass is a breadth-first search
+    over the in-rows that expands a whole frontier per step. */
+void Digraph<HexPoint>::FindStronglyConnectedComponents
+(std::vector<bitset_t>& comp) const
+{
+    comp.clear();
+    bitset_t visited;
+    HexPoint stack[BITSETSIZE];
+    std::size_t size = 0;
+    for (BitsetIterator x(m_vertices); x; ++x)
+        if (!visited.test(*x))
+            DFS(*x, visited, EMPTY_BITSET, stack, size);
+
+    visited.reset();
+    while (size > 0)
+    {
+        HexPoint x = stack[--size];
+        if (visited.test(x))
+            continue;
+        bitset_t c;
+        c.set(x);
+        bitset_t frontier = c;
+        while (frontier.any())
+        {
+            bitset_t next;
+            for (BitsetIterator y(frontier); y; ++y)
+                next |= m_in[*y];
+            frontier = next - visited - c;
+            c |= frontier;
+        }
+        visited |= c;
+        comp.push_back(c);
+    }
+}
+
+//----------------------------------------------------------------------------
+
+void Digraph<HexPoint>::Clear()
+{
+    for (BitsetIterator x(m_vertices); x; ++x)
+    {
+        m_out[*x].reset();
+        m_in[*x].reset();
+    }
+    m_vertices.reset();
+}
+
+void Digraph<HexPoint>::Swap(Digraph<HexPoint>& other)
+{
+    for (BitsetIterator x(m_vertices | other.m_vertices); x; ++x)
+    {
+        std::swap(m_out[*x], other.m_out[*x]);
+        std::swap(m_in[*x], other.m_in[*x]);
+    }
+    std::swap(m_vertices, other.m_vertices);
+}
+
+void Digraph<HexPoint>::AddEdges(HexPoint source, const bitset_t& targets)
+{
+    if (targets.none())
+        return;
+    m_vertices.set(source);
+    m_vertices |= targets;
+    m_out[source] |= targets;
+    for (BitsetIterator x(targets); x; ++x)
+        m_in[*x].set(source);
+}
+
+void Digraph<HexPoint>::RemoveVertex(HexPoint vertex)
+{
+    if (!VertexExists(vertex))
+        return;
+    for (BitsetIterator t(m_out[vertex]); t; ++t)
+        m_in[*t].reset(vertex);
+    for (BitsetIterator s(m_in[vertex]); s; ++s)
+        m_out[*s].reset(vertex);
+    m_out[vertex].reset();
+    m_in[vertex].reset();
+    m_vertices.reset(vertex);
+}
+
+void Digraph<HexPoint>::RemoveVertices(const bitset_t& vertices)
+{
+    const bitset_t removed = vertices & m_vertices;
+    if (removed.none())
+        return;
+    for (BitsetIterator x(removed); x; ++x)
+    {
+        m_out[*x].reset();
+        m_in[*x].reset();
+    }
+    m_vertices -= removed;
+    for (BitsetIterator x(m_vertices); x; ++x)
+    {
+        m_out[*x] -= removed;
+        m_in[*x] -= removed;
+    }
+}
+
+//----------------------------------------------------------------------------
@@ -0,0 +1,227 @@
+//----------------------------------------------------------------------------
+/** @file HexPointDigraph.hpp */
+//----------------------------------------------------------------------------
+
+#ifndef HEXPOINTDIGRAPH_HPP
+#define HEXPOINTDIGRAPH_HPP
+
+#include "Digraph.hpp"
+#include "Hex.hpp"
+
+_BEGIN_BENZENE_NAMESPACE_
+
+//----------------------------------------------------------------------------
+
+/** Directed graph on HexPoints.
+    Stores the out- and in-neighbours of every point as a bitset_t
+    row, so set queries, closure and cycle detection are bitset
+    operations. Holds no heap memory. Sets of points are passed as
+    bitsets where the generic Digraph uses std::set. */
+template<>
+class Digraph<HexPoint>
+{
+public:
+
+    /** Constructs an empty graph. */
+    Digraph();
+
+    //------------------------------------------------------------------------
+
+    /** Returns number of vertices in graph. */
+    std::size_t NumVertices() const;
+
+    /** Returns the vertex set. */
+    const bitset_t& Vertices() const;
+
+    /** Returns true if vertex exists in graph. */
+    bool VertexExists(HexPoint vertex) const;
+
+    /** Returns true if vertex has no outgoing or incoming edges. */
+    bool IsIsolated(HexPoint vertex) const;
+
+    /** Returns the vertices with out-degree>0 and in-degree==0. */
+    bitset_t Sources() const;
+
+    /** Returns the vertices with out-degree==0 and in-degree>0. */
+    bitset_t Sinks() const;
+
+    /** Returns the number of edges entering target. */
+    std::size_t InDegree(HexPoint target) const;
+
+    /** Returns the number of edges leaving source. */
+    std::size_t OutDegree(HexPoint source) const;
+
+    /** Returns true if there is an edge (x->y). */
+    bool IsEdge(HexPoint x, HexPoint y) const;
+
+    /** Returns the transpose of this graph (ie, the graph with
+        edge directions reversed). */
+    void Transpose(Digraph<HexPoint>& out) const;
+
+    /** Stores the graph with an edge (x->y) for each non-empty path
+        from x to y in out. */
+    void TransitiveClosure(Digraph<HexPoint>& out) const;
+
+    //------------------------------------------------------------------------
+
+    /** Returns set of nodes pointed to by source. */
+    const bitset_t& OutSet(HexPoint source) const;
+
+    /** Returns all targets of vertices in source. */
+    bitset_t OutSet(const bitset_t& source) const;
+
+    /** Returns nodes pointing to target. */
+    const bitset_t& InSet(HexPoint target) const;
+
+    /** Returns all sources of edges into any member of target. */
+    bitset_t InSet(const bitset_t& target) const;
+
+    //------------------------------------------------------------------------
+
+    /** Depth-first search from p; finished vertices are pushed onto
+        stack, which must have room for NumVertices() points. If it
+        explores an element of killing, stops and returns true. */
+    bool DFS(HexPoint p, bitset_t& visited, const bitset_t& killing,
+             HexPoint* stack, std::size_t& size) const;
+
+    /** Same as DFS(), but explores only the points of vertices, as
+        if the other vertices had been removed. */
+    bool DFS(HexPoint p, const bitset_t& vertices, bitset_t& visited,
+             const bitset_t& killing, HexPoint* stack,
+             std::size_t& size) const;
+
+    /** Same as DFS() restricted to vertices, but follows the edges
+        backwards, as on the transposed graph. */
+    bool TransposedDFS(HexPoint p, const bitset_t& vertices,
+                       bitset_t& visited, const bitset_t& killing,
+                       HexPoint* stack, std::size_t& size) const;
+
+    /** Returns all vertices that are on a two cycle. */
+    bitset_t FindTwoCycles() const;
+
+    /** Returns all vertices that are on a cycle. */
+    bitset_t FindCycles() const;
+
+    /** Stores the strongly connected components of the graph in
+        comp. */
+    void FindStronglyConnectedComponents(std::vector<bitset_t>& comp) const;
+
+    //------------------------------------------------------------------------
+
+    /** Clears the graph. */
+    void Clear();
+
+    /** Exchanges the contents of two graphs. Only the rows of
+        vertices are exchanged, so the cost depends on the number of
+        vertices and not on BITSETSIZE. */
+    void Swap(Digraph<HexPoint>& other);
+
+    /** Adds each point in vertices as a vertex, without edges. */
+    void AddVertices(const bitset_t& vertices);
+
+    /** Adds edge from source to target. */
+    void AddEdge(HexPoint source, HexPoint target);
+
+    /** Adds edges from source to each of the targets. */
+    void AddEdges(HexPoint source, const bitset_t& targets);
+
+    /** Removes edge from source to target. */
+    void RemoveEdge(HexPoint source, HexPoint target);
+
+    /** Removes vertex from the graph. */
+    void RemoveVertex(HexPoint vertex);
+
+    /** Removes each vertex in vertices from the graph. */
+    void RemoveVertices(const bitset_t& vertices);
+
+private:
+
+    /** Rows of points that are not vertices are always empty. */
+    bitset_t m_out[BITSETSIZE];
+
+    /** See m_out. */
+    bitset_t m_in[BITSETSIZE];
+
+    bitset_t m_vertices;
+
+    static bool RowDFS(const bitset_t* rows, HexPoint p,
+                       const bitset_t& vertices, bitset_t& visited,
+                       const bitset_t& killing, HexPoint* stack,
+                       std::size_t& size);
+};
+
+inline Digraph<HexPoint>::Digraph()
+{
+}
+
+inline std::size_t Digraph<HexPoint>::NumVertices() const
+{
+    return m_vertices.count();
+}
+
+inline const bitset_t& Digraph<HexPoint>::Vertices() const
+{
+    return m_vertices;
+}
+
+inline bool Digraph<HexPoint>::VertexExists(HexPoint vertex) const
+{
+    return m_vertices.test(vertex);
+}
+
+inline bool Digraph<HexPoint>::IsIsolated(HexPoint vertex) const
+{
+    return m_in[vertex].none() && m_out[vertex].none();
+}
+
+inline std::size_t Digraph<HexPoint>::InDegree(HexPoint target) const
+{
+    BenzeneAssert(VertexExists(target));
+    return m_in[target].count();
+}
+
+inline std::size_t Digraph<HexPoint>::OutDegree(HexPoint source) const
+{
+    BenzeneAssert(VertexExists(source));
+    return m_out[source].count();
+}
+
+inline bool Digraph<HexPoint>::IsEdge(HexPoint source, HexPoint target) const
+{
+    return m_out[source].test(target);
+}
+
+inline const bitset_t& Digraph<HexPoint>::OutSet(HexPoint source) const
+{
+    return m_out[source];
+}
+
+inline const bitset_t& Digraph<HexPoint>::InSet(HexPoint target) const
+{
+    return m_in[target];
+}
+
+inline void Digraph<HexPoint>::AddVertices(const bitset_t& vertices)
+{
+    m_vertices |= vertices;
+}
+
+inline void Digraph<HexPoint>::AddEdge(HexPoint source, HexPoint target)
+{
+    m_vertices.set(source);
+    m_vertices.set(target);
+    m_out[source].set(target);
+    m_in[target].set(source);
+}
+
+inline void Digraph<HexPoint>::RemoveEdge(HexPoint source, HexPoint target)
+{
+    m_out[source].reset(target);
+    m_in[target].reset(source);
+}
+
+//----------------------------------------------------------------------------
+
+_END_BENZENE_NAMESPACE_
+
+#endif // HEXPOINTDIGRAPH_HPP
@@ -31,6 +31,9 @@ public:
 
     SgHashCode Hash() const;
 
+    /** Hash of the state with the board rotated by 180 degrees. */
+    SgHashCode RotatedHash() const;
+
     void PlayMove(HexPoint move);
     
     void UndoMove(HexPoint move);
@@ -88,6 +91,11 @@ inline SgHashCode HexState::Hash() const
     return m_brd.Hash(m_toPlay);
 }
 
+inline SgHashCode HexState::RotatedHash() const
+{
+    return m_brd.RotatedHash(m_toPlay);
+}
+
 inline void HexState::PlayMove(HexPoint move)
 {
     m_brd.PlayMove(m_toPlay, move);
@@ -0,0 +1,365 @@
+//----------------------------------------------------------------------------
+/** @file ICECache.cpp */
+//----------------------------------------------------------------------------
+
+#include "BitsetIterator.hpp"
+#include "ICECache.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <boost/thread/locks.hpp>
+
+using namespace benzene;
+
+//----------------------------------------------------------------------------
+
+std::string ICECache::Statistics::ToString() const
+{
+    std::ostringstream os;
+    os << "Lookups    " << lookups << '\n'
+       << "Hits       " << hits;
+    if (lookups)
+        os << " (" << (100.0 * double(hits) / double(lookups)) << "%)";
+    os << '\n'
+       << "Misses     " << lookups - hits << '\n'
+       << "Stores     " << stores << '\n'
+       << "Busy       " << busy << '\n'
+       << "Oversized  " << oversized << '\n'
+       << "Capacity   " << capacity;
+    return os.str();
+}
+
+//----------------------------------------------------------------------------
+
+namespace {
+
+/** Table that a thread is reading, published so that SetCapacity()
+    does not free it underneath. There is one record per thread; the
+    record of a thread that exited is reused. The records of all
+    caches are in one list that is never freed. Padded so that a
+    record shares no cache line with other data. */
+struct HazardRecord
+{
+    char paddingBefore[64];
+
+    std::atomic<const void*> table;
+
+    std::atomic<bool> used;
+
+    HazardRecord* next;
+
+    char paddingAfter[64];
+};
+
+std::atomic<HazardRecord*> s_records(0);
+
+HazardRecord* AcquireRecord()
+{
+    for (HazardRecord* r = s_records.load(); r; r = r->next)
+    {
+        bool used = false;
+        if (!r->used.load(std::memory_order_relaxed)
+            && r->used.compare_exchange_strong(used, true))
+            return r;
+    }
+    HazardRecord* r = new HazardRecord;
+    r->table.store(0, std::memory_order_relaxed);
+    r->used.store(true, std::memory_order_relaxed);
+    r->next = s_records.load();
+    while (!s_records.compare_exchange_weak(r->next, r))
+        ;
+    return r;
+}
+
+/** Gives the record of a thread back when the thread exits. */
+struct RecordOwner
+{
+    HazardRecord* record;
+
+    RecordOwner()
+        : record(0)
+    { }
+
+    ~RecordOwner()
+    {
+        if (record)
+            record->used.store(false, std::memory_order_release);
+    }
+};
+
+thread_local RecordOwner t_owner;
+
+HazardRecord& ThreadRecord()
+{
+    if (!t_owner.record)
+        t_owner.record = AcquireRecord();
+    return *t_owner.record;
+}
+
+/** Returns once no thread reads table. */
+void WaitUntilUnused(const void* table)
+{
+    for (HazardRecord* r = s_records.load(); r; r = r->next)
+        while (r->table.load() == table)
+            std::this_thread::yield();
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+
+/** Publishes the current table in the hazard record of the thread for
+    its lifetime. The record is written before the table pointer is
+    read again, both sequentially consistent, so either SetCapacity()
+    sees the record or the scope sees the new table. */
+class ICECache::TableScope
+{
+public:
+    explicit TableScope(const ICECache& cache)
+        : m_record(ThreadRecord())
+    {
+        Table* table = cache.m_table.load();
+        while (true)
+        {
+            m_record.table.store(table);
+            Table* current = cache.m_table.load();
+            if (current == table)
+                break;
+            table = current;
+        }
+        m_table = table;
+    }
+
+    ~TableScope()
+    {
+        m_record.table.store(0, std::memory_order_release);
+    }
+
+    /** Null if the capacity is zero. */
+    Table* Get() const
+    {
+        return m_table;
+    }
+
+private:
+    HazardRecord& m_record;
+
+    Table* m_table;
+};
+
+//----------------------------------------------------------------------------
+
+ICECache::Table::Table(std::size_t size)
+    : mask(size - 1),
+      slots(new Slot[size])
+{
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        slots[i].sequence.store(0, std::memory_order_relaxed);
+        slots[i].entry.used = false;
+    }
+}
+
+ICECache::ICECache(std::size_t capacity)
+    : m_table(0)
+{
+    SetCapacity(capacity);
+}
+
+ICECache::~ICECache()
+{
+    delete m_table.load();
+}
+
+ICECache& ICECache::Global()
+{
+    static ICECache s_cache(4096);
+    return s_cache;
+}
+
+std::size_t ICECache::Key(SgHashCode hash, HexColor color,
+                          unsigned settings)
+{
+    return hash.Code1() ^ (std::size_t(settings) * 0x9e3779b9u)
+        ^ std::size_t(color);
+}
+
+ICECache::Counters& ICECache::Shard(std::size_t key)
+{
+    return m_counters[key % NUM_STAT_SHARDS];
+}
+
+bool ICECache::Get(SgHashCode hash, HexColor color, unsigned settings,
+                   InferiorCells& inf, unsigned& result)
+{
+    const std::size_t key = Key(hash, color, settings);
+    Counters& counters = Shard(key);
+    counters.lookups.fetch_add(1, std::memory_order_relaxed);
+    TableScope scope(*this);
+    Table* table = scope.Get();
+    if (!table)
+        return false;
+    Slot& slot = table->slots[key & table->mask];
+    const unsigned sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence & 1)
+        return false;
+    // Copy only the rows in use; the copy is checked against the
+    // sequence counter before it is used.
+    Entry entry;
+    std::memcpy(&entry, &slot.entry, offsetof(Entry, rows));
+    if (!entry.used || entry.hash != hash || entry.color != unsigned(color)
+        || entry.settings != settings || entry.numRows > MAX_ROWS)
+        return false;
+    std::memcpy(entry.rows, slot.entry.rows,
+                entry.numRows * sizeof(bitset_t));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+        return false;
+
+    inf.Clear();
+    for (BWIterator c; c; ++c)
+        inf.m_fillin[*c] = entry.fillin[*c];
+    inf.m_vulnerable = entry.vulnerable;
+    inf.m_s_reversible = entry.sReversible;
+    inf.m_blockers = entry.blockers;
+    inf.m_s_reversible_carriers = entry.sReversibleCarriers;
+    std::size_t row = 0;
+    for (BitsetIterator p(entry.vulnerable); p; ++p)
+        inf.m_killers[*p] = entry.rows[row++];
+    for (BitsetIterator p(entry.sReversible); p; ++p)
+        inf.m_s_reversers[*p] = entry.rows[row++];
+    inf.m_inf_graph.AddVertices(entry.vertices);
+    for (BitsetIterator p(entry.dominated); p; ++p)
+        inf.m_inf_graph.AddEdges(*p, entry.rows[row++]);
+    BenzeneAssert(row == entry.numRows);
+    result = entry.result;
+    counters.hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void ICECache::Put(SgHashCode hash, HexColor color, unsigned settings,
+                   const InferiorCells& inf, unsigned result)
+{
+    const std::size_t key = Key(hash, color, settings);
+    Counters& counters = Shard(key);
+    TableScope scope(*this);
+    Table* table = scope.Get();
+    if (!table)
+        return;
+    const Digraph<HexPoint>& graph = inf.m_inf_graph;
+    bitset_t dominated;
+    for (BitsetIterator p(graph.Vertices()); p; ++p)
+        if (graph.OutSet(*p).any())
+            dominated.set(*p);
+    const std::size_t numRows = inf.m_vulnerable.count()
+        + inf.m_s_reversible.count() + dominated.count();
+    if (numRows > MAX_ROWS)
+    {
+        counters.oversized.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Slot& slot = table->slots[key & table->mask];
+    unsigned sequence = slot.sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1)
+        || !slot.sequence.compare_exchange_strong(sequence, sequence + 1,
+                                                  std::memory_order_acquire))
+    {
+        counters.busy.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    Entry& entry = slot.entry;
+    entry.hash = hash;
+    entry.color = color;
+    entry.settings = settings;
+    entry.used = true;
+    entry.result = result;
+    entry.numRows = unsigned(numRows);
+    for (BWIterator c; c; ++c)
+        entry.fillin[*c] = inf.m_fillin[*c];
+    entry.vulnerable = inf.m_vulnerable;
+    entry.sReversible = inf.m_s_reversible;
+    entry.blockers = inf.m_blockers;
+    entry.sReversibleCarriers = inf.m_s_reversible_carriers;
+    entry.vertices = graph.Vertices();
+    entry.dominated = dominated;
+    std::size_t row = 0;
+    for (BitsetIterator p(inf.m_vulnerable); p; ++p)
+        entry.rows[row++] = inf.m_killers[*p];
+    for (BitsetIterator p(inf.m_s_reversible); p; ++p)
+        entry.rows[row++] = inf.m_s_reversers[*p];
+    for (BitsetIterator p(dominated); p; ++p)
+        entry.rows[row++] = graph.OutSet(*p);
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    counters.stores.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ICECache::Clear()
+{
+    TableScope scope(*this);
+    Table* table = scope.Get();
+    for (std::size_t i = 0; table && i <= table->mask; ++i)
+    {
+        Slot& slot = table->slots[i];
+        unsigned sequence = slot.sequence.load(std::memory_order_relaxed);
+        while ((sequence & 1)
+               || !slot.sequence.compare_exchange_weak
+                  (sequence, sequence + 1, std::memory_order_acquire))
+            sequence = slot.sequence.load(std::memory_order_relaxed) & ~1u;
+        slot.entry.used = false;
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+    }
+    ResetStatistics();
+}
+
+void ICECache::SetCapacity(std::size_t capacity)
+{
+    boost::mutex::scoped_lock lock(m_resizeMutex);
+    std::size_t size = 0;
+    if (capacity > 0)
+        for (size = 1; size < capacity; size <<= 1)
+            ;
+    Table* old = m_table.exchange(size ? new Table(size) : 0);
+    ResetStatistics();
+    if (old)
+    {
+        WaitUntilUnused(old);
+        delete old;
+    }
+}
+
+void ICECache::ResetStatistics()
+{
+    for (std::size_t i = 0; i < NUM_STAT_SHARDS; ++i)
+    {
+        m_counters[i].lookups.store(0);
+        m_counters[i].hits.store(0);
+        m_counters[i].stores.store(0);
+        m_counters[i].busy.store(0);
+        m_counters[i].oversized.store(0);
+    }
+}
+
+ICECache::Statistics ICECache::GetStatistics() const
+{
+    Statistics stats;
+    stats.lookups = stats.hits = stats.stores = 0;
+    stats.busy = stats.oversized = 0;
+    for (std::size_t i = 0; i < NUM_STAT_SHARDS; ++i)
+    {
+        stats.lookups += m_counters[i].lookups.load();
+        stats.hits += m_counters[i].hits.load();
+        stats.stores += m_counters[i].stores.load();
+        stats.busy += m_counters[i].busy.load();
+        stats.oversized += m_counters[i].oversized.load();
+    }
+    TableScope scope(*this);
+    stats.capacity = scope.Get() ? scope.Get()->mask + 1 : 0;
+    return stats;
+}
+
+//----------------------------------------------------------------------------
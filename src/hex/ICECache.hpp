@@ -0,0 +1,199 @@
+//----------------------------------------------------------------------------
+/** @file ICECache.hpp */
+//----------------------------------------------------------------------------
+
+#ifndef ICECACHE_HPP
+#define ICECACHE_HPP
+
+#include "SgSystem.h"
+#include "SgHash.h"
+#include "Hex.hpp"
+#include "HexColor.hpp"
+#include "HexPoint.hpp"
+#include "InferiorCells.hpp"
+
+#include <atomic>
+#include <string>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+_BEGIN_BENZENE_NAMESPACE_
+
+//----------------------------------------------------------------------------
+
+/** Cache of ICEngine results shared by all threads.
+
+    Entries are keyed by the hash of all stones on the board, the
+    color, and a settings word that holds the fill-in mode and the
+    engine parameters that affect the result. An entry stores the
+    complete InferiorCells (fill-in, vulnerable, strong-reversible and
+    dominated cells with their killers, reversers and superiors) and
+    one result value.
+
+    The cache is a fixed array of slots indexed by the key; a new
+    entry replaces the one in its slot. Each slot is guarded by a
+    sequence counter: readers copy the entry without locking and
+    treat a copy that raced with a writer as a miss. A writer that
+    finds its slot busy drops the entry. Results with more rows than
+    an entry holds are not cached.
+
+    The slots form a table that SetCapacity() replaces. Each thread
+    publishes the table it is reading in a hazard record of its own,
+    and SetCapacity() frees the old table once no record holds it, so
+    the read path writes no shared memory other than the slot and a
+    statistics shard. The counters are split into cache-line aligned
+    shards selected by the key.
+
+    Used by ICEngine when ICEngine::UseCache() is set. */
+class ICECache : private boost::noncopyable
+{
+public:
+    /** Maximum number of killer, reverser and superior rows of an
+        entry. */
+    static const std::size_t MAX_ROWS = 64;
+
+    /** Counters since the last Clear(). */
+    struct Statistics
+    {
+        std::size_t lookups;
+
+        std::size_t hits;
+
+        std::size_t stores;
+
+        /** Stores dropped because a writer held the slot. */
+        std::size_t busy;
+
+        /** Stores dropped because the entry had too many rows. */
+        std::size_t oversized;
+
+        std::size_t capacity;
+
+        std::string ToString() const;
+    };
+
+    /** Creates a cache with capacity rounded up to a power of two
+        slots. */
+    explicit ICECache(std::size_t capacity);
+
+    ~ICECache();
+
+    /** The cache shared by all ICEngines. */
+    static ICECache& Global();
+
+    /** Copies a cached entry to inf and result and returns true, or
+        returns false if there is none. Never blocks. */
+    bool Get(SgHashCode hash, HexColor color, unsigned settings,
+             InferiorCells& inf, unsigned& result);
+
+    /** Stores inf and result, replacing the entry in its slot. Never
+        blocks. */
+    void Put(SgHashCode hash, HexColor color, unsigned settings,
+             const InferiorCells& inf, unsigned result);
+
+    /** Removes all entries and resets the counters. */
+    void Clear();
+
+    /** Clears the cache and changes its capacity (in entries). Can
+        be called while other threads use the cache; it waits until
+        no thread reads the old slots before it frees them. */
+    void SetCapacity(std::size_t capacity);
+
+    Statistics GetStatistics() const;
+
+private:
+    struct Entry
+    {
+        SgHashCode hash;
+
+        unsigned color;
+
+        unsigned settings;
+
+        bool used;
+
+        unsigned result;
+
+        /** Number of valid rows. */
+        unsigned numRows;
+
+        bitset_t fillin[BLACK_AND_WHITE];
+
+        bitset_t vulnerable;
+
+        bitset_t sReversible;
+
+        bitset_t blockers;
+
+        bitset_t sReversibleCarriers;
+
+        /** Vertices of the inferiority graph. */
+        bitset_t vertices;
+
+        /** Vertices with outgoing edges. */
+        bitset_t dominated;
+
+        /** Killers of each vulnerable cell, then reversers of each
+            strong-reversible cell, then superiors of each dominated
+            cell, each in increasing order of the cell. */
+        bitset_t rows[MAX_ROWS];
+    };
+
+    struct Slot
+    {
+        /** Odd while a writer changes the entry. */
+        std::atomic<unsigned> sequence;
+
+        Entry entry;
+    };
+
+    struct Table
+    {
+        explicit Table(std::size_t size);
+
+        std::size_t mask;
+
+        boost::scoped_array<Slot> slots;
+    };
+
+    static const std::size_t NUM_STAT_SHARDS = 64;
+
+    /** Counters of the keys with the same value modulo
+        NUM_STAT_SHARDS. */
+    struct alignas(64) Counters
+    {
+        std::atomic<std::size_t> lookups;
+
+        std::atomic<std::size_t> hits;
+
+        std::atomic<std::size_t> stores;
+
+        std::atomic<std::size_t> busy;
+
+        std::atomic<std::size_t> oversized;
+    };
+
+    class TableScope;
+
+    /** Null if the capacity is zero. */
+    std::atomic<Table*> m_table;
+
+    /** Serializes SetCapacity(). */
+    boost::mutex m_resizeMutex;
+
+    Counters m_counters[NUM_STAT_SHARDS];
+
+    static std::size_t Key(SgHashCode hash, HexColor color,
+                           unsigned settings);
+
+    Counters& Shard(std::size_t key);
+
+    void ResetStatistics();
+};
+
+//----------------------------------------------------------------------------
+
+_END_BENZENE_NAMESPACE_
+
+#endif // ICECACHE_HPP
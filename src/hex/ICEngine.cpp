@@ -8,9 +8,13 @@
 #include "BoardUtil.hpp"
 #include "BitsetIterator.hpp"
 #include "HexColor.hpp"
+#include "ICECache.hpp"
 #include "ICEngine.hpp"
+#include "ZobristHash.hpp"
 
+#include <algorithm>
 #include "boost/filesystem/path.hpp"
+#include <boost/thread/tss.hpp>
 
 using namespace benzene;
 
@@ -484,6 +488,45 @@ void UseGraphTheoryToFindDeadVulnerable(HexColor color, Groups& groups,
 
 //----------------------------------------------------------------------------
 
+/** Hit buffer of the calling thread, reused by the Find*() methods so
+    that matching does not allocate. */
+PatternHitBuffer& ThreadHitBuffer()
+{
+    static boost::thread_specific_ptr<PatternHitBuffer> s_buffer;
+    if (!s_buffer.get())
+        s_buffer.reset(new PatternHitBuffer());
+    return *s_buffer;
+}
+
+/** Kinds of cached computations, @see ICEngine::CacheSettings(). */
+const unsigned CACHE_INFERIOR = 0;
+const unsigned CACHE_FILLIN = 1;
+
+/** Hash of all stones on the board, including fill-in. */
+SgHashCode CacheHash(const StoneBoard& brd)
+{
+    ZobristHash zobrist(brd.Width(), brd.Height());
+    zobrist.Compute(brd.GetBlack(), brd.GetWhite());
+    return zobrist.Hash();
+}
+
+/** Puts the fill-in of a cached result on the board, as computing it
+    would have done. */
+void ApplyCachedFillin(Groups& groups, PatternState& pastate,
+                       const InferiorCells& inf)
+{
+    StoneBoard& brd = groups.Board();
+    const bitset_t fillin = inf.Fillin(BLACK) | inf.Fillin(WHITE);
+    if (fillin.none())
+        return;
+    for (BWIterator c; c; ++c)
+        brd.AddColor(*c, inf.Fillin(*c));
+    pastate.Update(fillin);
+    GroupBuilder::Build(brd, groups);
+}
+
+//----------------------------------------------------------------------------
+
 }  // anonymous namespace
 
 //----------------------------------------------------------------------------
@@ -498,7 +541,8 @@ ICEngine::ICEngine()
       m_iterative_dead_regions(false),
       m_use_capture(true),
       m_find_reversible(true),
-      m_use_s_reversible_as_reversible(false)
+      m_use_s_reversible_as_reversible(false),
+      m_use_cache(false)
 {
     LoadPatterns();
 }
@@ -515,6 +559,22 @@ void ICEngine::LoadPatterns()
     m_patterns.LoadPatterns("ice-patterns.txt");
 }    
 
+unsigned ICEngine::CacheSettings(unsigned kind, HexPoint last_move,
+                                 bool only_around_last_move) const
+{
+    return unsigned(m_find_presimplicial_pairs)
+        | unsigned(m_find_all_pattern_killers) << 1
+        | unsigned(m_find_all_pattern_superiors) << 2
+        | unsigned(m_find_three_sided_dead_regions) << 3
+        | unsigned(m_iterative_dead_regions) << 4
+        | unsigned(m_use_capture) << 5
+        | unsigned(m_find_reversible) << 6
+        | unsigned(m_use_s_reversible_as_reversible) << 7
+        | kind << 8
+        | unsigned(only_around_last_move) << 12
+        | unsigned(last_move) << 16;
+}
+
 //----------------------------------------------------------------------------
 
 HexPoint ICEngine::ComputeInferiorCells(HexColor color, Groups& groups,
@@ -533,6 +593,23 @@ HexPoint ICEngine::ComputeInferiorCells(HexColor color, Groups& groups,
     HexPoint reverser = INVALID_POINT;
     bool find_reversible = m_find_reversible && (last_move != INVALID_POINT);
 
+    SgHashCode hash;
+    unsigned settings = 0;
+    if (m_use_cache)
+    {
+        hash = CacheHash(brd);
+        settings = CacheSettings(CACHE_INFERIOR,
+                                 (find_reversible || only_around_last_move)
+                                 ? last_move : INVALID_POINT,
+                                 only_around_last_move);
+        unsigned result;
+        if (ICECache::Global().Get(hash, color, settings, inf, result))
+        {
+            ApplyCachedFillin(groups, pastate, inf);
+            return static_cast<HexPoint>(result);
+        }
+    }
+
     // Warning : we cannot fillin to find reversible, as there is a risk that
     // the fillin is different from the one used for pruning at last step.
     // Thus, unless the fillin is incremental, we are forced to just use the
@@ -546,7 +623,8 @@ HexPoint ICEngine::ComputeInferiorCells(HexColor color, Groups& groups,
     if (only_around_last_move)
         ComputeFillin(groups, pastate, inf, color, BICOLOR, last_move);
     else
-        ComputeFillin(groups, pastate, inf, color, BICOLOR);
+        ComputeFillin(groups, pastate, inf, color, BICOLOR,
+                      groups.Board().GetEmpty());
 
     bitset_t consider = groups.Board().GetEmpty();
     FindSReversible(pastate, color, consider, inf);
@@ -558,6 +636,8 @@ HexPoint ICEngine::ComputeInferiorCells(HexColor color, Groups& groups,
 #ifndef NDEBUG
     BenzeneAssert(groups.Board().Hash() == oldBoard.Hash());
 #endif
+    if (m_use_cache)
+        ICECache::Global().Put(hash, color, settings, inf, reverser);
     
     return reverser;
 }
@@ -566,8 +646,23 @@ std::size_t ICEngine::ComputeFillin(Groups& groups, PatternState& pastate,
 				    InferiorCells& inf, HexColor color,
                                     FillinMode mode) const
 {
-    return ComputeFillin(groups, pastate, inf, color, mode,
-			 groups.Board().GetEmpty());
+    if (!m_use_cache)
+        return ComputeFillin(groups, pastate, inf, color, mode,
+                             groups.Board().GetEmpty());
+    const SgHashCode hash = CacheHash(groups.Board());
+    const unsigned settings
+        = CacheSettings(CACHE_FILLIN | unsigned(mode) << 1, INVALID_POINT,
+                        false);
+    unsigned result;
+    if (ICECache::Global().Get(hash, color, settings, inf, result))
+    {
+        ApplyCachedFillin(groups, pastate, inf);
+        return result;
+    }
+    std::size_t count = ComputeFillin(groups, pastate, inf, color, mode,
+                                      groups.Board().GetEmpty());
+    ICECache::Global().Put(hash, color, settings, inf, unsigned(count));
+    return count;
 }
 
 std::size_t ICEngine::ComputeFillin(Groups& groups, PatternState& pastate,
@@ -672,6 +767,7 @@ std::size_t ICEngine::ComputePatternFillin(
     StoneBoard& board = pastate.Board();
     bitset_t consider = cons;
     std::size_t count = 0;
+    PatternHits hits;
     while (consider.any())
     {
 	// consider changes inside the loop, but the starting tests ensure
@@ -683,7 +779,7 @@ std::size_t ICEngine::ComputePatternFillin(
 	    if (inf.Fillin(BLACK).test(*p)
 		|| inf.Fillin(WHITE).test(*p))
 	        continue;
-	    PatternHits hits ;
+	    hits.clear();
 	    pastate.MatchOnCell(m_patterns.HashedEFillin(), *p,
 				PatternState::STOP_AT_FIRST_HIT, hits);
 	    if (!hits.empty())
@@ -701,13 +797,11 @@ std::size_t ICEngine::ComputePatternFillin(
 		continue;
 	    }
 	    
-	    std::vector<HexColor> to_fillin;
-	    to_fillin.push_back(color);
-	    if (UsesCapture(mode))
-	        to_fillin.push_back(!color);
+	    const HexColor to_fillin[] = { color, !color };
+	    const HexColor* to_fillin_end
+	        = to_fillin + (UsesCapture(mode) ? 2 : 1);
 
-	    for (std::vector<HexColor>::const_iterator c = to_fillin.begin();
-		 c != to_fillin.end(); ++c)
+	    for (const HexColor* c = to_fillin; c != to_fillin_end; ++c)
 	    {
 	      if (*c == color || Bicolor(mode))
 	          pastate.MatchOnCell(m_patterns.HashedFillin(*c), *p,
@@ -726,9 +820,9 @@ std::size_t ICEngine::ComputePatternFillin(
 		        if (board.IsEmpty(*n))
 			    consider.set(*n);
 		    ++count;
-		    const std::vector<HexPoint>& others = hits[0].Moves1();
-		    const std::vector<HexPoint>& opps = hits[0].Moves2();
-		    for (std::vector<HexPoint>::const_iterator
+		    const PatternHit::Points others = hits[0].Moves1();
+		    const PatternHit::Points opps = hits[0].Moves2();
+		    for (PatternHit::Points::const_iterator
 			   it = others.begin(); it != others.end(); ++it)
 		    {
 			consider.reset(*it);
@@ -747,7 +841,7 @@ std::size_t ICEngine::ComputePatternFillin(
 		    // This optimisation (making it work for M_U_C too)
 		    // works only because the cells in opps are captured.
 		    {
-		        for (std::vector<HexPoint>::const_iterator
+		        for (PatternHit::Points::const_iterator
 			       it = opps.begin(); it != opps.end(); ++it)
 			{
 			    consider.reset(*it);
@@ -819,7 +913,7 @@ void ICEngine::FindSReversible(const PatternState& pastate, HexColor color,
 			       const bitset_t& consider,
 			       InferiorCells& inf) const
 {
-    std::vector<PatternHits> hits(FIRST_INVALID);
+    PatternHitBuffer& hits = ThreadHitBuffer();
     bitset_t rev = pastate.MatchOnBoard(consider, 
 					m_patterns.HashedSReversible(color),
 				        PatternState::MATCH_ALL, hits);
@@ -830,13 +924,13 @@ void ICEngine::FindSReversible(const PatternState& pastate, HexColor color,
     // If it is vulnerable, we try not to add+remove as reversible.
     for (BitsetIterator p(rev); p; ++p) 
     {
-        for (unsigned i=0; i<hits[*p].size(); ++i) 
+        for (unsigned i=0; i<hits.NumHits(*p); ++i) 
         {
-	    const std::vector<HexPoint>& empty = hits[*p][i].Empty();
+	    const PatternHit::Points empty = hits.Hit(*p, i).Empty();
 	    if (empty.size() != 1)
 	        continue;
 	    // the only empty cell is the reverser, so vulnerable
-	    const std::vector<HexPoint>& killer = hits[*p][i].Moves2();
+	    const PatternHit::Points killer = hits.Hit(*p, i).Moves2();
 	    BenzeneAssert(killer.size() == 1);
 	    inf.AddVulnerable(*p, killer[0]);
 	    if (!m_find_all_pattern_killers)
@@ -846,13 +940,13 @@ void ICEngine::FindSReversible(const PatternState& pastate, HexColor color,
     
     for (BitsetIterator p(rev); p; ++p) 
     {
-	for (unsigned i=0; i<hits[*p].size(); ++i) 
+	for (unsigned i=0; i<hits.NumHits(*p); ++i) 
 	{
-	    const std::vector<HexPoint>& empty = hits[*p][i].Empty();
+	    const PatternHit::Points empty = hits.Hit(*p, i).Empty();
 	    if (empty.size() == 1)
 	        continue;
-	    const std::vector<HexPoint>& others = hits[*p][i].Moves1();
-	    const std::vector<HexPoint>& reverser = hits[*p][i].Moves2();
+	    const PatternHit::Points others = hits.Hit(*p, i).Moves1();
+	    const PatternHit::Points reverser = hits.Hit(*p, i).Moves2();
 	    BenzeneAssert(reverser.size() == 1);
 	    bitset_t carrier;
 	    for (unsigned j=0; j<empty.size(); ++j)
@@ -860,7 +954,7 @@ void ICEngine::FindSReversible(const PatternState& pastate, HexColor color,
 		    carrier.set(empty[j]);
 	    inf.AddSReversible(*p, carrier, reverser[0], false);
 	    carrier.set(*p);
-	    for (std::vector<HexPoint>::const_iterator it = others.begin();
+	    for (PatternHit::Points::const_iterator it = others.begin();
 		 it != others.end(); ++it)
 	    {
 	        carrier.reset(*it);
@@ -875,17 +969,17 @@ void ICEngine::FindTReversible(const PatternState& pastate, HexColor color,
 			       const bitset_t& consider,
 			       InferiorCells& inf) const
 {
-    std::vector<PatternHits> hits(FIRST_INVALID);
+    PatternHitBuffer& hits = ThreadHitBuffer();
     bitset_t rev = pastate.MatchOnBoard(consider, 
 					m_patterns.HashedTReversible(color),
 				        PatternState::MATCH_ALL, hits);
     
     for (BitsetIterator p(rev); p; ++p) 
     {
-	for (unsigned i=0; i<hits[*p].size(); ++i) 
+	for (unsigned i=0; i<hits.NumHits(*p); ++i) 
 	{
-	    const std::vector<HexPoint>& empty = hits[*p][i].Empty();
-	    const std::vector<HexPoint>& reverser = hits[*p][i].Moves2();
+	    const PatternHit::Points empty = hits.Hit(*p, i).Empty();
+	    const PatternHit::Points reverser = hits.Hit(*p, i).Moves2();
 	    BenzeneAssert(reverser.size() == 1);
 	    bitset_t carrier;
 	    for (unsigned j=0; j<empty.size(); ++j)
@@ -904,16 +998,16 @@ void ICEngine::FindVulnerable(const PatternState& pastate, HexColor color,
     if (m_find_all_pattern_killers)
         matchmode = PatternState::MATCH_ALL;
   
-    std::vector<PatternHits> hits(FIRST_INVALID);
+    PatternHitBuffer& hits = ThreadHitBuffer();
     bitset_t vul = pastate.MatchOnBoard(consider, 
 					m_patterns.HashedVulnerable(color),
 				        matchmode, hits);
     
     for (BitsetIterator p(vul); p; ++p) 
     {
-        for (unsigned i=0; i<hits[*p].size(); ++i) 
+        for (unsigned i=0; i<hits.NumHits(*p); ++i) 
         {
-	    const std::vector<HexPoint>& reverser = hits[*p][i].Moves2();
+	    const PatternHit::Points reverser = hits.Hit(*p, i).Moves2();
 	    BenzeneAssert(reverser.size() == 1);
 	    inf.AddVulnerable(*p, reverser[0]);
 	    if (!m_find_all_pattern_killers)
@@ -931,17 +1025,17 @@ void ICEngine::FindInferior(const PatternState& pastate, HexColor color,
        PatternState::MATCH_ALL :
        PatternState::STOP_AT_FIRST_HIT);
 
-    std::vector<PatternHits> hits(FIRST_INVALID);
+    PatternHitBuffer& hits = ThreadHitBuffer();
     bitset_t infe = pastate.MatchOnBoard(consider,
 					 m_patterns.HashedInferior(color),
 					 matchmode, hits);
 
     for (BitsetIterator p(infe); p; ++p) 
     {
-        for (unsigned i=0; i<hits[*p].size(); ++i) 
+        for (unsigned i=0; i<hits.NumHits(*p); ++i) 
         {
-            const std::vector<HexPoint>& others = hits[*p][i].Moves1();
-	    const std::vector<HexPoint>& superior = hits[*p][i].Moves2();
+            const PatternHit::Points others = hits.Hit(*p, i).Moves1();
+	    const PatternHit::Points superior = hits.Hit(*p, i).Moves2();
             BenzeneAssert(superior.size() == 1);
             inf.AddInferior(*p, superior[0]);
 	    for (unsigned j=0; j<others.size(); ++j)
@@ -998,8 +1092,8 @@ HexPoint ICEngine::IsReversible(PatternState& pastate,
 			    PatternState::MATCH_ALL, loc_hits);
         for (unsigned i=0; i<loc_hits.size(); ++i)
 	{
-	    const std::vector<HexPoint>& others = loc_hits[i].Moves1();
-	    if (find(others.begin(), others.end(), p) != others.end())
+	    const PatternHit::Points others = loc_hits[i].Moves1();
+	    if (std::find(others.begin(), others.end(), p) != others.end())
 	    {
 	        if (occupied) {brd.AddColor(color,p); pastate.Update(p);}
 		return loc_hits[i].Moves2()[0];
@@ -1029,8 +1123,8 @@ PatternHits ICEngine::FindInferiorOnCell(const PatternState& pastate,
 			    PatternState::MATCH_ALL, loc_hits);
         for (unsigned i=0; i<loc_hits.size(); ++i)
 	{
-	    const std::vector<HexPoint>& others = loc_hits[i].Moves1();
-	    if (find(others.begin(), others.end(), cell) != others.end())
+	    const PatternHit::Points others = loc_hits[i].Moves1();
+	    if (std::find(others.begin(), others.end(), cell) != others.end())
 	        hits.push_back(loc_hits[i]);
 	}
     }
@@ -194,6 +194,14 @@ public:
     /** @see UseSReversibleAsReversible() */
     void SetUseSReversibleAsReversible(bool enable);
 
+    /** If enabled, ComputeInferiorCells() and ComputeFillin() (the
+        overload without consider set) look up and store their results
+        in the shared ICECache. */
+    bool UseCache() const;
+
+    /** @see UseCache() */
+    void SetUseCache(bool enable);
+
     // @}
 
 private:
@@ -221,10 +229,18 @@ private:
     /** @see UseSReversibleAsReversible() */
     bool m_use_s_reversible_as_reversible;
 
+    /** @see UseCache() */
+    bool m_use_cache;
+
     IcePatternSet m_patterns;
 
     void LoadPatterns();
 
+    /** Key word for ICECache: the parameters that affect results,
+        the kind of computation and its arguments. */
+    unsigned CacheSettings(unsigned kind, HexPoint last_move,
+                           bool only_around_last_move) const;
+
     std::size_t CliqueCutsetDead(HexColor color, Groups& groups,
 				 PatternState& pastate, 
                                  InferiorCells& inf) const;
@@ -320,6 +336,16 @@ inline void ICEngine::SetUseSReversibleAsReversible(bool enable)
     m_use_s_reversible_as_reversible = enable;
 }
 
+inline bool ICEngine::UseCache() const
+{
+    return m_use_cache;
+}
+
+inline void ICEngine::SetUseCache(bool enable)
+{
+    m_use_cache = enable;
+}
+
 //----------------------------------------------------------------------------
 
 /** Utilities needed by ICE. */
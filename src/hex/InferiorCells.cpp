@@ -11,11 +11,17 @@
 */
 //----------------------------------------------------------------------------
 
+#include <type_traits>
+#include <utility>
+
 #include "BitsetIterator.hpp"
 #include "InferiorCells.hpp"
 
 using namespace benzene;
 
+static_assert(std::is_trivially_copyable<InferiorCells>::value,
+              "InferiorCells must not own heap memory");
+
 //----------------------------------------------------------------------------
 
 InferiorCells::InferiorCells()
@@ -29,14 +35,9 @@ bitset_t InferiorCells::Inferior() const
 {
     if (!m_inferior_computed) {
         
-        // Remove strong-reversible cells from graph
-        Digraph<HexPoint> g(m_inf_graph);
-        for (BitsetIterator p(Vulnerable()); p; ++p)
-            g.RemoveVertex(*p);
-	for (BitsetIterator p(SReversible()); p; ++p)
-            g.RemoveVertex(*p);
-
-        m_inferior = InferiorCellsUtil::PrunableFromInferiorityGraph(g);
+        // Ignore vulnerable and strong-reversible cells
+        m_inferior = InferiorCellsUtil::PrunableFromInferiorityGraph
+            (m_inf_graph, Vulnerable() | SReversible());
         m_inferior_computed = true;
 
         /// TODO: ensure m_inferior is disjoint from all others.
@@ -78,7 +79,7 @@ void InferiorCells::AddFillin(HexColor color, const bitset_t& fillin)
 void InferiorCells::AddVulnerable(HexPoint vulnerable, HexPoint killer)
 {
     m_vulnerable.set(vulnerable);
-    m_killers[vulnerable].insert(killer);
+    m_killers[vulnerable].set(killer);
     RemoveSReversible(vulnerable);
     m_inferior_computed = false;
 
@@ -86,13 +87,10 @@ void InferiorCells::AddVulnerable(HexPoint vulnerable, HexPoint killer)
 }
 
 void InferiorCells::AddVulnerable(HexPoint vulnerable,
-                                  const std::set<HexPoint>& killers)
+                                  const bitset_t& killers)
 {
     m_vulnerable.set(vulnerable);
-    std::set<HexPoint>::iterator it = killers.begin();
-    for (; it != killers.end(); ++it) {
-      m_killers[vulnerable].insert(*it);
-    }
+    m_killers[vulnerable] |= killers;
     RemoveSReversible(vulnerable);
     m_inferior_computed = false;
 
@@ -130,7 +128,7 @@ void InferiorCells::AddSReversible(HexPoint reversible,
 	if (is_threat) m_blockers.set(reversible);
 	m_s_reversible_carriers |= carrier;
 	m_s_reversible.set(reversible);
-	m_s_reversers[reversible].insert(reverser);
+	m_s_reversers[reversible].set(reverser);
     
 	m_inferior_computed = false;
 	AssertPairwiseDisjoint();
@@ -147,7 +145,7 @@ void InferiorCells::AddInferior(HexPoint inferior,
 }
 
 void InferiorCells::AddInferior(HexPoint inferior,
-				const std::set<HexPoint>& superiors)
+				const bitset_t& superiors)
 {
     m_inf_graph.AddEdges(inferior, superiors);
     m_inferior_computed = false;
@@ -170,8 +168,7 @@ void InferiorCells::AddSReversibleFrom(const InferiorCells& other)
     for (BitsetIterator p(other.SReversible()); p; ++p)
     {
         m_s_reversible.set(*p);
-	m_s_reversers[*p].insert(other.m_s_reversers[*p].begin(),
-				 other.m_s_reversers[*p].end());
+	m_s_reversers[*p] |= other.m_s_reversers[*p];
     }
     m_blockers |= other.m_blockers ;
     m_s_reversible_carriers |= other.m_s_reversible_carriers ;
@@ -181,8 +178,7 @@ void InferiorCells::AddSReversibleFrom(const InferiorCells& other)
 
 void InferiorCells::AddInferiorFrom(const InferiorCells& other)
 {
-    bitset_t vertices=BitsetUtil::SetToBitset(other.m_inf_graph.Vertices());
-    for (BitsetIterator p(vertices); p; ++p)
+    for (BitsetIterator p(other.m_inf_graph.Vertices()); p; ++p)
         AddInferior(*p, other.m_inf_graph.OutSet(*p));
     //AssertPairwiseDisjoint();
 }
@@ -199,6 +195,26 @@ void InferiorCells::Clear()
     ClearInferior();
 }
 
+/** Rows of m_killers and m_s_reversers are empty outside of
+    m_vulnerable and m_s_reversible, so only the rows of members are
+    exchanged. */
+void InferiorCells::Swap(InferiorCells& other)
+{
+    for (BWIterator c; c; ++c)
+        std::swap(m_fillin[*c], other.m_fillin[*c]);
+    for (BitsetIterator p(m_vulnerable | other.m_vulnerable); p; ++p)
+        std::swap(m_killers[*p], other.m_killers[*p]);
+    std::swap(m_vulnerable, other.m_vulnerable);
+    for (BitsetIterator p(m_s_reversible | other.m_s_reversible); p; ++p)
+        std::swap(m_s_reversers[*p], other.m_s_reversers[*p]);
+    std::swap(m_s_reversible, other.m_s_reversible);
+    std::swap(m_blockers, other.m_blockers);
+    std::swap(m_s_reversible_carriers, other.m_s_reversible_carriers);
+    m_inf_graph.Swap(other.m_inf_graph);
+    std::swap(m_inferior_computed, other.m_inferior_computed);
+    std::swap(m_inferior, other.m_inferior);
+}
+
 void InferiorCells::ClearFillin(HexColor color)
 {
     m_fillin[color].reset();
@@ -229,7 +245,7 @@ void InferiorCells::ClearInferior()
 void InferiorCells::RemoveVulnerable(HexPoint vulnerable)
 {
   if (m_vulnerable.test(vulnerable)) {
-      m_killers[vulnerable].clear();
+      m_killers[vulnerable].reset();
       m_vulnerable.reset(vulnerable);
       m_inferior_computed = false;
   }
@@ -238,7 +254,7 @@ void InferiorCells::RemoveVulnerable(HexPoint vulnerable)
 void InferiorCells::RemoveVulnerable(const bitset_t& vulnerable)
 {
     for (BitsetIterator p(vulnerable & m_vulnerable); p; ++p) {
-        m_killers[*p].clear();
+        m_killers[*p].reset();
     }
     m_vulnerable = m_vulnerable - vulnerable;
     m_inferior_computed = false;
@@ -251,7 +267,7 @@ void InferiorCells::RemoveVulnerable(const bitset_t& vulnerable)
 void InferiorCells::RemoveSReversible(HexPoint reversible)
 {
   if (m_s_reversible.test(reversible)) {
-      m_s_reversers[reversible].clear();
+      m_s_reversers[reversible].reset();
       m_s_reversible.reset(reversible);
       m_inferior_computed = false;
   }
@@ -260,7 +276,7 @@ void InferiorCells::RemoveSReversible(HexPoint reversible)
 void InferiorCells::RemoveSReversible(const bitset_t& reversible)
 {
     for (BitsetIterator p(reversible & m_s_reversible); p; ++p) {
-        m_s_reversers[*p].clear();
+        m_s_reversers[*p].reset();
     }
     m_s_reversible = m_s_reversible - reversible;
     m_inferior_computed = false;
@@ -276,10 +292,7 @@ void InferiorCells::RemoveInferior(HexPoint inferior)
 
 void InferiorCells::RemoveInferior(const bitset_t& inferior)
 {
-    bitset_t vertices = BitsetUtil::SetToBitset(m_inf_graph.Vertices());
-    for (BitsetIterator p(vertices & inferior); p; ++p) {
-        m_inf_graph.RemoveVertex(*p);
-    }
+    m_inf_graph.RemoveVertices(inferior);
     m_inferior_computed = false;
 }
 
@@ -313,10 +326,9 @@ bitset_t InferiorCells::FindPresimplicialPairs() const
     for (BitsetIterator x(m_vulnerable); x; ++x)
     {
 
-        for (std::set<HexPoint>::iterator y = m_killers[*x].begin();
-	     y != m_killers[*x].end(); ++y)
+        for (BitsetIterator y(m_killers[*x]); y; ++y)
 	{
-	    if (m_killers[*y].find(*x) != m_killers[*y].end())
+	    if (m_killers[*y].test(*x))
 	    {
 	        fillin.set(*x);
 		fillin.set(*y);
@@ -348,11 +360,10 @@ std::string InferiorCells::GuiOutput() const
         {
             os << "iv[";
             bool first=true;
-            std::set<HexPoint>::const_iterator i;
-            for (i = m_killers[p].begin(); i != m_killers[p].end(); ++i) 
+            for (BitsetIterator q(m_killers[p]); q; ++q) 
             {
                 if (!first) os << "-";
-                os << *i;
+                os << *q;
                 first = false;
             }
             os << "]";
@@ -361,11 +372,10 @@ std::string InferiorCells::GuiOutput() const
         {
             os << "is[";
             bool first=true;
-            std::set<HexPoint>::const_iterator i;
-            for (i = m_s_reversers[p].begin(); i != m_s_reversers[p].end(); ++i) 
+            for (BitsetIterator q(m_s_reversers[p]); q; ++q) 
             {
                 if (!first) os << "-";
-                os << *i;
+                os << *q;
                 first = false;
             }
             os << "]";
@@ -374,11 +384,10 @@ std::string InferiorCells::GuiOutput() const
         {
             os << "ii[";
             bool first=true;
-            std::set<HexPoint>::iterator i;
-            for (i=m_inf_graph.out_begin(p); i!=m_inf_graph.out_end(p); ++i) 
+            for (BitsetIterator q(m_inf_graph.OutSet(p)); q; ++q) 
             {
                 if (!first) os << "-";
-                os << *i;
+                os << *q;
                 first = false;
             }
             os << "]";
@@ -403,41 +412,44 @@ std::string InferiorCells::GuiOutput() const
 
 //----------------------------------------------------------------------------
 
-// Based on Kosaraju's algorithm
+/** Based on Kosaraju's algorithm. Both passes are restricted to the
+    vertices that are not removed, so the graph is neither copied nor
+    transposed. */
 bitset_t 
-InferiorCellsUtil::PrunableFromInferiorityGraph(const Digraph<HexPoint>& graph)
+InferiorCellsUtil::PrunableFromInferiorityGraph(const Digraph<HexPoint>& graph,
+                                                const bitset_t& removed)
 {
-    Digraph<HexPoint> trans_graph;
-    graph.Transpose(trans_graph);
-    
-    std::set<HexPoint> visited;
-    std::set<HexPoint> killing;
-    std::vector<HexPoint> stack;
+    const bitset_t vertices = graph.Vertices() - removed;
+    bitset_t visited;
+    bitset_t killing;
+    HexPoint stack[BITSETSIZE];
+    std::size_t size = 0;
     // First, a simple DFS on the transposed graph.
-    for (std::set<HexPoint>::iterator it = trans_graph.Vertices().begin();
-	 it != trans_graph.Vertices().end(); ++it)
+    for (BitsetIterator it(vertices); it; ++it)
     {
-        if (visited.find(*it) != visited.end())
+        if (visited.test(*it))
 	    continue;
-	trans_graph.DFS(*it, visited, killing, stack);
+	graph.TransposedDFS(*it, vertices, visited, killing, stack, size);
     }
     
     bitset_t prunable;
-    visited.clear();
-    std::vector<HexPoint> useless_stack;
+    visited.reset();
+    HexPoint useless_stack[BITSETSIZE];
     // Then, a DFS starting from the top of the stack.
-    for (std::vector<HexPoint>::reverse_iterator it = stack.rbegin();
-	 it != stack.rend(); ++it)
+    while (size > 0)
     {
-        if (visited.find(*it) != visited.end())
+        HexPoint p = stack[--size];
+        if (visited.test(p))
 	{
-	    prunable.set(*it);
+	    prunable.set(p);
 	    continue;
 	}
-        if (graph.DFS(*it, visited, killing, useless_stack))
-	    prunable.set(*it);
-	killing.insert(visited.begin(), visited.end());
-	visited.clear();
+        std::size_t useless_size = 0;
+        if (graph.DFS(p, vertices, visited, killing, useless_stack,
+                      useless_size))
+	    prunable.set(p);
+	killing |= visited;
+	visited.reset();
     }
     return prunable;
 }
@@ -7,13 +7,15 @@
 #define INFERIOR_CELLS_HPP
 
 #include "Hex.hpp"
-#include "Digraph.hpp"
+#include "HexPointDigraph.hpp"
 
 _BEGIN_BENZENE_NAMESPACE_
 
 //----------------------------------------------------------------------------
 
-/** Set of inferior cells. */
+/** Set of inferior cells.
+    Killers, reversers and superiors are stored as one bitset per
+    cell, so the class holds no heap memory and is cheap to copy. */
 class InferiorCells
 {
 public:
@@ -46,8 +48,12 @@ public:
 
     bitset_t All() const;
 
-    const std::set<HexPoint>& Killers(HexPoint p) const;
-    const std::set<HexPoint>& SReversers(HexPoint p) const;
+    const bitset_t& Killers(HexPoint p) const;
+    const bitset_t& SReversers(HexPoint p) const;
+
+    /** Cells p was found inferior to, including those of cells that
+        are not in Inferior(). */
+    const bitset_t& Superiors(HexPoint p) const;
 
     /** The blocker is:
 	- for a strong-reverse pattern, the reverser
@@ -82,7 +88,7 @@ public:
     void AddVulnerable(HexPoint vulnerable,
 		       HexPoint killer);
     void AddVulnerable(HexPoint vulnerable,
-		       const std::set<HexPoint>& killers);
+		       const bitset_t& killers);
 
     /** Theis function test if the cell is already known to be strong-
 	reversible (or vulnerable). In this case, it does nothing. */
@@ -94,7 +100,7 @@ public:
     void AddInferior(HexPoint inferior,
 		     HexPoint superior);
     void AddInferior(HexPoint inferior,
-		     const std::set<HexPoint>& superiors);
+		     const bitset_t& superiors);
 
     /** Make sure to have cleared before calling these. */
     void AddVulnerableFrom(const InferiorCells& other);
@@ -105,6 +111,9 @@ public:
 
     void Clear();
 
+    /** Exchanges the contents of two sets without copying. */
+    void Swap(InferiorCells& other);
+
     void ClearFillin(HexColor color);
     void ClearVulnerable();
     void ClearSReversible();
@@ -123,6 +132,9 @@ public:
     
 private:
 
+    /** Stores and restores the raw rows. */
+    friend class ICECache;
+
     //------------------------------------------------------------------------
 
     void AssertPairwiseDisjoint() const;
@@ -132,9 +144,9 @@ private:
     bitset_t m_fillin[BLACK_AND_WHITE];
 
     bitset_t m_vulnerable;
-    std::set<HexPoint> m_killers[BITSETSIZE];
+    bitset_t m_killers[BITSETSIZE];
     bitset_t m_s_reversible;
-    std::set<HexPoint> m_s_reversers[BITSETSIZE];
+    bitset_t m_s_reversers[BITSETSIZE];
 
     bitset_t m_blockers;
     bitset_t m_s_reversible_carriers;
@@ -171,18 +183,21 @@ inline bitset_t InferiorCells::SReversible() const
     return m_s_reversible;
 }
 
-inline 
-const std::set<HexPoint>& InferiorCells::Killers(HexPoint p) const
+inline const bitset_t& InferiorCells::Killers(HexPoint p) const
 {
     return m_killers[p];
 }
 
-inline 
-const std::set<HexPoint>& InferiorCells::SReversers(HexPoint p) const
+inline const bitset_t& InferiorCells::SReversers(HexPoint p) const
 {
     return m_s_reversers[p];
 }
 
+inline const bitset_t& InferiorCells::Superiors(HexPoint p) const
+{
+    return m_inf_graph.OutSet(p);
+}
+
 inline 
 const bitset_t InferiorCells::Blockers() const
 {
@@ -201,7 +216,9 @@ const bitset_t InferiorCells::SReversibleCarriers() const
 namespace InferiorCellsUtil
 {
 
-    bitset_t PrunableFromInferiorityGraph(const Digraph<HexPoint>& graph);
+    /** Prunable cells of graph without the vertices in removed. */
+    bitset_t PrunableFromInferiorityGraph(const Digraph<HexPoint>& graph,
+                                          const bitset_t& removed);
 
 }
 
@@ -6,13 +6,18 @@
 #include "BoardUtil.hpp"
 #include "PatternState.hpp"
 
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
 using namespace benzene;
 
 //----------------------------------------------------------------------------
 
 const PatternMatcherData* PatternMatcherData::Get(const ConstBoard* brd)
 {
+    static boost::mutex mutex;
     static std::vector<const PatternMatcherData*> data;
+    boost::lock_guard<boost::mutex> lock(mutex);
     for (std::size_t i = 0; i < data.size(); ++i) 
         if (*brd == *data[i]->brd)
             return data[i];
@@ -27,15 +32,42 @@ PatternMatcherData::PatternMatcherData(const ConstBoard* brd)
     Initialize();
 }
 
-/** For each cell, store the slice and godel for every other cell. */
+/** For each offset, store its slice and godel; for each cell, store
+    the edges and points in its slices. */
 void PatternMatcherData::Initialize()
 {
+    static_assert(MAX_WIDTH > 2 * Pattern::MAX_EXTENSION,
+                  "offsets of nearby cells must be distinct");
+    static_assert(FIRST_INVALID <= 0xffff, "points must fit in a short");
+    static_assert(SLICE_SIZE <= 8, "godels must fit in a char");
     LogFine() << "PatternMatcherData::Initialize " 
 	      << "(" << brd->Width() << " x " << brd->Height() <<")\n";
-    memset(played_in_slice, 0, sizeof(played_in_slice));
-    memset(played_in_godel, 0, sizeof(played_in_godel));
-    memset(played_in_edge,  0, sizeof(played_in_edge));
-    memset(inverse_slice_godel, 0, sizeof(inverse_slice_godel));
+    memset(m_offsets, 0, sizeof(m_offsets));
+    memset(m_played_in_edge,  0, sizeof(m_played_in_edge));
+    memset(m_inverse_slice_godel, 0, sizeof(m_inverse_slice_godel));
+    for (int s = 0; s < Pattern::NUM_SLICES; s++) 
+    {
+        int fwd = s;
+        int lft = (s + 2) % NUM_DIRECTIONS;
+        int x1 = HexPointUtil::DeltaX(fwd); 
+        int y1 = HexPointUtil::DeltaY(fwd);
+        for (int i = 1, g = 0; i <= Pattern::MAX_EXTENSION; i++) 
+        {
+            int x2 = x1;
+            int y2 = y1;
+            for (int j = 0; j < i; j++) 
+            {
+                Offset& offset = m_offsets[y2 * MAX_WIDTH + x2 + MAX_OFFSET];
+                offset.slice = static_cast<unsigned char>(s);
+                offset.godel = static_cast<unsigned char>(1 << g);
+                x2 += HexPointUtil::DeltaX(lft);
+                y2 += HexPointUtil::DeltaY(lft);
+                g++;
+            }
+            x1 += HexPointUtil::DeltaX(fwd);
+            y1 += HexPointUtil::DeltaY(fwd);
+        }
+    }
     for (BoardIterator ip1 = brd->Interior(); ip1; ++ip1)
     {
         int x, y;
@@ -57,19 +89,19 @@ void PatternMatcherData::Initialize()
                     if (x2 == -1 && y2 == brd->Height()) 
                     {
                         // southwest obtuse corner
-                        played_in_edge[p1][SOUTH - FIRST_EDGE][s] 
-                            |= (1 << g);
-                        played_in_edge[p1][WEST - FIRST_EDGE][s]
-                            |= (1 << g);
+                        m_played_in_edge[p1][SOUTH - FIRST_EDGE][s] 
+                            |= static_cast<unsigned char>(1 << g);
+                        m_played_in_edge[p1][WEST - FIRST_EDGE][s]
+                            |= static_cast<unsigned char>(1 << g);
                     } 
                     // handle obtuse corner: both colors get it. 
                     else if (x2 == brd->Width() && y2 == -1) 
                     {
                         // northeast obtuse corner
-                        played_in_edge[p1][NORTH - FIRST_EDGE][s] 
-                            |= (1 << g);
-                        played_in_edge[p1][EAST - FIRST_EDGE][s]
-                            |= (1 << g);
+                        m_played_in_edge[p1][NORTH - FIRST_EDGE][s] 
+                            |= static_cast<unsigned char>(1 << g);
+                        m_played_in_edge[p1][EAST - FIRST_EDGE][s]
+                            |= static_cast<unsigned char>(1 << g);
                     } 
                     else 
                     {
@@ -78,16 +110,10 @@ void PatternMatcherData::Initialize()
                         if (p2 != INVALID_POINT) 
                         {
                             if (HexPointUtil::isEdge(p2)) 
-                            {
-                                played_in_edge[p1][p2 - FIRST_EDGE][s] 
-                                    |= (1 << g);
-                            } 
-                            else 
-                            {
-                                played_in_slice[p1][p2] = s;
-                            }
-			    played_in_godel[p1][p2] = (1 << g);
-                            inverse_slice_godel[p1][s][g] = p2;
+                                m_played_in_edge[p1][p2 - FIRST_EDGE][s] 
+                                    |= static_cast<unsigned char>(1 << g);
+                            m_inverse_slice_godel[p1][s][g] 
+                                = static_cast<unsigned short>(p2);
                         }
                     }
                     x2 += HexPointUtil::DeltaX(lft);
@@ -105,7 +131,7 @@ HexPoint PatternMatcherData::GetRotatedMove(HexPoint cell, int slice,
                                             int bit, int angle) const
 {
     slice = (slice + 6 - angle) % Pattern::NUM_SLICES;
-    return inverse_slice_godel[cell][slice][bit];
+    return InverseSliceGodel(cell, slice, bit);
 }
 
 //----------------------------------------------------------------------------
@@ -116,6 +142,7 @@ PatternState::PatternState(StoneBoard& brd)
       m_update_radius(Pattern::MAX_EXTENSION)
 {
     ClearGodels();
+    ClearPatternCheckStats();
 }
 
 PatternState::~PatternState()
@@ -135,7 +162,7 @@ void PatternState::UpdateRingGodel(HexPoint cell)
     BenzeneAssert(Pattern::NUM_SLICES == 6);
     for (int opp_slice = 3, slice = 0; slice < Pattern::NUM_SLICES; ++slice) 
     {
-        HexPoint p = m_data->inverse_slice_godel[cell][slice][0];
+        HexPoint p = m_data->InverseSliceGodel(cell, slice, 0);
         m_ring_godel[p].AddColorToSlice(opp_slice, color);
         m_ring_godel[p].RemoveColorFromSlice(opp_slice, EMPTY);
         if (++opp_slice == Pattern::NUM_SLICES) opp_slice = 0;
@@ -154,8 +181,10 @@ void PatternState::Update(HexPoint cell)
     if (HexColorUtil::isBlackWhite(color))
         for (BoardIterator p = m_brd.Const().Nbs(cell, r); p; ++p) 
 	{
-	    int slice = m_data->played_in_slice[*p][cell];
-	    int godel = m_data->played_in_godel[*p][cell];
+            if (HexPointUtil::isEdge(*p))
+                continue;
+	    int slice = m_data->PlayedInSlice(*p, cell);
+	    int godel = m_data->PlayedInGodel(*p, cell);
 	    m_slice_godel[*p][color][slice] |= godel;
 	    // Update *p's ring godel if we played next to it
 	    if (godel == 1)
@@ -167,8 +196,10 @@ void PatternState::Update(HexPoint cell)
     else
         for (BoardIterator p = m_brd.Const().Nbs(cell, r); p; ++p) 
 	{
-	    int slice = m_data->played_in_slice[*p][cell];
-	    int godel = m_data->played_in_godel[*p][cell];
+            if (HexPointUtil::isEdge(*p))
+                continue;
+	    int slice = m_data->PlayedInSlice(*p, cell);
+	    int godel = m_data->PlayedInGodel(*p, cell);
 	    m_slice_godel[*p][BLACK][slice] &= ~godel;
 	    m_slice_godel[*p][WHITE][slice] &= ~godel;
 	    // Update *p's ring godel if we played next to it
@@ -178,12 +209,11 @@ void PatternState::Update(HexPoint cell)
     return;
 
  handleEdge:
-    int edge = cell - FIRST_EDGE;
     for (BoardIterator p = m_brd.Const().Nbs(cell, r); p; ++p) 
     {
         for (int slice = 0; slice < Pattern::NUM_SLICES; ++slice)
         {
-            int godel = m_data->played_in_edge[*p][edge][slice];
+            int godel = m_data->PlayedInEdge(*p, cell, slice);
             m_slice_godel[*p][color][slice] |= godel;
             // Update *p's ring godel if we played next to it.
             // Must use AddColorToSlice instead of SetSliceToColor
@@ -233,16 +263,29 @@ void PatternState::MatchOnCell(const HashedPatternSet& patset,
 {
     const RingGodel& ring_godel = m_ring_godel[cell];
     const RotatedPatternList& rlist = patset.ListForGodel(ring_godel);
-    RotatedPatternList::const_iterator it = rlist.begin();
-    for (; it != rlist.end(); ++it) 
+    const int* gb = m_slice_godel[cell][BLACK];
+    const int* gw = m_slice_godel[cell][WHITE];
+    const std::size_t blocks = (rlist.size() + HashedPatternSet::BLOCK_SIZE
+                                - 1) / HashedPatternSet::BLOCK_SIZE;
+    m_statistics.pattern_checks.fetch_add(rlist.size(),
+                                          std::memory_order_relaxed);
+    m_statistics.ring_checks.fetch_add(rlist.size(),
+                                       std::memory_order_relaxed);
+    m_statistics.slice_checks.fetch_add(Pattern::NUM_SLICES * rlist.size(),
+                                        std::memory_order_relaxed);
+    for (std::size_t b = 0; b < blocks; ++b)
     {
-        std::vector<HexPoint> empty, moves1, moves2;
-        if (CheckRotatedPattern(cell, *it, empty, moves1, moves2)) 
+        unsigned match = patset.MatchBlock(ring_godel, b, gb, gw);
+        for (; match; match &= match - 1)
         {
-	    hits.push_back(PatternHit(it->GetPattern(),
-				      empty, moves1, moves2));
+            const RotatedPattern& rotpat 
+                = rlist[b * HashedPatternSet::BLOCK_SIZE 
+                        + __builtin_ctz(match)];
+            BenzeneAssert(CheckRotatedPattern(cell, rotpat));
+            hits.push_back(PatternHit(rotpat.GetPattern()));
+            GetRotatedMoves(cell, rotpat, hits.back());
             if (mode == STOP_AT_FIRST_HIT)
-                break;
+                return;
         }
     }
 }
@@ -263,6 +306,27 @@ bitset_t PatternState::MatchOnBoard(const bitset_t& consider,
     return ret;
 }
 
+bitset_t PatternState::MatchOnBoard(const bitset_t& consider, 
+                                    const HashedPatternSet& patset, 
+                                    MatchMode mode, 
+                                    PatternHitBuffer& hits) const
+{
+    hits.Clear();
+    bitset_t lookat = consider & Board().Const().GetCells();
+    for (BitsetIterator p(lookat); p; ++p)
+    {
+        const std::size_t begin = hits.m_hits.size();
+        MatchOnCell(patset, *p, mode, hits.m_hits);
+        if (hits.m_hits.size() != begin)
+        {
+            hits.m_cells.set(*p);
+            hits.m_begin[*p] = begin;
+            hits.m_end[*p] = hits.m_hits.size();
+        }
+    }
+    return hits.m_cells;
+}
+
 bitset_t PatternState::MatchOnBoard(const bitset_t& consider, 
                                     const HashedPatternSet& patset) const
 {
@@ -270,10 +334,15 @@ bitset_t PatternState::MatchOnBoard(const bitset_t& consider,
     bitset_t lookat = consider & Board().Const().GetCells();
     for (BitsetIterator p(lookat); p; ++p) 
     {
-        PatternHits hits;
-        MatchOnCell(patset, *p, STOP_AT_FIRST_HIT, hits);
-        if (!hits.empty())
-            ret.set(*p);
+        const RingGodel& ring_godel = m_ring_godel[*p];
+        const std::size_t size = patset.ListForGodel(ring_godel).size();
+        for (std::size_t b = 0; b * HashedPatternSet::BLOCK_SIZE < size; ++b)
+            if (patset.MatchBlock(ring_godel, b, m_slice_godel[*p][BLACK],
+                                  m_slice_godel[*p][WHITE]))
+            {
+                ret.set(*p);
+                break;
+            }
     }
     return ret;
 }
@@ -281,54 +350,54 @@ bitset_t PatternState::MatchOnBoard(const bitset_t& consider,
 //-----------------------------------------------------------------------------
 
 /** Checks the pre-rotated pattern against the board. Returns true if
-    it matches.  Pattern encoded moves are stored in moves. */
+    it matches. */
 bool PatternState::CheckRotatedPattern(HexPoint cell, 
-                                       const RotatedPattern& rotpat,
-				       std::vector<HexPoint>& empty,
-                                       std::vector<HexPoint>& moves1,
-                                       std::vector<HexPoint>& moves2) const
+                                       const RotatedPattern& rotpat) const
 {
     BenzeneAssert(m_brd.Const().IsCell(cell));
-    m_statistics.pattern_checks++;
+    m_statistics.pattern_checks.fetch_add(1, std::memory_order_relaxed);
     bool matches = CheckRingGodel(cell, rotpat);
-    const Pattern* pattern = rotpat.GetPattern();
-    if (matches && pattern->Extension() > 1)
+    if (matches && rotpat.GetPattern()->Extension() > 1)
         matches = CheckRotatedSlices(cell, rotpat);
-    if (matches) 
+    return matches;
+}
+
+/** Stores the moves encoded by a pattern matching at cell in hit. */
+void PatternState::GetRotatedMoves(HexPoint cell,
+                                   const RotatedPattern& rotpat,
+                                   PatternHit& hit) const
+{
+    const Pattern* pattern = rotpat.GetPattern();
+    if (pattern->GetFlags() & Pattern::HAS_EMPTY) 
     {
-        if (pattern->GetFlags() & Pattern::HAS_EMPTY) 
+        for (unsigned i = 0; i < pattern->GetEmpty().size(); ++i) 
         {
-            for (unsigned i = 0; i < pattern->GetEmpty().size(); ++i) 
-            {
-                int slice = pattern->GetEmpty()[i].first;
-                int bit = pattern->GetEmpty()[i].second;
-                empty.push_back(m_data->GetRotatedMove(cell, slice, bit, 
-						       rotpat.Angle()));
-            }
+            int slice = pattern->GetEmpty()[i].first;
+            int bit = pattern->GetEmpty()[i].second;
+            hit.AddEmpty(m_data->GetRotatedMove(cell, slice, bit, 
+                                                rotpat.Angle()));
         }
-	if (pattern->GetFlags() & Pattern::HAS_MOVES1) 
+    }
+    if (pattern->GetFlags() & Pattern::HAS_MOVES1) 
+    {
+        for (unsigned i = 0; i < pattern->GetMoves1().size(); ++i) 
         {
-            for (unsigned i = 0; i < pattern->GetMoves1().size(); ++i) 
-            {
-                int slice = pattern->GetMoves1()[i].first;
-                int bit = pattern->GetMoves1()[i].second;
-                moves1.push_back(m_data->GetRotatedMove(cell, slice, bit, 
-                                                        rotpat.Angle()));
-            }
+            int slice = pattern->GetMoves1()[i].first;
+            int bit = pattern->GetMoves1()[i].second;
+            hit.AddMoves1(m_data->GetRotatedMove(cell, slice, bit, 
+                                                 rotpat.Angle()));
         }
-        if (pattern->GetFlags() & Pattern::HAS_MOVES2) 
+    }
+    if (pattern->GetFlags() & Pattern::HAS_MOVES2) 
+    {
+        for (unsigned i = 0; i < pattern->GetMoves2().size(); ++i) 
         {
-            for (unsigned i = 0; i < pattern->GetMoves2().size(); ++i) 
-            {
-                int slice = pattern->GetMoves2()[i].first;
-                int bit = pattern->GetMoves2()[i].second;
-                moves2.push_back(m_data->GetRotatedMove(cell, slice, bit, 
-                                                        rotpat.Angle()));
-            }
+            int slice = pattern->GetMoves2()[i].first;
+            int bit = pattern->GetMoves2()[i].second;
+            hit.AddMoves2(m_data->GetRotatedMove(cell, slice, bit, 
+                                                 rotpat.Angle()));
         }
-        return true;
     }
-    return false;
 }
 
 /** Convenience method. */
@@ -347,9 +416,9 @@ bool PatternState::CheckRotatedSlices(HexPoint cell, const Pattern& pattern,
     const int *gw = m_slice_godel[cell][WHITE];
     const Pattern::slice_t* pat = pattern.GetData();
     bool matches = true;
-    for (int i = 0; matches && i < Pattern::NUM_SLICES; ++i) 
+    int i = 0;
+    for (; matches && i < Pattern::NUM_SLICES; ++i) 
     {
-        m_statistics.slice_checks++;
         int j = (angle + i) % Pattern::NUM_SLICES;
         int black_b = gb[i] & pat[j][Pattern::FEATURE_CELLS];
         int white_b = gw[i] & pat[j][Pattern::FEATURE_CELLS];
@@ -372,6 +441,8 @@ bool PatternState::CheckRotatedSlices(HexPoint cell, const Pattern& pattern,
         else if ((white_b & white_p) != white_p)
             matches = false;
     }
+    m_statistics.slice_checks.fetch_add(static_cast<size_t>(i),
+                                        std::memory_order_relaxed);
     return matches;
 }
 
@@ -386,7 +457,7 @@ bool PatternState::CheckRingGodel(HexPoint cell,
 bool PatternState::CheckRingGodel(HexPoint cell, 
                                   const Pattern& pattern, int angle) const
 {
-    m_statistics.ring_checks++;
+    m_statistics.ring_checks.fetch_add(1, std::memory_order_relaxed);
     return pattern.RingGodel(angle).MatchesGodel(m_ring_godel[cell]);
 }
 
@@ -5,6 +5,8 @@
 #ifndef PATTERNSTATE_HPP
 #define PATTERNSTATE_HPP
 
+#include <atomic>
+
 #include "Hex.hpp"
 #include "HashedPatternSet.hpp"
 #include "Pattern.hpp"
@@ -14,30 +16,47 @@ _BEGIN_BENZENE_NAMESPACE_
 
 //----------------------------------------------------------------------------
 
-/** Instance of a pattern matching a subset of the board.  */
+/** Instance of a pattern matching a subset of the board.
+    The encoded cells are stored inline, so a hit holds no heap
+    memory. */
 class PatternHit
 {
 public:
+    /** Most cells a pattern can encode in one list: every cell of
+        its slices. */
+    static const int MAX_POINTS 
+        = Pattern::NUM_SLICES * Pattern::MAX_EXTENSION
+        * (Pattern::MAX_EXTENSION + 1) / 2;
+
+    /** Read-only view of one of the lists of a hit. Converts to a
+        std::vector for code that needs a copy. */
+    class Points
+    {
+    public:
+        typedef const HexPoint* const_iterator;
+
+        Points(const HexPoint* begin, std::size_t size);
+
+        std::size_t size() const;
+
+        bool empty() const;
+
+        HexPoint operator[](std::size_t i) const;
+
+        const_iterator begin() const;
+
+        const_iterator end() const;
+
+        operator std::vector<HexPoint>() const;
+
+    private:
+        const HexPoint* m_begin;
+
+        std::size_t m_size;
+    };
 
-    /** Creates an instance with a set of encoded move1, and
-        move2 is empty. */
-    PatternHit(const Pattern* pat,
-	       const std::vector<HexPoint>& empty,
-	       const std::vector<HexPoint>& moves1);
-
-    /** Creates an instance with a set of encoded moves1, and
-        a single move2. */
-    PatternHit(const Pattern* pat,
-	       const std::vector<HexPoint>& empty,
-               const std::vector<HexPoint>& moves1,
-               const HexPoint move2);
-
-    /** Creates an instance with two sets of encoded moves1
-	and moves2. */
-    PatternHit(const Pattern* pat,
-	       const std::vector<HexPoint>& empty,
-               const std::vector<HexPoint>& moves1,
-               const std::vector<HexPoint>& moves2);
+    /** Creates an instance with empty lists. */
+    explicit PatternHit(const Pattern* pat);
 
     /** Returns the pattern. */
     const Pattern* GetPattern() const;
@@ -45,54 +64,73 @@ public:
     /** Returns the set of moves the pattern encodes.
         The empty cells also include moves1 and moves2 if they
         are not black nor white. */
-    const std::vector<HexPoint>& Empty() const;
+    Points Empty() const;
   
-    const std::vector<HexPoint>& Moves1() const;
+    Points Moves1() const;
 
-    const std::vector<HexPoint>& Moves2() const;
+    /** Currently, no kind of pattern has more then one element in
+        moves2. */
+    Points Moves2() const;
+
+    void AddEmpty(HexPoint p);
+
+    void AddMoves1(HexPoint p);
+
+    void AddMoves2(HexPoint p);
 
 private:
+    enum { EMPTY_LIST, MOVES1_LIST, MOVES2_LIST, NUM_LISTS };
+
     const Pattern* m_pattern;
 
-    std::vector<HexPoint> m_empty;
+    unsigned char m_size[NUM_LISTS];
 
-    std::vector<HexPoint> m_moves1;
+    HexPoint m_points[NUM_LISTS][MAX_POINTS];
 
-    /** Currently, no kind of pattern has more then one
-        element in moves2 */
-    std::vector<HexPoint> m_moves2;
+    void Add(int list, HexPoint p);
 };
 
-inline PatternHit::PatternHit(const Pattern* pat,
-			      const std::vector<HexPoint>& empty,
-                              const std::vector<HexPoint>& moves1)
-    : m_pattern(pat),
-      m_empty(empty),
-      m_moves1(moves1),
-      m_moves2()
+inline PatternHit::Points::Points(const HexPoint* begin, std::size_t size)
+    : m_begin(begin),
+      m_size(size)
+{
+}
+
+inline std::size_t PatternHit::Points::size() const
+{
+    return m_size;
+}
+
+inline bool PatternHit::Points::empty() const
+{
+    return m_size == 0;
+}
+
+inline HexPoint PatternHit::Points::operator[](std::size_t i) const
+{
+    BenzeneAssert(i < m_size);
+    return m_begin[i];
+}
+
+inline PatternHit::Points::const_iterator PatternHit::Points::begin() const
+{
+    return m_begin;
+}
+
+inline PatternHit::Points::const_iterator PatternHit::Points::end() const
 {
+    return m_begin + m_size;
 }
 
-inline PatternHit::PatternHit(const Pattern* pat,
-			      const std::vector<HexPoint>& empty,
-                              const std::vector<HexPoint>& moves1,
-                              const HexPoint move2)
-    : m_pattern(pat),
-      m_empty(empty),
-      m_moves1(moves1),
-      m_moves2(1, move2)
+inline PatternHit::Points::operator std::vector<HexPoint>() const
 {
+    return std::vector<HexPoint>(begin(), end());
 }
 
-inline PatternHit::PatternHit(const Pattern* pat,
-			      const std::vector<HexPoint>& empty,
-                              const std::vector<HexPoint>& moves1,
-                              const std::vector<HexPoint>& moves2)
-    : m_pattern(pat),
-      m_empty(empty),
-      m_moves1(moves1),
-      m_moves2(moves2)
+inline PatternHit::PatternHit(const Pattern* pat)
+    : m_pattern(pat)
 {
+    m_size[EMPTY_LIST] = m_size[MOVES1_LIST] = m_size[MOVES2_LIST] = 0;
 }
 
 inline const Pattern* PatternHit::GetPattern() const
@@ -100,19 +138,40 @@ inline const Pattern* PatternHit::GetPattern() const
     return m_pattern;
 }
 
-inline const std::vector<HexPoint>& PatternHit::Empty() const
+inline PatternHit::Points PatternHit::Empty() const
+{
+    return Points(m_points[EMPTY_LIST], m_size[EMPTY_LIST]);
+}
+
+inline PatternHit::Points PatternHit::Moves1() const
+{
+    return Points(m_points[MOVES1_LIST], m_size[MOVES1_LIST]);
+}
+
+inline PatternHit::Points PatternHit::Moves2() const
+{
+    return Points(m_points[MOVES2_LIST], m_size[MOVES2_LIST]);
+}
+
+inline void PatternHit::Add(int list, HexPoint p)
+{
+    BenzeneAssert(m_size[list] < MAX_POINTS);
+    m_points[list][m_size[list]++] = p;
+}
+
+inline void PatternHit::AddEmpty(HexPoint p)
 {
-    return m_empty;
+    Add(EMPTY_LIST, p);
 }
 
-inline const std::vector<HexPoint>& PatternHit::Moves1() const
+inline void PatternHit::AddMoves1(HexPoint p)
 {
-    return m_moves1;
+    Add(MOVES1_LIST, p);
 }
 
-inline const std::vector<HexPoint>& PatternHit::Moves2() const
+inline void PatternHit::AddMoves2(HexPoint p)
 {
-    return m_moves2;
+    Add(MOVES2_LIST, p);
 }
 
 //----------------------------------------------------------------------------
@@ -122,27 +181,88 @@ typedef std::vector<PatternHit> PatternHits;
 
 //----------------------------------------------------------------------------
 
-/** Data used for pattern matching. */
+/** Hits of PatternState::MatchOnBoard(), grouped by cell.
+    Keeps its memory between uses, so matching into the same buffer
+    again does not allocate once it has held the largest result. */
+class PatternHitBuffer
+{
+public:
+    PatternHitBuffer();
+
+    /** Removes all hits. */
+    void Clear();
+
+    /** Number of hits on cell. */
+    std::size_t NumHits(HexPoint cell) const;
+
+    /** The i-th hit on cell. */
+    const PatternHit& Hit(HexPoint cell, std::size_t i) const;
+
+private:
+    friend class PatternState;
+
+    PatternHits m_hits;
+
+    /** Cells with at least one hit. */
+    bitset_t m_cells;
+
+    /** Hits of a cell in m_cells are m_hits[m_begin[cell], m_end[cell]). */
+    std::size_t m_begin[BITSETSIZE];
+
+    std::size_t m_end[BITSETSIZE];
+};
+
+inline PatternHitBuffer::PatternHitBuffer()
+{
+}
+
+inline void PatternHitBuffer::Clear()
+{
+    m_hits.clear();
+    m_cells.reset();
+}
+
+inline std::size_t PatternHitBuffer::NumHits(HexPoint cell) const
+{
+    return m_cells.test(cell) ? m_end[cell] - m_begin[cell] : 0;
+}
+
+inline const PatternHit& PatternHitBuffer::Hit(HexPoint cell,
+                                               std::size_t i) const
+{
+    BenzeneAssert(i < NumHits(cell));
+    return m_hits[m_begin[cell] + i];
+}
+
+//----------------------------------------------------------------------------
+
+/** Data used for pattern matching.
+    The slice and godel of a cell relative to a nearby cell depend only
+    on their offset, so they are stored per offset rather than per pair
+    of cells. All tables use the smallest types that fit; with
+    BITSETSIZE 384 they take about 37kB instead of about 1.5MB. */
 class PatternMatcherData
 {
 public:
-    /** Returns instance for given board. */
+    /** Returns instance for given board. Thread-safe. */
     static const PatternMatcherData* Get(const ConstBoard* brd);
 
     /** Board data is defined on. */
     const ConstBoard* brd;
 
-    /** For x: slice in which y resides. */
-    int played_in_slice[BITSETSIZE][BITSETSIZE];
+    /** For cell x: slice in which cell y resides. Cell y must be
+        within Pattern::MAX_EXTENSION of x. */
+    int PlayedInSlice(HexPoint x, HexPoint y) const;
 
-    /** For x: godel in the slice in which y resides. */
-    int played_in_godel[BITSETSIZE][BITSETSIZE];
+    /** For cell x: godel in the slice in which cell y resides. Cell y
+        must be within Pattern::MAX_EXTENSION of x. */
+    int PlayedInGodel(HexPoint x, HexPoint y) const;
 
-    /** For x, edge y, slice s: set of godels edge hits. */
-    int played_in_edge[BITSETSIZE][4][Pattern::NUM_SLICES];
+    /** For cell x, edge y, slice s: set of godels edge hits. */
+    int PlayedInEdge(HexPoint x, HexPoint edge, int slice) const;
 
     /** Maps a cell's (slice,godel) to a point. */
-    HexPoint inverse_slice_godel[BITSETSIZE][Pattern::NUM_SLICES][32];
+    HexPoint InverseSliceGodel(HexPoint cell, int slice, int bit) const;
 
     /** Returns the HexPoint of the position (slice, bit) centered on cell
         and rotated by angle. */
@@ -150,12 +270,66 @@ public:
                             int bit, int angle) const;
 
 private:
+    /** Number of cells in a slice. */
+    static const int SLICE_SIZE 
+        = Pattern::MAX_EXTENSION * (Pattern::MAX_EXTENSION + 1) / 2;
+
+    /** Largest difference of two cells within Pattern::MAX_EXTENSION. */
+    static const int MAX_OFFSET = Pattern::MAX_EXTENSION * (MAX_WIDTH + 1);
+
+    /** Slice and godel of a cell relative to another. */
+    struct Offset
+    {
+        unsigned char slice;
+
+        unsigned char godel;
+    };
+
+    /** Offsets indexed by y - x + MAX_OFFSET; distinct as long as
+        MAX_WIDTH > 2 * Pattern::MAX_EXTENSION. */
+    Offset m_offsets[2 * MAX_OFFSET + 1];
+
+    unsigned char m_played_in_edge[BITSETSIZE][4][Pattern::NUM_SLICES];
+
+    unsigned short m_inverse_slice_godel[BITSETSIZE][Pattern::NUM_SLICES]
+                                        [SLICE_SIZE];
+
     /** Constructor. */
     PatternMatcherData(const ConstBoard* brd);
 
     void Initialize();
 };
 
+inline int PatternMatcherData::PlayedInSlice(HexPoint x, HexPoint y) const
+{
+    BenzeneAssert(HexPointUtil::isInteriorCell(x));
+    BenzeneAssert(HexPointUtil::isInteriorCell(y));
+    BenzeneAssert(-MAX_OFFSET <= y - x && y - x <= MAX_OFFSET);
+    return m_offsets[y - x + MAX_OFFSET].slice;
+}
+
+inline int PatternMatcherData::PlayedInGodel(HexPoint x, HexPoint y) const
+{
+    BenzeneAssert(HexPointUtil::isInteriorCell(x));
+    BenzeneAssert(HexPointUtil::isInteriorCell(y));
+    BenzeneAssert(-MAX_OFFSET <= y - x && y - x <= MAX_OFFSET);
+    return m_offsets[y - x + MAX_OFFSET].godel;
+}
+
+inline int PatternMatcherData::PlayedInEdge(HexPoint x, HexPoint edge,
+                                            int slice) const
+{
+    return m_played_in_edge[x][edge - FIRST_EDGE][slice];
+}
+
+inline HexPoint PatternMatcherData::InverseSliceGodel(HexPoint cell,
+                                                      int slice,
+                                                      int bit) const
+{
+    BenzeneAssert(bit < SLICE_SIZE);
+    return static_cast<HexPoint>(m_inverse_slice_godel[cell][slice][bit]);
+}
+
 //----------------------------------------------------------------------------
 
 /** Tracks pattern state info on a board. */
@@ -241,6 +415,14 @@ public:
                           MatchMode mode, 
                           std::vector<PatternHits>& hits) const;
 
+    /** Same as above, but stores the hits in a reusable buffer,
+        which is cleared first. Does not allocate memory once the
+        buffer has grown to the size of the result. */
+    bitset_t MatchOnBoard(const bitset_t& consider, 
+                          const HashedPatternSet& patset, 
+                          MatchMode mode, 
+                          PatternHitBuffer& hits) const;
+
     /** Matches the hashed patterns on the given consider set,
         returning a set of cells where at least one pattern
         matched. For each cell, the search is aborted after the first
@@ -260,17 +442,19 @@ public:
     std::string DumpPatternCheckStats() const;
 
 private:
-    /** Pattern checking statistics. */
+    /** Pattern checking statistics. Atomic since the black and white
+        connection builds of a HexBoard may match patterns on the same
+        state concurrently (see VCBuilderParam::parallel_builds). */
     struct Statistics
     {
         /** Number of pattern checks. */
-        size_t pattern_checks;
+        std::atomic<size_t> pattern_checks;
 
         /** Number of calls to checkRingGodel(). */
-        size_t ring_checks;
+        std::atomic<size_t> ring_checks;
 
         /** Number of slice checks. */
-        size_t slice_checks;
+        std::atomic<size_t> slice_checks;
     };
 
     StoneBoard& m_brd;
@@ -307,10 +491,10 @@ private:
                         const RotatedPattern& rotpat) const;
 
     bool CheckRotatedPattern(HexPoint cell, 
-                             const RotatedPattern& rotpat,
-			     std::vector<HexPoint>& empty,
-                             std::vector<HexPoint>& moves1,
-                             std::vector<HexPoint>& moves2) const;
+                             const RotatedPattern& rotpat) const;
+
+    void GetRotatedMoves(HexPoint cell, const RotatedPattern& rotpat,
+                         PatternHit& hit) const;
 };
 
 inline const StoneBoard& PatternState::Board() const
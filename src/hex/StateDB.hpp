@@ -15,12 +15,11 @@ _BEGIN_BENZENE_NAMESPACE_
 
 namespace {
 
-SgHashCode GetHash(const HexState& state)
+/** Returns the smaller of the hashes of the state and its rotation. */
+inline SgHashCode GetHash(const HexState& state)
 {
     SgHashCode hash1 = state.Hash();
-    HexState rotatedState(state);
-    rotatedState.Position().RotateBoard();
-    SgHashCode hash2 = rotatedState.Hash();
+    SgHashCode hash2 = state.RotatedHash();
     return (hash1 < hash2) ? hash1 : hash2;
 }
 
@@ -82,8 +81,10 @@ public:
         Statistics();
     };
 
-    /** Opens database, creates it if it does not exist. */
-    StateDB(const std::string& filename, const std::string& type);
+    /** Opens database, creates it if it does not exist. See
+        HashDB for the backend. */
+    StateDB(const std::string& filename, const std::string& type,
+            HashDBBackend backend = HASHDB_BERKELEY);
 
     /** Closes database. */    
     ~StateDB();
@@ -116,8 +117,9 @@ private:
 };
 
 template<class T>
-StateDB<T>::StateDB(const std::string& filename, const std::string& type)
-    : m_db(filename, type),
+StateDB<T>::StateDB(const std::string& filename, const std::string& type,
+                    HashDBBackend backend)
+    : m_db(filename, type, backend),
       m_stats()
 {
 }
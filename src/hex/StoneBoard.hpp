@@ -72,6 +72,13 @@ public:
         Hash(). */
     SgHashCode Hash(HexColor toPlay) const;
 
+    /** Returns the hash Hash() would return after RotateBoard(). */
+    SgHashCode RotatedHash() const;
+
+    /** Returns the hash Hash(toPlay) would return after
+        RotateBoard(). */
+    SgHashCode RotatedHash(HexColor toPlay) const;
+
     //-----------------------------------------------------------------------
 
     /** Number of played stones on the interior of the board. 
@@ -306,6 +313,16 @@ inline SgHashCode StoneBoard::Hash(HexColor toPlay) const
     return m_hash.Hash(toPlay);
 }
 
+inline SgHashCode StoneBoard::RotatedHash() const
+{
+    return m_hash.RotatedHash(EMPTY);
+}
+
+inline SgHashCode StoneBoard::RotatedHash(HexColor toPlay) const
+{
+    return m_hash.RotatedHash(toPlay);
+}
+
 inline bitset_t StoneBoard::GetBlack() const
 {
     return m_stones[BLACK] & Const().GetLocations();
@@ -0,0 +1,167 @@
+//----------------------------------------------------------------------------
+/** @file VCCache.cpp */
+//----------------------------------------------------------------------------
+
+#include "VCCache.hpp"
+
+#include <sstream>
+
+using namespace benzene;
+
+//----------------------------------------------------------------------------
+
+std::size_t VCCacheData::Bytes() const
+{
+    return sizeof(VCCacheData)
+        + (fulls.capacity() + semis.capacity()) * sizeof(List)
+        + carriers.capacity() * sizeof(bitset_t)
+        + old.capacity() / 8;
+}
+
+//----------------------------------------------------------------------------
+
+std::string VCCache::Statistics::ToString() const
+{
+    std::ostringstream os;
+    os << "Lookups    " << lookups << '\n'
+       << "Hits       " << hits;
+    if (lookups)
+        os << " (" << (100.0 * double(hits) / double(lookups)) << "%)";
+    os << '\n'
+       << "Stores     " << stores << '\n'
+       << "Evictions  " << evictions << '\n'
+       << "Entries    " << entries << '/' << capacity << '\n'
+       << "Memory     " << bytes / 1024 << "kb";
+    return os.str();
+}
+
+//----------------------------------------------------------------------------
+
+inline VCCache::Key::Key(SgHashCode hash, HexColor color, unsigned settings)
+    : hash(hash),
+      color(color),
+      settings(settings)
+{
+}
+
+inline bool VCCache::Key::operator<(const Key& other) const
+{
+    if (hash != other.hash)
+        return hash < other.hash;
+    if (color != other.color)
+        return color < other.color;
+    return settings < other.settings;
+}
+
+inline VCCache::Slot::Slot(const Key& key, const DataPtr& data)
+    : key(key),
+      data(data),
+      referenced(false)
+{
+}
+
+//----------------------------------------------------------------------------
+
+VCCache::VCCache(std::size_t capacity)
+    : m_capacity(capacity)
+{
+    ClearUnlocked();
+}
+
+VCCache::~VCCache()
+{
+}
+
+VCCache& VCCache::Global()
+{
+    static VCCache s_cache(4096);
+    return s_cache;
+}
+
+VCCache::DataPtr VCCache::Get(SgHashCode hash, HexColor color,
+                              unsigned settings)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_stats.lookups++;
+    std::map<Key, std::size_t>::const_iterator it
+        = m_index.find(Key(hash, color, settings));
+    if (it == m_index.end())
+        return DataPtr();
+    m_stats.hits++;
+    Slot& slot = m_slots[it->second];
+    slot.referenced = true;
+    return slot.data;
+}
+
+void VCCache::Put(SgHashCode hash, HexColor color, unsigned settings,
+                  const DataPtr& data)
+{
+    if (m_capacity == 0)
+        return;
+    const Key key(hash, color, settings);
+    const std::size_t bytes = data->Bytes();
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_stats.stores++;
+    std::map<Key, std::size_t>::iterator it = m_index.find(key);
+    if (it != m_index.end())
+    {
+        Slot& slot = m_slots[it->second];
+        m_bytes -= slot.data->Bytes();
+        slot.data = data;
+    }
+    else if (m_slots.size() < m_capacity)
+    {
+        m_index[key] = m_slots.size();
+        m_slots.push_back(Slot(key, data));
+    }
+    else
+    {
+        while (m_slots[m_hand].referenced)
+        {
+            m_slots[m_hand].referenced = false;
+            m_hand = (m_hand + 1) % m_slots.size();
+        }
+        Slot& slot = m_slots[m_hand];
+        m_index.erase(slot.key);
+        m_bytes -= slot.data->Bytes();
+        m_stats.evictions++;
+        slot = Slot(key, data);
+        m_index[key] = m_hand;
+        m_hand = (m_hand + 1) % m_slots.size();
+    }
+    m_bytes += bytes;
+}
+
+void VCCache::Clear()
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    ClearUnlocked();
+}
+
+void VCCache::SetCapacity(std::size_t capacity)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_capacity = capacity;
+    ClearUnlocked();
+}
+
+void VCCache::ClearUnlocked()
+{
+    m_slots.clear();
+    m_index.clear();
+    m_hand = 0;
+    m_bytes = 0;
+    m_stats = Statistics();
+}
+
+VCCache::Statistics VCCache::GetStatistics() const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    Statistics stats = m_stats;
+    stats.entries = m_slots.size();
+    stats.capacity = m_capacity;
+    stats.bytes = m_bytes;
+    return stats;
+}
+
+//----------------------------------------------------------------------------
@@ -0,0 +1,168 @@
+//----------------------------------------------------------------------------
+/** @file VCCache.hpp */
+//----------------------------------------------------------------------------
+
+#ifndef VCCACHE_HPP
+#define VCCACHE_HPP
+
+#include "SgSystem.h"
+#include "SgHash.h"
+#include "Hex.hpp"
+#include "HexColor.hpp"
+#include "HexPoint.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/utility.hpp>
+
+_BEGIN_BENZENE_NAMESPACE_
+
+//----------------------------------------------------------------------------
+
+/** Connection set of one color in compact form, as produced by a
+    build from scratch. @see VCS::Store(), VCS::Load(). */
+struct VCCacheData
+{
+    /** The carriers between one pair of points. */
+    struct List
+    {
+        HexPoint x;
+
+        HexPoint y;
+
+        /** The list's carriers are carriers[begin, end). */
+        std::size_t begin;
+
+        std::size_t end;
+
+        /** Intersection maintained by the list. */
+        bitset_t intersection;
+
+        /** Whether an or-list is queued for the or-rule. */
+        bool queued;
+    };
+
+    std::vector<List> fulls;
+
+    std::vector<List> semis;
+
+    std::vector<bitset_t> carriers;
+
+    /** Processed flag of each carrier. */
+    std::vector<bool> old;
+
+    /** Approximate memory used. */
+    std::size_t Bytes() const;
+};
+
+//----------------------------------------------------------------------------
+
+/** Thread-safe cache of connection sets shared by all HexBoards.
+
+    Entries are keyed by the hash of all stones on the board (played
+    and fill-in), the connection color, and the builder settings that
+    affect the result. When full, entries are evicted with the clock
+    algorithm: an entry survives one sweep of the clock hand for every
+    hit since the hand last passed it.
+
+    Used by HexBoard when VCBuilderParam::use_cache is set. */
+class VCCache : private boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr<const VCCacheData> DataPtr;
+
+    /** Counters since the last Clear(). */
+    struct Statistics
+    {
+        std::size_t lookups;
+
+        std::size_t hits;
+
+        std::size_t stores;
+
+        std::size_t evictions;
+
+        std::size_t entries;
+
+        std::size_t capacity;
+
+        /** Approximate memory used by entries. */
+        std::size_t bytes;
+
+        std::string ToString() const;
+    };
+
+    explicit VCCache(std::size_t capacity);
+
+    ~VCCache();
+
+    /** The cache shared by all HexBoards. */
+    static VCCache& Global();
+
+    /** Returns cached data, or a null pointer if none. */
+    DataPtr Get(SgHashCode hash, HexColor color, unsigned settings);
+
+    /** Stores data, replacing an older entry or evicting one if the
+        cache is full. */
+    void Put(SgHashCode hash, HexColor color, unsigned settings,
+             const DataPtr& data);
+
+    /** Removes all entries and resets the counters. */
+    void Clear();
+
+    /** Clears the cache and changes its capacity (in entries). */
+    void SetCapacity(std::size_t capacity);
+
+    Statistics GetStatistics() const;
+
+private:
+    struct Key
+    {
+        SgHashCode hash;
+
+        HexColor color;
+
+        unsigned settings;
+
+        Key(SgHashCode hash, HexColor color, unsigned settings);
+
+        bool operator<(const Key& other) const;
+    };
+
+    struct Slot
+    {
+        Key key;
+
+        DataPtr data;
+
+        bool referenced;
+
+        Slot(const Key& key, const DataPtr& data);
+    };
+
+    mutable boost::mutex m_mutex;
+
+    std::size_t m_capacity;
+
+    std::vector<Slot> m_slots;
+
+    std::map<Key, std::size_t> m_index;
+
+    std::size_t m_hand;
+
+    std::size_t m_bytes;
+
+    Statistics m_stats;
+
+    void ClearUnlocked();
+};
+
+//----------------------------------------------------------------------------
+
+_END_BENZENE_NAMESPACE_
+
+#endif // VCCACHE_HPP
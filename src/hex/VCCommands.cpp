@@ -2,8 +2,13 @@
 /** @file VCCommands.cpp */
 //----------------------------------------------------------------------------
 
+#include "SgSystem.h"
+#include "SgTimer.h"
+
+#include "BitsetIterator.hpp"
 #include "BoardUtil.hpp"
 #include "EndgameUtil.hpp"
+#include "VCCache.hpp"
 #include "VCCommands.hpp"
 #include "VCUtil.hpp"
 
@@ -39,7 +44,14 @@ void VCCommands::Register(GtpEngine& e)
     Register(e, "vc-undo-incremental", &VCCommands::CmdUndoIncremental);
     Register(e, "vc-set-stats", &VCCommands::CmdSetInfo);
     Register(e, "vc-builder-stats", &VCCommands::CmdBuilderStats);
+    Register(e, "vc-builder-profile", &VCCommands::CmdBuilderProfile);
+    Register(e, "vc-builder-profile-clear",
+             &VCCommands::CmdBuilderProfileClear);
+    Register(e, "vc-cache-stats", &VCCommands::CmdCacheStats);
+    Register(e, "vc-cache-clear", &VCCommands::CmdCacheClear);
+    Register(e, "vc-cache-capacity", &VCCommands::CmdCacheCapacity);
     Register(e, "vc-maintenance-responses", &VCCommands::CmdVCMResponses);
+    Register(e, "vc-bench-play-undo", &VCCommands::CmdBenchPlayUndo);
 }
 
 void VCCommands::AddAnalyzeCommands(HtpCommand& cmd)
@@ -59,6 +71,7 @@ void VCCommands::AddAnalyzeCommands(HtpCommand& cmd)
         "inferior/VC Build Undo Incremental/vc-undo-incremental\n"
         "string/VC Set Stats/vc-set-stats %c\n"
         "string/VC Builder Stats/vc-builder-stats %c\n"
+        "string/VC Cache Stats/vc-cache-stats\n"
         "plist/VC Maintenance Responses/vc-maintenance-responses %p\n";
 }
 
@@ -253,6 +266,36 @@ void VCCommands::CmdVCMResponses(HtpCommand& cmd)
     cmd << HexPointUtil::ToString(responses);
 }
 
+/** Times PlayMove()/UndoMove() pairs on the current position.
+    Usage: "vc-bench-play-undo [color] [repeats]". Plays every empty
+    cell in turn, repeats times, and prints the mean time per pair. */
+void VCCommands::CmdBenchPlayUndo(HtpCommand& cmd)
+{
+    cmd.CheckNuArgLessEqual(2);
+    HexColor color = m_game.Board().WhoseTurn();
+    if (cmd.NuArg() >= 1)
+        color = HtpUtil::ColorArg(cmd, 0);
+    std::size_t repeats = 1;
+    if (cmd.NuArg() >= 2)
+        repeats = cmd.ArgMin<std::size_t>(1, 1);
+    HexBoard& brd = m_env.SyncBoard(m_game.Board());
+    brd.ComputeAll(color);
+    const bitset_t empty = brd.GetPosition().GetEmpty();
+    std::size_t pairs = 0;
+    SgTimer timer;
+    for (std::size_t i = 0; i < repeats; ++i)
+        for (BitsetIterator p(empty); p; ++p)
+        {
+            brd.PlayMove(color, *p);
+            brd.UndoMove();
+            pairs++;
+        }
+    double elapsed = timer.GetTime();
+    cmd << "pairs " << pairs << " total " << elapsed << "s per-pair "
+        << (pairs ? 1e6 * elapsed / static_cast<double>(pairs) : 0.0)
+        << "us";
+}
+
 //----------------------------------------------------------------------------
 
 /** Obtains statistics on connection set. */
@@ -281,6 +324,42 @@ void VCCommands::CmdBuilderStats(HtpCommand& cmd)
     brd.Cons(color).DumpBuildStats(cmd);
 }
 
-//----------------------------------------------------------------------------
+/** Prints the build profile of the given color as JSON.
+    The profile is empty unless built with BENZENE_VC_PROFILE. */
+void VCCommands::CmdBuilderProfile(HtpCommand& cmd)
+{
+    cmd.CheckNuArg(1);
+    HexColor color = HtpUtil::ColorArg(cmd, 0);
+    HexBoard& brd = *m_env.brd;
+    cmd << brd.Cons(color).Profile().ToJson();
+}
 
+void VCCommands::CmdBuilderProfileClear(HtpCommand& cmd)
+{
+    cmd.CheckArgNone();
+    HexBoard& brd = *m_env.brd;
+    for (BWIterator c; c; ++c)
+        brd.Cons(*c).ClearProfile();
+}
 
+/** Prints hit rate and memory use of the shared VC cache. */
+void VCCommands::CmdCacheStats(HtpCommand& cmd)
+{
+    cmd.CheckArgNone();
+    cmd << '\n' << VCCache::Global().GetStatistics().ToString();
+}
+
+void VCCommands::CmdCacheClear(HtpCommand& cmd)
+{
+    cmd.CheckArgNone();
+    VCCache::Global().Clear();
+}
+
+/** Sets the number of entries of the shared VC cache; clears it. */
+void VCCommands::CmdCacheCapacity(HtpCommand& cmd)
+{
+    cmd.CheckNuArg(1);
+    VCCache::Global().SetCapacity(cmd.ArgMin<std::size_t>(0, 0));
+}
+
+//----------------------------------------------------------------------------
@@ -48,7 +48,13 @@ private:
     void CmdUndoIncremental(HtpCommand& cmd);
     void CmdSetInfo(HtpCommand& cmd);
     void CmdBuilderStats(HtpCommand& cmd);
+    void CmdBuilderProfile(HtpCommand& cmd);
+    void CmdBuilderProfileClear(HtpCommand& cmd);
+    void CmdCacheStats(HtpCommand& cmd);
+    void CmdCacheClear(HtpCommand& cmd);
+    void CmdCacheCapacity(HtpCommand& cmd);
     void CmdVCMResponses(HtpCommand& cmd);
+    void CmdBenchPlayUndo(HtpCommand& cmd);
 };
 
 //----------------------------------------------------------------------------
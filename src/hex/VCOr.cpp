@@ -1,3 +1,4 @@
+#include "CarrierMatrix.hpp"
 #include "VCOr.hpp"
 #include "VCS.hpp"
 
@@ -191,9 +192,185 @@ inline int VCOrCombiner::Filter(int start, int count, size_t a) const
     return res;
 }
 
+/** VCOrCombiner for semi lists of at most CarrierMatrix::MAX_CARRIERS
+    carriers. The semis of a search are masks over a CarrierMatrix, so
+    filtering them by a cell is an and instead of copying the carriers
+    that remain. Only the full connections are kept in m_mem. Gives the
+    same result in the same order as VCOrCombiner. */
+class MatrixOrCombiner
+{
+public:
+    MatrixOrCombiner(const CarrierList& semis, const CarrierList& fulls,
+                     bitset_t xCapturedSet, bitset_t yCapturedSet);
+
+    vector<bitset_t> SearchResult() const;
+
+private:
+    typedef CarrierMatrix::Mask Mask;
+
+    const CarrierMatrix m_semis;
+    bitset_t m_xCapturedSet;
+    bitset_t m_yCapturedSet;
+    std::vector<bitset_t> m_mem;
+
+    int Search(bitset_t forbidden, bool captureX, bool captureY,
+               Mask new_semis, Mask old_semis,
+               int filtered, int filtered_count);
+
+    bitset_t Add(Mask new_semis, Mask old_semis, bitset_t capturedSet) const;
+    int Filter(int start, int count, size_t a);
+};
+
+MatrixOrCombiner::MatrixOrCombiner(const CarrierList& semis,
+                                   const CarrierList& fulls,
+                                   bitset_t xCapturedSet,
+                                   bitset_t yCapturedSet)
+    : m_semis(semis),
+      m_xCapturedSet(xCapturedSet), m_yCapturedSet(yCapturedSet)
+{
+    const Mask new_semis = m_semis.New();
+    if (!new_semis)
+        return;
+    m_mem.reserve(fulls.Count());
+    for (CarrierList::Iterator i(fulls); i; ++i)
+        m_mem.push_back(i.Carrier());
+    Search(bitset_t(), true, true, new_semis, m_semis.All() & ~new_semis,
+           0, fulls.Count());
+}
+
+inline vector<bitset_t> MatrixOrCombiner::SearchResult() const
+{
+    return m_mem;
+}
+
+/** Same as VCOrCombiner::Search(); the new connections found are
+    returned at m_mem[filtered]. */
+int MatrixOrCombiner::Search(bitset_t forbidden, bool captureX, bool captureY,
+                             Mask new_semis, Mask old_semis,
+                             int filtered, int filtered_count)
+{
+    BenzeneAssert(new_semis);
+    bitset_t I_new = m_semis.Intersection(new_semis);
+    bitset_t I_old = m_semis.Intersection(old_semis);
+    bitset_t I = I_new & I_old;
+    bitset_t capturedSet;
+    if (captureX)
+        capturedSet |= m_xCapturedSet;
+    if (captureY)
+        capturedSet |= m_yCapturedSet;
+
+    if (!BitsetUtil::IsSubsetOf(I, capturedSet))
+    {
+        m_mem.resize(filtered);
+        return 0;
+    }
+
+    int new_conn = filtered + filtered_count;
+    int new_conn_count = 0;
+
+    if (filtered_count == 0)
+    {
+        bitset_t minCapturedSet;
+        if ((I & m_xCapturedSet).any())
+            minCapturedSet |= m_xCapturedSet;
+        if ((I & m_yCapturedSet).any())
+            minCapturedSet |= m_yCapturedSet;
+        m_mem.push_back(Add(new_semis, old_semis, minCapturedSet));
+        filtered_count++;
+        new_conn_count++;
+    }
+
+    forbidden |= I_new;
+
+    while (true)
+    {
+        size_t min_size = std::numeric_limits<size_t>::max();
+        bitset_t allowed;
+        for (int i = 0; i < filtered_count && min_size > 0; i++)
+        {
+            bitset_t A = m_mem[filtered + i] - forbidden;
+            size_t size = A.count();
+            if (size < min_size)
+            {
+                min_size = size;
+                allowed = A;
+            }
+        }
+
+        if (min_size == 0)
+        {
+            for (int i = 0; i < new_conn_count; i++)
+                m_mem[filtered + i] = m_mem[new_conn + i];
+            m_mem.resize(filtered + new_conn_count);
+            return new_conn_count;
+        }
+
+        size_t a = allowed._Find_first();
+        BenzeneAssert(a < allowed.size());
+        forbidden.set(a);
+
+        int rec_filtered = filtered + filtered_count;
+        int rec_filtered_count = Filter(filtered, filtered_count, a);
+        int rec_new_conn_count =
+            Search(forbidden, captureX & !m_xCapturedSet[a],
+                   captureY & !m_yCapturedSet[a],
+                   new_semis & ~m_semis.Cell(a),
+                   old_semis & ~m_semis.Cell(a),
+                   rec_filtered, rec_filtered_count);
+        filtered_count += rec_new_conn_count;
+        new_conn_count += rec_new_conn_count;
+    }
+}
+
+/** Same as VCOrCombiner::Add() over the new semis followed by the
+    old ones. */
+inline bitset_t MatrixOrCombiner::Add(Mask new_semis, Mask old_semis,
+                                      bitset_t capturedSet) const
+{
+    bitset_t U = capturedSet;
+    bitset_t I;
+    I.set();
+    for (Mask set = new_semis; ; set &= set - 1)
+    {
+        if (!set)
+        {
+            BenzeneAssert(old_semis);
+            set = old_semis;
+            old_semis = 0;
+        }
+        const bitset_t& next = m_semis.Carrier(CarrierMatrix::First(set));
+        if (BitsetUtil::IsSubsetOf(I, next))
+            continue;
+        I &= next;
+        U |= next;
+        if (BitsetUtil::IsSubsetOf(I, capturedSet))
+            break;
+    }
+    return U;
+}
+
+inline int MatrixOrCombiner::Filter(int start, int count, size_t a)
+{
+    int res = 0;
+    for (int i = 0; i < count; i++)
+    {
+        bitset_t s = m_mem[start + i];
+        if (!s[a])
+        {
+            m_mem.push_back(s);
+            res++;
+        }
+    }
+    return res;
+}
+
 vector<bitset_t> benzene::VCOr(const CarrierList& semis, const CarrierList& fulls,
                                bitset_t xCapturedSet, bitset_t yCapturedSet)
 {
+    if (static_cast<std::size_t>(semis.Count())
+        <= CarrierMatrix::MAX_CARRIERS)
+        return MatrixOrCombiner(semis, fulls, xCapturedSet, yCapturedSet)
+            .SearchResult();
     VCOrCombiner comb(semis, fulls, xCapturedSet, yCapturedSet);
     return comb.SearchResult();
 }
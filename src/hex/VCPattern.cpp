@@ -8,6 +8,8 @@
 #include "StoneBoard.hpp"
 #include "VCPattern.hpp"
 
+#include <algorithm>
+
 using namespace benzene;
 
 //----------------------------------------------------------------------------
@@ -155,10 +157,15 @@ void ProcessPattern(const VCPattern& pat, StoneBoard& brd,
 
 //----------------------------------------------------------------------------
 
-VCPattern::VCPatternSetMap& VCPattern::GetConstructed(HexColor color)
+VCPattern::GlobalData& VCPattern::GetGlobalData()
 {
     static GlobalData data;
-    return data.constructed[color];
+    return data;
+}
+
+VCPattern::VCPatternSetMap& VCPattern::GetConstructed(HexColor color)
+{
+    return GetGlobalData().constructed[color];
 }
 
 const VCPatternSet& 
@@ -187,6 +194,19 @@ VCPattern::GetPatterns(int width, int height, HexColor color)
     return GetConstructed(color)[key];
 }
 
+const VCPatternIndex&
+VCPattern::GetIndex(int width, int height, HexColor color)
+{
+    const VCPatternSet& patterns = GetPatterns(width, height, color);
+    VCPatternIndexMap& indexed = GetGlobalData().indexed[color];
+    std::pair<int, int> key = std::make_pair(width, height);
+    VCPatternIndexMap::iterator it = indexed.find(key);
+    if (it == indexed.end())
+        it = indexed.insert(std::make_pair(key,
+                                           VCPatternIndex(patterns))).first;
+    return it->second;
+}
+
 void VCPattern::CreatePatterns(int width, int height)
 {
     LogFine() << "VCPattern::CreatePatterns(" 
@@ -406,6 +426,60 @@ bool VCPattern::Matches(HexColor color, const StoneBoard& brd) const
 
 //----------------------------------------------------------------------------
 
+VCPatternIndex::VCPatternIndex()
+{
+}
+
+VCPatternIndex::VCPatternIndex(const VCPatternSet& patterns)
+{
+    m_must_have.reserve(patterns.size());
+    for (std::size_t i = 0; i < patterns.size(); ++i)
+    {
+        const bitset_t mustHave = patterns[i].MustHave();
+        m_must_have.push_back(mustHave);
+        if (mustHave.none())
+            m_free.push_back(i);
+        for (BitsetIterator p(mustHave); p; ++p)
+            m_touching[*p].push_back(i);
+    }
+}
+
+void VCPatternIndex::Candidates(bitset_t stones,
+                                std::vector<std::size_t>& out) const
+{
+    out = m_free;
+    // Visit each pattern only from its first must-have cell
+    for (BitsetIterator p(stones); p; ++p)
+        for (std::size_t j = 0; j < m_touching[*p].size(); ++j)
+        {
+            const std::size_t i = m_touching[*p][j];
+            if (m_must_have[i]._Find_first() == static_cast<std::size_t>(*p)
+                && BitsetUtil::IsSubsetOf(m_must_have[i], stones))
+                out.push_back(i);
+        }
+    std::sort(out.begin(), out.end());
+}
+
+void VCPatternIndex::Candidates(bitset_t stones, bitset_t added,
+                                std::vector<std::size_t>& out) const
+{
+    out.clear();
+    added &= stones;
+    // Visit each pattern only from its first must-have cell in added
+    for (BitsetIterator p(added); p; ++p)
+        for (std::size_t j = 0; j < m_touching[*p].size(); ++j)
+        {
+            const std::size_t i = m_touching[*p][j];
+            if ((m_must_have[i] & added)._Find_first()
+                == static_cast<std::size_t>(*p)
+                && BitsetUtil::IsSubsetOf(m_must_have[i], stones))
+                out.push_back(i);
+        }
+    std::sort(out.begin(), out.end());
+}
+
+//----------------------------------------------------------------------------
+
 bool VCPattern::ShiftPattern(HexDirection dir, const StoneBoard& brd)
 {
     bitset_t must, oppt, bad;
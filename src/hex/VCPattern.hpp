@@ -18,6 +18,42 @@ typedef std::vector<VCPattern> VCPatternSet;
 
 //----------------------------------------------------------------------------
 
+/** Index from cells to the patterns of a VCPatternSet that need a
+    stone there. A pattern can only match if all its must-have cells
+    hold stones of the color, so lookups only visit patterns that
+    pass this test; VCPattern::Matches() must still be called to
+    check for opponent stones. Results are pattern indices in
+    increasing order, the order of the set. */
+class VCPatternIndex
+{
+public:
+    VCPatternIndex();
+
+    explicit VCPatternIndex(const VCPatternSet& patterns);
+
+    /** Sets out to the patterns whose must-have cells are all in
+        stones. */
+    void Candidates(bitset_t stones, std::vector<std::size_t>& out) const;
+
+    /** Sets out to the patterns whose must-have cells are all in
+        stones and include a cell in added. Used after added stones
+        were played, to find the patterns that can match only now. */
+    void Candidates(bitset_t stones, bitset_t added,
+                    std::vector<std::size_t>& out) const;
+
+private:
+    /** Must-have cells of each pattern. */
+    std::vector<bitset_t> m_must_have;
+
+    /** Patterns with the cell in their must-have set. */
+    std::vector<std::size_t> m_touching[BITSETSIZE];
+
+    /** Patterns with an empty must-have set. */
+    std::vector<std::size_t> m_free;
+};
+
+//----------------------------------------------------------------------------
+
 /** Precomputed pattern specifying a virtual connection/ladder. */
 class VCPattern
 {        
@@ -34,6 +70,11 @@ public:
     static const VCPatternSet& GetPatterns(int width, int height, 
                                            HexColor color);
 
+    /** Returns the index of GetPatterns(width, height, color);
+        creates both if they do not exist. */
+    static const VCPatternIndex& GetIndex(int width, int height,
+                                          HexColor color);
+
     /** Returns cells that this player must have. */
     bitset_t MustHave() const;
 
@@ -64,11 +105,15 @@ private:
     //------------------------------------------------------------------------
 
     typedef std::map< std::pair<int, int>, VCPatternSet > VCPatternSetMap;
+    typedef std::map< std::pair<int, int>, VCPatternIndex > VCPatternIndexMap;
     struct GlobalData
     {
         VCPatternSetMap constructed[BLACK_AND_WHITE];
+        VCPatternIndexMap indexed[BLACK_AND_WHITE];
     };
 
+    static GlobalData& GetGlobalData();
+
     /** Returns the set of PatternSets already constructed. */
     static VCPatternSetMap& GetConstructed(HexColor color);
 
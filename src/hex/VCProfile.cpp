@@ -0,0 +1,97 @@
+//----------------------------------------------------------------------------
+/** @file VCProfile.cpp */
+//----------------------------------------------------------------------------
+
+#include "VCProfile.hpp"
+
+#include <sstream>
+
+using namespace benzene;
+
+//----------------------------------------------------------------------------
+
+namespace {
+
+const char* s_phaseNames[VCProfile::NUM_PHASES] = {
+    "captured_sets", "base", "patterns", "merge", "and_full", "and_semi", "or"
+};
+
+/** Prints the lengths up to the last non-empty bin. */
+void WriteLengths(std::ostream& os, const std::size_t* lengths,
+                  std::size_t numBins, const char* separator)
+{
+    std::size_t end = numBins;
+    while (end > 0 && lengths[end - 1] == 0)
+        --end;
+    for (std::size_t i = 0; i < end; ++i)
+        os << (i ? separator : "") << lengths[i];
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+
+VCProfile::VCProfile()
+{
+    Clear();
+}
+
+bool VCProfile::Enabled()
+{
+    return BENZENE_VC_PROFILE != 0;
+}
+
+const char* VCProfile::PhaseName(Phase phase)
+{
+    return s_phaseNames[phase];
+}
+
+void VCProfile::Clear()
+{
+    m_builds = 0;
+    for (std::size_t i = 0; i < NUM_PHASES; ++i)
+    {
+        m_calls[i] = 0;
+        m_time[i] = 0;
+    }
+    for (std::size_t i = 0; i < NUM_BINS; ++i)
+        m_lengths[0][i] = m_lengths[1][i] = 0;
+}
+
+void VCProfile::AddBuild()
+{
+    m_builds++;
+}
+
+std::string VCProfile::ToString() const
+{
+    std::ostringstream os;
+    os << "profile builds:" << m_builds << '\n';
+    for (std::size_t i = 0; i < NUM_PHASES; ++i)
+        os << "  " << s_phaseNames[i] << ": " << m_time[i] / 1000
+           << "us in " << m_calls[i] << '\n';
+    os << "  full lengths: ";
+    WriteLengths(os, m_lengths[0], NUM_BINS, " ");
+    os << "\n  semi lengths: ";
+    WriteLengths(os, m_lengths[1], NUM_BINS, " ");
+    return os.str();
+}
+
+std::string VCProfile::ToJson() const
+{
+    std::ostringstream os;
+    os << "{\"enabled\":" << (Enabled() ? "true" : "false")
+       << ",\"builds\":" << m_builds
+       << ",\"phases\":{";
+    for (std::size_t i = 0; i < NUM_PHASES; ++i)
+        os << (i ? "," : "") << '"' << s_phaseNames[i] << "\":{\"calls\":"
+           << m_calls[i] << ",\"ns\":" << m_time[i] << '}';
+    os << "},\"full_lengths\":[";
+    WriteLengths(os, m_lengths[0], NUM_BINS, ",");
+    os << "],\"semi_lengths\":[";
+    WriteLengths(os, m_lengths[1], NUM_BINS, ",");
+    os << "]}";
+    return os.str();
+}
+
+//----------------------------------------------------------------------------
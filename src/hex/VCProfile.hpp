@@ -0,0 +1,139 @@
+//----------------------------------------------------------------------------
+/** @file VCProfile.hpp */
+//----------------------------------------------------------------------------
+
+#ifndef VCPROFILE_HPP
+#define VCPROFILE_HPP
+
+#include "Benzene.hpp"
+
+#include <chrono>
+#include <string>
+#include <boost/utility.hpp>
+
+/** Set to 1 (cmake -DBENZENE_VC_PROFILE=ON) to profile VC builds.
+    When 0 the builder contains no profiling code. */
+#ifndef BENZENE_VC_PROFILE
+#define BENZENE_VC_PROFILE 0
+#endif
+
+_BEGIN_BENZENE_NAMESPACE_
+
+//----------------------------------------------------------------------------
+
+/** Time spent in each phase of VC builds and lengths of the carrier
+    lists they leave behind, summed over builds since the last
+    Clear(). Filled by VCS only if BENZENE_VC_PROFILE is set. */
+class VCProfile
+{
+public:
+    enum Phase
+    {
+        /** ComputeCapturedSets(). */
+        CAPTURED_SETS,
+
+        /** AddBaseVCs(). */
+        BASE,
+
+        /** AddPatternVCs(). */
+        PATTERNS,
+
+        /** Merge() and shrinking in incremental builds. */
+        MERGE,
+
+        /** And-rule over a stone; builds fulls. */
+        AND_FULL,
+
+        /** And-rule over an empty cell; builds semis. */
+        AND_SEMI,
+
+        /** Or-rule. */
+        OR,
+
+        NUM_PHASES
+    };
+
+    /** Number of length bins; longer lists go to the last bin. */
+    static const std::size_t NUM_BINS = 32;
+
+    VCProfile();
+
+    /** Whether profiling is compiled in. */
+    static bool Enabled();
+
+    static const char* PhaseName(Phase phase);
+
+    void Clear();
+
+    /** Counts a finished build. */
+    void AddBuild();
+
+    /** Adds the length of one full (semi = false) or semi list. */
+    void AddLength(bool semi, std::size_t length);
+
+    /** Human-readable summary. */
+    std::string ToString() const;
+
+    /** Same data as a JSON object. */
+    std::string ToJson() const;
+
+    /** Adds the time of its lifetime to a phase. */
+    class Scope : boost::noncopyable
+    {
+    public:
+        Scope(VCProfile& profile, Phase phase);
+
+        ~Scope();
+
+    private:
+        VCProfile& m_profile;
+
+        Phase m_phase;
+
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+private:
+    std::size_t m_builds;
+
+    std::size_t m_calls[NUM_PHASES];
+
+    /** Nanoseconds. */
+    std::chrono::nanoseconds::rep m_time[NUM_PHASES];
+
+    std::size_t m_lengths[2][NUM_BINS];
+};
+
+inline VCProfile::Scope::Scope(VCProfile& profile, Phase phase)
+    : m_profile(profile),
+      m_phase(phase),
+      m_start(std::chrono::steady_clock::now())
+{
+}
+
+inline VCProfile::Scope::~Scope()
+{
+    m_profile.m_calls[m_phase]++;
+    m_profile.m_time[m_phase] += std::chrono::duration_cast
+        <std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                     - m_start).count();
+}
+
+inline void VCProfile::AddLength(bool semi, std::size_t length)
+{
+    m_lengths[semi][length < NUM_BINS ? length : NUM_BINS - 1]++;
+}
+
+/** Times the rest of the enclosing block as phase of profile. */
+#if BENZENE_VC_PROFILE
+#define VC_PROFILE_SCOPE(profile, phase) \
+    VCProfile::Scope vcProfileScope(profile, VCProfile::phase)
+#else
+#define VC_PROFILE_SCOPE(profile, phase)
+#endif
+
+//----------------------------------------------------------------------------
+
+_END_BENZENE_NAMESPACE_
+
+#endif // VCPROFILE_HPP
@@ -5,8 +5,12 @@
 #include "SgSystem.h"
 #include "SgTimer.h"
 
+#include <chrono>
+#include <sstream>
+
 #include "Hex.hpp"
 #include "BitsetIterator.hpp"
+#include "CarrierMatrix.hpp"
 #include "Misc.hpp"
 #include "VCS.hpp"
 #include "VCOr.hpp"
@@ -22,38 +26,84 @@ VCBuilderParam::VCBuilderParam()
       use_non_edge_patterns(true),
       incremental_builds(true),
       limit_fulls(true),
-      limit_or(true)
+      limit_or(true),
+      parallel_builds(false),
+      journal_undo(false),
+      use_cache(false),
+      max_rule_applications(0),
+      max_build_usec(0)
+{
+}
+
+bool VCBuilderParam::IsBudgeted() const
+{
+    return max_rule_applications != 0 || max_build_usec != 0;
+}
+
+unsigned VCBuilderParam::ResultSettings() const
 {
+    return (and_over_edge ? 1 : 0)
+        | (use_patterns ? 2 : 0)
+        | (use_non_edge_patterns ? 4 : 0)
+        | (limit_fulls ? 8 : 0)
+        | (limit_or ? 16 : 0);
 }
 
 //----------------------------------------------------------------------------
 
+CarrierList::Watcher::~Watcher()
+{
+}
+
 inline CarrierList::CarrierList()
+    : m_watcher(0)
 {
 }
 
 inline CarrierList::CarrierList(bitset_t carrier)
-    : m_list(1, carrier)
+    : m_list(1, carrier),
+      m_watcher(0)
 {
 }
 
 inline CarrierList::CarrierList(const std::vector<bitset_t>& carriers_list)
+    : m_watcher(0)
 {
     m_list.reserve(carriers_list.size());
     for (std::size_t i = 0; i < carriers_list.size(); ++i)
         AddNew(carriers_list[i]);
 }
 
+CarrierList::CarrierList(const CarrierList& other)
+    : m_list(other.m_list),
+      m_watcher(0)
+{
+}
+
+CarrierList& CarrierList::operator=(const CarrierList& other)
+{
+    m_list = other.m_list;
+    return *this;
+}
+
 inline void CarrierList::AddNew(bitset_t carrier)
 {
+    Touch();
     m_list.push_back(carrier);
 }
 
 inline bool CarrierList::SupersetOfAny(bitset_t carrier) const
+{
+    return SupersetOfAny(Elem(carrier));
+}
+
+inline bool CarrierList::SupersetOfAny(const Elem& elem) const
 {
     for (std::size_t i = 0; i < m_list.size(); ++i)
-        if (BitsetUtil::IsSubsetOf(m_list[i].carrier, carrier))
+        if (m_list[i].IsSubsetOf(elem))
         {
+            if (i > 0)
+                Touch();
             // Move to front
             Elem c = m_list[i];
             for (std::size_t j = i; j > 0; j--)
@@ -70,8 +120,10 @@ inline bool CarrierList::RemoveSupersetsOfCheckAnyRemoved(const CarrierList& fil
     std::size_t i = 0;
     for (; i < m_list.size(); ++i)
     {
-        if (!filter.SupersetOfAny(m_list[i].carrier))
+        if (!filter.SupersetOfAny(m_list[i]))
             m_list[j++] = m_list[i];
+        else if (j == i)
+            Touch();
     }
     m_list.resize(j);
     return j < i;
@@ -80,16 +132,19 @@ inline bool CarrierList::RemoveSupersetsOfCheckAnyRemoved(const CarrierList& fil
 template <bool check_old>
 inline bool CarrierList::RemoveSupersetsOf(bitset_t carrier)
 {
+    const Elem elem(carrier);
     std::size_t j = 0;
     std::size_t i = 0;
     bool check_old_res = false;
     for (; i < m_list.size(); ++i)
     {
-        if (!BitsetUtil::IsSubsetOf(carrier, m_list[i].carrier))
+        if (!elem.IsSubsetOf(m_list[i]))
             m_list[j++] = m_list[i];
-        else if (check_old)
+        else
         {
-            if (m_list[i].old)
+            if (j == i)
+                Touch();
+            if (check_old && m_list[i].old)
                 check_old_res = true;
         }
     }
@@ -110,8 +165,13 @@ inline size_t CarrierList::RemoveAllContaining_(bitset_t set,
     {
         if ((set & m_list[i].carrier).none())
             m_list[j++] = m_list[i];
-        else if (store_removed)
-            removed->push_back(m_list[i].carrier);
+        else
+        {
+            if (j == i)
+                Touch();
+            if (store_removed)
+                removed->push_back(m_list[i].carrier);
+        }
     }
     m_list.resize(j);
     return i - j;
@@ -145,9 +205,11 @@ inline void CarrierList::RemoveSupersetsOfUnchecked(bitset_t carrier)
 
 inline bool CarrierList::TrySetOld(bitset_t carrier) const
 {
+    const unsigned long signature = carrier.fold();
     for (std::size_t i = 0; i < m_list.size(); ++i)
-        if (m_list[i].carrier == carrier)
+        if (m_list[i].signature == signature && m_list[i].carrier == carrier)
         {
+            Touch();
             m_list[i].old = true;
             return true;
         }
@@ -201,12 +263,14 @@ inline bitset_t CarrierList::GetNewIntersection() const
 
 inline void CarrierList::MarkAllOld()
 {
+    Touch();
     for (std::size_t i = 0; i < m_list.size(); i++)
         m_list[i].old = true;
 }
 
 inline void CarrierList::MarkAllNew()
 {
+    Touch();
     for (std::size_t i = 0; i < m_list.size(); i++)
         m_list[i].old = false;
 }
@@ -214,6 +278,31 @@ inline void CarrierList::MarkAllNew()
 inline void CarrierList::Clear()
 {
     m_list.clear();
+    m_watcher = 0;
+}
+
+inline void CarrierList::StoreCarriers(VCCacheData& data,
+                                       VCCacheData::List& list) const
+{
+    list.begin = data.carriers.size();
+    for (std::size_t i = 0; i < m_list.size(); ++i)
+    {
+        data.carriers.push_back(m_list[i].carrier);
+        data.old.push_back(m_list[i].old);
+    }
+    list.end = data.carriers.size();
+}
+
+inline void CarrierList::LoadCarriers(const VCCacheData& data,
+                                      const VCCacheData::List& list)
+{
+    Touch();
+    m_list.clear();
+    for (std::size_t i = list.begin; i < list.end; ++i)
+    {
+        m_list.push_back(data.carriers[i]);
+        m_list.back().old = data.old[i];
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -314,9 +403,30 @@ inline void VCS::AndList::MarkAllUnprocessed()
 
 inline void VCS::AndList::CalcIntersection()
 {
+    Touch();
     m_processed_intersection = GetOldIntersection();
 }
 
+void VCS::AndList::Clear()
+{
+    CarrierList::Clear();
+    m_processed_intersection.set();
+}
+
+void VCS::AndList::Store(VCCacheData& data, VCCacheData::List& list) const
+{
+    StoreCarriers(data, list);
+    list.intersection = m_processed_intersection;
+    list.queued = false;
+}
+
+void VCS::AndList::Load(const VCCacheData& data,
+                        const VCCacheData::List& list)
+{
+    LoadCarriers(data, list);
+    m_processed_intersection = list.intersection;
+}
+
 //----------------------------------------------------------------------------
 
 inline VCS::OrList::OrList()
@@ -388,10 +498,22 @@ inline bool VCS::OrList::RemoveSupersetsOf(const CarrierList& filter)
 inline bool VCS::OrList::TryQueue(bitset_t capturedSet)
 {
     bool prev_queued = m_queued;
-    m_queued = BitsetUtil::IsSubsetOf(m_intersection, capturedSet);
+    bool queued = BitsetUtil::IsSubsetOf(m_intersection, capturedSet);
+    if (queued != prev_queued)
+        Touch();
+    m_queued = queued;
     return !prev_queued && m_queued;
 }
 
+inline void VCS::OrList::Dequeue()
+{
+    if (m_queued)
+    {
+        Touch();
+        m_queued = false;
+    }
+}
+
 void VCS::OrList::MarkAllProcessed()
 {
     MarkAllOld();
@@ -405,6 +527,7 @@ void VCS::OrList::MarkAllUnprocessed()
 
 inline void VCS::OrList::CalcIntersection()
 {
+    Touch();
     m_intersection = GetAllIntersection();
 }
 
@@ -412,6 +535,22 @@ void VCS::OrList::Clear()
 {
     CarrierList::Clear();
     m_intersection.set();
+    m_queued = false;
+}
+
+void VCS::OrList::Store(VCCacheData& data, VCCacheData::List& list) const
+{
+    StoreCarriers(data, list);
+    list.intersection = m_intersection;
+    list.queued = m_queued;
+}
+
+void VCS::OrList::Load(const VCCacheData& data,
+                       const VCCacheData::List& list)
+{
+    LoadCarriers(data, list);
+    m_intersection = list.intersection;
+    m_queued = list.queued;
 }
 
 //---------------------------------------------------------------------------
@@ -425,7 +564,8 @@ inline void VCS::TestQueuesEmpty()
 VCS::VCS(HexColor color)
     : m_color(color),
       m_edge1(HexPointUtil::colorEdge1(color)),
-      m_edge2(HexPointUtil::colorEdge2(color))
+      m_edge2(HexPointUtil::colorEdge2(color)),
+      m_partial(false)
 {
     LoadCapturedSetPatterns();
 }
@@ -464,6 +604,7 @@ VCS::VCS(const VCS& other)
 /** Computes the 0-connections defined by adjacency.*/
 void VCS::AddBaseVCs()
 {
+    VC_PROFILE_SCOPE(m_profile, BASE);
     HexColorSet not_other = HexColorSetUtil::ColorOrEmpty(m_color);
     for (GroupIterator x(*m_groups, not_other); x; ++x)
     {
@@ -480,12 +621,34 @@ void VCS::AddBaseVCs()
 
 /** Adds vcs obtained by pre-computed patterns. */
 void VCS::AddPatternVCs()
+{
+    VC_PROFILE_SCOPE(m_profile, PATTERNS);
+    std::vector<std::size_t> candidates;
+    VCPattern::GetIndex(m_brd->Width(), m_brd->Height(), m_color)
+        .Candidates(m_brd->GetColor(m_color) & m_brd->Const().GetCells(),
+                    candidates);
+    AddPatternVCs(candidates);
+}
+
+/** Adds vcs obtained by pre-computed patterns that match only since
+    the added stones were played. */
+void VCS::AddPatternVCs(bitset_t added)
+{
+    VC_PROFILE_SCOPE(m_profile, PATTERNS);
+    std::vector<std::size_t> candidates;
+    VCPattern::GetIndex(m_brd->Width(), m_brd->Height(), m_color)
+        .Candidates(m_brd->GetColor(m_color) & m_brd->Const().GetCells(),
+                    added, candidates);
+    AddPatternVCs(candidates);
+}
+
+void VCS::AddPatternVCs(const std::vector<std::size_t>& candidates)
 {
     const VCPatternSet& patterns
     = VCPattern::GetPatterns(m_brd->Width(), m_brd->Height(), m_color);
-    for (std::size_t i=0; i<patterns.size(); ++i)
+    for (std::size_t i=0; i<candidates.size(); ++i)
     {
-        const VCPattern& pat = patterns[i];
+        const VCPattern& pat = patterns[candidates[i]];
         if (!m_param->use_non_edge_patterns
             && !HexPointUtil::isEdge(pat.Endpoint(0))
             && !HexPointUtil::isEdge(pat.Endpoint(1)))
@@ -510,18 +673,20 @@ void VCS::AddPatternVCs()
 
 void VCS::ComputeCapturedSets(const PatternState& patterns)
 {
+    VC_PROFILE_SCOPE(m_profile, CAPTURED_SETS);
     SG_UNUSED(patterns);
+    PatternHits hits;
     for (BoardIterator p(m_brd->Const().EdgesAndInterior()); p; ++p)
     {
         m_capturedSet[*p] = EMPTY_BITSET;
         if (m_brd->GetColor(*p) == EMPTY)
         {
-            PatternHits hits;
+            hits.clear();
             patterns.MatchOnCell(m_hash_capturedSetPatterns[m_color],
                                  *p, PatternState::STOP_AT_FIRST_HIT, hits);
             for (std::size_t i = 0; i < hits.size(); ++i)
             {
-                const std::vector<HexPoint>& moves = hits[0].Moves2();
+                const PatternHit::Points moves = hits[0].Moves2();
                 for (std::size_t j = 0; j < moves.size(); ++j)
                     m_capturedSet[*p].set(moves[j]);
             }
@@ -544,6 +709,10 @@ void VCS::Build(VCBuilderParam& param,
     if (m_param->use_patterns)
         AddPatternVCs();
     DoSearch();
+    m_partial = m_statistics.stopped;
+#if BENZENE_VC_PROFILE
+    ProfileLengths();
+#endif
 
     LogFine() << "  " << timer.GetTime() << "s to build vcs.\n";
 }
@@ -560,8 +729,18 @@ void VCS::Build(VCBuilderParam& param,
     m_brd = &m_groups->Board();
     if (use_changelog)
     {
+        // Every undo level uses the mode of the first one
+        bool journal = backups.empty() ? param.journal_undo
+                                       : bool(backups.back().journal);
         backups.push_back(Backup());
-        backups.back().Create(*this);
+        backups.back().partial = m_partial;
+        if (journal)
+        {
+            backups.back().journal.reset(new Journal());
+            SetJournal(backups.back().journal.get());
+        }
+        else
+            backups.back().Create(*this);
     }
 
     if (param.incremental_builds)
@@ -572,25 +751,129 @@ void VCS::Build(VCBuilderParam& param,
         m_statistics = Statistics();
         ComputeCapturedSets(patterns);
         Merge(oldGroups, capturedSet, added);
+        // Patterns that matched before are already merged
+        if (m_param->use_patterns)
+            AddPatternVCs(added[m_color]);
     }
     else
     {
         Reset();
         ComputeCapturedSets(patterns);
         AddBaseVCs();
+        if (m_param->use_patterns)
+            AddPatternVCs();
     }
-
-    if (m_param->use_patterns)
-        AddPatternVCs();
     DoSearch();
+    m_partial |= m_statistics.stopped;
+#if BENZENE_VC_PROFILE
+    ProfileLengths();
+#endif
 
     LogFine() << "  " << timer.GetTime() << "s to build vcs.\n";
 }
 
+namespace {
+
+template <class T>
+void StoreLists(const BitsetUPairMap<T>& map, VCCacheData& data,
+                std::vector<VCCacheData::List>& lists)
+{
+    for (int x = 0; x < BITSETSIZE; x++)
+        for (BitsetIterator y(map[HexPoint(x)].Entries()); y && *y <= x; ++y)
+        {
+            lists.push_back(VCCacheData::List());
+            lists.back().x = HexPoint(x);
+            lists.back().y = *y;
+            map[HexPoint(x)][*y]->Store(data, lists.back());
+        }
+}
+
+template <class T>
+void LoadLists(BitsetUPairMap<T>& map, const VCCacheData& data,
+               const std::vector<VCCacheData::List>& lists)
+{
+    for (std::size_t i = 0; i < lists.size(); ++i)
+        map.Put(lists[i].x, lists[i].y)->Load(data, lists[i]);
+}
+
+} // namespace
+
+void VCS::Store(VCCacheData& data) const
+{
+    StoreLists(m_fulls, data, data.fulls);
+    StoreLists(m_semis, data, data.semis);
+}
+
+void VCS::Load(VCBuilderParam& param, const Groups& groups,
+               const PatternState& patterns, const VCCacheData& data)
+{
+    TestQueuesEmpty();
+    m_param = &param;
+    m_groups = &groups;
+    m_brd = &m_groups->Board();
+    Reset();
+    m_partial = false;
+    ComputeCapturedSets(patterns);
+    LoadLists(m_fulls, data, data.fulls);
+    LoadLists(m_semis, data, data.semis);
+}
+
 void VCS::Revert()
 {
-    backups.back().Restore(*this);
-    backups.pop_back();
+    Backup& backup = backups.back();
+    m_partial = backup.partial;
+    if (backup.journal)
+    {
+        SetJournal(0);
+        m_fulls.Undo(backup.journal->fulls);
+        m_semis.Undo(backup.journal->semis);
+        backups.pop_back();
+        if (!backups.empty())
+            SetJournal(backups.back().journal.get());
+    }
+    else
+    {
+        backup.Restore(*this);
+        backups.pop_back();
+    }
+}
+
+namespace {
+
+template <class T>
+void WatchAll(const BitsetUPairMap<T>& map, CarrierList::Watcher* watcher)
+{
+    for (int x = 0; x < BITSETSIZE; x++)
+        for (BitsetIterator y(map[HexPoint(x)].Entries()); y && *y <= x; ++y)
+            map[HexPoint(x)][*y]->Watch(watcher);
+}
+
+} // namespace
+
+void VCS::SetJournal(Journal* journal)
+{
+    m_fulls.SetJournal(journal ? &journal->fulls : 0);
+    m_semis.SetJournal(journal ? &journal->semis : 0);
+    WatchAll(m_fulls, journal ? &journal->fulls_watcher : 0);
+    WatchAll(m_semis, journal ? &journal->semis_watcher : 0);
+}
+
+void VCS::ProfileLengths()
+{
+    m_profile.AddBuild();
+    for (int x = 0; x < BITSETSIZE; x++)
+    {
+        const HexPoint xp = static_cast<HexPoint>(x);
+        for (BitsetIterator y(m_fulls[xp].Entries()); y && *y < x; ++y)
+            m_profile.AddLength(false, m_fulls[xp][*y]->Count());
+        for (BitsetIterator y(m_semis[xp].Entries()); y && *y < x; ++y)
+            m_profile.AddLength(true, m_semis[xp][*y]->Count());
+    }
+}
+
+void VCS::ClearProfile()
+{
+    m_profile.Clear();
 }
 
 void VCS::Reset()
@@ -601,6 +884,22 @@ void VCS::Reset()
     m_statistics = Statistics();
 }
 
+std::string VCS::Statistics::ToString() const
+{
+    std::ostringstream os;
+    os << "base:" << base_successes << '/' << base_attempts << '\n'
+       << "pat:" << pattern_successes << '/' << pattern_attempts << '\n'
+       << "and-f:" << and_full_successes << '/' << and_full_attempts << '\n'
+       << "and-s:" << and_semi_successes << '/' << and_semi_attempts << '\n'
+       << "order2:" << order2_successes << '/' << order2_attempts << '\n'
+       << "or:" << or_successes << '/' << or_attempts << '\n'
+       << "doOr():" << goodOrs << '/' << doOrs << '\n'
+       << "s0/s1/u1:" << shrunk0 << '/' << shrunk1 << '/' << upgraded << '\n'
+       << "killed0/killed1:" << killed0 << '/' << killed1 << '\n'
+       << "rules:" << applications << (stopped ? " (stopped)" : "");
+    return os.str();
+}
+
 /** @page mergeshrink Incremental Update Algorithm
 
     The connection set is updated to the new state of the board in a
@@ -617,6 +916,7 @@ void VCS::Reset()
 void VCS::Merge(const Groups& oldGroups, bitset_t* oldCapturedSet,
                 bitset_t added[BLACK_AND_WHITE])
 {
+    VC_PROFILE_SCOPE(m_profile, MERGE);
     // Kill connections containing stones the opponent just played.
     // NOTE: This *must* be done in the original state, not in the
     // state with the newly added stones. If we are adding stones of
@@ -884,20 +1184,36 @@ void VCS::MergeAndShrink(bitset_t* oldCapturedSet, bitset_t added,
 
 void VCS::DoSearch()
 {
-    while (true)
+    const std::size_t maxApplications = m_param->max_rule_applications;
+    // SgTimer follows SgTime::DefaultMode(), which is too coarse for a
+    // budget in microseconds in cpu mode and stands still in
+    // deterministic mode
+    const std::chrono::steady_clock::time_point deadline
+        = std::chrono::steady_clock::now()
+        + std::chrono::microseconds(m_param->max_build_usec);
+    while (!m_fulls_and_queue.IsEmpty() || !m_semis_or_queue.IsEmpty())
     {
+        // Reading the clock costs more than most rule applications
+        if ((maxApplications
+             && m_statistics.applications >= maxApplications)
+            || (m_param->max_build_usec
+                && m_statistics.applications % 64 == 0
+                && std::chrono::steady_clock::now() >= deadline))
+        {
+            StopSearch();
+            break;
+        }
+        m_statistics.applications++;
         if (!m_fulls_and_queue.IsEmpty())
         {
             Full vc = m_fulls_and_queue.Pop();
             AndFull(vc.x, vc.y, vc.carrier);
         }
-        else if (!m_semis_or_queue.IsEmpty())
+        else
         {
             Ends p = m_semis_or_queue.Pop();
             OrSemis(p.x, p.y);
         }
-        else
-            break;
     }
     TestQueuesEmpty();
     m_fulls_and_queue.Clear();
@@ -905,6 +1221,18 @@ void VCS::DoSearch()
     TestQueuesEmpty();
 }
 
+void VCS::StopSearch()
+{
+    m_statistics.stopped = true;
+    m_fulls_and_queue.Clear();
+    while (!m_semis_or_queue.IsEmpty())
+    {
+        Ends p = m_semis_or_queue.Pop();
+        if (OrList* semis = m_semis[p.x][p.y])
+            semis->Dequeue();
+    }
+}
+
 // And rule stuff
 
 #define FUNC(__name) VCS::VCAnd::Functor##__name()
@@ -952,7 +1280,10 @@ inline void VCS::VCAnd::TryAddFull(bitset_t carrier, Func func)
             return TryAddFull<typename S::FullsNull>(carrier, func);
     }
     if (S::fulls_null)
-        fulls = vcs.m_fulls.Put(x, y, new AndList(carrier));
+    {
+        fulls = vcs.m_fulls.Put(x, y);
+        fulls->Add(carrier);
+    }
     else if (!fulls->TryAdd(carrier, vcs.m_param->limit_fulls))
         SWITCHTO(S);
     vcs.m_fulls_and_queue.Push(Full(x, y, carrier));
@@ -986,7 +1317,8 @@ inline void VCS::VCAnd::TryAddSemi(bitset_t carrier, Func func)
             if (fulls->SupersetOfAny(carrier))
                 SWITCHTO(S);
         }
-        semis = vcs.m_semis.Put(x, y, new OrList(carrier));
+        semis = vcs.m_semis.Put(x, y);
+        semis->TryAdd(carrier);
     }
     else
     {
@@ -1037,6 +1369,7 @@ inline void VCS::AndFull(HexPoint x, HexPoint z, bitset_t carrier,
 inline void VCS::AndFullEmptyFull(HexPoint x, HexPoint z, bitset_t carrier,
                                   bitset_t xzCapturedSet)
 {
+    VC_PROFILE_SCOPE(m_profile, AND_SEMI);
     for (BitsetIterator it(m_fulls[z].Entries().reset(x) - carrier); it; ++it)
     {
         HexPoint y = *it;
@@ -1088,6 +1421,7 @@ inline void VCS::VCAnd::FEFNext()
 inline void VCS::AndFullStoneFull(HexPoint x, HexPoint z, bitset_t carrier,
                                   bitset_t xzCapturedSet)
 {
+    VC_PROFILE_SCOPE(m_profile, AND_FULL);
     for (BitsetIterator it(m_fulls[z].Entries().reset(x) - carrier); it; ++it)
     {
         HexPoint y = *it;
@@ -1138,6 +1472,7 @@ inline void VCS::VCAnd::FSFNext()
 
 void VCS::OrSemis(HexPoint x, HexPoint y)
 {
+    VC_PROFILE_SCOPE(m_profile, OR);
     BenzeneAssert(x != y);
     OrList* xy_semis = m_semis[x][y];
     BenzeneAssert(xy_semis);
@@ -1153,18 +1488,89 @@ void VCS::OrSemis(HexPoint x, HexPoint y)
         return;
     m_statistics.goodOrs++;
     m_statistics.or_attempts += new_fulls.size();
-    m_statistics.or_successes += new_fulls.size();
     if (!xy_fulls)
-        xy_fulls = m_fulls.Put(x, y, new AndList());
+        xy_fulls = m_fulls.Put(x, y);
     for (std::vector<bitset_t>::iterator it = new_fulls.begin();
             it != new_fulls.end(); ++it)
         if (xy_fulls->TryAdd(*it, m_param->limit_fulls))
+        {
+            m_statistics.or_successes++;
             m_fulls_and_queue.Push(Full(x, y, *it));
+        }
+}
+
+//----------------------------------------------------------------------------
+
+namespace {
+
+/** VCOr(CarrierList, bitset_t, bitset_t, bitset_t) on a carrier
+    matrix; gives the same result in the same order. */
+vector<bitset_t> MatrixOr(const CarrierMatrix& semis, bitset_t cands,
+                          bitset_t xCapturedSet, bitset_t yCapturedSet)
+{
+    typedef CarrierMatrix::Mask Mask;
+    vector<bitset_t> res;
+    bitset_t capturedSet;
+    Mask alive = semis.All();
+    while (cands.any())
+    {
+        alive &= ~semis.SupersetsOf(alive, cands);
+        bitset_t I_new = semis.Intersection(alive & semis.New());
+        cands -= I_new;
+        if (cands.none())
+            break;
+
+        bitset_t I_old = semis.Intersection(alive & ~semis.New());
+        bitset_t I = I_new & I_old;
+
+        if (!BitsetUtil::IsSubsetOf(I, capturedSet))
+            capturedSet |= xCapturedSet;
+        if (!BitsetUtil::IsSubsetOf(I, capturedSet))
+            capturedSet |= yCapturedSet;
+        if (!BitsetUtil::IsSubsetOf(I, capturedSet))
+            break;
+
+        cands -= capturedSet;
+        if (cands.none())
+            break;
+
+        size_t a = cands._Find_first();
+        const Mask without = alive & ~semis.Cell(a);
+        bitset_t I2 = semis.Intersection(without);
+
+        if (BitsetUtil::IsSubsetOf(I2, capturedSet))
+        {
+            bitset_t U = capturedSet;
+            I2.set();
+            for (std::size_t i = 0;
+                 i < CarrierMatrix::MAX_CARRIERS && (without >> i); ++i)
+            {
+                if (!(without >> i & 1)
+                    || BitsetUtil::IsSubsetOf(I2, semis.Carrier(i)))
+                    continue;
+                I2 &= semis.Carrier(i);
+                U |= semis.Carrier(i);
+                if (BitsetUtil::IsSubsetOf(I2, capturedSet))
+                    break;
+            }
+            res.push_back(U);
+            cands &= U;
+        }
+        else
+            cands.reset(a);
+    }
+    return res;
 }
 
+} // anonymous namespace
+
 vector<bitset_t> benzene::VCOr(CarrierList semis, bitset_t cands,
                                bitset_t xCapturedSet, bitset_t yCapturedSet)
 {
+    if (static_cast<std::size_t>(semis.Count())
+        <= CarrierMatrix::MAX_CARRIERS)
+        return MatrixOr(CarrierMatrix(semis), cands,
+                        xCapturedSet, yCapturedSet);
     vector<bitset_t> res;
     bitset_t capturedSet;
     while (cands.any())
@@ -1225,7 +1631,10 @@ inline bool VCS::TryAddFull(HexPoint x, HexPoint y, bitset_t carrier)
     BenzeneAssert(x != y);
     AndList* fulls = m_fulls[x][y];
     if (!fulls)
-        fulls = m_fulls.Put(x, y, new AndList(carrier));
+    {
+        fulls = m_fulls.Put(x, y);
+        fulls->Add(carrier);
+    }
     else if (!fulls->TryAdd(carrier, m_param->limit_fulls))
         return false;
     m_fulls_and_queue.Push(Full(x, y, carrier));
@@ -1235,6 +1644,26 @@ inline bool VCS::TryAddFull(HexPoint x, HexPoint y, bitset_t carrier)
     return true;
 }
 
+VCS::Journal::Journal()
+    : fulls_watcher(fulls),
+      semis_watcher(semis)
+{
+}
+
+template <class T>
+VCS::Journal::ListWatcher<T>::ListWatcher
+(typename BitsetUPairMap<T>::Journal& log)
+    : m_log(log)
+{
+}
+
+template <class T>
+void VCS::Journal::ListWatcher<T>::Save(const CarrierList& list)
+{
+    // Only lists of type T in the map of m_log are watched by this
+    m_log.SaveValue(static_cast<T*>(const_cast<CarrierList*>(&list)));
+}
+
 inline void VCS::Backup::Create(VCS& vcs)
 {
     vcs.TestQueuesEmpty();
@@ -1380,6 +1809,11 @@ bool VCS::FullExists(HexPoint x, HexPoint y) const
     return !fulls->IsEmpty();
 }
 
+bool VCS::IsPartial() const
+{
+    return m_partial;
+}
+
 bool VCS::FullExists() const
 {
     return FullExists(m_edge1, m_edge2);
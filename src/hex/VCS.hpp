@@ -12,6 +12,10 @@
 #include "BitsetMap.hpp"
 #include "PatternState.hpp"
 #include "Queue.hpp"
+#include "VCCache.hpp"
+#include "VCProfile.hpp"
+
+#include <boost/shared_ptr.hpp>
 
 _BEGIN_BENZENE_NAMESPACE_
 
@@ -43,6 +47,37 @@ struct VCBuilderParam
      *  which reduce intersection of vcs. */
     bool limit_or;
 
+    /** Whether HexBoard builds the black and white connection sets
+     *  concurrently, using one helper thread per board. */
+    bool parallel_builds;
+
+    /** Whether incremental builds are undone by replaying a journal
+     *  of the lists they changed, instead of restoring a snapshot of
+     *  all connections. Takes effect once no builds are pending
+     *  undo. */
+    bool journal_undo;
+
+    /** Whether HexBoard looks up and stores connection sets built
+     *  from scratch in the shared VCCache. */
+    bool use_cache;
+
+    /** Maximum number of and- and or-rule applications per build;
+     *  0 for no limit. A build that hits a budget stops with the
+     *  connections found so far, which are sound but incomplete.
+     *  @see VCS::IsPartial(). */
+    std::size_t max_rule_applications;
+
+    /** Maximum time spent applying rules per build, in
+     *  microseconds; 0 for no limit. */
+    std::size_t max_build_usec;
+
+    /** Whether either of the budgets above is set. */
+    bool IsBudgeted() const;
+
+    /** Bit mask of the settings that change the result of a build;
+     *  part of the VCCache key. */
+    unsigned ResultSettings() const;
+
     /** Constructor. */
     VCBuilderParam();
 };
@@ -54,19 +89,74 @@ class CarrierList
 public:
     CarrierList();
 
+    /** Copies the carriers; the copy is not watched. */
+    CarrierList(const CarrierList& other);
+
+    /** Copies the carriers; keeps this list's watcher. */
+    CarrierList& operator=(const CarrierList& other);
+
     int Count() const;
     bool IsEmpty() const;
 
+    /** Is told about a list just before the list first changes.
+        Used to journal changes for undo. */
+    class Watcher
+    {
+    public:
+        virtual ~Watcher();
+
+        virtual void Save(const CarrierList& list) = 0;
+    };
+
+    /** Makes the list report to watcher before its next change
+        (including a reordering by SupersetOfAny()). The report
+        happens once; pass 0 to stop watching. */
+    void Watch(Watcher* watcher) const;
+
+    /** Reports the list to its watcher, if any, and stops watching. */
+    void Touch() const;
+
 private:
+    /** A carrier with a precomputed size and signature.
+        These reject most non-subset pairs with one or two word
+        compares before the full bitsets are compared. The list keeps
+        insertion (and move-to-front) order, since iteration order is
+        relied upon by the and/or rules. */
     struct Elem
     {
         Elem() { }
-        Elem(bitset_t carrier) : carrier(carrier), old(false) { }
+        Elem(bitset_t carrier)
+            : carrier(carrier),
+              signature(carrier.fold()),
+              size(static_cast<unsigned short>(carrier.count())),
+              old(false)
+        { }
+
+        /** Returns false only if carrier is not a subset of
+            other.carrier. */
+        bool MaybeSubsetOf(const Elem& other) const
+        {
+            return size <= other.size
+                && (signature & ~other.signature) == 0;
+        }
+
+        bool IsSubsetOf(const Elem& other) const
+        {
+            return MaybeSubsetOf(other)
+                && BitsetUtil::IsSubsetOf(carrier, other.carrier);
+        }
+
         bitset_t carrier;
+        unsigned long signature;
+        unsigned short size;
         bool old;
     };
     mutable std::vector<Elem> m_list;
 
+    mutable Watcher* m_watcher;
+
+    bool SupersetOfAny(const Elem& elem) const;
+
 public:
     /** Iterates over a CarrierList. */
     class Iterator : public SafeBool<Iterator>
@@ -122,6 +212,12 @@ protected:
 
     void Clear();
 
+    /** Appends the carriers to data and sets list's range. */
+    void StoreCarriers(VCCacheData& data, VCCacheData::List& list) const;
+
+    /** Replaces the carriers by those of list. */
+    void LoadCarriers(const VCCacheData& data, const VCCacheData::List& list);
+
 private:
     template <bool check_old>
     bool RemoveSupersetsOf(bitset_t carrier);
@@ -162,6 +258,21 @@ inline bool CarrierList::IsEmpty() const
     return m_list.empty();
 }
 
+inline void CarrierList::Watch(Watcher* watcher) const
+{
+    m_watcher = watcher;
+}
+
+inline void CarrierList::Touch() const
+{
+    if (m_watcher)
+    {
+        Watcher* watcher = m_watcher;
+        m_watcher = 0;
+        watcher->Save(*this);
+    }
+}
+
 inline int CarrierList::Count() const
 {
     return int(m_list.size());
@@ -199,6 +310,15 @@ public:
     /** Reverts last incremental build. */
     void Revert();
 
+    /** Copies the connections into data. */
+    void Store(VCCacheData& data) const;
+
+    /** Replaces the connections by data, which must have been stored
+        after a build from scratch on groups with the same settings.
+        Equivalent to Build(param, groups, patterns). */
+    void Load(VCBuilderParam& param, const Groups& groups,
+              const PatternState& patterns, const VCCacheData& data);
+
     // @}
 
     /** Calls used by solver/players staff */
@@ -231,6 +351,13 @@ public:
         connecting edges. Returns INVALID_POINT if there is none. */
     HexPoint SmallestSemiKey() const;
 
+    /** Whether a build stopped at its budget before reaching the
+        fixed point, either the last one or, for incremental builds,
+        one it was based on. Such connections are sound, but
+        connections may be missing, so mustplays are weaker and
+        losses can be missed. Solvers should not rely on them. */
+    bool IsPartial() const;
+
     bool FullExists() const;
 
     bool FullExists(HexPoint x, HexPoint y) const;
@@ -266,6 +393,12 @@ public:
     template <class Stream>
     void DumpBuildStats(Stream& os) const;
 
+    /** Profile of the builds since the last ClearProfile(); empty
+        unless BENZENE_VC_PROFILE is set. */
+    const VCProfile& Profile() const;
+
+    void ClearProfile();
+
     bitset_t GetFullNbs(HexPoint x) const;
     bitset_t GetSemiNbs(HexPoint x) const;
     bitset_t FullIntersection(HexPoint x, HexPoint y) const;
@@ -338,6 +471,12 @@ private:
         /** Semis killed by opponent stones in merge phase. */
         std::size_t killed1;
 
+        /** And- and or-rule applications. */
+        std::size_t applications;
+
+        /** Whether the build stopped at its budget. */
+        bool stopped;
+
         /** Dumps statistics to a string. */
         std::string ToString() const;
     };
@@ -378,6 +517,12 @@ private:
         bool TrySetProcessed(bitset_t carrier);
         void MarkAllUnprocessed();
         void CalcIntersection();
+
+        /** Empties the list; used when recycled by the arena. */
+        void Clear();
+
+        void Store(VCCacheData& data, VCCacheData::List& list) const;
+        void Load(const VCCacheData& data, const VCCacheData::List& list);
     private:
         bitset_t m_processed_intersection;
     };
@@ -399,13 +544,19 @@ private:
 
         bool TryQueue(bitset_t capturedSet);
 
+        /** Takes the list off the or-queue without processing it. */
+        void Dequeue();
+
         void MarkAllProcessed();
         void MarkAllUnprocessed();
         void CalcIntersection();
 
-    protected:
+        /** Empties the list; used when recycled by the arena. */
         void Clear();
 
+        void Store(VCCacheData& data, VCCacheData::List& list) const;
+        void Load(const VCCacheData& data, const VCCacheData::List& list);
+
     private:
         bitset_t m_intersection;
         bool m_queued;
@@ -425,6 +576,11 @@ private:
     VCBuilderParam *m_param;
     Statistics m_statistics;
 
+    /** @see IsPartial() */
+    bool m_partial;
+
+    VCProfile m_profile;
+
     bitset_t m_capturedSet[BITSETSIZE];
     PatternSet m_capturedSetPatterns[BLACK_AND_WHITE];
     HashedPatternSet m_hash_capturedSetPatterns[BLACK_AND_WHITE];
@@ -433,14 +589,24 @@ private:
     void ComputeCapturedSets(const PatternState& patterns);
     void AddBaseVCs();
     void AddPatternVCs();
+    void AddPatternVCs(bitset_t added);
+    void AddPatternVCs(const std::vector<std::size_t>& candidates);
 
     /** Clears connections and statistics for the from scratch build. */
     void Reset();
 
+    /** Adds the lengths of all carrier lists to the profile. */
+    void ProfileLengths();
+
     void TestQueuesEmpty();
 
+    /** Applies the and- and or-rules until no new connections are
+        found or the budget in m_param runs out. */
     void DoSearch();
 
+    /** Empties the rule queues when DoSearch() runs out of budget. */
+    void StopSearch();
+
     /** And rule staff */
     // @{
 
@@ -543,12 +709,52 @@ private:
     bool Shrink(bitset_t added, OrList* semis, const CarrierList& list,
                 const AndList* filter);
 
+    /** Changes made since an incremental build started; used instead
+        of a Backup if VCBuilderParam::journal_undo is set. Lists
+        report to the watchers before they first change, and the maps
+        log entries created and deleted. */
+    class Journal
+    {
+    public:
+        Journal();
+
+        BitsetUPairMap<AndList>::Journal fulls;
+        BitsetUPairMap<OrList>::Journal semis;
+
+        template <class T>
+        class ListWatcher : public CarrierList::Watcher
+        {
+        public:
+            explicit ListWatcher(typename BitsetUPairMap<T>::Journal& log);
+
+            void Save(const CarrierList& list);
+
+        private:
+            typename BitsetUPairMap<T>::Journal& m_log;
+        };
+
+        ListWatcher<AndList> fulls_watcher;
+        ListWatcher<OrList> semis_watcher;
+
+    private:
+        /** Not implemented. */
+        Journal(const Journal&);
+        Journal& operator=(const Journal&);
+    };
+
     class Backup
     {
     public:
         void Create(VCS& vcs);
         void Restore(VCS& vcs);
 
+        /** Set if this undo level is journaled; Create() and
+            Restore() are not used then. */
+        boost::shared_ptr<Journal> journal;
+
+        /** VCS::m_partial before the build. */
+        bool partial;
+
     private:
         BitsetUPairMap<AndList>::Backup fulls;
         BitsetUPairMap<OrList>::Backup semis;
@@ -556,6 +762,10 @@ private:
     friend class Backup;
 
     std::vector<Backup> backups;
+
+    /** Records all following changes in journal, or stops recording
+        if journal is 0. */
+    void SetJournal(Journal* journal);
     // @}
 };
 
@@ -614,8 +824,17 @@ void VCS::DumpDataStats(Stream& os, int maxConnections, int numBins) const
 template <class Stream>
 void VCS::DumpBuildStats(Stream& os) const
 {
-    UNUSED(os);
-    BenzeneAssert(false /* stub */);
+    os << m_statistics.ToString() << '\n'
+       << "partial: " << m_partial << '\n'
+       << "fulls arena: " << m_fulls.ArenaStatistics().ToString() << '\n'
+       << "semis arena: " << m_semis.ArenaStatistics().ToString() << '\n';
+    if (VCProfile::Enabled())
+        os << m_profile.ToString() << '\n';
+}
+
+inline const VCProfile& VCS::Profile() const
+{
+    return m_profile;
 }
 
 //---------------------------------------------------------------------------
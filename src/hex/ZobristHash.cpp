@@ -64,7 +64,9 @@ void ZobristHash::GlobalData::GetHashes()
 //----------------------------------------------------------------------------
 
 ZobristHash::ZobristHash(int width, int height)
-    : m_base(GetGlobalData().m_hashes[30 * width + height])
+    : m_base(GetGlobalData().m_hashes[30 * width + height]),
+      m_width(width),
+      m_height(height)
 {
     BenzeneAssert(30 * width + height < 1024);
     Reset();
@@ -82,9 +84,17 @@ void ZobristHash::Compute(const bitset_t& black, const bitset_t& white)
     for (int p = 0; p < BITSETSIZE; ++p) 
     {
         if (black.test(p)) 
+        {
             m_hash.Xor(GetGlobalData().m_black_hashes[p]);
+            m_rotated.Xor(GetGlobalData().m_black_hashes
+                          [Rotate(static_cast<HexPoint>(p))]);
+        }
         if (white.test(p)) 
+        {
             m_hash.Xor(GetGlobalData().m_white_hashes[p]);
+            m_rotated.Xor(GetGlobalData().m_white_hashes
+                          [Rotate(static_cast<HexPoint>(p))]);
+        }
     }
 }
 
@@ -20,6 +20,10 @@ _BEGIN_BENZENE_NAMESPACE_
 
     Each unique boardsize has its own base hash, so hashes of
     positions on different boardsizes should never collide.
+
+    The hash of the position rotated by 180 degrees is maintained
+    alongside the hash, so the canonical hash of a position and its
+    rotation needs no copy of the board. @see RotatedHash().
 */
 class ZobristHash
 {
@@ -32,6 +36,13 @@ public:
 
     /** Helper function: same as Hash(EMPTY). */
     SgHashCode Hash() const;
+
+    /** Returns the hash the position rotated by 180 degrees would
+        have, for the color to play. */
+    SgHashCode RotatedHash(HexColor toPlay) const;
+
+    /** Helper function: same as RotatedHash(EMPTY). */
+    SgHashCode RotatedHash() const;
     
     /** Reset hash to the base hash value. */
     void Reset();
@@ -47,9 +58,20 @@ private:
     /** Hash for the current state. */
     SgHashCode m_hash;
 
+    /** Hash for the current state rotated by 180 degrees. */
+    SgHashCode m_rotated;
+
     /** Base hash. */
     SgHashCode m_base;
 
+    int m_width;
+
+    int m_height;
+
+    /** Returns the point p is moved to by rotating the board. Points
+        that are not edges or cells of the board are not moved. */
+    HexPoint Rotate(HexPoint p) const;
+
     //----------------------------------------------------------------------
 
     /** Data shared amoungst all instances of ZobristHash. */
@@ -92,16 +114,44 @@ inline SgHashCode ZobristHash::Hash() const
     return Hash(EMPTY);
 }
 
+inline SgHashCode ZobristHash::RotatedHash(HexColor toPlay) const
+{
+    SgHashCode ret(m_rotated);
+    ret.Xor(*GetGlobalData().m_toPlay_hashes[toPlay]);
+    return ret;
+}
+
+inline SgHashCode ZobristHash::RotatedHash() const
+{
+    return RotatedHash(EMPTY);
+}
+
 inline void ZobristHash::Reset()
 {
     m_hash = m_base;
+    m_rotated = m_base;
+}
+
+inline HexPoint ZobristHash::Rotate(HexPoint p) const
+{
+    if (HexPointUtil::isEdge(p))
+        return HexPointUtil::oppositeEdge(p);
+    if (!HexPointUtil::isInteriorCell(p))
+        return p;
+    int x, y;
+    HexPointUtil::pointToCoords(p, x, y);
+    if (x >= m_width || y >= m_height)
+        return p;
+    return HexPointUtil::coordsToPoint(m_width - 1 - x, m_height - 1 - y);
 }
 
 inline void ZobristHash::Update(HexColor color, HexPoint cell)
 {
     BenzeneAssert(HexColorUtil::isBlackWhite(color));
     BenzeneAssert(0 <= cell && cell < BITSETSIZE);
-    m_hash.Xor(GetGlobalData().m_color_hashes[color][cell]);
+    const SgHashCode* hashes = GetGlobalData().m_color_hashes[color];
+    m_hash.Xor(hashes[cell]);
+    m_rotated.Xor(hashes[Rotate(cell)]);
 }
 
 //----------------------------------------------------------------------------
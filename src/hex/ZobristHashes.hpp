@@ -1,5 +1,5 @@
 
-std::string s_predefined_hashes[] =
+const char* const s_predefined_hashes[] =
 {
     "a0c99a1c59023682",    // 0
     "491b86e3b32b998d",
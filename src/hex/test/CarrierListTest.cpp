@@ -165,6 +165,146 @@ BOOST_AUTO_TEST_CASE(CarrierList_Basic)
 
 }
 
+/** Random carrier over the cells of a 13x13 board. */
+bitset_t RandomCarrier(int density)
+{
+    bitset_t b;
+    for (int i = FIRST_CELL; i < FIRST_CELL + 169; ++i)
+        if (rand() % 256 < density)
+            b.set(i);
+    return b;
+}
+
+BOOST_AUTO_TEST_CASE(CarrierList_SignatureFilterMatchesFullCheck)
+{
+    srand(17);
+    for (int trial = 0; trial < 200; ++trial)
+    {
+        List vl;
+        std::vector<bitset_t> naive;
+        for (int k = 0; k < 20; ++k)
+        {
+            bitset_t b = RandomCarrier(4 + trial % 32);
+            vl.Add(b);
+            naive.push_back(b);
+        }
+        bitset_t probe = RandomCarrier(4 + trial % 32) | naive[trial % 20];
+        if (trial % 3 == 0)
+            probe = naive[trial % 20] & RandomCarrier(128);
+
+        bool anySubset = false;
+        for (std::size_t i = 0; i < naive.size(); ++i)
+            anySubset |= BitsetUtil::IsSubsetOf(naive[i], probe);
+        BOOST_CHECK_EQUAL(vl.SupersetOfAny(probe), anySubset);
+
+        std::vector<bitset_t> kept;
+        for (std::size_t i = 0; i < naive.size(); ++i)
+            if (!BitsetUtil::IsSubsetOf(probe, naive[i]))
+                kept.push_back(naive[i]);
+        BOOST_CHECK_EQUAL(vl.RemoveSupersetsOfCheckAnyRemoved(probe),
+                          kept.size() < naive.size());
+        BOOST_REQUIRE_EQUAL(vl.Count(), (int)kept.size());
+        // Survivors keep their relative order (SupersetOfAny above
+        // may have moved one of them to the front).
+        std::size_t matched = 0;
+        for (List::Iterator it(vl); it; ++it)
+            for (std::size_t i = 0; i < kept.size(); ++i)
+                if (kept[i] == it.Carrier())
+                {
+                    ++matched;
+                    break;
+                }
+        BOOST_CHECK_EQUAL(matched, kept.size());
+    }
+}
+
+/** Lists of up to 64 carriers take the bit-sliced path of VCOr();
+    padding a list with carriers containing every cell forces the
+    general path without changing the result, since those are removed
+    as supersets of the candidates before any intersection. */
+BOOST_AUTO_TEST_CASE(CarrierList_VCOrMatrixMatchesList)
+{
+    srand(23);
+    bitset_t all;
+    all.set();
+    std::size_t found = 0;
+    for (int trial = 0; trial < 300; ++trial)
+    {
+        List small;
+        List padded;
+        for (int k = 0; k < 65; ++k)
+            padded.Add(all);
+        const int count = 1 + trial % 64;
+        for (int k = 0; k < count; ++k)
+        {
+            bitset_t b = RandomCarrier(2 + trial % 6);
+            small.Add(b);
+            padded.Add(b);
+            if (rand() % 3 == 0)
+            {
+                small.TrySetOld(b);
+                padded.TrySetOld(b);
+            }
+        }
+        bitset_t cands = (trial % 2) ? RandomCarrier(192) : all;
+        bitset_t xCaptured = RandomCarrier(2);
+        bitset_t yCaptured = RandomCarrier(2);
+        std::vector<bitset_t> expected
+            = VCOr(padded, cands, xCaptured, yCaptured);
+        std::vector<bitset_t> result
+            = VCOr(small, cands, xCaptured, yCaptured);
+        BOOST_REQUIRE_EQUAL(result.size(), expected.size());
+        for (std::size_t i = 0; i < result.size(); ++i)
+            BOOST_CHECK_EQUAL(result[i], expected[i]);
+        found += result.size();
+    }
+    BOOST_CHECK(found > 0);
+}
+
+/** Same as above for the full or-rule. The padding carriers are new,
+    so each list needs a new carrier of its own for the padding to not
+    change the result. */
+BOOST_AUTO_TEST_CASE(CarrierList_VCOrCombinerMatrixMatchesList)
+{
+    srand(29);
+    bitset_t all;
+    all.set();
+    std::size_t found = 0;
+    for (int trial = 0; trial < 200; ++trial)
+    {
+        List small;
+        List padded;
+        for (int k = 0; k < 65; ++k)
+            padded.Add(all);
+        const int count = 1 + trial % 8;
+        for (int k = 0; k < count; ++k)
+        {
+            bitset_t b = RandomCarrier(2 + trial % 6);
+            small.Add(b);
+            padded.Add(b);
+            if (k > 0 && rand() % 3 == 0)
+            {
+                small.TrySetOld(b);
+                padded.TrySetOld(b);
+            }
+        }
+        List fulls;
+        for (int k = 0; k < trial % 3; ++k)
+            fulls.Add(RandomCarrier(4));
+        bitset_t xCaptured = RandomCarrier(2);
+        bitset_t yCaptured = RandomCarrier(2);
+        std::vector<bitset_t> expected
+            = VCOr(padded, fulls, xCaptured, yCaptured);
+        std::vector<bitset_t> result
+            = VCOr(small, fulls, xCaptured, yCaptured);
+        BOOST_REQUIRE_EQUAL(result.size(), expected.size());
+        for (std::size_t i = 0; i < result.size(); ++i)
+            BOOST_CHECK_EQUAL(result[i], expected[i]);
+        found += result.size();
+    }
+    BOOST_CHECK(found > 0);
+}
+
 }
 
 //---------------------------------------------------------------------------
@@ -5,6 +5,8 @@
 #include <boost/test/auto_unit_test.hpp>
 
 #include "SgSystem.h"
+#include "SgRandom.h"
+#include "BitsetIterator.hpp"
 #include "Groups.hpp"
 #include "BoardIterator.hpp"
 
@@ -180,6 +182,61 @@ BOOST_AUTO_TEST_CASE(Groups_Iterator)
     BOOST_CHECK(!g);
 }
 
+/** Checks that a and b have the same groups in the same order. */
+void CheckSameGroups(const Groups& a, const Groups& b)
+{
+    BOOST_REQUIRE_EQUAL(a.NumGroups(), b.NumGroups());
+    GroupIterator ga(a);
+    GroupIterator gb(b);
+    for (; ga; ++ga, ++gb)
+    {
+        BOOST_CHECK_EQUAL(ga->Captain(), gb->Captain());
+        BOOST_CHECK_EQUAL(ga->Color(), gb->Color());
+        BOOST_CHECK_EQUAL(ga->Members(), gb->Members());
+        BOOST_CHECK_EQUAL(ga->Nbs(), gb->Nbs());
+        for (int cs = 0; cs < NUM_COLOR_SETS; ++cs)
+        {
+            HexColorSet colorset = static_cast<HexColorSet>(cs);
+            BOOST_CHECK_EQUAL(ga->Nbs(colorset), gb->Nbs(colorset));
+        }
+    }
+    BOOST_CHECK_EQUAL(a.GetWinner(), b.GetWinner());
+}
+
+BOOST_AUTO_TEST_CASE(Groups_UpdateMatchesBuild)
+{
+    SgRandom random;
+    for (int game = 0; game < 20; ++game)
+    {
+        StoneBoard brd(7, 7);
+        Groups groups;
+        GroupBuilder::Build(brd, groups);
+        while (brd.GetEmpty().any())
+        {
+            // Add one to three stones, sometimes of both colors.
+            bitset_t added;
+            int num = 1 + random.Int(3);
+            for (int i = 0; i < num; ++i)
+            {
+                std::vector<HexPoint> empty;
+                for (BitsetIterator p(brd.GetEmpty()); p; ++p)
+                    empty.push_back(*p);
+                if (empty.empty())
+                    break;
+                HexPoint p = empty[random.Int(empty.size())];
+                brd.AddColor(random.Int(2) ? BLACK : WHITE, p);
+                added.set(p);
+            }
+            Groups updated;
+            GroupBuilder::Update(brd, groups, added, updated);
+            Groups built;
+            GroupBuilder::Build(brd, built);
+            CheckSameGroups(updated, built);
+            std::swap(groups, updated);
+        }
+    }
+}
+
 //----------------------------------------------------------------------------
 
 } // namespace
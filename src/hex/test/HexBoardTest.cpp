@@ -4,8 +4,10 @@
 //----------------------------------------------------------------------------
 
 #include <boost/test/auto_unit_test.hpp>
+#include "SgTime.h"
 
 #include "HexBoard.hpp"
+#include "VCCache.hpp"
 #include "VCS.hpp"
 
 using namespace benzene;
@@ -50,6 +52,244 @@ BOOST_AUTO_TEST_CASE(HexBoard_CopyConstructor)
     BOOST_CHECK_EQUAL(cpy.GetPosition().GetColor(HEX_CELL_B2), BLACK);
 }
 
+/** Checks that the boards have the same position, groups and
+    inferior cells. */
+void CheckSameState(const HexBoard& a, const HexBoard& b)
+{
+    BOOST_CHECK_EQUAL(a.GetPosition().GetBlack(), b.GetPosition().GetBlack());
+    BOOST_CHECK_EQUAL(a.GetPosition().GetWhite(), b.GetPosition().GetWhite());
+    BOOST_CHECK_EQUAL(a.GetPosition().GetPlayed(),
+                      b.GetPosition().GetPlayed());
+    BOOST_CHECK_EQUAL(a.GetPosition().Hash(), b.GetPosition().Hash());
+    BOOST_CHECK_EQUAL(a.GetGroups().NumGroups(), b.GetGroups().NumGroups());
+    for (BoardIterator p(a.Const().EdgesAndInterior()); p; ++p)
+        BOOST_CHECK_EQUAL(a.GetGroups().CaptainOf(*p),
+                          b.GetGroups().CaptainOf(*p));
+    const InferiorCells& ia = a.GetInferiorCells();
+    const InferiorCells& ib = b.GetInferiorCells();
+    for (BWIterator c; c; ++c)
+        BOOST_CHECK_EQUAL(ia.Fillin(*c), ib.Fillin(*c));
+    BOOST_CHECK_EQUAL(ia.Vulnerable(), ib.Vulnerable());
+    BOOST_CHECK_EQUAL(ia.SReversible(), ib.SReversible());
+    BOOST_CHECK_EQUAL(ia.Inferior(), ib.Inferior());
+    BOOST_CHECK_EQUAL(ia.All(), ib.All());
+}
+
+BOOST_AUTO_TEST_CASE(HexBoard_UndoRestoresState)
+{
+    ICEngine ice;
+    VCBuilderParam param;
+    HexBoard brd(7, 7, ice, param);
+    brd.SetBackupIceInfo(false);
+    brd.GetPosition().PlayMove(WHITE, HEX_CELL_C3);
+    brd.ComputeAll(BLACK);
+    HexBoard root(brd);
+
+    brd.PlayMove(BLACK, HEX_CELL_D4);
+    HexBoard afterPlay(brd);
+    brd.TryMove(WHITE, HEX_CELL_E3);
+    HexBoard afterTry(brd);
+    bitset_t stones;
+    stones.set(HEX_CELL_B5);
+    stones.set(HEX_CELL_F2);
+    brd.PlayStones(BLACK, stones, WHITE);
+
+    brd.UndoMove();
+    CheckSameState(brd, afterTry);
+    brd.UndoMove();
+    CheckSameState(brd, afterPlay);
+    brd.UndoMove();
+    CheckSameState(brd, root);
+}
+
+/** Checks that both boards have the same full and semi neighbours
+    for every cell and color. */
+void CheckSameVCs(const HexBoard& a, const HexBoard& b)
+{
+    for (BWIterator c; c; ++c)
+        for (BoardIterator p(a.Const().EdgesAndInterior()); p; ++p)
+        {
+            BOOST_CHECK_EQUAL(a.Cons(*c).GetFullNbs(*p),
+                              b.Cons(*c).GetFullNbs(*p));
+            BOOST_CHECK_EQUAL(a.Cons(*c).GetSemiNbs(*p),
+                              b.Cons(*c).GetSemiNbs(*p));
+        }
+}
+
+BOOST_AUTO_TEST_CASE(HexBoard_ParallelBuildsMatchSerial)
+{
+    ICEngine ice;
+    VCBuilderParam serialParam;
+    VCBuilderParam parallelParam;
+    parallelParam.parallel_builds = true;
+    HexBoard serial(7, 7, ice, serialParam);
+    HexBoard parallel(7, 7, ice, parallelParam);
+    serial.ComputeAll(BLACK);
+    parallel.ComputeAll(BLACK);
+    CheckSameVCs(serial, parallel);
+
+    const HexPoint moves[] = { HEX_CELL_D4, HEX_CELL_C5, HEX_CELL_B2 };
+    HexColor color = BLACK;
+    for (std::size_t i = 0; i < sizeof(moves) / sizeof(moves[0]); ++i)
+    {
+        serial.PlayMove(color, moves[i]);
+        parallel.PlayMove(color, moves[i]);
+        CheckSameVCs(serial, parallel);
+        color = !color;
+    }
+    serial.UndoMove();
+    parallel.UndoMove();
+    CheckSameVCs(serial, parallel);
+}
+
+/** Checks that both boards have the same carrier lists, in the same
+    order, between every pair of cells. */
+void CheckSameCarriers(const HexBoard& a, const HexBoard& b)
+{
+    for (BWIterator c; c; ++c)
+        for (BoardIterator x(a.Const().EdgesAndInterior()); x; ++x)
+            for (BoardIterator y(a.Const().EdgesAndInterior()); *y != *x; ++y)
+            {
+                for (int semi = 0; semi < 2; ++semi)
+                {
+                    const CarrierList& la = semi
+                        ? a.Cons(*c).GetSemiCarriers(*x, *y)
+                        : a.Cons(*c).GetFullCarriers(*x, *y);
+                    const CarrierList& lb = semi
+                        ? b.Cons(*c).GetSemiCarriers(*x, *y)
+                        : b.Cons(*c).GetFullCarriers(*x, *y);
+                    BOOST_REQUIRE_EQUAL(la.Count(), lb.Count());
+                    CarrierList::Iterator ia(la);
+                    CarrierList::Iterator ib(lb);
+                    for (; ia; ++ia, ++ib)
+                    {
+                        BOOST_CHECK_EQUAL(ia.Carrier(), ib.Carrier());
+                        BOOST_CHECK_EQUAL(ia.Old(), ib.Old());
+                    }
+                }
+            }
+}
+
+BOOST_AUTO_TEST_CASE(HexBoard_JournalUndoMatchesBackup)
+{
+    ICEngine ice;
+    VCBuilderParam backupParam;
+    VCBuilderParam journalParam;
+    journalParam.journal_undo = true;
+    HexBoard backup(7, 7, ice, backupParam);
+    HexBoard journal(7, 7, ice, journalParam);
+    backup.ComputeAll(BLACK);
+    journal.ComputeAll(BLACK);
+    CheckSameCarriers(backup, journal);
+
+    const HexPoint moves[] = { HEX_CELL_D4, HEX_CELL_C5, HEX_CELL_B2,
+                               HEX_CELL_E3, HEX_CELL_C3, HEX_CELL_F2 };
+    const std::size_t numMoves = sizeof(moves) / sizeof(moves[0]);
+    HexColor color = BLACK;
+    for (std::size_t i = 0; i < numMoves; ++i)
+    {
+        backup.PlayMove(color, moves[i]);
+        journal.PlayMove(color, moves[i]);
+        CheckSameCarriers(backup, journal);
+        if (i == 2)
+        {
+            backup.UndoMove();
+            journal.UndoMove();
+            CheckSameCarriers(backup, journal);
+            backup.PlayMove(color, moves[i]);
+            journal.PlayMove(color, moves[i]);
+        }
+        color = !color;
+    }
+    for (std::size_t i = 0; i < numMoves; ++i)
+    {
+        backup.UndoMove();
+        journal.UndoMove();
+        CheckSameCarriers(backup, journal);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(HexBoard_CachedBuildMatchesBuild)
+{
+    VCCache::Global().Clear();
+    ICEngine ice;
+    VCBuilderParam param;
+    VCBuilderParam cachedParam;
+    cachedParam.use_cache = true;
+    HexBoard plain(7, 7, ice, param);
+    HexBoard first(7, 7, ice, cachedParam);
+    HexBoard second(7, 7, ice, cachedParam);
+    plain.ComputeAll(BLACK);
+    first.ComputeAll(BLACK);
+    BOOST_CHECK_EQUAL(VCCache::Global().GetStatistics().hits, 0u);
+    second.ComputeAll(BLACK);
+    BOOST_CHECK_EQUAL(VCCache::Global().GetStatistics().hits, 2u);
+    CheckSameCarriers(plain, first);
+    CheckSameCarriers(plain, second);
+
+    // Incremental builds continue from loaded connections
+    plain.PlayMove(BLACK, HEX_CELL_D4);
+    second.PlayMove(BLACK, HEX_CELL_D4);
+    CheckSameCarriers(plain, second);
+    plain.UndoMove();
+    second.UndoMove();
+    CheckSameCarriers(plain, second);
+    VCCache::Global().Clear();
+}
+
+BOOST_AUTO_TEST_CASE(HexBoard_BudgetedBuildIsPartial)
+{
+    ICEngine ice;
+    VCBuilderParam param;
+    VCBuilderParam budgetParam;
+    budgetParam.max_rule_applications = 20;
+    HexBoard complete(7, 7, ice, param);
+    HexBoard partial(7, 7, ice, budgetParam);
+    complete.ComputeAll(BLACK);
+    partial.ComputeAll(BLACK);
+    BOOST_CHECK(!complete.Cons(BLACK).IsPartial());
+    BOOST_CHECK(partial.Cons(BLACK).IsPartial());
+    BOOST_CHECK(partial.Cons(WHITE).IsPartial());
+
+    // Every connection found is one the complete build has as well
+    for (BWIterator c; c; ++c)
+        for (BoardIterator p(complete.Const().EdgesAndInterior()); p; ++p)
+        {
+            BOOST_CHECK(BitsetUtil::IsSubsetOf(
+                            partial.Cons(*c).GetFullNbs(*p),
+                            complete.Cons(*c).GetFullNbs(*p)));
+            BOOST_CHECK(BitsetUtil::IsSubsetOf(
+                            partial.Cons(*c).GetSemiNbs(*p)
+                            - complete.Cons(*c).GetFullNbs(*p),
+                            complete.Cons(*c).GetSemiNbs(*p)));
+        }
+
+    // Incremental builds on a partial set stay partial until undone
+    budgetParam.max_rule_applications = 0;
+    partial.PlayMove(BLACK, HEX_CELL_D4);
+    BOOST_CHECK(partial.Cons(BLACK).IsPartial());
+    partial.UndoMove();
+    BOOST_CHECK(partial.Cons(BLACK).IsPartial());
+    partial.ComputeAll(BLACK);
+    BOOST_CHECK(!partial.Cons(BLACK).IsPartial());
+    CheckSameCarriers(complete, partial);
+}
+
+/** The time budget does not depend on SgTime, which stands still in
+    SG_TIME_NONE. */
+BOOST_AUTO_TEST_CASE(HexBoard_TimeBudgetIgnoresTimeMode)
+{
+    const SgTimeMode mode = SgTime::DefaultMode();
+    SgTime::SetDefaultMode(SG_TIME_NONE);
+    ICEngine ice;
+    VCBuilderParam param;
+    param.max_build_usec = 1;
+    HexBoard brd(11, 11, ice, param);
+    brd.ComputeAll(BLACK);
+    SgTime::SetDefaultMode(mode);
+    BOOST_CHECK(brd.Cons(BLACK).IsPartial());
+}
+
 //---------------------------------------------------------------------------
 
 } // namespace
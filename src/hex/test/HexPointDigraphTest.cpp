@@ -0,0 +1,250 @@
+//----------------------------------------------------------------------------
+/** @file HexPointDigraphTest.cpp */
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <boost/test/auto_unit_test.hpp>
+
+#include "SgSystem.h"
+#include "SgRandom.h"
+
+#include "BitsetIterator.hpp"
+#include "HexPointDigraph.hpp"
+
+using namespace benzene;
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+const HexPoint a1 = HEX_CELL_A1;
+const HexPoint b1 = HEX_CELL_B1;
+const HexPoint c1 = HEX_CELL_C1;
+const HexPoint d1 = HEX_CELL_D1;
+const HexPoint e1 = HEX_CELL_E1;
+const HexPoint f1 = HEX_CELL_F1;
+const HexPoint g1 = HEX_CELL_G1;
+const HexPoint a2 = HEX_CELL_A2;
+const HexPoint b2 = HEX_CELL_B2;
+const HexPoint c2 = HEX_CELL_C2;
+const HexPoint d2 = HEX_CELL_D2;
+const HexPoint e2 = HEX_CELL_E2;
+const HexPoint f2 = HEX_CELL_F2;
+
+/** Same graph as Digraph_AllTests, with cell n for vertex n. */
+BOOST_AUTO_TEST_CASE(HexPointDigraph_AllTests)
+{
+    Digraph<HexPoint> g;
+
+    g.AddEdge(a1, b1);
+    BOOST_CHECK_EQUAL(g.OutDegree(a1), 1u);
+    BOOST_CHECK_EQUAL(g.OutDegree(b1), 0u);
+    BOOST_CHECK_EQUAL(g.InDegree(a1), 0u);
+    BOOST_CHECK_EQUAL(g.InDegree(b1), 1u);
+    BOOST_CHECK(g.IsEdge(a1, b1));
+    BOOST_CHECK(!g.IsEdge(b1, a1));
+    BOOST_CHECK(g.VertexExists(a1));
+    BOOST_CHECK(g.VertexExists(b1));
+
+    g.AddEdge(b1, a1);
+    g.AddEdge(d1, e1);
+    g.AddEdge(a1, c1);
+    g.AddEdge(e1, g1);
+    g.AddEdge(c1, a1);
+    g.AddEdge(a2, a1);
+    g.AddEdge(b2, c1);
+    bitset_t s = g.FindTwoCycles();
+    BOOST_CHECK_EQUAL(s.count(), 3u);
+    BOOST_CHECK(s.test(a1) && s.test(b1) && s.test(c1));
+
+    s = g.OutSet(a1);
+    BOOST_CHECK_EQUAL(s.count(), 2u);
+    BOOST_CHECK(s.test(b1) && s.test(c1));
+
+    s = g.InSet(a1);
+    BOOST_CHECK_EQUAL(s.count(), 3u);
+    BOOST_CHECK(s.test(b1) && s.test(c1) && s.test(a2));
+
+    bitset_t t;
+    t.set(a1);
+    t.set(c1);
+    s = g.InSet(t);
+    BOOST_CHECK_EQUAL(s.count(), 5u);
+    BOOST_CHECK(s.test(b2));
+
+    g.AddEdge(a1, a1);
+    BOOST_CHECK_EQUAL(g.OutSet(a1).count(), 3u);
+
+    Digraph<HexPoint> tr;
+    g.Transpose(tr);
+    BOOST_CHECK(tr.IsEdge(e1, d1));
+    BOOST_CHECK(tr.IsEdge(g1, e1));
+    BOOST_CHECK(tr.IsEdge(a1, a2));
+    BOOST_CHECK(tr.IsEdge(a1, a1));
+    BOOST_CHECK(!tr.IsEdge(d1, e1));
+
+    t = g.Sources();
+    BOOST_CHECK_EQUAL(t.count(), 3u);
+    BOOST_CHECK(t.test(d1) && t.test(a2) && t.test(b2));
+    t = g.Sinks();
+    BOOST_CHECK_EQUAL(t.count(), 1u);
+    BOOST_CHECK(t.test(g1));
+
+    g.Clear();
+    BOOST_CHECK_EQUAL(g.NumVertices(), 0u);
+
+    g.AddEdge(a1, b1);
+    g.AddEdge(b1, c1);
+    g.RemoveEdge(a1, b1);
+    BOOST_CHECK(!g.IsEdge(a1, b1));
+    BOOST_CHECK(g.VertexExists(a1));
+    BOOST_CHECK(g.VertexExists(b1));
+    BOOST_CHECK(g.VertexExists(c1));
+
+    g.AddEdge(a1, e1);
+    g.AddEdge(b1, e1);
+    g.RemoveVertex(e1);
+    BOOST_CHECK(!g.VertexExists(e1));
+    BOOST_CHECK(g.VertexExists(a1));
+    BOOST_CHECK(!g.IsEdge(a1, e1));
+    BOOST_CHECK(!g.IsEdge(b1, e1));
+    BOOST_CHECK(g.InSet(e1).none());
+}
+
+BOOST_AUTO_TEST_CASE(HexPointDigraph_StronglyConnectedComponents)
+{
+    //  a1 -> b1 -> c1 -> d1    a2 <-> b2   c2 -> d2
+    //  ^           |
+    //  +-----------+
+    Digraph<HexPoint> g;
+    g.AddEdge(a1, b1);
+    g.AddEdge(b1, c1);
+    g.AddEdge(c1, a1);
+    g.AddEdge(c1, d1);
+    g.AddEdge(a2, b2);
+    g.AddEdge(b2, a2);
+    g.AddEdge(c2, d2);
+
+    std::vector<bitset_t> comp;
+    g.FindStronglyConnectedComponents(comp);
+    BOOST_CHECK_EQUAL(comp.size(), 5u);
+    for (std::size_t i = 0; i < comp.size(); ++i)
+    {
+        if (comp[i].test(a1))
+            BOOST_CHECK_EQUAL(comp[i].count(), 3u);
+        if (comp[i].test(a2))
+            BOOST_CHECK_EQUAL(comp[i].count(), 2u);
+    }
+
+    bitset_t cycles = g.FindCycles();
+    BOOST_CHECK_EQUAL(cycles.count(), 5u);
+    BOOST_CHECK(!cycles.test(d1) && !cycles.test(c2));
+
+    Digraph<HexPoint> closure;
+    g.TransitiveClosure(closure);
+    BOOST_CHECK(closure.IsEdge(a1, d1));
+    BOOST_CHECK(closure.IsEdge(a1, a1));
+    BOOST_CHECK(!closure.IsEdge(d1, a1));
+    BOOST_CHECK(closure.InSet(d1).test(b1));
+
+    g.AddEdge(e2, f2);
+    g.AddEdge(f2, f1);
+    g.RemoveVertices(g.FindCycles());
+    BOOST_CHECK_EQUAL(g.NumVertices(), 6u);
+    BOOST_CHECK(g.IsEdge(c2, d2));
+    BOOST_CHECK(g.InSet(d1).none());
+}
+
+/** Components and two-cycles agree with the generic graph on random
+    graphs over the whole board. */
+BOOST_AUTO_TEST_CASE(HexPointDigraph_MatchesGeneric)
+{
+    SgRandom random;
+    for (int trial = 0; trial < 20; ++trial)
+    {
+        Digraph<HexPoint> dense;
+        Digraph<int> generic;
+        for (int i = 0; i < 300; ++i)
+        {
+            HexPoint x = static_cast<HexPoint>
+                (FIRST_CELL + random.Int(FIRST_INVALID - FIRST_CELL));
+            HexPoint y = static_cast<HexPoint>
+                (FIRST_CELL + random.Int(FIRST_INVALID - FIRST_CELL));
+            dense.AddEdge(x, y);
+            generic.AddEdge(x, y);
+        }
+        std::set<int> cycles;
+        generic.FindTwoCycles(cycles);
+        bitset_t twoCycles = dense.FindTwoCycles();
+        BOOST_CHECK_EQUAL(twoCycles.count(), cycles.size());
+        for (BitsetIterator p(twoCycles); p; ++p)
+            BOOST_CHECK_EQUAL(cycles.count(*p), 1u);
+
+        std::vector<std::set<int> > genericComp;
+        std::vector<bitset_t> denseComp;
+        generic.FindStronglyConnectedComponents(genericComp);
+        dense.FindStronglyConnectedComponents(denseComp);
+        BOOST_CHECK_EQUAL(genericComp.size(), denseComp.size());
+        for (std::size_t i = 0; i < genericComp.size(); ++i)
+        {
+            const std::set<int>& c = genericComp[i];
+            bitset_t members;
+            for (std::set<int>::const_iterator it = c.begin();
+                 it != c.end(); ++it)
+                members.set(*it);
+            bool found = false;
+            for (std::size_t j = 0; j < denseComp.size(); ++j)
+                found |= (denseComp[j] == members);
+            BOOST_CHECK(found);
+        }
+    }
+}
+
+
+/** Restricting DFS to vertices visits the same points, in the same
+    order, as a DFS on a copy without the other vertices. */
+BOOST_AUTO_TEST_CASE(HexPointDigraph_MaskedDFS)
+{
+    SgRandom random;
+    for (int trial = 0; trial < 20; ++trial)
+    {
+        Digraph<HexPoint> g;
+        bitset_t removed;
+        for (int i = 0; i < 300; ++i)
+        {
+            HexPoint x = static_cast<HexPoint>
+                (FIRST_CELL + random.Int(FIRST_INVALID - FIRST_CELL));
+            HexPoint y = static_cast<HexPoint>
+                (FIRST_CELL + random.Int(FIRST_INVALID - FIRST_CELL));
+            g.AddEdge(x, y);
+            if (random.Int(8) == 0)
+                removed.set(x);
+        }
+        const bitset_t vertices = g.Vertices() - removed;
+        Digraph<HexPoint> copy(g);
+        copy.RemoveVertices(removed);
+        Digraph<HexPoint> trans;
+        copy.Transpose(trans);
+        for (BitsetIterator p(vertices); p; ++p)
+        {
+            bitset_t v1, v2;
+            HexPoint s1[BITSETSIZE], s2[BITSETSIZE];
+            std::size_t n1 = 0, n2 = 0;
+            g.DFS(*p, vertices, v1, EMPTY_BITSET, s1, n1);
+            copy.DFS(*p, v2, EMPTY_BITSET, s2, n2);
+            BOOST_CHECK_EQUAL(v1, v2);
+            BOOST_CHECK(std::equal(s1, s1 + n1, s2) && n1 == n2);
+
+            v1.reset();
+            v2.reset();
+            n1 = n2 = 0;
+            g.TransposedDFS(*p, vertices, v1, EMPTY_BITSET, s1, n1);
+            trans.DFS(*p, v2, EMPTY_BITSET, s2, n2);
+            BOOST_CHECK_EQUAL(v1, v2);
+            BOOST_CHECK(std::equal(s1, s1 + n1, s2) && n1 == n2);
+        }
+    }
+}
+}
+
+//---------------------------------------------------------------------------
@@ -0,0 +1,166 @@
+//---------------------------------------------------------------------------
+/** @file ICECacheTest.cpp
+ */
+//---------------------------------------------------------------------------
+
+#include <atomic>
+#include <boost/bind.hpp>
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "ICECache.hpp"
+#include "ICEngine.hpp"
+
+using namespace benzene;
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+SgHashCode Hash(unsigned i)
+{
+    return SgHashCode(i + 1);
+}
+
+void CheckSameInferior(const InferiorCells& a, const InferiorCells& b)
+{
+    for (BWIterator c; c; ++c)
+        BOOST_CHECK_EQUAL(a.Fillin(*c), b.Fillin(*c));
+    BOOST_CHECK_EQUAL(a.Vulnerable(), b.Vulnerable());
+    BOOST_CHECK_EQUAL(a.SReversible(), b.SReversible());
+    BOOST_CHECK_EQUAL(a.Blockers(), b.Blockers());
+    BOOST_CHECK_EQUAL(a.SReversibleCarriers(), b.SReversibleCarriers());
+    BOOST_CHECK_EQUAL(a.Inferior(), b.Inferior());
+    BOOST_CHECK_EQUAL(a.All(), b.All());
+    for (int i = 0; i < BITSETSIZE; ++i)
+    {
+        HexPoint p = static_cast<HexPoint>(i);
+        BOOST_CHECK_EQUAL(a.Killers(p), b.Killers(p));
+        BOOST_CHECK_EQUAL(a.SReversers(p), b.SReversers(p));
+        BOOST_CHECK_EQUAL(a.Superiors(p), b.Superiors(p));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ICECache_GetPut)
+{
+    ICECache cache(16);
+    InferiorCells inf;
+    inf.AddFillin(BLACK, HEX_CELL_A1);
+    inf.AddFillin(WHITE, HEX_CELL_B1);
+    inf.AddVulnerable(HEX_CELL_C1, HEX_CELL_D1);
+    bitset_t carrier;
+    carrier.set(HEX_CELL_E2);
+    inf.AddSReversible(HEX_CELL_C2, carrier, HEX_CELL_D2, false);
+    inf.AddInferior(HEX_CELL_C3, HEX_CELL_D3);
+    inf.AddInferior(HEX_CELL_C3, HEX_CELL_E3);
+
+    InferiorCells out;
+    unsigned result = 0;
+    BOOST_CHECK(!cache.Get(Hash(1), BLACK, 0, out, result));
+    cache.Put(Hash(1), BLACK, 0, inf, 7);
+    BOOST_CHECK(cache.Get(Hash(1), BLACK, 0, out, result));
+    BOOST_CHECK_EQUAL(result, 7u);
+    CheckSameInferior(inf, out);
+    // Color and settings are part of the key
+    BOOST_CHECK(!cache.Get(Hash(1), WHITE, 0, out, result));
+    BOOST_CHECK(!cache.Get(Hash(1), BLACK, 1, out, result));
+
+    ICECache::Statistics stats = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(stats.lookups, 4u);
+    BOOST_CHECK_EQUAL(stats.hits, 1u);
+    BOOST_CHECK_EQUAL(stats.stores, 1u);
+    BOOST_CHECK_EQUAL(stats.capacity, 16u);
+
+    cache.Clear();
+    BOOST_CHECK(!cache.Get(Hash(1), BLACK, 0, out, result));
+    BOOST_CHECK_EQUAL(cache.GetStatistics().hits, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(ICECache_Oversized)
+{
+    ICECache cache(16);
+    InferiorCells inf;
+    for (int i = 1; i <= int(ICECache::MAX_ROWS) + 1; ++i)
+        inf.AddInferior(static_cast<HexPoint>(FIRST_CELL + i), HEX_CELL_A1);
+    cache.Put(Hash(1), BLACK, 0, inf, 0);
+    InferiorCells out;
+    unsigned result;
+    BOOST_CHECK(!cache.Get(Hash(1), BLACK, 0, out, result));
+    BOOST_CHECK_EQUAL(cache.GetStatistics().oversized, 1u);
+}
+
+/** Stores and looks up entries whose result is their key; counts hits
+    with another result. */
+void PutAndGet(ICECache* cache, unsigned first, std::atomic<int>* wrong)
+{
+    InferiorCells inf;
+    inf.AddVulnerable(HEX_CELL_C1, HEX_CELL_D1);
+    InferiorCells out;
+    for (unsigned i = first; i < first + 20000; ++i)
+    {
+        const unsigned key = i % 64;
+        cache->Put(Hash(key), BLACK, 0, inf, key);
+        unsigned result;
+        if (cache->Get(Hash(key), BLACK, 0, out, result) && result != key)
+            ++*wrong;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ICECache_SetCapacityWhileInUse)
+{
+    ICECache cache(16);
+    std::atomic<int> wrong(0);
+    boost::thread_group threads;
+    for (unsigned i = 0; i < 3; ++i)
+        threads.create_thread(boost::bind(PutAndGet, &cache, i * 7, &wrong));
+    for (std::size_t i = 0; i < 200; ++i)
+        cache.SetCapacity(i % 3 == 0 ? 0 : 1 + i % 64);
+    threads.join_all();
+    BOOST_CHECK_EQUAL(wrong.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ICECache_ComputeInferiorCellsHit)
+{
+    ICECache::Global().Clear();
+    ICEngine ice;
+    ICEngine cachedIce;
+    cachedIce.SetUseCache(true);
+    StoneBoard brd(7, 7);
+    brd.PlayMove(BLACK, HEX_CELL_D4);
+    brd.PlayMove(WHITE, HEX_CELL_C5);
+    brd.PlayMove(BLACK, HEX_CELL_B2);
+
+    InferiorCells expected;
+    StoneBoard expectedBrd(brd);
+    {
+        PatternState pastate(expectedBrd);
+        pastate.Update();
+        Groups groups;
+        GroupBuilder::Build(expectedBrd, groups);
+        ice.ComputeInferiorCells(WHITE, groups, pastate, expected,
+                                 HEX_CELL_B2);
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+        StoneBoard cachedBrd(brd);
+        PatternState pastate(cachedBrd);
+        pastate.Update();
+        Groups groups;
+        GroupBuilder::Build(cachedBrd, groups);
+        InferiorCells inf;
+        cachedIce.ComputeInferiorCells(WHITE, groups, pastate, inf,
+                                       HEX_CELL_B2);
+        CheckSameInferior(expected, inf);
+        BOOST_CHECK_EQUAL(cachedBrd.GetBlack(), expectedBrd.GetBlack());
+        BOOST_CHECK_EQUAL(cachedBrd.GetWhite(), expectedBrd.GetWhite());
+        Groups rebuilt;
+        GroupBuilder::Build(cachedBrd, rebuilt);
+        BOOST_CHECK_EQUAL(groups.NumGroups(), rebuilt.NumGroups());
+    }
+    BOOST_CHECK_EQUAL(ICECache::Global().GetStatistics().hits, 1u);
+    ICECache::Global().Clear();
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------
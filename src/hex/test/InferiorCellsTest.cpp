@@ -35,9 +35,9 @@ BOOST_AUTO_TEST_CASE(InferiorCells_Dominated)
 
     //   a1 -> b1 <- c1
     inf.Clear();
-    inf.AddDominated(a1, b1);
-    inf.AddDominated(c1, b1);
-    dom = inf.Dominated();
+    inf.AddInferior(a1, b1);
+    inf.AddInferior(c1, b1);
+    dom = inf.Inferior();
     BOOST_CHECK_EQUAL(dom.count(), 2u);
     BOOST_CHECK(dom.test(a1));
     BOOST_CHECK(dom.test(c1));
@@ -45,9 +45,9 @@ BOOST_AUTO_TEST_CASE(InferiorCells_Dominated)
                 
     //   a1 <- b1 -> c1
     inf.Clear();
-    inf.AddDominated(b1, a1);
-    inf.AddDominated(b1, c1);
-    dom = inf.Dominated();
+    inf.AddInferior(b1, a1);
+    inf.AddInferior(b1, c1);
+    dom = inf.Inferior();
     BOOST_CHECK_EQUAL(dom.count(), 1u);
     BOOST_CHECK(!dom.test(a1));
     BOOST_CHECK(!dom.test(c1));
@@ -60,14 +60,14 @@ BOOST_AUTO_TEST_CASE(InferiorCells_Dominated)
     //              (vul)
     //
     inf.Clear();
-    inf.AddDominated(a1, b1);
-    inf.AddDominated(b1, c1);
+    inf.AddInferior(a1, b1);
+    inf.AddInferior(b1, c1);
 
-    inf.AddDominated(a2, b2);
-    inf.AddDominated(b2, c2);
+    inf.AddInferior(a2, b2);
+    inf.AddInferior(b2, c2);
     inf.AddVulnerable(c2, c3);
 
-    dom = inf.Dominated();
+    dom = inf.Inferior();
     BOOST_CHECK(dom.test(a1));
     BOOST_CHECK(dom.test(b1));
     BOOST_CHECK(!dom.test(c1));
@@ -83,9 +83,9 @@ BOOST_AUTO_TEST_CASE(InferiorCells_Dominated)
     //   a1 -> b1
     // 
     inf.Clear();
-    inf.AddDominated(a1, b1);
-    inf.AddDominated(b1, a1);
-    dom = inf.Dominated();
+    inf.AddInferior(a1, b1);
+    inf.AddInferior(b1, a1);
+    dom = inf.Inferior();
     BOOST_CHECK_EQUAL(dom.count(), 1u);
     BOOST_CHECK(dom.test(a1) != dom.test(b1));
 
@@ -99,12 +99,12 @@ BOOST_AUTO_TEST_CASE(InferiorCells_Dominated)
     //         b2
     // 
     inf.Clear();
-    inf.AddDominated(a1, b1);
-    inf.AddDominated(b1, c1);
-    inf.AddDominated(c1, a1);
-    inf.AddDominated(b2, a2);
-    inf.AddDominated(a2, b1);
-    dom = inf.Dominated();
+    inf.AddInferior(a1, b1);
+    inf.AddInferior(b1, c1);
+    inf.AddInferior(c1, a1);
+    inf.AddInferior(b2, a2);
+    inf.AddInferior(a2, b1);
+    dom = inf.Inferior();
 
     BOOST_CHECK_EQUAL(dom.count(), 4u);
     BOOST_CHECK(dom.test(b2));
@@ -120,10 +120,10 @@ BOOST_AUTO_TEST_CASE(InferiorCells_Dominated)
     //         ^
     //         b2
     // 
-    inf.AddDominated(c1, a3);
-    inf.AddDominated(a3, b3);
-    inf.AddDominated(b3, a3);
-    dom = inf.Dominated();
+    inf.AddInferior(c1, a3);
+    inf.AddInferior(a3, b3);
+    inf.AddInferior(b3, a3);
+    dom = inf.Inferior();
     
     BOOST_CHECK_EQUAL(dom.count(), 6u);
     BOOST_CHECK(dom.test(b2));
@@ -142,16 +142,52 @@ BOOST_AUTO_TEST_CASE(InferiorCells_Dominated)
     //          +----+ 
     // 
     inf.Clear();
-    inf.AddDominated(a1, b1);
-    inf.AddDominated(b1, a1);
-    inf.AddDominated(b1, c1);
-    inf.AddDominated(c1, b1);
-    dom = inf.Dominated();
+    inf.AddInferior(a1, b1);
+    inf.AddInferior(b1, a1);
+    inf.AddInferior(b1, c1);
+    inf.AddInferior(c1, b1);
+    dom = inf.Inferior();
     BOOST_CHECK_EQUAL(dom.count(), 2u);
     BOOST_CHECK(!dom.test(a1) || !dom.test(b1) || !dom.test(c1));
     
 }
 
+bitset_t Only(HexPoint p)
+{
+    bitset_t b;
+    b.set(p);
+    return b;
+}
+
+BOOST_AUTO_TEST_CASE(InferiorCells_Swap)
+{
+    InferiorCells a;
+    a.AddVulnerable(HEX_CELL_A1, HEX_CELL_B1);
+    a.AddInferior(HEX_CELL_C1, HEX_CELL_D1);
+    InferiorCells b;
+    b.AddVulnerable(HEX_CELL_A2, HEX_CELL_B2);
+    b.AddFillin(BLACK, Only(HEX_CELL_C2));
+    BOOST_CHECK(b.Inferior().none());
+
+    a.Swap(b);
+    BOOST_CHECK_EQUAL(a.Vulnerable(), Only(HEX_CELL_A2));
+    BOOST_CHECK_EQUAL(a.Killers(HEX_CELL_A2),
+                      Only(HEX_CELL_B2));
+    BOOST_CHECK(a.Killers(HEX_CELL_A1).none());
+    BOOST_CHECK_EQUAL(a.Fillin(BLACK), Only(HEX_CELL_C2));
+    BOOST_CHECK(a.Inferior().none());
+    BOOST_CHECK(a.Superiors(HEX_CELL_C1).none());
+
+    BOOST_CHECK_EQUAL(b.Vulnerable(), Only(HEX_CELL_A1));
+    BOOST_CHECK_EQUAL(b.Killers(HEX_CELL_A1),
+                      Only(HEX_CELL_B1));
+    BOOST_CHECK(b.Killers(HEX_CELL_A2).none());
+    BOOST_CHECK(b.Fillin(BLACK).none());
+    BOOST_CHECK_EQUAL(b.Inferior(), Only(HEX_CELL_C1));
+    BOOST_CHECK_EQUAL(b.Superiors(HEX_CELL_C1),
+                      Only(HEX_CELL_D1));
+}
+
 }
 
 //---------------------------------------------------------------------------
@@ -17,6 +17,7 @@
 #include <boost/test/auto_unit_test.hpp>
 
 #include "SgSystem.h"
+#include "BitsetIterator.hpp"
 #include "PatternState.hpp"
 
 using namespace benzene;
@@ -113,6 +114,92 @@ BOOST_AUTO_TEST_CASE(PatternState_Tests)
     BOOST_CHECK_EQUAL(hits[HEX_CELL_K8].size(), 1u);
     BOOST_CHECK_EQUAL(hits[HEX_CELL_K8][0].Moves1().size(), 1u);
     BOOST_CHECK_EQUAL(hits[HEX_CELL_K8][0].Moves1()[0], HEX_CELL_K9);
+
+    // A hit buffer holds the same hits; matching again replaces them
+    PatternHitBuffer buffer;
+    for (int i = 0; i < 2; ++i)
+    {
+        BOOST_CHECK_EQUAL(pastate.MatchOnBoard(brd.GetEmpty(), hashpat,
+                                               PatternState::MATCH_ALL,
+                                               buffer), found);
+        for (BitsetIterator p(brd.GetEmpty()); p; ++p)
+        {
+            BOOST_REQUIRE_EQUAL(buffer.NumHits(*p), hits[*p].size());
+            for (std::size_t j = 0; j < hits[*p].size(); ++j)
+            {
+                const PatternHit& hit = buffer.Hit(*p, j);
+                BOOST_CHECK_EQUAL(hit.GetPattern(), hits[*p][j].GetPattern());
+                std::vector<HexPoint> moves1 = hit.Moves1();
+                std::vector<HexPoint> expected = hits[*p][j].Moves1();
+                BOOST_CHECK(moves1 == expected);
+            }
+        }
+    }
+    pastate.MatchOnBoard(EMPTY_BITSET, hashpat,
+                         PatternState::MATCH_ALL, buffer);
+    BOOST_CHECK_EQUAL(buffer.NumHits(HEX_CELL_H4), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(PatternState_MatchBlocks)
+{
+    // Enough copies of the pattern above to fill more than one block
+    // of HashedPatternSet; all of them must match, in order.
+    std::string patstring 
+        = "v:1,0,1,0,0;1,0,0,1,0;1,0,1,0,0;1,0,1,0,0;0,0,0,0,0;0,0,0,0,0;";
+    const std::size_t num = HashedPatternSet::BLOCK_SIZE + 3;
+    PatternSet patterns;
+    for (std::size_t i = 0; i < num; ++i)
+    {
+        Pattern pattern;
+        BOOST_CHECK(pattern.Unserialize(patstring));
+        pattern.SetName("pat");
+        patterns.push_back(pattern);
+    }
+    HashedPatternSet hashpat;
+    hashpat.Hash(patterns);
+
+    StoneBoard brd(11, 11);
+    PatternState pastate(brd);
+    brd.PlayMove(WHITE, HEX_CELL_G4);
+    brd.PlayMove(WHITE, HEX_CELL_H3);
+    brd.PlayMove(WHITE, HEX_CELL_I4);
+    pastate.Update();
+
+    PatternHits hits;
+    pastate.MatchOnCell(hashpat, HEX_CELL_H4, PatternState::MATCH_ALL, hits);
+    BOOST_REQUIRE_EQUAL(hits.size(), num);
+    for (std::size_t i = 0; i < num; ++i)
+        BOOST_CHECK_EQUAL(hits[i].GetPattern(), &patterns[i]);
+    hits.clear();
+    pastate.MatchOnCell(hashpat, HEX_CELL_H4, 
+                        PatternState::STOP_AT_FIRST_HIT, hits);
+    BOOST_CHECK_EQUAL(hits.size(), 1u);
+    hits.clear();
+    pastate.MatchOnCell(hashpat, HEX_CELL_H5, PatternState::MATCH_ALL, hits);
+    BOOST_CHECK(hits.empty());
+    BOOST_CHECK(pastate.MatchOnBoard(brd.GetEmpty(), hashpat)
+                .test(HEX_CELL_H4));
+}
+
+BOOST_AUTO_TEST_CASE(PatternMatcherData_SlicesMatchOffsets)
+{
+    const int sliceSize 
+        = Pattern::MAX_EXTENSION * (Pattern::MAX_EXTENSION + 1) / 2;
+    for (int size = 1; size <= MAX_WIDTH; size += 5)
+    {
+        StoneBoard brd(size, size);
+        const PatternMatcherData* data = PatternMatcherData::Get(&brd.Const());
+        for (BoardIterator p(brd.Const().Interior()); p; ++p)
+            for (int s = 0; s < Pattern::NUM_SLICES; ++s)
+                for (int g = 0; g < sliceSize; ++g)
+                {
+                    HexPoint q = data->InverseSliceGodel(*p, s, g);
+                    if (!HexPointUtil::isInteriorCell(q))
+                        continue;
+                    BOOST_CHECK_EQUAL(data->PlayedInSlice(*p, q), s);
+                    BOOST_CHECK_EQUAL(data->PlayedInGodel(*p, q), 1 << g);
+                }
+    }
 }
 
 }
@@ -4,6 +4,7 @@
 #include <boost/test/auto_unit_test.hpp>
 
 #include "SgSystem.h"
+#include "BitsetIterator.hpp"
 #include "StateDB.hpp"
 
 using namespace benzene;
@@ -75,6 +76,45 @@ BOOST_AUTO_TEST_CASE(StateDB_StateMap)
     BOOST_CHECK_EQUAL(map[srb2], 1);
 }
 
+BOOST_AUTO_TEST_CASE(StateDB_RotatedHashMatchesRotatedBoard)
+{
+    const int sizes[][2] = { { 1, 1 }, { 3, 5 }, { 7, 7 }, 
+                             { MAX_WIDTH, MAX_HEIGHT } };
+    for (std::size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k)
+    {
+        HexState state(StoneBoard(sizes[k][0], sizes[k][1]), BLACK);
+        std::vector<HexPoint> played;
+        unsigned seed = 12345;
+        for (int i = 0; i < 60; ++i)
+        {
+            seed = seed * 1103515245u + 12345u;
+            bitset_t empty = state.Position().GetEmpty();
+            if (empty.none() || (played.size() > 2 && (seed >> 16) % 4 == 0))
+            {
+                state.UndoMove(played.back());
+                played.pop_back();
+            }
+            else
+            {
+                std::size_t n = (seed >> 8) % empty.count();
+                BitsetIterator p(empty);
+                for (; n > 0; --n)
+                    ++p;
+                state.PlayMove(*p);
+                played.push_back(*p);
+            }
+            HexState rotated(state);
+            rotated.Position().RotateBoard();
+            BOOST_CHECK_EQUAL(state.RotatedHash(), rotated.Hash());
+            BOOST_CHECK_EQUAL(rotated.RotatedHash(), state.Hash());
+            SgHashCode expected = state.Hash() < rotated.Hash() 
+                ? state.Hash() : rotated.Hash();
+            BOOST_CHECK_EQUAL(GetHash(state), expected);
+            BOOST_CHECK_EQUAL(GetHash(rotated), expected);
+        }
+    }
+}
+
 }
 
 //---------------------------------------------------------------------------
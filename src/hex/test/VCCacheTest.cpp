@@ -0,0 +1,78 @@
+//---------------------------------------------------------------------------
+/** @file VCCacheTest.cpp
+ */
+//---------------------------------------------------------------------------
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "VCCache.hpp"
+
+using namespace benzene;
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+VCCache::DataPtr MakeData(std::size_t carriers)
+{
+    boost::shared_ptr<VCCacheData> data(new VCCacheData());
+    data->carriers.resize(carriers);
+    return data;
+}
+
+SgHashCode Hash(unsigned i)
+{
+    return SgHashCode(i + 1);
+}
+
+BOOST_AUTO_TEST_CASE(VCCache_GetPut)
+{
+    VCCache cache(4);
+    VCCache::DataPtr data = MakeData(3);
+    BOOST_CHECK(!cache.Get(Hash(1), BLACK, 0));
+    cache.Put(Hash(1), BLACK, 0, data);
+    BOOST_CHECK(cache.Get(Hash(1), BLACK, 0) == data);
+    // Color and settings are part of the key
+    BOOST_CHECK(!cache.Get(Hash(1), WHITE, 0));
+    BOOST_CHECK(!cache.Get(Hash(1), BLACK, 1));
+
+    VCCache::Statistics stats = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(stats.lookups, 4u);
+    BOOST_CHECK_EQUAL(stats.hits, 1u);
+    BOOST_CHECK_EQUAL(stats.stores, 1u);
+    BOOST_CHECK_EQUAL(stats.entries, 1u);
+    BOOST_CHECK_EQUAL(stats.bytes, data->Bytes());
+
+    cache.Clear();
+    BOOST_CHECK(!cache.Get(Hash(1), BLACK, 0));
+    BOOST_CHECK_EQUAL(cache.GetStatistics().entries, 0u);
+    BOOST_CHECK_EQUAL(cache.GetStatistics().bytes, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(VCCache_ClockEviction)
+{
+    VCCache cache(3);
+    for (unsigned i = 0; i < 3; ++i)
+        cache.Put(Hash(i), BLACK, 0, MakeData(i + 1));
+    // Referenced entries survive the next sweep
+    BOOST_CHECK(cache.Get(Hash(0), BLACK, 0));
+    BOOST_CHECK(cache.Get(Hash(2), BLACK, 0));
+    cache.Put(Hash(3), BLACK, 0, MakeData(1));
+    BOOST_CHECK(cache.Get(Hash(0), BLACK, 0));
+    BOOST_CHECK(!cache.Get(Hash(1), BLACK, 0));
+    BOOST_CHECK(cache.Get(Hash(2), BLACK, 0));
+    BOOST_CHECK(cache.Get(Hash(3), BLACK, 0));
+    VCCache::Statistics stats = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(stats.evictions, 1u);
+    BOOST_CHECK_EQUAL(stats.entries, 3u);
+
+    cache.SetCapacity(0);
+    cache.Put(Hash(4), BLACK, 0, MakeData(1));
+    BOOST_CHECK(!cache.Get(Hash(4), BLACK, 0));
+}
+
+//---------------------------------------------------------------------------
+
+} // namespace
+
+//---------------------------------------------------------------------------
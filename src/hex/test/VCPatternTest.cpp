@@ -0,0 +1,81 @@
+//---------------------------------------------------------------------------
+/** @file VCPatternTest.cpp */
+//---------------------------------------------------------------------------
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "SgSystem.h"
+#include "BoardIterator.hpp"
+#include "VCPattern.hpp"
+
+#include <cstdlib>
+
+using namespace benzene;
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+/** Checks that the index finds exactly the matching patterns, as
+    well as the patterns that match only since stones were added. */
+BOOST_AUTO_TEST_CASE(VCPattern_IndexFindsAllMatches)
+{
+    srand(11);
+    const int size = 9;
+    for (BWIterator c; c; ++c)
+    {
+        const VCPatternSet& patterns = VCPattern::GetPatterns(size, size, *c);
+        const VCPatternIndex& index = VCPattern::GetIndex(size, size, *c);
+        BOOST_REQUIRE(!patterns.empty());
+        std::size_t matched = 0;
+        for (int trial = 0; trial < 20; ++trial)
+        {
+            StoneBoard brd(size, size);
+            bitset_t oldStones;
+            for (int move = 0; move < 2 * (trial + 1); ++move)
+            {
+                for (BoardIterator p(brd.Const().Interior()); p; ++p)
+                    if (brd.IsEmpty(*p) && rand() % 40 == 0)
+                    {
+                        brd.PlayMove(move % 2 ? !*c : *c, *p);
+                        break;
+                    }
+                if (move == trial)
+                    oldStones = brd.GetColor(*c) & brd.Const().GetCells();
+            }
+            const bitset_t stones
+                = brd.GetColor(*c) & brd.Const().GetCells();
+
+            std::vector<std::size_t> all;
+            std::vector<std::size_t> added;
+            index.Candidates(stones, all);
+            index.Candidates(stones, stones - oldStones, added);
+            std::vector<std::size_t> expectedAll;
+            std::vector<std::size_t> expectedAdded;
+            for (std::size_t i = 0; i < patterns.size(); ++i)
+                if (patterns[i].Matches(*c, brd))
+                {
+                    expectedAll.push_back(i);
+                    if (!BitsetUtil::IsSubsetOf(patterns[i].MustHave(),
+                                                oldStones))
+                        expectedAdded.push_back(i);
+                }
+            std::vector<std::size_t> matchAll;
+            std::vector<std::size_t> matchAdded;
+            for (std::size_t i = 0; i < all.size(); ++i)
+                if (patterns[all[i]].Matches(*c, brd))
+                    matchAll.push_back(all[i]);
+            for (std::size_t i = 0; i < added.size(); ++i)
+                if (patterns[added[i]].Matches(*c, brd))
+                    matchAdded.push_back(added[i]);
+            BOOST_CHECK(matchAll == expectedAll);
+            BOOST_CHECK(matchAdded == expectedAdded);
+            matched += expectedAll.size();
+        }
+        BOOST_CHECK(matched > 0);
+    }
+}
+
+}
+
+//---------------------------------------------------------------------------
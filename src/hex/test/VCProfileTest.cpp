@@ -0,0 +1,46 @@
+//---------------------------------------------------------------------------
+/** @file VCProfileTest.cpp
+ */
+//---------------------------------------------------------------------------
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "VCProfile.hpp"
+
+using namespace benzene;
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+BOOST_AUTO_TEST_CASE(VCProfile_Json)
+{
+    VCProfile profile;
+    profile.AddBuild();
+    profile.AddLength(false, 1);
+    profile.AddLength(false, 1);
+    profile.AddLength(false, 3);
+    profile.AddLength(true, 1000);
+    {
+        VCProfile::Scope scope(profile, VCProfile::OR);
+    }
+    const std::string json = profile.ToJson();
+    BOOST_CHECK(json.find("\"builds\":1,") != std::string::npos);
+    BOOST_CHECK(json.find("\"or\":{\"calls\":1,") != std::string::npos);
+    BOOST_CHECK(json.find("\"base\":{\"calls\":0,\"ns\":0}")
+                != std::string::npos);
+    BOOST_CHECK(json.find("\"full_lengths\":[0,2,0,1]")
+                != std::string::npos);
+    // Lists longer than the last bin are counted in it
+    BOOST_CHECK(json.find("\"semi_lengths\":[0,0,0,0,0,0,0,0,0,0,"
+                          "0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1]")
+                != std::string::npos);
+
+    profile.Clear();
+    BOOST_CHECK(profile.ToJson().find("\"full_lengths\":[]")
+                != std::string::npos);
+}
+
+}
+
+//---------------------------------------------------------------------------
@@ -82,6 +82,37 @@ BOOST_AUTO_TEST_CASE(ZobristHash_InitializationAndUpdates)
     BOOST_CHECK_EQUAL(h1, zh1.Hash());
 }
 
+BOOST_AUTO_TEST_CASE(ZobristHash_Rotated)
+{
+    // 3x2 board: a1 <-> c2, b1 <-> b2, c1 <-> a2
+    ZobristHash zh(3, 2);
+    BOOST_CHECK_EQUAL(zh.Hash(), zh.RotatedHash());
+    zh.Update(BLACK, HEX_CELL_A1);
+    zh.Update(WHITE, HEX_CELL_B1);
+    zh.Update(BLACK, NORTH);
+    zh.Update(WHITE, EAST);
+    ZobristHash rotated(3, 2);
+    rotated.Update(BLACK, HEX_CELL_C2);
+    rotated.Update(WHITE, HEX_CELL_B2);
+    rotated.Update(BLACK, SOUTH);
+    rotated.Update(WHITE, WEST);
+    BOOST_CHECK_EQUAL(zh.RotatedHash(), rotated.Hash());
+    BOOST_CHECK_EQUAL(zh.Hash(), rotated.RotatedHash());
+    BOOST_CHECK_EQUAL(zh.RotatedHash(BLACK), rotated.Hash(BLACK));
+    BOOST_CHECK(zh.Hash() != zh.RotatedHash());
+
+    // Compute() agrees with Update()
+    bitset_t black, white;
+    black.set(HEX_CELL_A1);
+    black.set(NORTH);
+    white.set(HEX_CELL_B1);
+    white.set(EAST);
+    ZobristHash computed(3, 2);
+    computed.Compute(black, white);
+    BOOST_CHECK_EQUAL(computed.Hash(), zh.Hash());
+    BOOST_CHECK_EQUAL(computed.RotatedHash(), zh.RotatedHash());
+}
+
 }
 
 //---------------------------------------------------------------------------
@@ -137,6 +137,10 @@ void DfpnCommands::CmdParam(HtpCommand& cmd)
             << m_solver.Threads() << '\n'
             << "[string] thread_work "
             << m_solver.ThreadWork() << '\n'
+            << "[bool] work_stealing "
+            << m_solver.WorkStealing() << '\n'
+            << "[string] split_depth "
+            << m_solver.SplitDepth() << '\n'
             << "[string] db_bak_filename "
             << m_solver.DbBakFilename() << '\n'
             << "[string] db_bak_start "
@@ -189,6 +193,10 @@ void DfpnCommands::CmdParam(HtpCommand& cmd)
             m_solver.SetThreads(cmd.ArgMinMax<int>(1, 1, DFPN_MAX_THREADS));
         else if (name == "thread_work")
             m_solver.SetThreadWork(cmd.ArgMin<size_t>(1, 1));
+        else if (name == "work_stealing")
+            m_solver.SetWorkStealing(cmd.Arg<bool>(1));
+        else if (name == "split_depth")
+            m_solver.SetSplitDepth(cmd.ArgMin<int>(1, 1));
         else if (name == "db_bak_filename")
             m_solver.SetDbBakFilename(cmd.Arg(1));
         else if (name == "db_bak_start")
@@ -370,14 +378,25 @@ void DfpnCommands::CmdGetPV(HtpCommand& cmd)
 }
 
 /** Opens a database. 
-    Usage: "db-open [filename]"
+    Usage: "db-open [filename] [bdb|mapped]"
+    An existing database is opened with the backend it was created
+    with; the second argument picks the backend of a new one. 
 */
 void DfpnCommands::CmdOpenDB(HtpCommand& cmd)
 {
     cmd.CheckNuArgLessEqual(3);
     std::string filename = cmd.Arg(0);
+    HashDBBackend backend = HASHDB_BERKELEY;
+    if (cmd.NuArg() >= 2)
+    {
+        std::string name = cmd.Arg(1);
+        if (name == "mapped")
+            backend = HASHDB_MAPPED;
+        else if (name != "bdb")
+            throw HtpFailure() << "Unknown backend: " << name;
+    }
     try {
-        m_db.reset(new DfpnDB(filename));
+        m_db.reset(new DfpnDB(filename, backend));
     }
     catch (BenzeneException& e) {
         m_db.reset(0);
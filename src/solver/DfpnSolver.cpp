@@ -28,10 +28,48 @@ using std::ceil;
 
 //----------------------------------------------------------------------------
 
+namespace {
+
+/** Writes tt entries to a backup file. */
+class TtDumper
+{
+public:
+    TtDumper(ofstream& os, const string& filename, size_t& count)
+        : m_os(os),
+          m_filename(filename),
+          m_count(count)
+    { }
+
+    void operator()(const SgHashCode& code, const DfpnData& entry) const
+    {
+        SgHashCode k = code;
+        int size = entry.PackedSize();
+        boost::scoped_array<byte> data(new byte[size]);
+        entry.Pack(data.get());
+        m_os.write(reinterpret_cast<const char *>(&k), sizeof(k));
+        m_os.write(reinterpret_cast<const char *>(data.get()), size);
+        if (m_os.bad())
+            throw BenzeneException() << "Error writing to file '"
+                                     << m_filename << "'\n";
+        m_count++;
+    }
+
+private:
+    ofstream& m_os;
+
+    const string& m_filename;
+
+    size_t& m_count;
+};
+
+} // namespace
+
+//----------------------------------------------------------------------------
+
 /** Current version of the dfpn database.
     Update this if DfpnData changes to prevent old out-of-date
     databases from being loaded. */
-const std::string DfpnDB::DFPN_DB_VERSION("BENZENE_DFPN_DB_VER_0003");
+const std::string DfpnDB::DFPN_DB_VERSION("BENZENE_DFPN_DB_VER_0004");
 
 //----------------------------------------------------------------------------
 
@@ -55,68 +93,113 @@ void DfpnBounds::CheckConsistency() const
 
 //----------------------------------------------------------------------------
 
+VirtualBoundsTT::Lock::Lock(const Bucket& bucket)
+    : m_bucket(bucket)
+{
+    int spins = 0;
+    while (m_bucket.m_lock.test_and_set(std::memory_order_acquire))
+        if (++spins % 64 == 0)
+            boost::this_thread::yield();
+}
+
+VirtualBoundsTT::Lock::~Lock()
+{
+    m_bucket.m_lock.clear(std::memory_order_release);
+}
+
+VirtualBoundsTT::VirtualBoundsTT()
+    : m_buckets(new Bucket[NUM_BUCKETS])
+{
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+        m_buckets[i].m_lock.clear();
+    Clear();
+}
+
+void VirtualBoundsTT::Clear()
+{
+    for (int i = 0; i < NUM_BUCKETS; ++i)
+        for (int j = 0; j < BLOCK_SIZE; ++j)
+            m_buckets[i].m_entry[j].workers.reset();
+    m_dropped.store(0);
+}
+
+VirtualBoundsTT::Bucket& VirtualBoundsTT::GetBucket(size_t depth,
+                                                    SgHashCode hash) const
+{
+    std::size_t key = hash.Code1() + depth * 0x9e3779b9u;
+    return m_buckets[key & (NUM_BUCKETS - 1)];
+}
+
+VirtualBoundsTT::Entry* VirtualBoundsTT::Find(Bucket& bucket, size_t depth,
+                                              SgHashCode hash)
+{
+    for (int i = 0; i < BLOCK_SIZE; ++i)
+    {
+        Entry& entry = bucket.m_entry[i];
+        if (entry.workers.any() && entry.hash == hash && entry.depth == depth)
+            return &entry;
+    }
+    return 0;
+}
+
 void VirtualBoundsTT::Store(int id, size_t depth, SgHashCode hash,
                             const DfpnBounds& bounds)
 {
-    if (depth >= data.size())
-        data.resize(depth + 1);
-    else
+    Bucket& bucket = GetBucket(depth, hash);
+    Lock lock(bucket);
+    Entry* entry = Find(bucket, depth, hash);
+    for (int i = 0; !entry && i < BLOCK_SIZE; ++i)
+        if (bucket.m_entry[i].workers.none())
+        {
+            entry = &bucket.m_entry[i];
+            entry->hash = hash;
+            entry->depth = depth;
+        }
+    if (!entry)
     {
-        std::vector<Entry>& level = data[depth];
-        for (size_t i = 0; i < level.size(); ++i)
-            if (level[i].hash == hash)
-            {
-                level[i].workers.set(id);
-                level[i].bounds = bounds;
-                return;
-            }
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
     }
-    Entry entry;
-    entry.hash = hash;
-    entry.workers.set(id);
-    entry.bounds = bounds;
-    data[depth].push_back(entry);
+    entry->workers.set(id);
+    entry->bounds = bounds;
 }
 
 void VirtualBoundsTT::Lookup(size_t depth, SgHashCode hash,
-                             DfpnBounds& bounds)
+                             DfpnBounds& bounds) const
 {
-    if (depth >= data.size())
-        return;
-    const std::vector<Entry>& level = data[depth];
-    for (size_t i = 0; i < level.size(); ++i)
-        if (level[i].hash == hash)
-        {
-            bounds = level[i].bounds;
-            return;
-        }
+    Bucket& bucket = GetBucket(depth, hash);
+    Lock lock(bucket);
+    const Entry* entry = Find(bucket, depth, hash);
+    if (entry)
+        bounds = entry->bounds;
 }
 
 void VirtualBoundsTT::Remove(int id, size_t depth, SgHashCode hash,
-                             const DfpnBounds& bounds, bool solved, bool *path_solved)
+                             const DfpnBounds& bounds, bool solved,
+                             std::atomic<bool>* path_solved)
 {
-    std::vector<Entry>& level = data[depth];
-    for (size_t i = 0; i < level.size(); ++i)
-        if (level[i].hash == hash)
-        {
-            level[i].workers.reset(id);
-            if (level[i].workers.none())
-            {
-                level[i] = level.back();
-                level.pop_back();
-            }
-            else
-            {
-                level[i].bounds = bounds;
-                if (solved)
-                {
-                    for (int tid = 0; tid < DFPN_MAX_THREADS; tid++)
-                        if (level[i].workers[tid])
-                            path_solved[tid] = true;
-                }
-            }
-            return;
-        }
+    Bucket& bucket = GetBucket(depth, hash);
+    Lock lock(bucket);
+    Entry* entry = Find(bucket, depth, hash);
+    if (!entry)
+        return;
+    entry->workers.reset(id);
+    if (entry->workers.none())
+        return;
+    entry->bounds = bounds;
+    if (solved)
+        for (int tid = 0; tid < DFPN_MAX_THREADS; tid++)
+            if (entry->workers[tid])
+                path_solved[tid] = true;
+}
+
+void VirtualBoundsTT::Release(int id, size_t depth, SgHashCode hash)
+{
+    Bucket& bucket = GetBucket(depth, hash);
+    Lock lock(bucket);
+    Entry* entry = Find(bucket, depth, hash);
+    if (entry)
+        entry->workers.reset(id);
 }
 
 //----------------------------------------------------------------------------
@@ -153,11 +236,61 @@ std::size_t DfpnChildren::MoveIndex(HexPoint x) const
 template <class T>
 const DfpnBounds DfpnChildren::GetBounds(
 			   size_t i,
-			   const std::vector<T> childrenBounds) const
+			   const std::vector<T>& childrenBounds) const
 {
     return childrenBounds[i].GetBounds(FirstMove(i));
 }
 
+int DfpnChildren::PackedSize() const
+{
+    const std::size_t size = sizeof(m_fillin[BLACK])
+        + sizeof(m_fillin[WHITE])
+        + sizeof(short) * (m_children.size() + 1);
+    return static_cast<int>(size);
+}
+
+byte* DfpnChildren::Pack(byte* data) const
+{
+    *reinterpret_cast<bitset_t*>(data) = m_fillin[BLACK];
+    data += sizeof(m_fillin[BLACK]);
+    *reinterpret_cast<bitset_t*>(data) = m_fillin[WHITE];
+    data += sizeof(m_fillin[WHITE]);
+    *reinterpret_cast<short*>(data) = static_cast<short>(m_children.size());
+    data += sizeof(short);
+    for (std::size_t i = 0; i < m_children.size(); ++i)
+    {
+        *reinterpret_cast<short*>(data) = static_cast<short>(m_children[i]);
+        data += sizeof(short);
+    }
+    return data;
+}
+
+const byte* DfpnChildren::Unpack(const byte* data)
+{
+    m_fillin[BLACK] = *reinterpret_cast<const bitset_t*>(data);
+    data += sizeof(m_fillin[BLACK]);
+    m_fillin[WHITE] = *reinterpret_cast<const bitset_t*>(data);
+    data += sizeof(m_fillin[WHITE]);
+    const short size = *reinterpret_cast<const short*>(data);
+    data += sizeof(short);
+    m_children.resize(size);
+    for (short i = 0; i < size; ++i)
+    {
+        short s = *reinterpret_cast<const short*>(data);
+        data += sizeof(short);
+        m_children[i] = static_cast<HexPoint>(s);
+    }
+    return data;
+}
+
+void DfpnChildren::Rotate(const ConstBoard& brd)
+{
+    for (std::size_t i = 0; i < m_children.size(); ++i)
+        m_children[i] = BoardUtil::Rotate(brd, m_children[i]);
+    for (BWIterator c; c; ++c)
+        m_fillin[*c] = BoardUtil::Rotate(brd, m_fillin[*c]);
+}
+
 //----------------------------------------------------------------------------
 
 /** @page dfpnguifx Dfpn Progress Indication
@@ -186,7 +319,7 @@ void DfpnSolver::GuiFx::ClearChildren()
 }
 
 void DfpnSolver::GuiFx::SetChildren(const DfpnChildren& children,
-                                    const std::vector<DfpnData>& data)
+                                    const std::vector<DfpnEntry>& data)
 {
     boost::lock_guard<boost::mutex> lock(m_mutex);
     m_children = children;
@@ -194,7 +327,7 @@ void DfpnSolver::GuiFx::SetChildren(const DfpnChildren& children,
 }
 
 void DfpnSolver::GuiFx::SetChildrenOnce(const DfpnChildren& children,
-                                        const std::vector<DfpnData>& data)
+                                        const std::vector<DfpnEntry>& data)
 {
     boost::lock_guard<boost::mutex> lock(m_mutex);
     if (m_data.empty())
@@ -346,27 +479,27 @@ void DfpnSolver::GuiFx::DoWrite()
 
 //----------------------------------------------------------------------------
 
-const DfpnBounds& DfpnData::GetBounds(HexPoint lastMove) const
+const DfpnBounds& DfpnEntry::GetBounds(HexPoint lastMove) const
 {
     if (IsReversible(lastMove))
         return m_reversibleBounds;
     return m_bounds;
 }
 
+//----------------------------------------------------------------------------
+
 int DfpnData::PackedSize() const
 {
-    return sizeof(m_bounds)
+    const std::size_t size = sizeof(m_bounds)
         + sizeof(m_bestMove)
-        + sizeof(m_fillin[BLACK])
-        + sizeof(m_fillin[WHITE])
         + sizeof(m_reversible)
         + (m_reversible ? 
 	   sizeof(m_reverser)
 	   + sizeof(m_reversibleBounds)
 	   : 0)
         + sizeof(m_work)
-        + sizeof(m_evaluationScore)
-        + sizeof(short) * (m_children.Size() + 1);
+        + sizeof(m_evaluationScore);
+    return static_cast<int>(size) + m_children.PackedSize();
 }
 
 void DfpnData::Pack(byte* data) const
@@ -376,10 +509,6 @@ void DfpnData::Pack(byte* data) const
     off += sizeof(m_bounds);
     *reinterpret_cast<HexPoint*>(off) = m_bestMove;
     off += sizeof(m_bestMove);
-    *reinterpret_cast<bitset_t*>(off) = m_fillin[BLACK];
-    off += sizeof(m_fillin[BLACK]);
-    *reinterpret_cast<bitset_t*>(off) = m_fillin[WHITE];
-    off += sizeof(m_fillin[WHITE]);
     *reinterpret_cast<HexPoint*>(off) = m_reversible;
     off += sizeof(m_reversible);
     if (m_reversible)
@@ -393,14 +522,7 @@ void DfpnData::Pack(byte* data) const
     off += sizeof(m_work);
     *reinterpret_cast<float*>(off) = m_evaluationScore;
     off += sizeof(m_evaluationScore);
-    const std::vector<HexPoint>& moves = m_children.m_children;
-    for (std::size_t i = 0; i < moves.size(); ++i)
-    {
-        *reinterpret_cast<short*>(off) = static_cast<short>(moves[i]);
-        off += sizeof(short);
-    }
-    *reinterpret_cast<short*>(off) = static_cast<short>(INVALID_POINT);
-    off += sizeof(short);
+    off = m_children.Pack(off);
     if (off - data != PackedSize())
         throw BenzeneException("Bad size!");
 }
@@ -411,10 +533,6 @@ void DfpnData::Unpack(const byte* data)
     data += sizeof(m_bounds);
     m_bestMove = *reinterpret_cast<const HexPoint*>(data);
     data += sizeof(m_bestMove);
-    m_fillin[BLACK] = *reinterpret_cast<const bitset_t*>(data);
-    data += sizeof(m_fillin[BLACK]);
-    m_fillin[WHITE] = *reinterpret_cast<const bitset_t*>(data);
-    data += sizeof(m_fillin[WHITE]);
     m_reversible = *reinterpret_cast<const HexPoint*>(data);
     data += sizeof(m_reversible);
     if (m_reversible)
@@ -428,30 +546,18 @@ void DfpnData::Unpack(const byte* data)
     data += sizeof(m_work);
     m_evaluationScore = *reinterpret_cast<const float*>(data);
     data += sizeof(m_evaluationScore);
-    std::vector<HexPoint> moves;
-    while (true)
-    {
-        short s = *reinterpret_cast<const short*>(data);
-        data += sizeof(short);
-        HexPoint p = static_cast<HexPoint>(s);
-        if (p == INVALID_POINT)
-            break;
-        moves.push_back(p);
-    }
-    m_children.SetChildren(moves);
+    m_children.Unpack(data);
     Validate();
 }
 
 void DfpnData::Rotate(const ConstBoard& brd)
 {
-    std::vector<HexPoint>& moves = m_children.m_children;
-    for (std::size_t i = 0; i < moves.size(); ++i)
-        moves[i] = BoardUtil::Rotate(brd, moves[i]);
+    m_children.Rotate(brd);
     m_bestMove = BoardUtil::Rotate(brd, m_bestMove);
-    for (BWIterator c; c; ++c)
-        m_fillin[*c] = BoardUtil::Rotate(brd, m_fillin[*c]);
     m_reversible = BoardUtil::Rotate(brd, m_reversible);
-    m_reverser = BoardUtil::Rotate(brd, m_reverser);
+    // m_reverser is not packed, and so not set, if not reversible
+    if (m_reversible)
+        m_reverser = BoardUtil::Rotate(brd, m_reverser);
 }
 
 bool DfpnData::ReplaceBy(const DfpnData& data) const
@@ -475,6 +581,8 @@ DfpnSolver::DfpnSolver()
       m_epsilon(0.0f),
       m_threads(1),
       m_threadWork(1000),
+      m_workStealing(false),
+      m_splitDepth(4),
       m_db_bak_filename("db.dump"),
       m_db_bak_start(date(2012,2,11),hours(3)),
       m_db_bak_period(hours(-48)),
@@ -487,6 +595,7 @@ DfpnSolver::DfpnSolver()
       m_winningEvaluation(-2.5, 2.0, 45),
       m_losingEvaluation(-2.5, 2.0, 45)
 {
+    m_taskQueues.reset(new TaskQueue[DFPN_MAX_THREADS]);
 }
 
 DfpnSolver::~DfpnSolver()
@@ -510,6 +619,8 @@ void DfpnSolver::PrintStatistics(HexColor winner,
        << double(m_numMIDcalls) / m_timer.GetTime() << '\n'
        << SgWriteLabel("VCs/sec")
        << double(m_numVCbuilds) / m_timer.GetTime() << '\n';
+    if (m_vtt.NuDropped())
+        os << SgWriteLabel("VTT Dropped") << m_vtt.NuDropped() << '\n';
     os << '\n' << SgWriteLabel("Consider Size");
     m_considerSetSize.Write(os);
     os << '\n' << SgWriteLabel("Move Index");
@@ -564,7 +675,10 @@ public:
 
     void operator()()
     {
-        solver.RunThread(id, maxBounds, state, board);
+        if (solver.WorkStealing())
+            solver.RunStealingThread(id, maxBounds, state, board);
+        else
+            solver.RunThread(id, maxBounds, state, board);
     }
 };
 
@@ -572,6 +686,10 @@ HexColor DfpnSolver::StartSearch(const HexState& state, HexBoard& board,
                                  DfpnStates& positions, PointSequence& pv,
                                  const DfpnBounds& maxBounds)
 {
+    // Partial connection sets weaken mustplays and proof sets, and
+    // with a time budget make them depend on timing
+    if (board.VCBuilderParameters().IsBudgeted())
+        throw BenzeneException("Dfpn: VC builds must not be budgeted!\n");
     m_aborted = false;
     m_positions = &positions;
     m_numTerminal = 0;
@@ -607,6 +725,15 @@ HexColor DfpnSolver::StartSearch(const HexState& state, HexBoard& board,
         m_guiFx.ClearChildren();
         m_guiFx.SetFirstPlayer(state.ToPlay());
     }
+    m_vtt.Clear();
+    m_freePathIds.clear();
+    for (int i = DFPN_MAX_THREADS - 1; i >= 0; --i)
+    {
+        m_path_solved[i] = false;
+        m_taskQueues[i].m_tasks.clear();
+        m_freePathIds.push_back(i);
+    }
+    m_stealEpoch = 0;
     boost::scoped_array<boost::thread> threads(new boost::thread[m_threads]);
     TryDoBackups(true); // only adjust start time for next backup
     for (int i = 0; i < m_threads; i++)
@@ -708,15 +835,22 @@ size_t DfpnSolver::TopMid(const DfpnBounds& maxBounds,
     DfpnBounds& bounds =
       (isReversible ? data.m_reversibleBounds : data.m_bounds);
 
-    if (data.m_work < m_threadWork &&
-        (depth != 0 || (data.m_work == 0)))
+    if ((data.m_work < m_threadWork &&
+         (depth != 0 || (data.m_work == 0)))
+        || (m_workStealing && depth >= size_t(m_splitDepth)))
     {
         if (vBounds.phi <= vBounds.delta || claimedWin)
             DfpnBounds::SetToWinning(vBounds);
         else
             DfpnBounds::SetToLosing(vBounds);
-        m_thread_path_solved[*m_thread_id] = false;
-        StoreVBounds(*m_thread_id, depth, &d);
+        m_path_solved[*m_path_id] = false;
+        StoreVBounds(*m_path_id, depth, &d);
+        if (m_workStealing)
+        {
+            PushTask(maxBounds, depth == 0 ? 1 : m_threadWork);
+            midCalled = true;
+            return 0;
+        }
         m_topmid_mutex.unlock();
 	{
             std::vector<std::pair<HexPoint, DfpnBounds> > pv;
@@ -749,8 +883,8 @@ size_t DfpnSolver::TopMid(const DfpnBounds& maxBounds,
         m_topmid_mutex.lock();
         vBounds = bounds;
         DBWrite(*m_state, data);
-        m_vtt.Remove(*m_thread_id, depth, d.hash, bounds,
-                     bounds.IsSolved(), m_thread_path_solved);
+        m_vtt.Remove(*m_path_id, depth, d.hash, bounds,
+                     bounds.IsSolved(), m_path_solved);
         return work;
     }
     BenzeneAssert(data.IsValid());
@@ -768,6 +902,7 @@ size_t DfpnSolver::TopMid(const DfpnBounds& maxBounds,
         if (first || midCalled)
         {
             LookupChildrenDB(d.childrenData, data.m_children);
+            d.expanded.Reset(data.m_children.Size());
             LookupChildren(depth + 1, d.virtualBounds,
                         d.childrenData, data.m_children);
             first = false;
@@ -851,8 +986,15 @@ size_t DfpnSolver::TopMid(const DfpnBounds& maxBounds,
 	
 	data.m_children.PlayMove(d.bestIndex, *m_state);
         m_history->Push(data.m_bestMove, d.hash);
-        work += TopMid(childMaxBounds, d.childrenData[d.bestIndex],
+        DfpnData* childData = d.expanded.Find(d.bestIndex);
+        if (!childData)
+        {
+            childData = &d.expanded.Add(d.bestIndex);
+            DBRead(*m_state, *childData);
+        }
+        work += TopMid(childMaxBounds, *childData,
                        d.virtualBounds[d.bestIndex], &d, midCalled);
+        d.childrenData[d.bestIndex] = *childData;
         m_history->Pop();
         data.m_children.UndoMove(d.bestIndex, *m_state);
 
@@ -866,9 +1008,11 @@ size_t DfpnSolver::TopMid(const DfpnBounds& maxBounds,
     if (bounds.IsSolved())
         NotifyListeners(*m_history, data);
     DBWrite(*m_state, data);
-    if (midCalled)
-        m_vtt.Remove(*m_thread_id, depth, d.hash, vBounds,
-                     bounds.IsSolved(), m_thread_path_solved);
+    // With work stealing, the path keeps its virtual bounds until
+    // its task is done; see RunTask()
+    if (midCalled && !m_workStealing)
+        m_vtt.Remove(*m_path_id, depth, d.hash, vBounds,
+                     bounds.IsSolved(), m_path_solved);
     if (m_useGuiFx && depth == 1)
         m_guiFx.UpdateBounds(m_history->LastMove(), bounds);
     return work;
@@ -881,6 +1025,7 @@ void DfpnSolver::RunThread(int id, const DfpnBounds& maxBounds,
     m_workBoard.reset(new HexBoard(board));
     m_history.reset(new DfpnHistory());
     m_thread_id.reset(new int(id));
+    m_path_id.reset(new int(id));
 
     DfpnData data;
     DfpnBounds vBounds;
@@ -918,6 +1063,174 @@ void DfpnSolver::RunThread(int id, const DfpnBounds& maxBounds,
     m_nothingToSearch_cond.notify_all();
 }
 
+void DfpnSolver::RunStealingThread(int id, const DfpnBounds& maxBounds,
+                                   const HexState& state, HexBoard& board)
+{
+    m_state.reset(new HexState(state));
+    m_workBoard.reset(new HexBoard(board));
+    m_history.reset(new DfpnHistory());
+    m_thread_id.reset(new int(id));
+    m_path_id.reset(new int(-1));
+
+    while (!CheckAbort())
+    {
+        TryDoBackups();
+
+        DfpnTask task;
+        if (PopTask(id, task) || StealTask(id, task))
+        {
+            RunTask(task, state);
+            continue;
+        }
+        size_t epoch = StealEpoch();
+        DfpnData data;
+        DBRead(state, data);
+        if (!maxBounds.GreaterThan(data.m_bounds))
+            break;
+        // Queue a task for this thread and, if there is another
+        // thread to steal it, a second one
+        bool midCalled = false;
+        for (int i = 0; i < (m_threads > 1 ? 2 : 1); ++i)
+        {
+            int pathId = AcquirePathId();
+            if (pathId < 0)
+                break;
+            *m_path_id = pathId;
+            *m_state = state;
+            m_history.reset(new DfpnHistory());
+            DBRead(*m_state, data);
+            DfpnBounds vBounds = data.m_bounds;
+            m_vtt.Lookup(0, m_state->Hash(), vBounds);
+            bool queued = false;
+            TopMid(maxBounds, data, vBounds, nullptr, queued);
+            if (!queued)
+            {
+                ReleasePathId(pathId);
+                break;
+            }
+            midCalled = true;
+        }
+        if (midCalled)
+            NextStealEpoch();
+        else if (maxBounds.GreaterThan(data.m_bounds))
+            // Every state worth searching is taken; wait until a task
+            // is done or queued
+            WaitForStealEpoch(epoch);
+    }
+    NextStealEpoch();
+}
+
+void DfpnSolver::PushTask(const DfpnBounds& maxBounds, size_t workBound)
+{
+    DfpnTask task;
+    task.path = m_history->Moves();
+    task.maxBounds = maxBounds;
+    task.workBound = workBound;
+    task.pathId = *m_path_id;
+    TaskQueue& queue = m_taskQueues[*m_thread_id];
+    boost::lock_guard<boost::mutex> lock(queue.m_mutex);
+    queue.m_tasks.push_back(task);
+}
+
+bool DfpnSolver::PopTask(int id, DfpnTask& task)
+{
+    TaskQueue& queue = m_taskQueues[id];
+    boost::lock_guard<boost::mutex> lock(queue.m_mutex);
+    if (queue.m_tasks.empty())
+        return false;
+    task = queue.m_tasks.back();
+    queue.m_tasks.pop_back();
+    return true;
+}
+
+bool DfpnSolver::StealTask(int id, DfpnTask& task)
+{
+    // Take the oldest task, which is the nearest to the root
+    for (int i = 1; i < m_threads; ++i)
+    {
+        TaskQueue& queue = m_taskQueues[(id + i) % m_threads];
+        boost::lock_guard<boost::mutex> lock(queue.m_mutex);
+        if (queue.m_tasks.empty())
+            continue;
+        task = queue.m_tasks.front();
+        queue.m_tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void DfpnSolver::RunTask(const DfpnTask& task, const HexState& root)
+{
+    *m_path_id = task.pathId;
+    *m_state = root;
+    m_history.reset(new DfpnHistory());
+    std::vector<SgHashCode> hashes;
+    DfpnData parentData;
+    for (size_t i = 0; i < task.path.size(); ++i)
+    {
+        hashes.push_back(m_state->Hash());
+        if (i + 1 == task.path.size())
+            DBRead(*m_state, parentData);
+        m_history->Push(task.path[i], m_state->Hash());
+        m_state->PlayMove(task.path[i]);
+    }
+    DfpnData data;
+    DBRead(*m_state, data);
+    if (task.path.empty())
+        MID(task.maxBounds, task.workBound, data);
+    else
+        MID(task.maxBounds, task.workBound, data, parentData);
+    DBWrite(*m_state, data);
+    const DfpnBounds& bounds = data.IsReversible(m_history->LastMove())
+        ? data.m_reversibleBounds : data.m_bounds;
+    m_vtt.Remove(task.pathId, task.path.size(), m_state->Hash(), bounds,
+                 bounds.IsSolved(), m_path_solved);
+    // The bounds of the ancestors are brought up to date by the next
+    // walk through them
+    for (size_t depth = 0; depth < hashes.size(); ++depth)
+        m_vtt.Release(task.pathId, depth, hashes[depth]);
+    ReleasePathId(task.pathId);
+    NextStealEpoch();
+}
+
+int DfpnSolver::AcquirePathId()
+{
+    boost::lock_guard<boost::mutex> lock(m_steal_mutex);
+    if (m_freePathIds.empty())
+        return -1;
+    int pathId = m_freePathIds.back();
+    m_freePathIds.pop_back();
+    return pathId;
+}
+
+void DfpnSolver::ReleasePathId(int pathId)
+{
+    boost::lock_guard<boost::mutex> lock(m_steal_mutex);
+    m_freePathIds.push_back(pathId);
+}
+
+size_t DfpnSolver::StealEpoch()
+{
+    boost::lock_guard<boost::mutex> lock(m_steal_mutex);
+    return m_stealEpoch;
+}
+
+void DfpnSolver::NextStealEpoch()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(m_steal_mutex);
+        ++m_stealEpoch;
+    }
+    m_nothingToSearch_cond.notify_all();
+}
+
+void DfpnSolver::WaitForStealEpoch(size_t epoch)
+{
+    boost::unique_lock<boost::mutex> lock(m_steal_mutex);
+    while (m_stealEpoch == epoch && !m_aborted)
+        m_nothingToSearch_cond.wait(lock);
+}
+
 // parentData can be DfpnData(), in which case no fillin optimisation
 // (making it incrementally) is performed but all works anyway.
 size_t DfpnSolver::CreateData(DfpnData& data, const DfpnData& parentData)
@@ -929,8 +1242,8 @@ size_t DfpnSolver::CreateData(DfpnData& data, const DfpnData& parentData)
     
     StoneBoard& brd = m_workBoard->GetPosition();
     brd.SetPosition(m_state->Position());
-    brd.AddColor(BLACK, parentData.m_fillin[BLACK]);
-    brd.AddColor(WHITE, parentData.m_fillin[WHITE]);
+    brd.AddColor(BLACK, parentData.m_children.Fillin(BLACK));
+    brd.AddColor(WHITE, parentData.m_children.Fillin(WHITE));
     data.m_reverser = m_workBoard->ComputeAll(colorToMove,
 					      m_history->LastMove(),
 					      false,
@@ -960,9 +1273,9 @@ size_t DfpnSolver::CreateData(DfpnData& data, const DfpnData& parentData)
     } 
 
     for (BWIterator c; c; ++c)
-        data.m_fillin[*c] =
-	  parentData.m_fillin[*c] |
-	  m_workBoard->GetInferiorCells().Fillin(*c);
+        data.m_children.SetFillin(*c,
+	  parentData.m_children.Fillin(*c) |
+	  m_workBoard->GetInferiorCells().Fillin(*c));
 
     bitset_t childrenBitset =
         EndgameUtil::MovesToConsider(*m_workBoard, colorToMove);
@@ -1002,7 +1315,7 @@ size_t DfpnSolver::CreateData(DfpnData& data, const DfpnData& parentData)
 }
 
 void DfpnSolver::UpdateStatsOnWin(const DfpnChildren& children,
-				  const std::vector<DfpnData>& childrenData,
+				  const std::vector<DfpnEntry>& childrenData,
                                   size_t bestIndex, size_t work)
 {
     if (!children.GetBounds(bestIndex,childrenData).IsLosing())
@@ -1014,7 +1327,7 @@ void DfpnSolver::UpdateStatsOnWin(const DfpnChildren& children,
 
 void DfpnSolver::UpdateSolvedBestMove(const DfpnBounds& bounds,
 				      DfpnData& data,
-                                      const std::vector<DfpnData>& childrenData)
+                                      const std::vector<DfpnEntry>& childrenData)
 {
     if (!bounds.IsSolved())
         return;
@@ -1093,8 +1406,10 @@ size_t DfpnSolver::MID(const DfpnBounds& maxBounds,
 
     ++m_numMIDcalls;
 
-    std::vector<DfpnData> childrenData(data.m_children.Size());
+    std::vector<DfpnEntry> childrenData(data.m_children.Size());
     LookupChildrenTT(childrenData, data.m_children);
+    DfpnExpandedChildren expanded;
+    expanded.Reset(data.m_children.Size());
 
     size_t bestIndex = data.m_children.MoveIndex(data.m_bestMove);
     size_t reverserIndex = data.m_children.MoveIndex(data.m_reverser);
@@ -1175,8 +1490,16 @@ size_t DfpnSolver::MID(const DfpnBounds& maxBounds,
 			            .GetBounds(INVALID_POINT));
         data.m_children.PlayMove(bestIndex, *m_state);
         m_history->Push(data.m_bestMove, currentHash);
+        // The child's children are read only now that it is searched
+        DfpnData* childData = expanded.Find(bestIndex);
+        if (!childData)
+        {
+            childData = &expanded.Add(bestIndex);
+            TTRead(*m_state, *childData);
+        }
 	size_t childWork = MID(childMaxBounds, workBound - work,
-                               childrenData[bestIndex], data);
+                               *childData, data);
+        childrenData[bestIndex] = *childData;
         work += childWork;
         data.m_work += childWork;
         m_history->Pop();
@@ -1188,7 +1511,7 @@ size_t DfpnSolver::MID(const DfpnBounds& maxBounds,
         UpdateStatsOnWin(data.m_children, childrenData,
 			 bestIndex, data.m_work + work);
 	
-    } while (!m_thread_path_solved[*m_thread_id] && !CheckAbort());
+    } while (!m_path_solved[*m_path_id] && !CheckAbort());
 
     if (m_useGuiFx && depth == 0)
         m_guiFx.WriteForced();
@@ -1410,32 +1733,39 @@ bool DfpnSolver::UpdateClaimedWinBounds(DfpnBounds& bounds,
     return true;
 }
 
-void DfpnSolver::LookupDataTT(DfpnData& data, const DfpnChildren& children, 
+void DfpnSolver::LookupDataTT(DfpnEntry& data, const DfpnChildren& children, 
 			      std::size_t childIndex, HexState& state)
 {
     children.PlayMove(childIndex, state);
-    TTReadNoLock(state, data);
+    if (m_positions->UseHashTable())
+        m_positions->HashTable()->LookupEntry(state.Hash(), &data);
     children.UndoMove(childIndex, state);
 }
 
-bool DfpnSolver::LookupDataDB(DfpnData& data, const DfpnChildren& children,
+bool DfpnSolver::LookupDataDB(DfpnEntry& data, const DfpnChildren& children,
                               std::size_t childIndex, HexState& state)
 {
     children.PlayMove(childIndex, state);
-    bool res = DBRead(state, data);
+    DfpnData dbData;
+    bool res;
+    {
+        boost::lock_guard<boost::mutex> lock(m_db_mutex);
+        res = m_positions->GetDB(state, dbData);
+    }
+    if (res)
+        data = dbData;
     children.UndoMove(childIndex, state);
     return res;
 }
 
-void DfpnSolver::LookupChildrenTT(std::vector<DfpnData>& childrenData,
+void DfpnSolver::LookupChildrenTT(std::vector<DfpnEntry>& childrenData,
                                 const DfpnChildren& children)
 {
-    boost::shared_lock<boost::shared_mutex> lock(m_tt_mutex);
     for (size_t i = 0; i < children.Size(); ++i)
         LookupDataTT(childrenData[i], children, i, *m_state);
 }
 
-void DfpnSolver::LookupChildrenDB(std::vector<DfpnData>& childrenData,
+void DfpnSolver::LookupChildrenDB(std::vector<DfpnEntry>& childrenData,
                                   const DfpnChildren& children)
 {
     std::vector<bool> dbRead(children.Size());
@@ -1447,7 +1777,6 @@ void DfpnSolver::LookupChildrenDB(std::vector<DfpnData>& childrenData,
     }
     if (allRead)
         return;
-    boost::shared_lock<boost::shared_mutex> lock(m_tt_mutex);
     for (size_t i = 0; i < children.Size(); ++i)
         if (!dbRead[i])
             LookupDataTT(childrenData[i], children, i, *m_state);
@@ -1455,7 +1784,7 @@ void DfpnSolver::LookupChildrenDB(std::vector<DfpnData>& childrenData,
 
 void DfpnSolver::LookupChildren(size_t depth,
                                 std::vector<DfpnBounds>& virtualBounds,
-                                const std::vector<DfpnData>& childrenData,
+                                const std::vector<DfpnEntry>& childrenData,
                                 const DfpnChildren& children)
 {
     for (size_t i = 0; i < children.Size(); ++i)
@@ -1467,36 +1796,23 @@ void DfpnSolver::LookupChildren(size_t depth,
     }
 }
 
-bool DfpnSolver::TTReadNoLock(const HexState& state, DfpnData& data)
-{
-    return m_positions->GetHT(state, data);
-}
-
 void DfpnSolver::TTWrite(const HexState& state, DfpnData& data)
 {
     data.m_bounds.CheckConsistency();
     data.m_reversibleBounds.CheckConsistency();
-    boost::upgrade_lock<boost::shared_mutex> lock(m_tt_mutex);
-    DfpnData prev;
-    bool hit = m_positions->GetHT(state, prev);
-    if (hit && prev.m_bounds.IsSolved())
-    {
-        data = prev;
-        return;
-    }
-    boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(lock);
-    m_positions->PutHT(state, data);
+    if (m_positions->UseHashTable())
+        m_positions->HashTable()->StoreUnlessSolved(state.Hash(), data);
 }
 
 bool DfpnSolver::TTRead(const HexState& state, DfpnData& data)
 {
-    boost::shared_lock<boost::shared_mutex> lock(m_tt_mutex);
-    return TTReadNoLock(state, data);
+    return m_positions->GetHT(state, data);
 }
 
 void DfpnSolver::DBWrite(const HexState& state, DfpnData& data)
 {
     TTWrite(state, data);
+    boost::lock_guard<boost::mutex> lock(m_db_mutex);
     DfpnData prev;
     bool hit = m_positions->GetDB(state, prev);
     if (hit && prev.m_bounds.IsSolved())
@@ -1509,8 +1825,11 @@ void DfpnSolver::DBWrite(const HexState& state, DfpnData& data)
 
 bool DfpnSolver::DBRead(const HexState& state, DfpnData& data)
 {
-    if (m_positions->GetDB(state, data))
-        return true;
+    {
+        boost::lock_guard<boost::mutex> lock(m_db_mutex);
+        if (m_positions->GetDB(state, data))
+            return true;
+    }
     return TTRead(state, data);
 }
 
@@ -1533,7 +1852,7 @@ void DfpnSolver::PropagateBackwards(const Game& game, DfpnStates& pos)
             break;
         if (data.m_bounds.IsSolved())
             break;
-        std::vector<DfpnData> childrenData(data.m_children.Size());
+        std::vector<DfpnEntry> childrenData(data.m_children.Size());
         for (size_t i = 0; i < data.m_children.Size(); ++i)
             LookupDataDB(childrenData[i], data.m_children, i, state);
         size_t maxChildIndex =
@@ -1577,7 +1896,7 @@ void DfpnSolver::DbRestore(DfpnStates& positions)
     positions.Database()->Restore(is);
 }
 
-void DfpnSolver::TtDump(DfpnStates& positions, bool locked)
+void DfpnSolver::TtDump(DfpnStates& positions)
 {
     SgTimer timer;
     timer.Start();
@@ -1585,32 +1904,12 @@ void DfpnSolver::TtDump(DfpnStates& positions, bool locked)
         throw BenzeneException("No tt used!\n");
     if (m_tt_bak_filename.empty())
         throw BenzeneException("Tt backup filename is empty!\n");
-    if (locked)
-        m_tt_mutex.unlock_shared();
     ofstream os(m_tt_bak_filename.c_str(), ios::out|ios::binary|ios::trunc);
     if (!os.is_open())
         throw BenzeneException() << "Error creating file '"
 				 << m_tt_bak_filename << "'\n";
     size_t count = 0;
-    if (locked)
-        m_tt_mutex.lock_shared();
-    for (DfpnHashTable::Iterator i(*positions.HashTable()); i; ++i)
-    {
-        SgHashCode k = i->m_hash;
-        int size = i->m_data.PackedSize();
-        boost::scoped_array<byte> data(new byte[size]);
-        i->m_data.Pack(data.get());
-        if (locked)
-            m_tt_mutex.unlock_shared();
-        os.write(reinterpret_cast<const char *>(&k), sizeof(k));
-        os.write(reinterpret_cast<const char *>(data.get()), size);
-        if (os.bad())
-            throw BenzeneException() << "Error writing to file '"
-				     << m_tt_bak_filename << "'\n";
-        count++;
-        if (locked)
-            m_tt_mutex.lock_shared();
-    }
+    positions.HashTable()->ForEach(TtDumper(os, m_tt_bak_filename, count));
     timer.Stop();
     LogDfpnThread()
         << "Tt dump: #entries=" << count
@@ -1734,10 +2033,7 @@ size_t DfpnSolver::AddNodeToTt(const SgNode* node, HexColor claimedWinner,
     
     DfpnData data;
     if (son)
-        // I don't know how locks work, but this part is always
-        // called with one single thread running so there should
-        // not be any problem.
-        TTReadNoLock(*m_state, data);
+        TTRead(*m_state, data);
     
     // If claimedWinner is to play, we add to the tt
     if (m_state->ToPlay() == claimedWinner && son)
@@ -1790,7 +2086,7 @@ void DfpnSolver::TryDoBackups(bool adjust_start)
                 backup = true;
                 m_db_bak_start += m_db_bak_period;
                 try {
-                    boost::lock_guard<boost::mutex> dblock(m_topmid_mutex);
+                    boost::lock_guard<boost::mutex> dblock(m_db_mutex);
                     BenzeneAssert(m_positions);
                     DbDump(*m_positions);
                 } catch (BenzeneException& e) {
@@ -1815,9 +2111,8 @@ void DfpnSolver::TryDoBackups(bool adjust_start)
                 backup = true;
                 m_tt_bak_start += m_tt_bak_period;
                 try {
-                    boost::shared_lock<boost::shared_mutex> lock(m_tt_mutex);
                     BenzeneAssert(m_positions);
-                    TtDump(*m_positions, true);
+                    TtDump(*m_positions);
                 } catch (BenzeneException& e) {
                     LogSevere() << "TtDump(): " << e.what();
                 }
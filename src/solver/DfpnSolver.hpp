@@ -7,7 +7,6 @@
 
 #include "SgSystem.h"
 #include "SgGameReader.h"
-#include "SgHashTable.h"
 #include "SgStatistics.h"
 #include "SgTimer.h"
 
@@ -15,10 +14,14 @@
 #include "HexBoard.hpp"
 #include "HexState.hpp"
 #include "Game.hpp"
+#include "ShardedHashTable.hpp"
 #include "StateDB.hpp"
 #include "SolverDB.hpp"
 
+#include <atomic>
+#include <deque>
 #include <limits>
+#include <boost/scoped_array.hpp>
 #include <boost/thread.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
@@ -183,29 +186,99 @@ inline std::ostream& operator<<(std::ostream& os, const DfpnBounds& bounds)
 static const int DFPN_MAX_THREADS = 64;
 
 /** Hash table for virtual bounds.
+
+    Holds the virtual bounds of the states on the paths the threads
+    are currently working below, keyed by depth and hash, with the set
+    of threads on each. Entries are kept in a fixed number of buckets
+    of BLOCK_SIZE entries; each bucket has its own spinlock, so any
+    thread can update the table at any time. An entry is free once no
+    thread is left on it. A store into a full bucket is dropped: the
+    state then just shows its real bounds, so threads may pick the
+    same child, but the search stays correct.
     @ingroup dfpn
  */
-class VirtualBoundsTT
+class VirtualBoundsTT : private boost::noncopyable
 {
 public:
+    VirtualBoundsTT();
+
+    /** Removes all entries. Must not be called while other threads
+        use the table. */
+    void Clear();
+
+    /** Adds thread id to the entry of the state and sets its
+        bounds. */
     void Store(int id, size_t depth, SgHashCode hash, const DfpnBounds& bounds);
-    void Lookup(size_t depth, SgHashCode hash, DfpnBounds& bounds);
+
+    /** Copies the bounds of the state into bounds if it has an
+        entry. */
+    void Lookup(size_t depth, SgHashCode hash, DfpnBounds& bounds) const;
+
+    /** Removes thread id from the entry of the state. If other
+        threads are left, sets its bounds, and if solved, sets
+        path_solved of those threads. */
     void Remove(int id, size_t depth, SgHashCode hash, const DfpnBounds& bounds,
-                bool solved, bool *path_solved);
+                bool solved, std::atomic<bool>* path_solved);
+
+    /** Removes thread id from the entry of the state and leaves its
+        bounds as they are. */
+    void Release(int id, size_t depth, SgHashCode hash);
+
+    /** Number of stores dropped because the bucket was full. */
+    std::size_t NuDropped() const;
+
 private:
+    static const int NUM_BUCKETS = 1024;
+
+    static const int BLOCK_SIZE = 8;
+
     struct Entry
     {
         SgHashCode hash;
+        size_t depth;
         std::bitset<DFPN_MAX_THREADS> workers;
         DfpnBounds bounds;
     };
 
-    std::vector<std::vector<Entry> > data;
+    struct Bucket
+    {
+        mutable std::atomic_flag m_lock;
+
+        Entry m_entry[BLOCK_SIZE];
+    };
+
+    /** Holds the spinlock of a bucket for its lifetime. */
+    class Lock
+    {
+    public:
+        explicit Lock(const Bucket& bucket);
+
+        ~Lock();
+
+    private:
+        const Bucket& m_bucket;
+    };
+
+    boost::scoped_array<Bucket> m_buckets;
+
+    std::atomic<std::size_t> m_dropped;
+
+    Bucket& GetBucket(size_t depth, SgHashCode hash) const;
+
+    static Entry* Find(Bucket& bucket, size_t depth, SgHashCode hash);
 };
 
+inline std::size_t VirtualBoundsTT::NuDropped() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
 //----------------------------------------------------------------------------
 
-/** Children of a dfpn state. 
+/** Children of a dfpn state and the fill-in they were computed with.
+    Computed once, when the state is expanded, and only needed while
+    the state itself is searched; kept out of DfpnEntry so that looking
+    up the children of a state does not copy their children.
     @ingroup dfpn
 */
 class DfpnChildren
@@ -231,13 +304,32 @@ public:
 
     template <class T>
     const DfpnBounds GetBounds(size_t i,
-			       const std::vector<T> childrenBounds) const; 
+			       const std::vector<T>& childrenBounds) const; 
+
+    /** Cells filled in for color in this state and its ancestors. */
+    const bitset_t& Fillin(HexColor color) const;
+
+    void SetFillin(HexColor color, const bitset_t& fillin);
+
+    /** @name Packing, used by DfpnData */
+    // @{
+
+    int PackedSize() const;
+
+    byte* Pack(byte* data) const;
+
+    const byte* Unpack(const byte* data);
+
+    void Rotate(const ConstBoard& brd);
+
+    // @}
 
 private:
-    friend class DfpnData;
     friend class DfpnSolver;
 
     std::vector<HexPoint> m_children;
+
+    bitset_t m_fillin[BLACK_AND_WHITE];
 };
 
 inline std::size_t DfpnChildren::Size() const
@@ -261,23 +353,35 @@ inline void DfpnChildren::AddChildBack(HexPoint x)
     m_children.push_back(x);
 }
 
+inline const bitset_t& DfpnChildren::Fillin(HexColor color) const
+{
+    return m_fillin[color];
+}
+
+inline void DfpnChildren::SetFillin(HexColor color, const bitset_t& fillin)
+{
+    m_fillin[color] = fillin;
+}
+
 //----------------------------------------------------------------------------
 
-/** State in DfpnHashTable.
-    Do not forget to update DFPN_DB_VERSION if this class changes in a
-    way that invalidiates old databases.  
+/** Fixed-size part of the data of a dfpn state.
+    This is what is read for every child of a state being searched,
+    so it holds no heap memory and is copied with memcpy. The children
+    of the state are stored beside it in DfpnHashTable and together
+    with it in DfpnData.
     @ingroup dfpn
  */
-class DfpnData
+class DfpnEntry
 {
 public:
     DfpnBounds m_bounds;
 
-    DfpnChildren m_children;
+    DfpnBounds m_reversibleBounds;
 
-    HexPoint m_bestMove;
+    size_t m_work;
 
-    bitset_t m_fillin[BLACK_AND_WHITE];
+    HexPoint m_bestMove;
 
     // When the node is created, a search for a reverser is performed.
     // If none is founds, then m_reversible = INVALID_POINT, and m_reverser
@@ -303,13 +407,10 @@ public:
     // but it is important not to add more data in the tt.
     HexPoint m_reversible;
     HexPoint m_reverser;
-    DfpnBounds m_reversibleBounds;
-    
-    size_t m_work;
 
     float m_evaluationScore;
 
-    DfpnData();
+    DfpnEntry();
 
     std::string Print() const;
 
@@ -328,50 +429,45 @@ public:
 
     void Invalidate();
     
-    bool IsBetterThan(const DfpnData& data) const;
-
-    // @}
-
-    /** @name PositionDBStateConcept */
-    // @{
-
-    int PackedSize() const;
-
-    void Pack(byte* data) const;
-
-    void Unpack(const byte* data);
-
-    void Rotate(const ConstBoard& brd);
-
-    bool ReplaceBy(const DfpnData& data) const;
+    bool IsBetterThan(const DfpnEntry& data) const;
 
     // @}
 
-private:
+protected:
   
     // This definition should not cause any problem as the last move
     // is never RESIGN.
     static const HexPoint ALL = RESIGN;
   
     bool m_isValid;
-};
 
+    /** Prints the entry; also the number of children and fill-in
+        cells if children is not null. */
+    std::string Print(const DfpnChildren* children) const;
+};
 
-inline DfpnData::DfpnData()
+inline DfpnEntry::DfpnEntry()
     : m_work(0),
       m_isValid(false)
 {
 }     
 
-inline std::string DfpnData::Print() const
+inline std::string DfpnEntry::Print() const
+{
+    return Print(0);
+}
+
+inline std::string DfpnEntry::Print(const DfpnChildren* children) const
 {
     std::ostringstream os;
     os << '[' 
-       << "bounds=" << m_bounds << ' '
-       << "children=" << m_children.Size() << ' '
-       << "bestmove=" << m_bestMove << ' '
-       << "fillin=" << m_fillin[BLACK].count() << '/'
-                    << m_fillin[WHITE].count() << ' ';
+       << "bounds=" << m_bounds << ' ';
+    if (children)
+        os << "children=" << children->Size() << ' ';
+    os << "bestmove=" << m_bestMove << ' ';
+    if (children)
+        os << "fillin=" << children->Fillin(BLACK).count() << '/'
+           << children->Fillin(WHITE).count() << ' ';
     if (m_reversible)
     {
       if (ClaimedWin())
@@ -387,13 +483,13 @@ inline std::string DfpnData::Print() const
     return os.str();
 }
 
-inline bool DfpnData::IsReversible(HexPoint lastMove) const
+inline bool DfpnEntry::IsReversible(HexPoint lastMove) const
 {
     return m_reversible &&
       (lastMove == m_reversible || m_reversible == ALL);
 }
 
-inline void DfpnData::ClaimWin(bool enable)
+inline void DfpnEntry::ClaimWin(bool enable)
 {
     if (enable)
         m_reversible = ALL;
@@ -401,31 +497,86 @@ inline void DfpnData::ClaimWin(bool enable)
         m_reversible = INVALID_POINT;
 }
 
-inline bool DfpnData::ClaimedWin() const
+inline bool DfpnEntry::ClaimedWin() const
 {
     return m_reversible == ALL;
 }
 
-inline bool DfpnData::IsBetterThan(const DfpnData& data) const
+inline bool DfpnEntry::IsBetterThan(const DfpnEntry& data) const
 {
     return m_work > data.m_work;
 }
 
-inline bool DfpnData::IsValid() const
+inline bool DfpnEntry::IsValid() const
 {
     return m_isValid;
 }
 
-inline void DfpnData::Validate()
+inline void DfpnEntry::Validate()
 {
     m_isValid = true;
 }
 
-inline void DfpnData::Invalidate()
+inline void DfpnEntry::Invalidate()
 {
     m_isValid = false;
 }
 
+/** Extends global output operator for DfpnEntry. */
+inline std::ostream& operator<<(std::ostream& os, const DfpnEntry& data)
+{
+    os << data.Print();
+    return os;
+}
+
+//----------------------------------------------------------------------------
+
+/** All data of a dfpn state: its DfpnEntry and its children.
+    Do not forget to update DFPN_DB_VERSION if this class changes in a
+    way that invalidiates old databases.  
+    @ingroup dfpn
+ */
+class DfpnData : public DfpnEntry
+{
+public:
+    DfpnChildren m_children;
+
+    DfpnData();
+
+    explicit DfpnData(const DfpnEntry& entry);
+
+    std::string Print() const;
+
+    /** @name PositionDBStateConcept */
+    // @{
+
+    int PackedSize() const;
+
+    void Pack(byte* data) const;
+
+    void Unpack(const byte* data);
+
+    void Rotate(const ConstBoard& brd);
+
+    bool ReplaceBy(const DfpnData& data) const;
+
+    // @}
+};
+
+inline DfpnData::DfpnData()
+{
+}
+
+inline DfpnData::DfpnData(const DfpnEntry& entry)
+    : DfpnEntry(entry)
+{
+}
+
+inline std::string DfpnData::Print() const
+{
+    return DfpnEntry::Print(&m_children);
+}
+
 /** Extends global output operator for DfpnData. */
 inline std::ostream& operator<<(std::ostream& os, const DfpnData& data)
 {
@@ -435,6 +586,63 @@ inline std::ostream& operator<<(std::ostream& os, const DfpnData& data)
 
 //----------------------------------------------------------------------------
 
+/** Full data of the children that a search frame has descended into.
+    The frame keeps the hot DfpnEntry of every child for selection,
+    but the tt may evict a child at any time, so the data of each
+    child searched from the frame is kept here. The tt and db are
+    read only on the first descent into a child.
+    @ingroup dfpn
+*/
+class DfpnExpandedChildren
+{
+public:
+    DfpnExpandedChildren();
+
+    /** Forgets all children; the frame has numChildren children. */
+    void Reset(std::size_t numChildren);
+
+    /** Data of child i, or null if the frame has not descended into
+        it. */
+    DfpnData* Find(std::size_t i);
+
+    /** Adds invalid data for child i and returns it. The reference
+        is valid until the next call to Add() or Reset(). */
+    DfpnData& Add(std::size_t i);
+
+private:
+    static const std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+    /** Index in m_data of each child, or NONE. */
+    std::vector<std::size_t> m_index;
+
+    std::vector<DfpnData> m_data;
+};
+
+inline DfpnExpandedChildren::DfpnExpandedChildren()
+{
+}
+
+inline void DfpnExpandedChildren::Reset(std::size_t numChildren)
+{
+    m_index.assign(numChildren, std::size_t(NONE));
+    m_data.clear();
+}
+
+inline DfpnData* DfpnExpandedChildren::Find(std::size_t i)
+{
+    return m_index[i] == NONE ? 0 : &m_data[m_index[i]];
+}
+
+inline DfpnData& DfpnExpandedChildren::Add(std::size_t i)
+{
+    BenzeneAssert(m_index[i] == NONE);
+    m_index[i] = m_data.size();
+    m_data.push_back(DfpnData());
+    return m_data.back();
+}
+
+//----------------------------------------------------------------------------
+
 /** History of moves played from root state to current state. 
     @ingroup dfpn
 */
@@ -458,6 +666,9 @@ public:
     /** Hash of last state. */
     SgHashCode LastHash() const;
 
+    /** Moves played from the first state. */
+    std::vector<HexPoint> Moves() const;
+
 private:
 
     /** Move played from state. */
@@ -501,6 +712,11 @@ inline SgHashCode DfpnHistory::LastHash() const
     return m_hash.back();
 }
 
+inline std::vector<HexPoint> DfpnHistory::Moves() const
+{
+    return std::vector<HexPoint>(m_move.begin() + 1, m_move.end());
+}
+
 //----------------------------------------------------------------------------
 
 /** Interface for listeners of DfpnSolver. 
@@ -517,10 +733,137 @@ public:
 
 //----------------------------------------------------------------------------
 
-/** Hashtable used in dfpn search.  
+/** Hashtable used in dfpn search. Shared by all dfpn threads, which
+    lock only the bucket they access.
+
+    The fixed-size DfpnEntry of each state is stored in the buckets;
+    its DfpnChildren are stored in a separate array slot that belongs
+    to the entry, so LookupEntry() copies only the entry and replacing
+    an entry reuses the memory of the children it replaces.
     @ingroup dfpn
 */
-typedef SgHashTable<DfpnData, 4> DfpnHashTable;
+class DfpnHashTable
+{
+public:
+    explicit DfpnHashTable(int maxHash);
+
+    void Clear();
+
+    int MaxHash() const;
+
+    /** Copies the entry stored under code and its children. */
+    bool Lookup(const SgHashCode& code, DfpnData* data) const;
+
+    /** Copies only the entry stored under code. */
+    bool LookupEntry(const SgHashCode& code, DfpnEntry* entry) const;
+
+    bool Store(const SgHashCode& code, const DfpnData& data);
+
+    /** Stores data under code unless the state is already solved in
+        the table, in which case data is set to the stored data and
+        false is returned. */
+    bool StoreUnlessSolved(const SgHashCode& code, DfpnData& data);
+
+    /** Calls f(code, const DfpnData&) for each stored state, without
+        blocking other threads; see ShardedHashTable::ForEach(). */
+    template<class F>
+    void ForEach(F f) const;
+
+    /** Writes statistics on hash table use. */
+    void WriteStatistics(std::ostream& out) const;
+
+private:
+    typedef ShardedHashTable<DfpnEntry, 4, DfpnChildren> Table;
+
+    struct KeepSolved
+    {
+        bool operator()(const DfpnEntry& entry) const
+        {
+            return entry.m_bounds.IsSolved();
+        }
+    };
+
+    template<class F>
+    class ForEachData
+    {
+    public:
+        ForEachData(F& f)
+            : m_f(f)
+        { }
+
+        void operator()(const SgHashCode& code, const DfpnEntry& entry,
+                        const DfpnChildren& children)
+        {
+            m_data = DfpnData(entry);
+            m_data.m_children = children;
+            m_f(code, static_cast<const DfpnData&>(m_data));
+        }
+
+    private:
+        F& m_f;
+
+        DfpnData m_data;
+    };
+
+    Table m_table;
+};
+
+inline DfpnHashTable::DfpnHashTable(int maxHash)
+    : m_table(maxHash)
+{
+}
+
+inline void DfpnHashTable::Clear()
+{
+    m_table.Clear();
+}
+
+inline int DfpnHashTable::MaxHash() const
+{
+    return m_table.MaxHash();
+}
+
+inline bool DfpnHashTable::Lookup(const SgHashCode& code,
+                                  DfpnData* data) const
+{
+    return m_table.Lookup(code, data, &data->m_children);
+}
+
+inline bool DfpnHashTable::LookupEntry(const SgHashCode& code,
+                                       DfpnEntry* entry) const
+{
+    return m_table.Lookup(code, entry);
+}
+
+inline bool DfpnHashTable::Store(const SgHashCode& code,
+                                 const DfpnData& data)
+{
+    return m_table.Store(code, data, data.m_children);
+}
+
+inline bool DfpnHashTable::StoreUnlessSolved(const SgHashCode& code,
+                                             DfpnData& data)
+{
+    return m_table.StoreUnless(code, data, data.m_children, KeepSolved());
+}
+
+template<class F>
+void DfpnHashTable::ForEach(F f) const
+{
+    m_table.ForEach(ForEachData<F>(f));
+}
+
+inline void DfpnHashTable::WriteStatistics(std::ostream& out) const
+{
+    out << m_table;
+}
+
+/** Writes statistics on hash table use (not the content). */
+inline std::ostream& operator<<(std::ostream& out, const DfpnHashTable& hash)
+{
+    hash.WriteStatistics(out);
+    return out;
+}
 
 /** Database of solved positions. 
     @ingroup dfpn
@@ -530,8 +873,9 @@ class DfpnDB : public StateDB<DfpnData>
 public:
     static const std::string DFPN_DB_VERSION;
 
-    DfpnDB(const std::string& filename)
-        : StateDB<DfpnData>(filename, DFPN_DB_VERSION)
+    DfpnDB(const std::string& filename,
+           HashDBBackend backend = HASHDB_BERKELEY)
+        : StateDB<DfpnData>(filename, DFPN_DB_VERSION, backend)
     { }
 };
 
@@ -569,8 +913,8 @@ public:
     /** Restores db from backup. */
     void DbRestore(DfpnStates& positions);
 
-    /** Does backup of tt. */
-    void TtDump(DfpnStates& positions, bool locked = false);
+    /** Does backup of tt. Safe to call while the search runs. */
+    void TtDump(DfpnStates& positions);
 
     /** Restores tt from backup. */
     void TtRestore(DfpnStates& positions);
@@ -653,6 +997,27 @@ public:
     /** See ThreadWork() */
     void SetThreadWork(size_t threadWork);
 
+    /** Whether threads share the work through work queues instead of
+        walking the top of the tree under one mutex.
+        With work stealing, a thread without work walks down from the
+        root without any global lock, publishing the virtual bounds of
+        its path in the VirtualBoundsTT, and queues the state it
+        reaches as a task. It queues a second task if it can, which
+        idle threads may steal, and runs its own tasks last in, first
+        out. */
+    bool WorkStealing() const;
+
+    /** See WorkStealing() */
+    void SetWorkStealing(bool enable);
+
+    /** Depth at which the walk of the top of the tree stops and
+        queues a task, if it did not stop before. Only used with
+        WorkStealing(). */
+    int SplitDepth() const;
+
+    /** See SplitDepth() */
+    void SetSplitDepth(int splitDepth);
+
     /** Name of backup file for db. */
     std::string DbBakFilename() const;
 
@@ -703,10 +1068,10 @@ private:
         void ClearChildren();
 
         void SetChildren(const DfpnChildren& children,
-                         const std::vector<DfpnData>& bounds);
+                         const std::vector<DfpnEntry>& bounds);
 
         void SetChildrenOnce(const DfpnChildren& children,
-                             const std::vector<DfpnData>& bounds);
+                             const std::vector<DfpnEntry>& bounds);
         
         void SetFirstPlayer(HexColor color);
 
@@ -727,7 +1092,7 @@ private:
 
         DfpnChildren m_children;
 
-        std::vector<DfpnData> m_data;
+        std::vector<DfpnEntry> m_data;
 
         HexColor m_firstColor;
 
@@ -752,14 +1117,52 @@ private:
     boost::thread_specific_ptr<HexBoard> m_workBoard;
     boost::thread_specific_ptr<DfpnHistory> m_history;
     boost::thread_specific_ptr<int> m_thread_id;
-    bool m_thread_path_solved[DFPN_MAX_THREADS];
+
+    /** Id of the path the thread works below; the thread id unless
+        WorkStealing(). Used for the VirtualBoundsTT and
+        m_path_solved. */
+    boost::thread_specific_ptr<int> m_path_id;
+    std::atomic<bool> m_path_solved[DFPN_MAX_THREADS];
+
+    /** State to search below, queued by TopMid() with
+        WorkStealing(). */
+    struct DfpnTask
+    {
+        /** Moves from the root to the state. */
+        std::vector<HexPoint> path;
+        DfpnBounds maxBounds;
+        size_t workBound;
+        /** Path id of the task, taken from m_freePathIds. */
+        int pathId;
+    };
+
+    struct TaskQueue
+    {
+        boost::mutex m_mutex;
+        std::deque<DfpnTask> m_tasks;
+    };
+
+    boost::scoped_array<TaskQueue> m_taskQueues;
+
+    /** Path ids not used by any task. Guarded by m_steal_mutex. */
+    std::vector<int> m_freePathIds;
+
+    /** Counts finished walks and tasks, so that a thread waiting for
+        work wakes up only after something changed. Guarded by
+        m_steal_mutex. */
+    size_t m_stealEpoch;
+
+    boost::mutex m_steal_mutex;
+
+    /** Guards the database, which TopMid() accesses without the
+        topmid mutex when WorkStealing(). */
+    boost::mutex m_db_mutex;
 
     boost::mutex m_topmid_mutex;
     boost::mutex m_abort_mutex;
     boost::mutex m_listeners_mutex;
     boost::mutex m_backup_mutex;
     boost::condition_variable m_nothingToSearch_cond;
-    boost::shared_mutex m_tt_mutex;
 
     DfpnStates* m_positions;
     VirtualBoundsTT m_vtt;
@@ -792,6 +1195,12 @@ private:
     /** See ThreadWork() */
     size_t m_threadWork;
 
+    /** See WorkStealing() */
+    bool m_workStealing;
+
+    /** See SplitDepth() */
+    int m_splitDepth;
+
     /** See DbBakFilename() */
     std::string m_db_bak_filename;
 
@@ -847,13 +1256,17 @@ public:
     void RunThread(int id, const DfpnBounds& maxBounds,
                    const HexState& state, HexBoard& board);
 
+    void RunStealingThread(int id, const DfpnBounds& maxBounds,
+                           const HexState& state, HexBoard& board);
+
 private:
     struct TopMidData
     {
         DfpnData& data;
         DfpnBounds& vBounds;
         SgHashCode hash;
-        std::vector<DfpnData> childrenData;
+        std::vector<DfpnEntry> childrenData;
+        DfpnExpandedChildren expanded;
         std::vector<DfpnBounds> virtualBounds;
         std::size_t bestIndex;
         std::size_t reverserIndex;
@@ -872,6 +1285,24 @@ private:
                   DfpnData& data, DfpnBounds& vBounds,
                   TopMidData* parent, bool& midCalled);
 
+    void PushTask(const DfpnBounds& maxBounds, size_t workBound);
+
+    bool PopTask(int id, DfpnTask& task);
+
+    bool StealTask(int id, DfpnTask& task);
+
+    void RunTask(const DfpnTask& task, const HexState& root);
+
+    int AcquirePathId();
+
+    void ReleasePathId(int pathId);
+
+    size_t StealEpoch();
+
+    void NextStealEpoch();
+
+    void WaitForStealEpoch(size_t epoch);
+
     size_t MID(const DfpnBounds& maxBounds, const size_t workBound,
                DfpnData& data, const DfpnData& parentData);
     size_t MID(const DfpnBounds& maxBounds, const size_t workBound,
@@ -881,10 +1312,10 @@ private:
 
     void UpdateSolvedBestMove(const DfpnBounds& bounds,
 			      DfpnData& data,
-                              const std::vector<DfpnData>& childrenData);
+                              const std::vector<DfpnEntry>& childrenData);
 
     void UpdateStatsOnWin(const DfpnChildren& children,
-			  const std::vector<DfpnData>& childrenData,
+			  const std::vector<DfpnEntry>& childrenData,
                           size_t bestIndex, size_t work);
 
     DfpnBoundType GetDeltaBound(DfpnBoundType delta) const;
@@ -932,24 +1363,22 @@ private:
 
     bool CheckAbort();
 
-    void LookupDataTT(DfpnData& data, const DfpnChildren& children,
+    void LookupDataTT(DfpnEntry& data, const DfpnChildren& children,
                       std::size_t childIndex, HexState& state);
 
-    bool LookupDataDB(DfpnData& data, const DfpnChildren& children,
+    bool LookupDataDB(DfpnEntry& data, const DfpnChildren& children,
                       std::size_t childIndex, HexState& state);
 
-    void LookupChildrenTT(std::vector<DfpnData>& childrenData,
+    void LookupChildrenTT(std::vector<DfpnEntry>& childrenData,
                           const DfpnChildren& children);
 
-    void LookupChildrenDB(std::vector<DfpnData>& childrenData,
+    void LookupChildrenDB(std::vector<DfpnEntry>& childrenData,
                           const DfpnChildren& children);
 
     void LookupChildren(size_t depth, std::vector<DfpnBounds>& virtualBounds,
-                        const std::vector<DfpnData>& childrenData,
+                        const std::vector<DfpnEntry>& childrenData,
                         const DfpnChildren& children);
 
-    bool TTReadNoLock(const HexState& state, DfpnData& data);
-
     void TTWrite(const HexState& state, DfpnData& data);
 
     bool TTRead(const HexState& state, DfpnData& data);
@@ -1058,6 +1487,26 @@ inline void DfpnSolver::SetThreadWork(size_t threadWork)
     m_threadWork = threadWork;
 }
 
+inline bool DfpnSolver::WorkStealing() const
+{
+    return m_workStealing;
+}
+
+inline void DfpnSolver::SetWorkStealing(bool enable)
+{
+    m_workStealing = enable;
+}
+
+inline int DfpnSolver::SplitDepth() const
+{
+    return m_splitDepth;
+}
+
+inline void DfpnSolver::SetSplitDepth(int splitDepth)
+{
+    m_splitDepth = splitDepth;
+}
+
 inline std::string DfpnSolver::DbBakFilename() const
 {
     return m_db_bak_filename;
@@ -56,6 +56,10 @@ HexColor DfsSolver::Solve(const HexState& state, HexBoard& brd,
                           DfsSolutionSet& solution, DfsStates& positions,
                           int depthLimit, double timeLimit)
 {
+    // Partial connection sets weaken mustplays and proof sets, and
+    // with a time budget make them depend on timing
+    if (brd.VCBuilderParameters().IsBudgeted())
+        throw BenzeneException("Dfs: VC builds must not be budgeted!\n");
     m_positions = &positions;
     m_depthLimit = depthLimit;
     m_timeLimit = timeLimit;
@@ -36,13 +36,11 @@ bitset_t ProofUtil::InitialProofForOpponent(const HexBoard& brd,
     // to add one.
     for (BitsetIterator p(inf.SReversible()); p; ++p) 
     {
-        const std::set<HexPoint>& reversers = inf.SReversers(*p);
-        proof.set(*reversers.begin());
+        proof.set(BitsetUtil::FirstSetBit(inf.SReversers(*p)));
     }
     for (BitsetIterator p(inf.Vulnerable()); p; ++p) 
     {
-        const std::set<HexPoint>& killers = inf.Killers(*p);
-        proof.set(*killers.begin());
+        proof.set(BitsetUtil::FirstSetBit(inf.Killers(*p)));
     }
     return proof;
 }
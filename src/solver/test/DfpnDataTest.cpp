@@ -0,0 +1,51 @@
+//----------------------------------------------------------------------------
+/** @file DfpnDataTest.cpp */
+//----------------------------------------------------------------------------
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <vector>
+
+#include "SgSystem.h"
+
+#include "DfpnSolver.hpp"
+
+using namespace benzene;
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+/** The reverser is not packed for non-reversible data, so after an
+    Unpack it keeps whatever it held before; Rotate must leave it
+    alone. */
+BOOST_AUTO_TEST_CASE(DfpnData_RotateIgnoresUnpackedReverser)
+{
+    const ConstBoard& brd = ConstBoard::Get(5, 5);
+    DfpnData data;
+    data.m_bounds = DfpnBounds(3, 4);
+    data.m_bestMove = HEX_CELL_B2;
+    data.m_reversible = INVALID_POINT;
+    data.m_work = 17;
+    data.m_evaluationScore = 0.5f;
+    std::vector<HexPoint> children;
+    children.push_back(HEX_CELL_B2);
+    children.push_back(HEX_CELL_C3);
+    data.m_children.SetChildren(children);
+
+    std::vector<byte> buffer(static_cast<std::size_t>(data.PackedSize()));
+    data.Pack(&buffer[0]);
+    DfpnData unpacked;
+    unpacked.m_reverser = HEX_CELL_A1;
+    unpacked.Unpack(&buffer[0]);
+    unpacked.Rotate(brd);
+
+    BOOST_CHECK_EQUAL(unpacked.m_reversible, INVALID_POINT);
+    BOOST_CHECK_EQUAL(unpacked.m_reverser, HEX_CELL_A1);
+    BOOST_CHECK_EQUAL(unpacked.m_bestMove, HEX_CELL_D4);
+    BOOST_CHECK_EQUAL(unpacked.m_work, 17u);
+}
+
+}
+
+//---------------------------------------------------------------------------
@@ -0,0 +1,48 @@
+//----------------------------------------------------------------------------
+/** @file DfpnSolverTest.cpp */
+//----------------------------------------------------------------------------
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "SgSystem.h"
+
+#include "DfpnSolver.hpp"
+
+using namespace benzene;
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+/** Solves the empty board of the given size for black with a tt of
+    the given number of entries and no db. */
+HexColor Solve(int size, int ttSize, PointSequence& pv)
+{
+    ICEngine ice;
+    VCBuilderParam param;
+    HexBoard brd(size, size, ice, param);
+    HexState state(brd.GetPosition(), BLACK);
+    boost::scoped_ptr<DfpnHashTable> table(new DfpnHashTable(ttSize));
+    boost::scoped_ptr<DfpnDB> db(0);
+    SolverDBParameters dbParam;
+    DfpnStates positions(table, db, dbParam);
+    DfpnSolver solver;
+    return solver.StartSearch(state, brd, positions, pv);
+}
+
+/** Children already searched by a frame are kept in that frame, so a
+    tt too small to hold them (as used by PerfectPlayer) must not make
+    the solver re-expand them. */
+BOOST_AUTO_TEST_CASE(DfpnSolver_SolvesWithTinyTT)
+{
+    PointSequence pv;
+    BOOST_CHECK_EQUAL(Solve(7, 1 << 16, pv), BLACK);
+    BOOST_CHECK(!pv.empty());
+    pv.clear();
+    BOOST_CHECK_EQUAL(Solve(7, 10, pv), BLACK);
+    BOOST_CHECK(!pv.empty());
+}
+
+}
+
+//---------------------------------------------------------------------------
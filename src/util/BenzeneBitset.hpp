@@ -16,6 +16,17 @@
 #include "Benzene.hpp"
 #include "BenzeneException.hpp"
 
+/** Vectorized word kernels for the bitset_t widths.
+    Enabled when compiling for x86-64 with at least SSE4.1 (see
+    BENZENE_SIMD in CMakeLists.txt); AVX2 is used when available.
+    Otherwise the plain libstdc++ word loops are used. */
+#if defined(__x86_64__) && defined(__SSE4_1__) && __SIZEOF_LONG__ == 8
+# define BENZENE_BITSET_SIMD 1
+# include <immintrin.h>
+#else
+# define BENZENE_BITSET_SIMD 0
+#endif
+
 _BEGIN_BENZENE_NAMESPACE_
 
 //----------------------------------------------------------------------------
@@ -25,6 +36,332 @@ _BEGIN_BENZENE_NAMESPACE_
  ((__n) < 1 ? 0 : ((__n) + _GLIBCXX_BITSET_BITS_PER_WORD - 1) \
                   / _GLIBCXX_BITSET_BITS_PER_WORD)
 
+//////////////////////////////////////////
+// Word kernels.
+
+/** Word-array operations used by _Base_bitset<_Nw>.
+    General case: the plain word loops from libstdc++. */
+template<size_t _Nw>
+struct _Bitset_kernel
+{
+    typedef unsigned long _WordT;
+
+    static void
+    _S_do_and(_WordT* __a, const _WordT* __b)
+    {
+        for (size_t __i = 0; __i < _Nw; __i++)
+            __a[__i] &= __b[__i];
+    }
+
+    static void
+    _S_do_or(_WordT* __a, const _WordT* __b)
+    {
+        for (size_t __i = 0; __i < _Nw; __i++)
+            __a[__i] |= __b[__i];
+    }
+
+    static void
+    _S_do_sub(_WordT* __a, const _WordT* __b)
+    {
+        for (size_t __i = 0; __i < _Nw; __i++)
+            __a[__i] &= ~__b[__i];
+    }
+
+    static bool
+    _S_is_equal(const _WordT* __a, const _WordT* __b)
+    {
+        for (size_t __i = 0; __i < _Nw; ++__i)
+            if (__a[__i] != __b[__i])
+                return false;
+        return true;
+    }
+
+    static bool
+    _S_is_subset_of(const _WordT* __a, const _WordT* __b)
+    {
+        for (size_t __i = 0; __i < _Nw; ++__i)
+            if (__a[__i] & ~__b[__i])
+                return false;
+        return true;
+    }
+
+    static bool
+    _S_is_less_than(const _WordT* __a, const _WordT* __b)
+    {
+        for (size_t __i = 0; __i < _Nw; ++__i)
+            if (__a[__i] != __b[__i])
+                return (__a[__i] < __b[__i]);
+        return false;
+    }
+
+    static bool
+    _S_is_any(const _WordT* __a)
+    {
+        for (size_t __i = 0; __i < _Nw; __i++)
+            if (__a[__i] != static_cast<_WordT>(0))
+                return true;
+        return false;
+    }
+
+    static size_t
+    _S_do_count(const _WordT* __a)
+    {
+        size_t __result = 0;
+        for (size_t __i = 0; __i < _Nw; __i++)
+            __result += __builtin_popcountl(__a[__i]);
+        return __result;
+    }
+
+    /** Index of the first non-zero word at or after __i, or _Nw. */
+    static size_t
+    _S_find_word(const _WordT* __a, size_t __i)
+    {
+        for (; __i < _Nw; __i++)
+            if (__a[__i] != static_cast<_WordT>(0))
+                return __i;
+        return _Nw;
+    }
+};
+
+#if BENZENE_BITSET_SIMD
+
+/** Vectorized word-array operations.
+    Processes 4 words per step with AVX2, 2 words per step with
+    SSE4.1, and a trailing odd word in scalar code. _Nw is a
+    compile-time constant so all loops are fully unrolled. Loads are
+    unaligned since bitsets are only word-aligned inside other
+    structures.
+
+    count() stays on scalar popcnt: without AVX-512 there is no
+    vector popcount that beats it at these widths. */
+template<size_t _Nw>
+struct _Bitset_simd_kernel
+{
+    typedef unsigned long _WordT;
+
+    static const unsigned _S_all_words = (1u << _Nw) - 1;
+
+    static __m128i
+    _S_load2(const _WordT* __p)
+    { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(__p)); }
+
+    static void
+    _S_store2(_WordT* __p, __m128i __v)
+    { _mm_storeu_si128(reinterpret_cast<__m128i*>(__p), __v); }
+
+    /** Bit i of result set iff word i of __v is zero. */
+    static unsigned
+    _S_mask2(__m128i __v)
+    {
+        return static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(__v)));
+    }
+
+#ifdef __AVX2__
+    static __m256i
+    _S_load4(const _WordT* __p)
+    { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(__p)); }
+
+    static void
+    _S_store4(_WordT* __p, __m256i __v)
+    { _mm256_storeu_si256(reinterpret_cast<__m256i*>(__p), __v); }
+
+    static unsigned
+    _S_mask4(__m256i __v)
+    {
+        return static_cast<unsigned>
+            (_mm256_movemask_pd(_mm256_castsi256_pd(__v)));
+    }
+#endif
+
+    struct _And
+    {
+        static __m128i _S(__m128i __x, __m128i __y)
+        { return _mm_and_si128(__x, __y); }
+#ifdef __AVX2__
+        static __m256i _S(__m256i __x, __m256i __y)
+        { return _mm256_and_si256(__x, __y); }
+#endif
+        static _WordT _S(_WordT __x, _WordT __y)
+        { return __x & __y; }
+    };
+
+    struct _Or
+    {
+        static __m128i _S(__m128i __x, __m128i __y)
+        { return _mm_or_si128(__x, __y); }
+#ifdef __AVX2__
+        static __m256i _S(__m256i __x, __m256i __y)
+        { return _mm256_or_si256(__x, __y); }
+#endif
+        static _WordT _S(_WordT __x, _WordT __y)
+        { return __x | __y; }
+    };
+
+    /** __x & ~__y. */
+    struct _AndNot
+    {
+        static __m128i _S(__m128i __x, __m128i __y)
+        { return _mm_andnot_si128(__y, __x); }
+#ifdef __AVX2__
+        static __m256i _S(__m256i __x, __m256i __y)
+        { return _mm256_andnot_si256(__y, __x); }
+#endif
+        static _WordT _S(_WordT __x, _WordT __y)
+        { return __x & ~__y; }
+    };
+
+    /** __a = __a op __b. */
+    template<class _Op>
+    static void
+    _S_apply(_WordT* __a, const _WordT* __b)
+    {
+        size_t __i = 0;
+#ifdef __AVX2__
+        for (; __i + 4 <= _Nw; __i += 4)
+            _S_store4(__a + __i, _Op::_S(_S_load4(__a + __i),
+                                         _S_load4(__b + __i)));
+#endif
+        for (; __i + 2 <= _Nw; __i += 2)
+            _S_store2(__a + __i, _Op::_S(_S_load2(__a + __i),
+                                         _S_load2(__b + __i)));
+        if (__i < _Nw)
+            __a[__i] = _Op::_S(__a[__i], __b[__i]);
+    }
+
+    /** Returns true if (__a op __b) has no bits set. */
+    template<class _Op>
+    static bool
+    _S_apply_is_zero(const _WordT* __a, const _WordT* __b)
+    {
+        size_t __i = 0;
+#ifdef __AVX2__
+        for (; __i + 4 <= _Nw; __i += 4)
+        {
+            __m256i __v = _Op::_S(_S_load4(__a + __i), _S_load4(__b + __i));
+            if (!_mm256_testz_si256(__v, __v))
+                return false;
+        }
+#endif
+        for (; __i + 2 <= _Nw; __i += 2)
+        {
+            __m128i __v = _Op::_S(_S_load2(__a + __i), _S_load2(__b + __i));
+            if (!_mm_testz_si128(__v, __v))
+                return false;
+        }
+        if (__i < _Nw)
+            return _Op::_S(__a[__i], __b[__i]) == 0;
+        return true;
+    }
+
+    /** Bit i of result set iff word i of __a equals word i of __b. */
+    static unsigned
+    _S_equal_words(const _WordT* __a, const _WordT* __b)
+    {
+        unsigned __m = 0;
+        size_t __i = 0;
+#ifdef __AVX2__
+        for (; __i + 4 <= _Nw; __i += 4)
+            __m |= _S_mask4(_mm256_cmpeq_epi64(_S_load4(__a + __i),
+                                               _S_load4(__b + __i))) << __i;
+#endif
+        for (; __i + 2 <= _Nw; __i += 2)
+            __m |= _S_mask2(_mm_cmpeq_epi64(_S_load2(__a + __i),
+                                            _S_load2(__b + __i))) << __i;
+        if (__i < _Nw)
+            __m |= static_cast<unsigned>(__a[__i] == __b[__i]) << __i;
+        return __m;
+    }
+
+    /** Bit i of result set iff word i of __a is non-zero. */
+    static unsigned
+    _S_nonzero_words(const _WordT* __a)
+    {
+        unsigned __m = 0;
+        size_t __i = 0;
+#ifdef __AVX2__
+        for (; __i + 4 <= _Nw; __i += 4)
+            __m |= _S_mask4(_mm256_cmpeq_epi64(_S_load4(__a + __i),
+                                               _mm256_setzero_si256()))
+                << __i;
+#endif
+        for (; __i + 2 <= _Nw; __i += 2)
+            __m |= _S_mask2(_mm_cmpeq_epi64(_S_load2(__a + __i),
+                                            _mm_setzero_si128())) << __i;
+        if (__i < _Nw)
+            __m |= static_cast<unsigned>(__a[__i] == 0) << __i;
+        return ~__m & _S_all_words;
+    }
+
+    static void
+    _S_do_and(_WordT* __a, const _WordT* __b)
+    { _S_apply<_And>(__a, __b); }
+
+    static void
+    _S_do_or(_WordT* __a, const _WordT* __b)
+    { _S_apply<_Or>(__a, __b); }
+
+    static void
+    _S_do_sub(_WordT* __a, const _WordT* __b)
+    { _S_apply<_AndNot>(__a, __b); }
+
+    static bool
+    _S_is_equal(const _WordT* __a, const _WordT* __b)
+    { return _S_equal_words(__a, __b) == _S_all_words; }
+
+    static bool
+    _S_is_subset_of(const _WordT* __a, const _WordT* __b)
+    { return _S_apply_is_zero<_AndNot>(__a, __b); }
+
+    static bool
+    _S_is_less_than(const _WordT* __a, const _WordT* __b)
+    {
+        const unsigned __diff = ~_S_equal_words(__a, __b) & _S_all_words;
+        if (__diff == 0)
+            return false;
+        const size_t __i = __builtin_ctz(__diff);
+        return __a[__i] < __b[__i];
+    }
+
+    static bool
+    _S_is_any(const _WordT* __a)
+    { return !_S_apply_is_zero<_Or>(__a, __a); }
+
+    static size_t
+    _S_do_count(const _WordT* __a)
+    {
+        size_t __result = 0;
+        for (size_t __i = 0; __i < _Nw; __i++)
+            __result += __builtin_popcountl(__a[__i]);
+        return __result;
+    }
+
+    static size_t
+    _S_find_word(const _WordT* __a, size_t __i)
+    {
+        const unsigned __m = _S_nonzero_words(__a) & (~0u << __i);
+        return __m ? static_cast<size_t>(__builtin_ctz(__m)) : _Nw;
+    }
+};
+
+/** 192 bits: 13x13 bitset_t. */
+template<>
+struct _Bitset_kernel<3> : public _Bitset_simd_kernel<3>
+{ };
+
+/** 224 bits: 14x14 bitset_t. */
+template<>
+struct _Bitset_kernel<4> : public _Bitset_simd_kernel<4>
+{ };
+
+/** 384 bits: 19x19 bitset_t. */
+template<>
+struct _Bitset_kernel<6> : public _Bitset_simd_kernel<6>
+{ };
+
+#endif // BENZENE_BITSET_SIMD
+
+//////////////////////////////////////////
+
 /**
  *  Base class, general case.  It is a class invariant that _Nw will be
  *  nonnegative.
@@ -82,17 +419,11 @@ struct _Base_bitset
     
     void
     _M_do_and(const _Base_bitset<_Nw>& __x)
-    {
-	for (size_t __i = 0; __i < _Nw; __i++)
-            _M_w[__i] &= __x._M_w[__i];
-    }
+    { _Bitset_kernel<_Nw>::_S_do_and(_M_w, __x._M_w); }
     
     void
     _M_do_or(const _Base_bitset<_Nw>& __x)
-    {
-	for (size_t __i = 0; __i < _Nw; __i++)
-            _M_w[__i] |= __x._M_w[__i];
-    }
+    { _Bitset_kernel<_Nw>::_S_do_or(_M_w, __x._M_w); }
     
     void
     _M_do_xor(const _Base_bitset<_Nw>& __x)
@@ -103,10 +434,7 @@ struct _Base_bitset
     
     void
     _M_do_sub(const _Base_bitset<_Nw>& __x)
-    {
-        for (size_t __i = 0; __i < _Nw; __i++)
-            _M_w[__i] &= ~__x._M_w[__i];
-    }
+    { _Bitset_kernel<_Nw>::_S_do_sub(_M_w, __x._M_w); }
     
     void
     _M_do_left_shift(size_t __shift);
@@ -134,31 +462,25 @@ struct _Base_bitset
     
     bool
       _M_is_equal(const _Base_bitset<_Nw>& __x) const
-    {
-	for (size_t __i = 0; __i < _Nw; ++__i)
-            if (_M_w[__i] != __x._M_w[__i])
-                return false;
-	return true;
-    }
+    { return _Bitset_kernel<_Nw>::_S_is_equal(_M_w, __x._M_w); }
 
     //////////////////////////////////////////
     // added by broderic
     bool
     _M_is_subset_of(const _Base_bitset<_Nw>& __x) const
-    {
-        for (size_t __i = 0; __i < _Nw; ++__i)
-            if (_M_w[__i] & ~__x._M_w[__i])
-                return false;
-        return true;
-    }
+    { return _Bitset_kernel<_Nw>::_S_is_subset_of(_M_w, __x._M_w); }
 
     bool
     _M_is_less_than(const _Base_bitset<_Nw>& __x) const
+    { return _Bitset_kernel<_Nw>::_S_is_less_than(_M_w, __x._M_w); }
+
+    _WordT
+    _M_do_fold() const
     {
-        for (size_t __i = 0; __i < _Nw; ++__i)
-            if (_M_w[__i] != __x._M_w[__i])
-                return (_M_w[__i] < __x._M_w[__i]);
-        return false;
+        _WordT __result = 0;
+        for (size_t __i = 0; __i < _Nw; __i++)
+            __result |= _M_w[__i];
+        return __result;
     }
 
     //////////////////////////////////////////
@@ -175,21 +497,11 @@ struct _Base_bitset
     
     bool
     _M_is_any() const
-    {
-	for (size_t __i = 0; __i < _Nw; __i++)
-            if (_M_w[__i] != static_cast<_WordT>(0))
-                return true;
-	return false;
-    }
+    { return _Bitset_kernel<_Nw>::_S_is_any(_M_w); }
     
     size_t
     _M_do_count() const
-    {
-	size_t __result = 0;
-	for (size_t __i = 0; __i < _Nw; __i++)
-            __result += __builtin_popcountl(_M_w[__i]);
-	return __result;
-    }
+    { return _Bitset_kernel<_Nw>::_S_do_count(_M_w); }
     
     unsigned long
     _M_do_to_ulong() const;
@@ -261,13 +573,10 @@ template<size_t _Nw>
 size_t
 _Base_bitset<_Nw>::_M_do_find_first(size_t __not_found) const
 {
-    for (size_t __i = 0; __i < _Nw; __i++)
-	{
-            _WordT __thisword = _M_w[__i];
-            if (__thisword != static_cast<_WordT>(0))
-                return (__i * _GLIBCXX_BITSET_BITS_PER_WORD
-                        + __builtin_ctzl(__thisword));
-	}
+    const size_t __i = _Bitset_kernel<_Nw>::_S_find_word(_M_w, 0);
+    if (__i < _Nw)
+        return (__i * _GLIBCXX_BITSET_BITS_PER_WORD
+                + __builtin_ctzl(_M_w[__i]));
     // not found, so return an indication of failure.
     return __not_found;
 }
@@ -295,14 +604,10 @@ _Base_bitset<_Nw>::_M_do_find_next(size_t __prev, size_t __not_found) const
 		+ __builtin_ctzl(__thisword));
 
     // check subsequent words
-    __i++;
-    for (; __i < _Nw; __i++)
-	{
-            __thisword = _M_w[__i];
-            if (__thisword != static_cast<_WordT>(0))
-                return (__i * _GLIBCXX_BITSET_BITS_PER_WORD
-                        + __builtin_ctzl(__thisword));
-	}
+    __i = _Bitset_kernel<_Nw>::_S_find_word(_M_w, __i + 1);
+    if (__i < _Nw)
+        return (__i * _GLIBCXX_BITSET_BITS_PER_WORD
+                + __builtin_ctzl(_M_w[__i]));
     // not found, so return an indication of failure.
     return __not_found;
 } // end _M_do_find_next
@@ -393,6 +698,10 @@ struct _Base_bitset<1>
     _M_is_less_than(const _Base_bitset<1>& __x) const
     { return _M_w < __x._M_w; }
 
+    _WordT
+    _M_do_fold() const
+    { return _M_w; }
+
     //////////////////////////////////////////
 
     void
@@ -551,6 +860,10 @@ struct _Base_bitset<0>
     _M_is_less_than(const _Base_bitset<0>&) const
     { return false; }
 
+    unsigned long
+    _M_do_fold() const
+    { return 0; }
+
     //////////////////////////////////////////
 
     size_t
@@ -840,6 +1153,14 @@ public:
     {
         return this->_M_is_less_than(__rhs);
     }
+
+    /** Bitwise or of all words: bit i is set iff some bit congruent
+        to i modulo the word size is set. A subset's fold is a subset
+        of the superset's fold, so this is a cheap subset prefilter. */
+    unsigned long fold() const
+    {
+        return this->_M_do_fold();
+    }
     /////////////////////////////////////////////////
 
     //@}
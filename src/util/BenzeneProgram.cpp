@@ -7,6 +7,7 @@
 
 #include "BenzeneException.hpp"
 #include "BenzeneProgram.hpp"
+#include "Bitset.hpp"
 
 #include <boost/program_options/cmdline.hpp>
 #include <boost/program_options/parsers.hpp>
@@ -115,6 +116,7 @@ void BenzeneProgram::InitializeSystem()
     InitLog();
     LogConfig() << m_name << " v" << m_version << " " << m_date << ".\n";
     LogConfig() << "============ InitializeSystem ============\n";
+    LogConfig() << "Bitset kernels: " << BitsetUtil::KernelName() << '\n';
     InitRandom();
 }
 
@@ -4,8 +4,10 @@
 
 #include <sstream>
 #include <cstdio>
+#include <cstdlib>
 #include "Bitset.hpp"
 #include "BenzeneAssert.hpp"
+#include "BenzeneException.hpp"
 
 using namespace benzene;
 
@@ -112,6 +114,73 @@ int BitsetUtil::FirstSetBit(const bitset_t& b)
 }
 //----------------------------------------------------------------------------
 
+std::string BitsetUtil::KernelName()
+{
+#if BENZENE_BITSET_SIMD && defined(__AVX2__)
+    return "avx2";
+#elif BENZENE_BITSET_SIMD
+    return "sse4.1";
+#else
+    return "scalar";
+#endif
+}
+
+void BitsetUtil::CheckKernelSupport()
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+# if BENZENE_BITSET_SIMD && defined(__AVX2__)
+    if (!__builtin_cpu_supports("avx2"))
+        throw BenzeneException("Bitset kernels were compiled for AVX2, "
+                               "which this processor does not support. "
+                               "Rebuild with -DBENZENE_SIMD=sse4.");
+# endif
+# if BENZENE_BITSET_SIMD
+    if (!__builtin_cpu_supports("sse4.1"))
+        throw BenzeneException("Bitset kernels were compiled for SSE4.1, "
+                               "which this processor does not support. "
+                               "Rebuild with -DBENZENE_SIMD=scalar.");
+# endif
+# ifdef __SSE4_2__
+    if (!__builtin_cpu_supports("sse4.2"))
+        throw BenzeneException("Compiled with SSE4.2, which this "
+                               "processor does not support. "
+                               "Rebuild with -DBENZENE_SIMD=scalar.");
+# endif
+# ifdef __POPCNT__
+    if (!__builtin_cpu_supports("popcnt"))
+        throw BenzeneException("Compiled with POPCNT, which this "
+                               "processor does not support. "
+                               "Rebuild with -DBENZENE_SIMD=scalar.");
+# endif
+#endif
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+namespace {
+
+/** Runs CheckKernelSupport() before the static initializers of the
+    rest of the program, which may already use the instructions it
+    checks for. Exceptions cannot be reported that early, so a missing
+    instruction set is printed with stdio and aborts. */
+__attribute__((constructor(101)))
+void CheckKernelSupportAtStartup()
+{
+    try {
+        BitsetUtil::CheckKernelSupport();
+    }
+    catch (const BenzeneException& e) {
+        std::fputs(e.what(), stderr);
+        std::fputc('\n', stderr);
+        std::abort();
+    }
+}
+
+} // namespace
+#endif
+
+//----------------------------------------------------------------------------
+
 /** @note Must specify the namespace here for some reason. */
 bitset_t benzene::operator-(const bitset_t& b1, const bitset_t& b2)
 {
@@ -115,6 +115,18 @@ namespace BitsetUtil
 
     /** Returns least-significant set bit in b. */
     int FirstSetBit(const bitset_t& b);
+
+    //------------------------------------------------------------------------
+
+    /** Name of the instruction set the bitset kernels were compiled
+        for: "avx2", "sse4.1" or "scalar". */
+    std::string KernelName();
+
+    /** Uses CPUID to check that this processor supports the
+        instruction set the bitset kernels were compiled for.
+        Throws a BenzeneException if it does not. Also run, aborting
+        on failure, before any static initializer of the program. */
+    void CheckKernelSupport();
 }
 
 //----------------------------------------------------------------------------
@@ -85,12 +85,17 @@ public:
     //------------------------------------------------------------------------
 
     /** If explores and element of killing, stops and return true. */
-    bool DFS(const HexPoint p, std::set<T>& visited,
+    bool DFS(const T& p, std::set<T>& visited,
 	     std::set<T>& killing, std::vector<T>& stack) const;
 
     /** Stores all vertices that are on a two cycle in cycles. */
     void FindTwoCycles(std::set<T>& cycles) const;
 
+    /** Stores the strongly connected components of the graph in
+        comp. */
+    void FindStronglyConnectedComponents(std::vector<std::set<T> >& comp)
+        const;
+
     //------------------------------------------------------------------------
 
     const_iterator out_begin(const T& source) const;
@@ -104,6 +109,9 @@ public:
     /** Clears the graph. */
     void Clear();
 
+    /** Exchanges the contents of two graphs without copying. */
+    void Swap(Digraph<T>& other);
+
     /** Adds edge from source to target. */
     void AddEdge(const T& source, const T& target);
 
@@ -300,6 +308,14 @@ void Digraph<T>::Clear()
     m_vertices.clear();
 }
 
+template<typename T>
+void Digraph<T>::Swap(Digraph<T>& other)
+{
+    m_out.swap(other.m_out);
+    m_in.swap(other.m_in);
+    m_vertices.swap(other.m_vertices);
+}
+
 template<typename T>
 void Digraph<T>::AddEdge(const T& source, const T& target)
 {
@@ -361,12 +377,12 @@ bool Digraph<T>::VertexExists(const T& v) const
 
 
 template<typename T>
-bool Digraph<T>::DFS(const HexPoint p, std::set<T>& visited,
+bool Digraph<T>::DFS(const T& p, std::set<T>& visited,
 		     std::set<T>& killing, std::vector<T>& stack) const
 {
     bool stopped = false;
     visited.insert(p);
-    for (std::set<HexPoint>::iterator it = m_out[p].begin();
+    for (iterator it = m_out[p].begin();
 	 it != m_out[p].end(); ++it)
     {
         if (visited.find(*it) != visited.end())
@@ -386,6 +402,33 @@ bool Digraph<T>::DFS(const HexPoint p, std::set<T>& visited,
     return stopped;
 }
 
+// Kosaraju's algorithm
+template<typename T>
+void Digraph<T>::FindStronglyConnectedComponents
+(std::vector<std::set<T> >& comp) const
+{
+    comp.clear();
+    std::set<T> visited;
+    std::set<T> killing;
+    std::vector<T> stack;
+    for (const_iterator x = m_vertices.begin(); x != m_vertices.end(); ++x)
+        if (visited.find(*x) == visited.end())
+            DFS(*x, visited, killing, stack);
+
+    Digraph<T> trans_graph;
+    Transpose(trans_graph);
+    visited.clear();
+    for (typename std::vector<T>::reverse_iterator x = stack.rbegin();
+         x != stack.rend(); ++x)
+    {
+        if (visited.find(*x) != visited.end())
+            continue;
+        std::vector<T> members;
+        trans_graph.DFS(*x, visited, killing, members);
+        comp.push_back(std::set<T>(members.begin(), members.end()));
+    }
+}
+
 
 //----------------------------------------------------------------------------
 
@@ -7,20 +7,24 @@
 
 #include <boost/concept_check.hpp>
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
 
 #include <db.h>
 
 #include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "SgHash.h"
 #include "SgTimer.h"
 #include "Benzene.hpp"
 #include "BenzeneAssert.hpp"
 #include "Logger.hpp"
+#include "MappedHashStore.hpp"
 #include "Types.hpp"
 #include "BenzeneException.hpp"
 
@@ -59,7 +63,22 @@ struct HashDBStateConcept
 
 //----------------------------------------------------------------------------
 
-/** Front end for a Berkely DB hash table. */
+/** Storage used by a HashDB. */
+enum HashDBBackend
+{
+    /** Berkeley DB hash table. */
+    HASHDB_BERKELEY,
+
+    /** MappedHashStore. */
+    HASHDB_MAPPED
+};
+
+//----------------------------------------------------------------------------
+
+/** Front end for a Berkely DB hash table or a MappedHashStore.
+    An existing file is opened with the backend its header belongs
+    to; backend is only used to create a new file. Dump(), Restore()
+    and Merge() work between databases of either backend. */
 template<class T>
 class HashDB
 {
@@ -67,7 +86,11 @@ class HashDB
 
 public:
     /** Opens database, creates it if it does not exist. */
-    HashDB(const std::string& filename, const std::string& type);
+    HashDB(const std::string& filename, const std::string& type,
+           HashDBBackend backend = HASHDB_BERKELEY);
+
+    /** Backend of the open database. */
+    HashDBBackend Backend() const;
 
     /** Closes database. */    
     ~HashDB();
@@ -99,7 +122,7 @@ public:
     /** Restore db from file. */
     void Restore(std::ifstream& is);
 
-    /** Returns statistics of the berkeley db. */
+    /** Returns statistics of the berkeley db or mapped store. */
     std::string BDBStatistics();
 
 private:
@@ -136,21 +159,73 @@ private:
         }
     };
 
+    /** Adds the records of a HashDB to another one; see Merge(). */
+    struct MergeRecord
+    {
+        HashDB<T>& m_db;
+
+        size_t m_conflicts;
+
+        size_t m_overwrites;
+
+        size_t m_copied;
+
+        MergeRecord(HashDB<T>& db)
+            : m_db(db), m_conflicts(0), m_overwrites(0), m_copied(0)
+        { }
+
+        void operator()(SgHashCode hash, const byte* data, std::size_t size);
+    };
+
+    /** Writes the records of a HashDB to a dump file; see Dump(). */
+    struct DumpRecord
+    {
+        std::ofstream& m_os;
+
+        size_t m_count;
+
+        DumpRecord(std::ofstream& os)
+            : m_os(os), m_count(0)
+        { }
+
+        void operator()(SgHashCode hash, const byte* data, std::size_t size);
+    };
+
     DB* m_db;
 
+    /** Used instead of m_db if the file is a MappedHashStore. */
+    boost::scoped_ptr<MappedHashStore> m_store;
+
     /** Name of database file. */
     std::string m_filename;
 
     bool GetHeader(Header& header) const;
     
     void PutHeader(Header& header);
+
+    bool GetRaw(SgHashCode hash, std::vector<byte>& data) const;
+
+    void PutRaw(SgHashCode hash, const byte* data, std::size_t size);
+
+    /** Calls f(SgHashCode, const byte*, std::size_t) for each
+        record. */
+    template<class F>
+    void ForEachRecord(F& f);
 };
 
 template<class T>
-HashDB<T>::HashDB(const std::string& filename, const std::string& type)
+HashDB<T>::HashDB(const std::string& filename, const std::string& type,
+                  HashDBBackend backend)
     : m_db(0),
       m_filename(filename)
 {
+    if (MappedHashStore::IsMappedFile(filename)
+        || (backend == HASHDB_MAPPED
+            && !std::ifstream(filename.c_str()).good()))
+    {
+        m_store.reset(new MappedHashStore(filename, type));
+        return;
+    }
     int ret;
     if ((ret = db_create(&m_db, NULL, 0)) != 0) 
     {
@@ -177,9 +252,17 @@ HashDB<T>::HashDB(const std::string& filename, const std::string& type)
         PutHeader(newHeader);
 }
 
+template<class T>
+HashDBBackend HashDB<T>::Backend() const
+{
+    return m_store ? HASHDB_MAPPED : HASHDB_BERKELEY;
+}
+
 template<class T>
 HashDB<T>::~HashDB()
 {
+    if (m_store)
+        return;
     int ret;
     if ((ret = m_db->close(m_db, CLOSE_FLAGS)) != 0) 
     {
@@ -192,6 +275,11 @@ HashDB<T>::~HashDB()
 template<class T>
 bool HashDB<T>::GetHeader(Header& header) const
 {
+    if (m_store)
+    {
+        header = Header(m_store->Type());
+        return true;
+    }
     static char key[32] = "dbtype";
     return Get(key, sizeof(key), &header, sizeof(header));
 }
@@ -199,6 +287,16 @@ bool HashDB<T>::GetHeader(Header& header) const
 template<class T>
 void HashDB<T>::PutHeader(Header& header)
 {
+    if (m_store)
+    {
+        // The type of a mapped store is fixed when it is created
+        if (header != Header(m_store->Type()))
+            throw BenzeneException()
+                << "HashDB: Conflicting database types. "
+                << "old: '" << m_store->Type() << "' "
+                << "new: '" << header.m_type << "'\n";
+        return;
+    }
     static char key[32] = "dbtype";
     Put(key, sizeof(key), &header, sizeof(header));
 }
@@ -206,6 +304,8 @@ void HashDB<T>::PutHeader(Header& header)
 template<class T>
 bool HashDB<T>::Exists(SgHashCode hash) const
 {
+    if (m_store)
+        return m_store->Exists(hash);
     DBT key, data;
     memset(&key, 0, sizeof(key)); 
     memset(&data, 0, sizeof(data)); 
@@ -231,6 +331,14 @@ bool HashDB<T>::Exists(SgHashCode hash) const
 template<class T>
 bool HashDB<T>::Get(SgHashCode hash, T& d) const
 {
+    if (m_store)
+    {
+        std::vector<byte> data;
+        if (!m_store->Get(hash, data))
+            return false;
+        d.Unpack(&data[0]);
+        return true;
+    }
     DBT key, data;
     memset(&key, 0, sizeof(key)); 
     memset(&data, 0, sizeof(data)); 
@@ -258,6 +366,16 @@ bool HashDB<T>::Get(SgHashCode hash, T& d) const
 template<class T>
 bool HashDB<T>::Get(void* k, int ksize, void* d, int dsize) const
 {
+    if (m_store)
+    {
+        std::vector<byte> data;
+        if (ksize != sizeof(SgHashCode))
+            throw BenzeneException("HashDB: mapped db keys are hash codes!");
+        if (!m_store->Get(*static_cast<SgHashCode*>(k), data))
+            return false;
+        memcpy(d, &data[0], std::min(std::size_t(dsize), data.size()));
+        return true;
+    }
     DBT key, data;
     memset(&key, 0, sizeof(key)); 
     memset(&data, 0, sizeof(data)); 
@@ -285,6 +403,13 @@ bool HashDB<T>::Get(void* k, int ksize, void* d, int dsize) const
 template<class T>
 bool HashDB<T>::Put(SgHashCode hash, const T& d)
 {
+    if (m_store)
+    {
+        boost::scoped_array<byte> arr(new byte[d.PackedSize()]);
+        d.Pack(arr.get());
+        m_store->Put(hash, arr.get(), d.PackedSize());
+        return true;
+    }
     DBT key, data; 
     memset(&key, 0, sizeof(key)); 
     memset(&data, 0, sizeof(data)); 
@@ -309,6 +434,14 @@ bool HashDB<T>::Put(SgHashCode hash, const T& d)
 template<class T>
 bool HashDB<T>::Put(void* k, int ksize, void* d, int dsize)
 {
+    if (m_store)
+    {
+        if (ksize != sizeof(SgHashCode))
+            throw BenzeneException("HashDB: mapped db keys are hash codes!");
+        m_store->Put(*static_cast<SgHashCode*>(k),
+                     static_cast<const byte*>(d), dsize);
+        return true;
+    }
     DBT key, data; 
     memset(&key, 0, sizeof(key)); 
     memset(&data, 0, sizeof(data)); 
@@ -331,77 +464,53 @@ bool HashDB<T>::Put(void* k, int ksize, void* d, int dsize)
 template<class T>
 void HashDB<T>::Flush()
 {
-    m_db->sync(m_db, 0);
+    if (m_store)
+        m_store->Flush();
+    else
+        m_db->sync(m_db, 0);
 }
 
 template<class T>
-void HashDB<T>::Merge(HashDB<T>& other)
+bool HashDB<T>::GetRaw(SgHashCode hash, std::vector<byte>& d) const
 {
-    DBC* cursorp;
-    other.m_db->cursor(other.m_db, NULL, &cursorp, 0);
-
+    if (m_store)
+        return m_store->Get(hash, d);
     DBT key, data;
     memset(&key, 0, sizeof(key));
     memset(&data, 0, sizeof(data));
-
-    int ret;
-    size_t confilcts = 0;
-    size_t overwrites = 0;
-    size_t copied = 0;
-    while ((ret = cursorp->c_get(cursorp, &key, &data, DB_NEXT)) == 0)
-    {
-        if (key.size != sizeof(SgHashCode))
-            continue;
-        ret = m_db->put(m_db, NULL, &key, &data, DB_NOOVERWRITE);
-        if (ret == DB_KEYEXIST)
-        {
-            confilcts++;
-            T d;
-            d.Unpack(static_cast<byte*>(data.data));
-            T d_orig;
-            DBT key_orig = key;
-            DBT data_orig;
-            memset(&data_orig, 0, sizeof(data_orig));
-            ret = m_db->get(m_db, NULL, &key_orig, &data_orig, 0);
-            if (ret == 0)
-            {
-                d_orig.Unpack(static_cast<byte*>(data_orig.data));
-                if (d_orig.ReplaceBy(d))
-                {
-                    ret = m_db->put(m_db, NULL, &key_orig, &data, 0);
-                    overwrites++;
-                    copied++;
-                }
-            }
-        } else
-            copied++;
-        if (ret != 0) {
-            cursorp->c_close(0);
-            m_db->err(m_db, ret, "%s", m_filename.c_str());
-            throw BenzeneException("HashDB: error in Merge()!");
-        }
-    }
-    cursorp->c_close(cursorp);
-    if (ret != DB_NOTFOUND)
+    key.data = &hash;
+    key.size = sizeof(hash);
+    int ret = m_db->get(m_db, NULL, &key, &data, 0);
+    if (ret == DB_NOTFOUND)
+        return false;
+    if (ret != 0)
     {
-        other.m_db->err(other.m_db, ret, "%s", m_filename.c_str());
-        throw BenzeneException("HashDB: error in Merge()!");
+        m_db->err(m_db, ret, "%s", m_filename.c_str());
+        throw BenzeneException("HashDB: error in GetRaw()!");
     }
-    LogDfpnThread()
-        << "Db merge: copied=" << copied
-        << " confilcts=" << confilcts
-        << " overwrites=" << overwrites << '\n';
+    const byte* p = static_cast<const byte*>(data.data);
+    d.assign(p, p + data.size);
+    return true;
 }
 
 template<class T>
-void HashDB<T>::Dump(std::ofstream& os)
+void HashDB<T>::PutRaw(SgHashCode hash, const byte* d, std::size_t size)
 {
-    SgTimer timer;
-    timer.Start();
-    Header header;
-    GetHeader(header);
-    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (m_store)
+        m_store->Put(hash, d, size);
+    else
+        Put(&hash, sizeof(hash), const_cast<byte*>(d), int(size));
+}
 
+template<class T>
+template<class F>
+void HashDB<T>::ForEachRecord(F& f)
+{
+    if (m_store)
+    {
+        m_store->ForEach(f);
+        return;
+    }
     DBC* cursorp;
     m_db->cursor(m_db, NULL, &cursorp, 0);
 
@@ -410,26 +519,82 @@ void HashDB<T>::Dump(std::ofstream& os)
     memset(&data, 0, sizeof(data));
 
     int ret;
-    size_t count = 0;
     while ((ret = cursorp->c_get(cursorp, &key, &data, DB_NEXT)) == 0)
     {
+        // Skip the header
         if (key.size != sizeof(SgHashCode))
             continue;
-        os.write(reinterpret_cast<const char *>(key.data), key.size);
-        unsigned ds = unsigned(data.size);
-        os.write(reinterpret_cast<const char *>(&ds), sizeof(ds));
-        os.write(reinterpret_cast<const char *>(data.data), data.size);
-        count++;
+        SgHashCode hash;
+        memcpy(&hash, key.data, sizeof(hash));
+        f(hash, static_cast<const byte*>(data.data), data.size);
     }
     cursorp->c_close(cursorp);
     if (ret != DB_NOTFOUND)
     {
         m_db->err(m_db, ret, "%s", m_filename.c_str());
-        throw BenzeneException("HashDB: error in Dump()!");
+        throw BenzeneException("HashDB: error reading records!");
     }
+}
+
+template<class T>
+void HashDB<T>::MergeRecord::operator()(SgHashCode hash, const byte* data,
+                                        std::size_t size)
+{
+    std::vector<byte> orig;
+    if (!m_db.GetRaw(hash, orig))
+    {
+        m_db.PutRaw(hash, data, size);
+        m_copied++;
+        return;
+    }
+    m_conflicts++;
+    T d;
+    d.Unpack(data);
+    T d_orig;
+    d_orig.Unpack(&orig[0]);
+    if (d_orig.ReplaceBy(d))
+    {
+        m_db.PutRaw(hash, data, size);
+        m_overwrites++;
+        m_copied++;
+    }
+}
+
+template<class T>
+void HashDB<T>::DumpRecord::operator()(SgHashCode hash, const byte* data,
+                                       std::size_t size)
+{
+    m_os.write(reinterpret_cast<const char *>(&hash), sizeof(hash));
+    unsigned ds = unsigned(size);
+    m_os.write(reinterpret_cast<const char *>(&ds), sizeof(ds));
+    m_os.write(reinterpret_cast<const char *>(data), size);
+    m_count++;
+}
+
+template<class T>
+void HashDB<T>::Merge(HashDB<T>& other)
+{
+    MergeRecord merge(*this);
+    other.ForEachRecord(merge);
+    LogDfpnThread()
+        << "Db merge: copied=" << merge.m_copied
+        << " confilcts=" << merge.m_conflicts
+        << " overwrites=" << merge.m_overwrites << '\n';
+}
+
+template<class T>
+void HashDB<T>::Dump(std::ofstream& os)
+{
+    SgTimer timer;
+    timer.Start();
+    Header header;
+    GetHeader(header);
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    DumpRecord dump(os);
+    ForEachRecord(dump);
     timer.Stop();
     LogDfpnThread()
-        << "Db dump: #entries=" << count
+        << "Db dump: #entries=" << dump.m_count
         << " time=" << timer.GetTime() << '\n';
 }
 
@@ -442,30 +607,19 @@ void HashDB<T>::Restore(std::ifstream& is)
     is.read(reinterpret_cast<char *>(&header), sizeof(header));
     PutHeader(header);
 
-    DBT key, data;
-    memset(&key, 0, sizeof(key));
-    memset(&data, 0, sizeof(data));
-
     size_t count = 0;
+    std::vector<byte> d;
     while (true)
     {
         SgHashCode k;
         is.read(reinterpret_cast<char *>(&k), sizeof(k));
         if (is.eof())
             break;
-        key.size = sizeof(k);
-        key.data = &k;
         unsigned ds;
         is.read(reinterpret_cast<char *>(&ds), sizeof(ds));
-        data.size = ds;
-        byte d[4096];
-        is.read(reinterpret_cast<char *>(d), data.size);
-        data.data = d;
-        int ret;
-        if ((ret = m_db->put(m_db, NULL, &key, &data, 0)) != 0) {
-            m_db->err(m_db, ret, "%s", m_filename.c_str());
-            throw BenzeneException("HashDB: error in Restore()!");
-        }
+        d.resize(std::max(ds, 1u));
+        is.read(reinterpret_cast<char *>(&d[0]), ds);
+        PutRaw(k, &d[0], ds);
         count++;
     }
     timer.Stop();
@@ -477,6 +631,8 @@ void HashDB<T>::Restore(std::ifstream& is)
 template<class T>
 std::string HashDB<T>::BDBStatistics()
 {
+    if (m_store)
+        return m_store->Statistics();
     DB_HASH_STAT* stats_ptr;
     int ret;
     if ((ret = m_db->stat(m_db, NULL, &stats_ptr, 0)) != 0) {
@@ -0,0 +1,457 @@
+//----------------------------------------------------------------------------
+/** @file MappedHashStore.cpp */
+//----------------------------------------------------------------------------
+
+#include "SgSystem.h"
+
+#include "MappedHashStore.hpp"
+#include "BenzeneException.hpp"
+#include "Logger.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace benzene;
+
+//----------------------------------------------------------------------------
+
+namespace {
+
+const char MAGIC[] = "BENZENE_MAPPED_HASH_STORE_1";
+
+/** Smallest mapping of the log, and granularity of its growth. */
+const std::size_t LOG_MAP_CHUNK = std::size_t(1) << 20;
+
+const std::size_t MIN_INDEX_CAPACITY = 1024;
+
+void WriteAll(int fd, const void* data, std::size_t size, off_t offset,
+              const std::string& filename)
+{
+    const char* p = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        ssize_t written = pwrite(fd, p, size, offset);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw BenzeneException() << "MappedHashStore: error writing '"
+                                     << filename << "': "
+                                     << strerror(errno);
+        }
+        p += written;
+        size -= std::size_t(written);
+        offset += written;
+    }
+}
+
+std::size_t IndexBytes(std::size_t capacity, std::size_t slotSize,
+                       std::size_t headerSize)
+{
+    return headerSize + capacity * slotSize;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+
+MappedHashStore::MappedHashStore(const std::string& filename,
+                                 const std::string& type)
+    : m_filename(filename),
+      m_logFd(-1),
+      m_log(0),
+      m_logMapped(0),
+      m_logEnd(0),
+      m_indexFd(-1),
+      m_index(0),
+      m_indexMapped(0)
+{
+    m_logFd = open(filename.c_str(), O_RDWR | O_CREAT, 0664);
+    if (m_logFd < 0)
+        throw BenzeneException() << "MappedHashStore: cannot open '"
+                                 << filename << "': " << strerror(errno);
+    try {
+        struct stat st;
+        if (fstat(m_logFd, &st) != 0)
+            throw BenzeneException() << "MappedHashStore: cannot stat '"
+                                     << filename << "'";
+        std::size_t fileSize = std::size_t(st.st_size);
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        if (fileSize == 0)
+        {
+            strncpy(header.m_magic, MAGIC, MAGIC_LENGTH - 1);
+            strncpy(header.m_type, type.c_str(), TYPE_LENGTH - 1);
+            WriteAll(m_logFd, &header, sizeof(header), 0, m_filename);
+            if (fsync(m_logFd) != 0)
+                throw BenzeneException() << "MappedHashStore: cannot sync '"
+                                         << filename << "'";
+            fileSize = sizeof(header);
+        }
+        else if (fileSize < sizeof(header)
+                 || pread(m_logFd, &header, sizeof(header), 0)
+                    != ssize_t(sizeof(header))
+                 || strncmp(header.m_magic, MAGIC, MAGIC_LENGTH) != 0)
+            throw BenzeneException() << "MappedHashStore: '" << filename
+                                     << "' is not a mapped hash store";
+        header.m_type[TYPE_LENGTH - 1] = 0;
+        m_type = header.m_type;
+        if (m_type != type.substr(0, TYPE_LENGTH - 1))
+            throw BenzeneException()
+                << "MappedHashStore: Conflicting database types. "
+                << "old: '" << m_type << "' "
+                << "new: '" << type << "'\n";
+        MapLog(fileSize);
+        m_logEnd = RecoverLog(fileSize);
+        if (!OpenIndex())
+        {
+            std::size_t records = 0;
+            for (std::size_t offset = sizeof(FileHeader); offset < m_logEnd;
+                 offset += RecordSize(Record(offset).m_size))
+                ++records;
+            std::size_t capacity = MIN_INDEX_CAPACITY;
+            while (capacity < 2 * records)
+                capacity *= 2;
+            BuildIndex(capacity, true);
+        }
+        // A crash from now on makes the index untrusted
+        Header().m_clean = 0;
+        msync(m_index, sizeof(IndexHeader), MS_SYNC);
+    }
+    catch (...) {
+        Close(false);
+        throw;
+    }
+}
+
+MappedHashStore::~MappedHashStore()
+{
+    Close(true);
+}
+
+bool MappedHashStore::IsMappedFile(const std::string& filename)
+{
+    std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+    char magic[MAGIC_LENGTH];
+    if (!is.read(magic, MAGIC_LENGTH))
+        return false;
+    return strncmp(magic, MAGIC, MAGIC_LENGTH) == 0;
+}
+
+std::string MappedHashStore::Type() const
+{
+    return m_type;
+}
+
+MappedHashStore::IndexHeader& MappedHashStore::Header() const
+{
+    return *reinterpret_cast<IndexHeader*>(m_index);
+}
+
+MappedHashStore::Slot* MappedHashStore::Slots() const
+{
+    return reinterpret_cast<Slot*>(m_index + sizeof(IndexHeader));
+}
+
+const MappedHashStore::RecordHeader&
+MappedHashStore::Record(boost::uint64_t offset) const
+{
+    return *reinterpret_cast<const RecordHeader*>(m_log + offset);
+}
+
+std::size_t MappedHashStore::RecordSize(std::size_t size)
+{
+    // Records start at multiples of 8
+    return (sizeof(RecordHeader) + size + 7) & ~std::size_t(7);
+}
+
+boost::uint32_t MappedHashStore::Checksum(SgHashCode hash, const byte* data,
+                                          std::size_t size)
+{
+    // FNV-1a over the hash, the size and the data
+    boost::uint32_t sum = 2166136261u;
+    const byte* h = reinterpret_cast<const byte*>(&hash);
+    for (std::size_t i = 0; i < sizeof(hash); ++i)
+        sum = (sum ^ h[i]) * 16777619u;
+    for (std::size_t i = 0; i < 4; ++i)
+        sum = (sum ^ byte(size >> (8 * i))) * 16777619u;
+    for (std::size_t i = 0; i < size; ++i)
+        sum = (sum ^ data[i]) * 16777619u;
+    return sum;
+}
+
+bool MappedHashStore::Insert(Slot* slots, std::size_t capacity,
+                             SgHashCode hash, boost::uint64_t offset)
+{
+    std::size_t i = hash.Code1() & (capacity - 1);
+    while (slots[i].m_offset != 0)
+    {
+        if (slots[i].m_hash == hash)
+        {
+            slots[i].m_offset = offset;
+            return false;
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+    slots[i].m_hash = hash;
+    slots[i].m_offset = offset;
+    return true;
+}
+
+const MappedHashStore::Slot* MappedHashStore::Find(SgHashCode hash) const
+{
+    const std::size_t capacity = Header().m_capacity;
+    const Slot* slots = Slots();
+    for (std::size_t i = hash.Code1() & (capacity - 1);
+         slots[i].m_offset != 0; i = (i + 1) & (capacity - 1))
+        if (slots[i].m_hash == hash)
+            return &slots[i];
+    return 0;
+}
+
+void MappedHashStore::MapLog(std::size_t length)
+{
+    if (m_log)
+        munmap(m_log, m_logMapped);
+    m_log = 0;
+    // The mapping may extend past the end of the file; only the
+    // part below m_logEnd is ever read.
+    std::size_t mapped = (length + LOG_MAP_CHUNK - 1) & ~(LOG_MAP_CHUNK - 1);
+    void* p = mmap(0, mapped, PROT_READ, MAP_SHARED, m_logFd, 0);
+    if (p == MAP_FAILED)
+        throw BenzeneException() << "MappedHashStore: cannot map '"
+                                 << m_filename << "': " << strerror(errno);
+    m_log = static_cast<byte*>(p);
+    m_logMapped = mapped;
+}
+
+std::size_t MappedHashStore::RecoverLog(std::size_t fileSize)
+{
+    std::size_t offset = sizeof(FileHeader);
+    while (offset + sizeof(RecordHeader) <= fileSize)
+    {
+        const RecordHeader& record = Record(offset);
+        if (record.m_size > fileSize
+            || offset + RecordSize(record.m_size) > fileSize
+            || Checksum(record.m_hash,
+                        reinterpret_cast<const byte*>(&record + 1),
+                        record.m_size) != record.m_checksum)
+            break;
+        offset += RecordSize(record.m_size);
+    }
+    if (offset < fileSize)
+    {
+        LogWarning() << "MappedHashStore: dropping " << (fileSize - offset)
+                     << " bytes of incomplete records at the end of '"
+                     << m_filename << "'\n";
+        if (ftruncate(m_logFd, off_t(offset)) != 0)
+            throw BenzeneException() << "MappedHashStore: cannot truncate '"
+                                     << m_filename << "'";
+    }
+    return offset;
+}
+
+bool MappedHashStore::OpenIndex()
+{
+    const std::string name = m_filename + ".idx";
+    int fd = open(name.c_str(), O_RDWR);
+    if (fd < 0)
+        return false;
+    IndexHeader header;
+    struct stat st;
+    if (pread(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header))
+        || fstat(fd, &st) != 0
+        || strncmp(header.m_magic, MAGIC, MAGIC_LENGTH) != 0
+        || header.m_clean != 1
+        || header.m_logEnd != m_logEnd
+        || header.m_capacity == 0
+        || (header.m_capacity & (header.m_capacity - 1)) != 0
+        || std::size_t(st.st_size) != IndexBytes(header.m_capacity,
+                                                 sizeof(Slot),
+                                                 sizeof(IndexHeader)))
+    {
+        LogInfo() << "MappedHashStore: rebuilding index of '"
+                  << m_filename << "'\n";
+        close(fd);
+        return false;
+    }
+    void* p = mmap(0, std::size_t(st.st_size), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+    MapIndex(fd, static_cast<byte*>(p), std::size_t(st.st_size));
+    return true;
+}
+
+void MappedHashStore::BuildIndex(std::size_t capacity, bool fromLog)
+{
+    const std::string name = m_filename + ".idx";
+    const std::string tmpName = name + ".tmp";
+    int fd = open(tmpName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0664);
+    if (fd < 0)
+        throw BenzeneException() << "MappedHashStore: cannot create '"
+                                 << tmpName << "': " << strerror(errno);
+    const std::size_t bytes = IndexBytes(capacity, sizeof(Slot),
+                                         sizeof(IndexHeader));
+    void* p = MAP_FAILED;
+    if (ftruncate(fd, off_t(bytes)) == 0)
+        p = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        close(fd);
+        throw BenzeneException() << "MappedHashStore: cannot map '"
+                                 << tmpName << "'";
+    }
+    byte* index = static_cast<byte*>(p);
+    IndexHeader& header = *reinterpret_cast<IndexHeader*>(index);
+    strncpy(header.m_magic, MAGIC, MAGIC_LENGTH - 1);
+    header.m_capacity = capacity;
+    header.m_count = 0;
+    header.m_logEnd = m_logEnd;
+    header.m_clean = 0;
+    Slot* slots = reinterpret_cast<Slot*>(index + sizeof(IndexHeader));
+    if (fromLog)
+    {
+        // Later records of a hash replace earlier ones
+        for (std::size_t offset = sizeof(FileHeader); offset < m_logEnd;
+             offset += RecordSize(Record(offset).m_size))
+            if (Insert(slots, capacity, Record(offset).m_hash, offset))
+                ++header.m_count;
+    }
+    else
+    {
+        const Slot* oldSlots = Slots();
+        for (std::size_t i = 0; i < Header().m_capacity; ++i)
+            if (oldSlots[i].m_offset != 0)
+            {
+                Insert(slots, capacity, oldSlots[i].m_hash,
+                       oldSlots[i].m_offset);
+                ++header.m_count;
+            }
+    }
+    if (rename(tmpName.c_str(), name.c_str()) != 0)
+    {
+        munmap(index, bytes);
+        close(fd);
+        throw BenzeneException() << "MappedHashStore: cannot rename '"
+                                 << tmpName << "'";
+    }
+    UnmapIndex();
+    MapIndex(fd, index, bytes);
+}
+
+void MappedHashStore::MapIndex(int fd, byte* index, std::size_t length)
+{
+    m_indexFd = fd;
+    m_index = index;
+    m_indexMapped = length;
+}
+
+void MappedHashStore::UnmapIndex()
+{
+    if (m_index)
+        munmap(m_index, m_indexMapped);
+    if (m_indexFd >= 0)
+        close(m_indexFd);
+    m_index = 0;
+    m_indexMapped = 0;
+    m_indexFd = -1;
+}
+
+void MappedHashStore::Close(bool clean)
+{
+    if (clean && m_index)
+    {
+        // The log must be on disk before the index claims to match it
+        fsync(m_logFd);
+        msync(m_index, m_indexMapped, MS_SYNC);
+        Header().m_logEnd = m_logEnd;
+        Header().m_clean = 1;
+        msync(m_index, sizeof(IndexHeader), MS_SYNC);
+    }
+    UnmapIndex();
+    if (m_log)
+        munmap(m_log, m_logMapped);
+    m_log = 0;
+    if (m_logFd >= 0)
+        close(m_logFd);
+    m_logFd = -1;
+}
+
+bool MappedHashStore::Exists(SgHashCode hash) const
+{
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+    return Find(hash) != 0;
+}
+
+bool MappedHashStore::Get(SgHashCode hash, std::vector<byte>& data) const
+{
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+    const Slot* slot = Find(hash);
+    if (!slot)
+        return false;
+    const RecordHeader& record = Record(slot->m_offset);
+    const byte* p = reinterpret_cast<const byte*>(&record + 1);
+    data.assign(p, p + record.m_size);
+    return true;
+}
+
+void MappedHashStore::Put(SgHashCode hash, const byte* data, std::size_t size)
+{
+    boost::unique_lock<boost::shared_mutex> lock(m_mutex);
+    if (2 * (Header().m_count + 1) > Header().m_capacity)
+        BuildIndex(2 * Header().m_capacity, false);
+    const std::size_t recordSize = RecordSize(size);
+    std::vector<byte> buffer(recordSize, 0);
+    RecordHeader& record = *reinterpret_cast<RecordHeader*>(&buffer[0]);
+    record.m_hash = hash;
+    record.m_size = boost::uint32_t(size);
+    record.m_checksum = Checksum(hash, data, size);
+    if (size)
+        memcpy(&buffer[sizeof(RecordHeader)], data, size);
+    // The record is complete in the log before the index points to it
+    WriteAll(m_logFd, &buffer[0], recordSize, off_t(m_logEnd), m_filename);
+    if (m_logEnd + recordSize > m_logMapped)
+        MapLog(2 * (m_logEnd + recordSize));
+    if (Insert(Slots(), Header().m_capacity, hash, m_logEnd))
+        ++Header().m_count;
+    m_logEnd += recordSize;
+}
+
+void MappedHashStore::Flush()
+{
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+    fsync(m_logFd);
+    msync(m_index, m_indexMapped, MS_SYNC);
+}
+
+std::size_t MappedHashStore::Size() const
+{
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+    return std::size_t(Header().m_count);
+}
+
+std::string MappedHashStore::Statistics() const
+{
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+    std::ostringstream os;
+    os << "[\n";
+    os << "type=" << m_type << '\n';
+    os << "nkeys=" << Header().m_count << '\n';
+    os << "capacity=" << Header().m_capacity << '\n';
+    os << "logbytes=" << m_logEnd << '\n';
+    os << ']';
+    return os.str();
+}
+
+//----------------------------------------------------------------------------
@@ -0,0 +1,198 @@
+//----------------------------------------------------------------------------
+/** @file MappedHashStore.hpp */
+//----------------------------------------------------------------------------
+
+#ifndef MAPPEDHASHSTORE_HPP
+#define MAPPEDHASHSTORE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/utility.hpp>
+
+#include "SgHash.h"
+#include "Benzene.hpp"
+#include "Types.hpp"
+
+_BEGIN_BENZENE_NAMESPACE_
+
+//----------------------------------------------------------------------------
+
+/** Persistent map from hash codes to byte strings in two
+    memory-mapped files.
+
+    The data file starts with a header holding a magic string and the
+    type of the data, followed by a log of records (hash, size,
+    checksum, data) that is only ever appended to; a put of an
+    existing hash appends a new record. The index file (the data file
+    name plus ".idx") is an open-addressing table from hash to the
+    offset of the latest record of that hash.
+
+    The index is only trusted if it was closed cleanly at the current
+    end of the log. Otherwise, e.g. after a crash, the log is scanned
+    from the start: it is cut at the first record that is incomplete
+    or fails its checksum and the index is rebuilt from it.
+
+    Any number of threads may read at the same time; a put waits for
+    the readers and excludes them while it appends. Used by HashDB as
+    an alternative to Berkeley DB. */
+class MappedHashStore : private boost::noncopyable
+{
+public:
+    /** Opens the store, creating it if the file does not exist.
+        Throws a BenzeneException if the file is not a store or holds
+        data of another type. */
+    MappedHashStore(const std::string& filename, const std::string& type);
+
+    /** Writes the index and closes the store. */
+    ~MappedHashStore();
+
+    /** Returns true if filename starts with the header of a
+        store. */
+    static bool IsMappedFile(const std::string& filename);
+
+    /** Type given when the store was created. */
+    std::string Type() const;
+
+    bool Exists(SgHashCode hash) const;
+
+    /** Copies the data stored under hash into data and returns true,
+        or returns false if there is none. */
+    bool Get(SgHashCode hash, std::vector<byte>& data) const;
+
+    /** Stores size bytes of data under hash. */
+    void Put(SgHashCode hash, const byte* data, std::size_t size);
+
+    /** Writes the log and index to disk. */
+    void Flush();
+
+    /** Calls f(SgHashCode, const byte* data, std::size_t size) for
+        the latest record of each hash. Puts wait until it returns. */
+    template<class F>
+    void ForEach(F& f) const;
+
+    /** Number of hashes stored. */
+    std::size_t Size() const;
+
+    std::string Statistics() const;
+
+private:
+    static const int MAGIC_LENGTH = 32;
+
+    static const int TYPE_LENGTH = 32;
+
+    struct FileHeader
+    {
+        char m_magic[MAGIC_LENGTH];
+
+        char m_type[TYPE_LENGTH];
+    };
+
+    struct RecordHeader
+    {
+        SgHashCode m_hash;
+
+        boost::uint32_t m_size;
+
+        boost::uint32_t m_checksum;
+    };
+
+    struct IndexHeader
+    {
+        char m_magic[MAGIC_LENGTH];
+
+        boost::uint64_t m_capacity;
+
+        boost::uint64_t m_count;
+
+        /** End of the log the index was written for. */
+        boost::uint64_t m_logEnd;
+
+        /** Zero while the store is open. */
+        boost::uint64_t m_clean;
+    };
+
+    struct Slot
+    {
+        SgHashCode m_hash;
+
+        /** Offset of the record in the log; zero if the slot is
+            empty. */
+        boost::uint64_t m_offset;
+    };
+
+    std::string m_filename;
+
+    std::string m_type;
+
+    int m_logFd;
+
+    /** Read-only mapping of the log; may extend past its end. */
+    byte* m_log;
+
+    std::size_t m_logMapped;
+
+    std::size_t m_logEnd;
+
+    int m_indexFd;
+
+    byte* m_index;
+
+    std::size_t m_indexMapped;
+
+    mutable boost::shared_mutex m_mutex;
+
+    IndexHeader& Header() const;
+
+    Slot* Slots() const;
+
+    const RecordHeader& Record(boost::uint64_t offset) const;
+
+    const Slot* Find(SgHashCode hash) const;
+
+    static std::size_t RecordSize(std::size_t size);
+
+    static boost::uint32_t Checksum(SgHashCode hash, const byte* data,
+                                    std::size_t size);
+
+    static bool Insert(Slot* slots, std::size_t capacity, SgHashCode hash,
+                       boost::uint64_t offset);
+
+    void MapLog(std::size_t length);
+
+    std::size_t RecoverLog(std::size_t fileSize);
+
+    bool OpenIndex();
+
+    void BuildIndex(std::size_t capacity, bool fromLog);
+
+    void MapIndex(int fd, byte* index, std::size_t length);
+
+    void UnmapIndex();
+
+    /** Unmaps and closes the files; marks the index clean if clean
+        is set. */
+    void Close(bool clean);
+};
+
+template<class F>
+void MappedHashStore::ForEach(F& f) const
+{
+    boost::shared_lock<boost::shared_mutex> lock(m_mutex);
+    const Slot* slots = Slots();
+    for (std::size_t i = 0; i < Header().m_capacity; ++i)
+        if (slots[i].m_offset != 0)
+        {
+            const RecordHeader& record = Record(slots[i].m_offset);
+            f(record.m_hash, reinterpret_cast<const byte*>(&record + 1),
+              std::size_t(record.m_size));
+        }
+}
+
+//----------------------------------------------------------------------------
+
+_END_BENZENE_NAMESPACE_
+
+#endif // MAPPEDHASHSTORE_HPP
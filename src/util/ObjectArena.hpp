@@ -0,0 +1,232 @@
+//----------------------------------------------------------------------------
+/** @file ObjectArena.hpp
+    Slab allocator for objects that are recycled instead of freed.
+ */
+//----------------------------------------------------------------------------
+
+#ifndef OBJECTARENA_HPP
+#define OBJECTARENA_HPP
+
+#include "Benzene.hpp"
+#include "BenzeneAssert.hpp"
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/utility.hpp>
+
+_BEGIN_BENZENE_NAMESPACE_
+
+//----------------------------------------------------------------------------
+
+/** Hands out objects of type T from slabs of SlabSize objects.
+
+    Objects are default constructed once, when their slab is
+    allocated, and are destroyed only with the arena. Delete() puts an
+    object on a free list and DeleteAll() releases every object in
+    constant time; neither frees memory. New() reuses released
+    objects after calling T::Clear(), which must restore the
+    default-constructed state. Heap buffers owned by T (e.g. vector
+    capacity) survive this, so a warmed-up arena does no allocation.
+
+    Pointers returned by New() stay valid until the arena is
+    destroyed, but the object may be handed out again once released. */
+template<typename T, std::size_t SlabSize = 256>
+class ObjectArena : boost::noncopyable
+{
+public:
+    /** Usage counters. */
+    struct Statistics
+    {
+        /** Number of slabs allocated. */
+        std::size_t slabs;
+
+        /** Objects in all slabs. */
+        std::size_t capacity;
+
+        /** Objects currently handed out. */
+        std::size_t in_use;
+
+        /** Most objects handed out at once since construction. */
+        std::size_t peak;
+
+        /** Bytes in slabs, not counting heap memory owned by the
+            objects. */
+        std::size_t bytes;
+
+        std::string ToString() const;
+    };
+
+    ObjectArena();
+
+    ~ObjectArena();
+
+    /** Returns an object in its default-constructed state. */
+    T* New();
+
+    /** Returns obj to the arena. */
+    void Delete(T* obj);
+
+    /** Returns all objects to the arena. */
+    void DeleteAll();
+
+    Statistics GetStatistics() const;
+
+    /** Undo support
+        Used to roll back New() and Delete() calls in reverse order. */
+    // @{
+
+    /** Which objects are handed out; does not include their values. */
+    struct State
+    {
+        std::size_t next;
+
+        std::vector<T*> free;
+    };
+
+    /** Whether the next New() reuses a deleted object. */
+    bool HasDeleted() const;
+
+    /** Undoes the last New(), which returned obj. */
+    void UndoNew(T* obj, bool reusedDeleted);
+
+    /** Undoes the last Delete() of obj. */
+    void UndoDelete(T* obj);
+
+    void GetState(State& state) const;
+
+    void SetState(const State& state);
+
+    // @}
+
+private:
+    std::vector<T*> m_slabs;
+
+    /** Index of the first never-handed-out object since the last
+        DeleteAll(). */
+    std::size_t m_next;
+
+    std::vector<T*> m_free;
+
+    std::size_t m_peak;
+};
+
+template<typename T, std::size_t SlabSize>
+inline ObjectArena<T, SlabSize>::ObjectArena()
+    : m_next(0),
+      m_peak(0)
+{
+}
+
+template<typename T, std::size_t SlabSize>
+inline ObjectArena<T, SlabSize>::~ObjectArena()
+{
+    for (std::size_t i = 0; i < m_slabs.size(); ++i)
+        delete [] m_slabs[i];
+}
+
+template<typename T, std::size_t SlabSize>
+inline T* ObjectArena<T, SlabSize>::New()
+{
+    T* obj;
+    if (!m_free.empty())
+    {
+        obj = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        if (m_next == m_slabs.size() * SlabSize)
+            m_slabs.push_back(new T[SlabSize]);
+        obj = m_slabs[m_next / SlabSize] + m_next % SlabSize;
+        ++m_next;
+        if (m_next > m_peak)
+            m_peak = m_next;
+    }
+    obj->Clear();
+    return obj;
+}
+
+template<typename T, std::size_t SlabSize>
+inline void ObjectArena<T, SlabSize>::Delete(T* obj)
+{
+    BenzeneAssert(obj);
+    m_free.push_back(obj);
+}
+
+template<typename T, std::size_t SlabSize>
+inline void ObjectArena<T, SlabSize>::DeleteAll()
+{
+    m_next = 0;
+    m_free.clear();
+}
+
+template<typename T, std::size_t SlabSize>
+inline bool ObjectArena<T, SlabSize>::HasDeleted() const
+{
+    return !m_free.empty();
+}
+
+template<typename T, std::size_t SlabSize>
+inline void ObjectArena<T, SlabSize>::UndoNew(T* obj, bool reusedDeleted)
+{
+    if (reusedDeleted)
+        m_free.push_back(obj);
+    else
+    {
+        BenzeneAssert(m_next > 0);
+        --m_next;
+        BenzeneAssert(obj == m_slabs[m_next / SlabSize] + m_next % SlabSize);
+    }
+}
+
+template<typename T, std::size_t SlabSize>
+inline void ObjectArena<T, SlabSize>::UndoDelete(T* obj)
+{
+    BenzeneAssert(!m_free.empty() && m_free.back() == obj);
+    m_free.pop_back();
+}
+
+template<typename T, std::size_t SlabSize>
+inline void ObjectArena<T, SlabSize>::GetState(State& state) const
+{
+    state.next = m_next;
+    state.free = m_free;
+}
+
+template<typename T, std::size_t SlabSize>
+inline void ObjectArena<T, SlabSize>::SetState(const State& state)
+{
+    BenzeneAssert(state.next <= m_slabs.size() * SlabSize);
+    m_next = state.next;
+    m_free = state.free;
+}
+
+template<typename T, std::size_t SlabSize>
+typename ObjectArena<T, SlabSize>::Statistics
+ObjectArena<T, SlabSize>::GetStatistics() const
+{
+    Statistics stats;
+    stats.slabs = m_slabs.size();
+    stats.capacity = m_slabs.size() * SlabSize;
+    stats.in_use = m_next - m_free.size();
+    stats.peak = m_peak;
+    stats.bytes = stats.capacity * sizeof(T);
+    return stats;
+}
+
+template<typename T, std::size_t SlabSize>
+std::string ObjectArena<T, SlabSize>::Statistics::ToString() const
+{
+    std::ostringstream os;
+    os << "in use " << in_use << '/' << capacity
+       << " peak " << peak
+       << " slabs " << slabs
+       << " (" << bytes / 1024 << "kb)";
+    return os.str();
+}
+
+//----------------------------------------------------------------------------
+
+_END_BENZENE_NAMESPACE_
+
+#endif // OBJECTARENA_HPP
@@ -0,0 +1,471 @@
+//----------------------------------------------------------------------------
+/** @file ShardedHashTable.hpp
+    Contains a thread-safe hash table with one lock per bucket.
+ */
+//----------------------------------------------------------------------------
+
+#ifndef SHARDEDHASHTABLE_HPP
+#define SHARDEDHASHTABLE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/utility.hpp>
+
+#include "SgHash.h"
+#include "SgHashTable.h"
+#include "SgWrite.h"
+#include "Benzene.hpp"
+
+_BEGIN_BENZENE_NAMESPACE_
+
+//----------------------------------------------------------------------------
+
+/** Default out-of-line part of ShardedHashTable entries: none. */
+struct NoColdData
+{
+};
+
+/** Rule of ShardedHashTable::StoreUnless() that never keeps. */
+template<class DATA>
+struct AlwaysReplace
+{
+    bool operator()(const DATA&) const
+    {
+        return false;
+    }
+};
+
+//----------------------------------------------------------------------------
+
+/** Hash table shared by several threads.
+
+    Drop-in replacement for SgHashTable with the same DATA
+    requirements (IsValid(), Invalidate() and IsBetterThan()). The
+    table is split into buckets of BLOCK_SIZE entries; a code always
+    lives in bucket code.Hash(number of buckets), and a full bucket
+    replaces its least valuable entry. Each bucket has its own
+    spinlock, so threads only wait for each other when they touch the
+    same bucket, and the lock is held only while entries are copied.
+
+    Statistics are kept in NUM_STAT_SHARDS shards, each on its own
+    cache line, selected by the bucket index modulo the number of
+    shards. Threads that touch unrelated buckets can still share a
+    shard, but all threads no longer count on the same line.
+
+    DATA is copied under the lock, so it may hold heap memory.
+
+    Each entry can have a COLD part that is stored out of line, in an
+    array parallel to the buckets, and copied only by the methods that
+    take it. Keep in DATA what is looked up often and in COLD what is
+    large; the COLD part of a replaced entry is assigned to, so memory
+    it owns is reused. */
+template<class DATA, int BLOCK_SIZE = 4, class COLD = NoColdData>
+class ShardedHashTable : private boost::noncopyable
+{
+public:
+    /** Creates a table with at least maxHash entries. */
+    explicit ShardedHashTable(int maxHash);
+
+    ~ShardedHashTable();
+
+    /** Marks all entries as invalid and resets the statistics.
+        Must not be called while other threads use the table. */
+    void Clear();
+
+    /** Number of entries requested at construction. */
+    int MaxHash() const;
+
+    /** Returns true and copies the data stored under code into data,
+        or returns false if none is stored. */
+    bool Lookup(const SgHashCode& code, DATA* data) const;
+
+    /** Same as Lookup(), but also copies the COLD part into cold. */
+    bool Lookup(const SgHashCode& code, DATA* data, COLD* cold) const;
+
+    /** Stores data and a default COLD part under code. Always
+        returns true. */
+    bool Store(const SgHashCode& code, const DATA& data);
+
+    /** Stores data and cold under code. Always returns true. */
+    bool Store(const SgHashCode& code, const DATA& data, const COLD& cold);
+
+    /** Stores data under code unless the entry already stored under
+        code satisfies keep. In that case the stored entry is copied
+        into data and false is returned. The test and the store are
+        one atomic step. */
+    template<class KEEP>
+    bool StoreUnless(const SgHashCode& code, DATA& data, KEEP keep);
+
+    /** Same as StoreUnless(code, data, keep) with a COLD part, which
+        is copied back into cold along with data if the stored entry
+        is kept. */
+    template<class KEEP>
+    bool StoreUnless(const SgHashCode& code, DATA& data, COLD& cold,
+                     KEEP keep);
+
+    /** Calls f(const SgHashCode&, const DATA&, const COLD&) for each
+        valid entry.
+        Other threads may keep using the table: each bucket is copied
+        under its lock and f is called on the copy, so f never runs
+        with a lock held. Entries stored during the walk may or may
+        not be visited. */
+    template<class F>
+    void ForEach(F f) const;
+
+    /** Number of collisions on store. */
+    std::size_t NuCollisions() const;
+
+    /** Total number of stores attempted. */
+    std::size_t NuStores() const;
+
+    /** Total number of lookups attempted. */
+    std::size_t NuLookups() const;
+
+    /** Number of successful lookups. */
+    std::size_t NuFound() const;
+
+private:
+    static const int NUM_STAT_SHARDS = 64;
+
+    struct Bucket
+    {
+        mutable std::atomic_flag m_lock;
+
+        SgHashEntry<DATA> m_entry[BLOCK_SIZE];
+    };
+
+    static const std::size_t CACHE_LINE_SIZE = 64;
+
+    /** Statistics of the buckets with the same index modulo
+        NUM_STAT_SHARDS; padded and aligned to its own cache line. */
+    struct alignas(CACHE_LINE_SIZE) Statistics
+    {
+        std::atomic<std::size_t> m_nuCollisions;
+
+        std::atomic<std::size_t> m_nuStores;
+
+        std::atomic<std::size_t> m_nuLookups;
+
+        std::atomic<std::size_t> m_nuFound;
+    };
+
+    /** Holds a bucket's lock for its lifetime. */
+    class Lock
+    {
+    public:
+        explicit Lock(const Bucket& bucket);
+
+        ~Lock();
+
+    private:
+        const Bucket& m_bucket;
+    };
+
+    int m_maxHash;
+
+    int m_numBuckets;
+
+    boost::scoped_array<Bucket> m_buckets;
+
+    /** COLD part of entry i of bucket h at h * BLOCK_SIZE + i. */
+    boost::scoped_array<COLD> m_cold;
+
+    /** Storage of m_stats, with room to align it: the table is
+        allocated with new, which ignores alignas before C++17. */
+    boost::scoped_array<char> m_statsStorage;
+
+    /** NUM_STAT_SHARDS shards in m_statsStorage. */
+    Statistics* m_stats;
+
+    Statistics& Stats(int bucket) const;
+
+    std::size_t Sum(std::atomic<std::size_t> Statistics::*counter) const;
+
+    /** Stores data and cold unless keep holds for the entry stored
+        under code and keptData is not null; then copies that entry
+        to keptData and keptCold instead. */
+    template<class KEEP>
+    bool DoStore(const SgHashCode& code, const DATA& data, const COLD& cold,
+                 KEEP keep, DATA* keptData, COLD* keptCold);
+
+    /** Returns the slot to write code into; must hold the lock. */
+    static int FindSlot(const Bucket& bucket, const SgHashCode& code,
+                        bool& collision);
+};
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+ShardedHashTable<DATA, BLOCK_SIZE, COLD>::Lock::Lock(const Bucket& bucket)
+    : m_bucket(bucket)
+{
+    int spins = 0;
+    while (m_bucket.m_lock.test_and_set(std::memory_order_acquire))
+        if (++spins % 64 == 0)
+            boost::this_thread::yield();
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+ShardedHashTable<DATA, BLOCK_SIZE, COLD>::Lock::~Lock()
+{
+    m_bucket.m_lock.clear(std::memory_order_release);
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+ShardedHashTable<DATA, BLOCK_SIZE, COLD>::ShardedHashTable(int maxHash)
+    : m_maxHash(maxHash),
+      m_numBuckets(std::max(1, (maxHash + BLOCK_SIZE - 1) / BLOCK_SIZE)),
+      m_buckets(new Bucket[m_numBuckets]),
+      m_cold(new COLD[m_numBuckets * BLOCK_SIZE]),
+      m_statsStorage(new char[(NUM_STAT_SHARDS + 1) * sizeof(Statistics)])
+{
+    for (int i = 0; i < m_numBuckets; ++i)
+        m_buckets[i].m_lock.clear();
+    void* storage = m_statsStorage.get();
+    std::size_t space = (NUM_STAT_SHARDS + 1) * sizeof(Statistics);
+    m_stats = static_cast<Statistics*>
+        (std::align(alignof(Statistics), NUM_STAT_SHARDS * sizeof(Statistics),
+                    storage, space));
+    for (int i = 0; i < NUM_STAT_SHARDS; ++i)
+        new (&m_stats[i]) Statistics;
+    Clear();
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+ShardedHashTable<DATA, BLOCK_SIZE, COLD>::~ShardedHashTable()
+{
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+void ShardedHashTable<DATA, BLOCK_SIZE, COLD>::Clear()
+{
+    for (int i = 0; i < m_numBuckets; ++i)
+        for (int j = 0; j < BLOCK_SIZE; ++j)
+            m_buckets[i].m_entry[j].m_data.Invalidate();
+    for (int i = 0; i < NUM_STAT_SHARDS; ++i)
+    {
+        m_stats[i].m_nuCollisions = 0;
+        m_stats[i].m_nuStores = 0;
+        m_stats[i].m_nuLookups = 0;
+        m_stats[i].m_nuFound = 0;
+    }
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+inline int ShardedHashTable<DATA, BLOCK_SIZE, COLD>::MaxHash() const
+{
+    return m_maxHash;
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+inline typename ShardedHashTable<DATA, BLOCK_SIZE, COLD>::Statistics&
+ShardedHashTable<DATA, BLOCK_SIZE, COLD>::Stats(int bucket) const
+{
+    return m_stats[bucket % NUM_STAT_SHARDS];
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+inline bool ShardedHashTable<DATA, BLOCK_SIZE, COLD>::Lookup(const SgHashCode& code,
+                                                      DATA* data) const
+{
+    return Lookup(code, data, 0);
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+bool ShardedHashTable<DATA, BLOCK_SIZE, COLD>::Lookup(const SgHashCode& code,
+                                                DATA* data, COLD* cold) const
+{
+    const int h = code.Hash(m_numBuckets);
+    Statistics& stats = Stats(h);
+    stats.m_nuLookups.fetch_add(1, std::memory_order_relaxed);
+    const Bucket& bucket = m_buckets[h];
+    Lock lock(bucket);
+    for (int i = 0; i < BLOCK_SIZE; ++i)
+    {
+        const SgHashEntry<DATA>& entry = bucket.m_entry[i];
+        if (!entry.m_data.IsValid())
+            return false;
+        if (entry.m_hash == code)
+        {
+            *data = entry.m_data;
+            if (cold)
+                *cold = m_cold[h * BLOCK_SIZE + i];
+            stats.m_nuFound.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+int ShardedHashTable<DATA, BLOCK_SIZE, COLD>::FindSlot(const Bucket& bucket,
+                                                       const SgHashCode& code,
+                                                       bool& collision)
+{
+    int best = 0;
+    for (int i = 0; i < BLOCK_SIZE; ++i)
+    {
+        const SgHashEntry<DATA>& entry = bucket.m_entry[i];
+        if (!entry.m_data.IsValid() || entry.m_hash == code)
+        {
+            collision = false;
+            return i;
+        }
+        if (bucket.m_entry[best].m_data.IsBetterThan(entry.m_data))
+            best = i;
+    }
+    collision = true;
+    return best;
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+inline bool ShardedHashTable<DATA, BLOCK_SIZE, COLD>::Store(const SgHashCode& code,
+                                                            const DATA& data)
+{
+    return Store(code, data, COLD());
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+inline bool ShardedHashTable<DATA, BLOCK_SIZE, COLD>::Store(const SgHashCode& code,
+                                                            const DATA& data,
+                                                            const COLD& cold)
+{
+    return DoStore(code, data, cold, AlwaysReplace<DATA>(), 0, 0);
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+template<class KEEP>
+inline bool
+ShardedHashTable<DATA, BLOCK_SIZE, COLD>::StoreUnless(const SgHashCode& code,
+                                                      DATA& data, KEEP keep)
+{
+    COLD cold;
+    return StoreUnless(code, data, cold, keep);
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+template<class KEEP>
+inline bool
+ShardedHashTable<DATA, BLOCK_SIZE, COLD>::StoreUnless(const SgHashCode& code,
+                                                      DATA& data, COLD& cold,
+                                                      KEEP keep)
+{
+    return DoStore(code, data, cold, keep, &data, &cold);
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+template<class KEEP>
+bool ShardedHashTable<DATA, BLOCK_SIZE, COLD>::DoStore(const SgHashCode& code,
+                                                 const DATA& data,
+                                                 const COLD& cold, KEEP keep,
+                                                 DATA* keptData,
+                                                 COLD* keptCold)
+{
+    const int h = code.Hash(m_numBuckets);
+    Statistics& stats = Stats(h);
+    stats.m_nuStores.fetch_add(1, std::memory_order_relaxed);
+    Bucket& bucket = m_buckets[h];
+    Lock lock(bucket);
+    bool collision;
+    const int slot = FindSlot(bucket, code, collision);
+    SgHashEntry<DATA>& entry = bucket.m_entry[slot];
+    COLD& entryCold = m_cold[h * BLOCK_SIZE + slot];
+    if (collision)
+        stats.m_nuCollisions.fetch_add(1, std::memory_order_relaxed);
+    else if (keptData && entry.m_data.IsValid() && keep(entry.m_data))
+    {
+        *keptData = entry.m_data;
+        *keptCold = entryCold;
+        return false;
+    }
+    entry.m_hash = code;
+    entry.m_data = data;
+    entryCold = cold;
+    return true;
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+template<class F>
+void ShardedHashTable<DATA, BLOCK_SIZE, COLD>::ForEach(F f) const
+{
+    SgHashEntry<DATA> copy[BLOCK_SIZE];
+    COLD coldCopy[BLOCK_SIZE];
+    for (int h = 0; h < m_numBuckets; ++h)
+    {
+        const Bucket& bucket = m_buckets[h];
+        int size = 0;
+        {
+            Lock lock(bucket);
+            for (; size < BLOCK_SIZE; ++size)
+            {
+                if (!bucket.m_entry[size].m_data.IsValid())
+                    break;
+                copy[size] = bucket.m_entry[size];
+                coldCopy[size] = m_cold[h * BLOCK_SIZE + size];
+            }
+        }
+        for (int i = 0; i < size; ++i)
+            f(static_cast<const SgHashCode&>(copy[i].m_hash),
+              static_cast<const DATA&>(copy[i].m_data),
+              static_cast<const COLD&>(coldCopy[i]));
+    }
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+std::size_t ShardedHashTable<DATA, BLOCK_SIZE, COLD>::Sum
+(std::atomic<std::size_t> Statistics::*counter) const
+{
+    std::size_t sum = 0;
+    for (int i = 0; i < NUM_STAT_SHARDS; ++i)
+        sum += (m_stats[i].*counter).load(std::memory_order_relaxed);
+    return sum;
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+std::size_t ShardedHashTable<DATA, BLOCK_SIZE, COLD>::NuCollisions() const
+{
+    return Sum(&Statistics::m_nuCollisions);
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+std::size_t ShardedHashTable<DATA, BLOCK_SIZE, COLD>::NuStores() const
+{
+    return Sum(&Statistics::m_nuStores);
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+std::size_t ShardedHashTable<DATA, BLOCK_SIZE, COLD>::NuLookups() const
+{
+    return Sum(&Statistics::m_nuLookups);
+}
+
+template<class DATA, int BLOCK_SIZE, class COLD>
+std::size_t ShardedHashTable<DATA, BLOCK_SIZE, COLD>::NuFound() const
+{
+    return Sum(&Statistics::m_nuFound);
+}
+
+//----------------------------------------------------------------------------
+
+/** Writes statistics on hash table use (not the content). */
+template<class DATA, int BLOCK_SIZE, class COLD>
+std::ostream& operator<<(std::ostream& out,
+                         const ShardedHashTable<DATA, BLOCK_SIZE, COLD>& hash)
+{
+    out << "HashTableStatistics:\n"
+        << SgWriteLabel("Stores") << hash.NuStores() << '\n'
+        << SgWriteLabel("LookupAttempt") << hash.NuLookups() << '\n'
+        << SgWriteLabel("LookupSuccess") << hash.NuFound() << '\n'
+        << SgWriteLabel("Collisions") << hash.NuCollisions() << '\n';
+    return out;
+}
+
+//----------------------------------------------------------------------------
+
+_END_BENZENE_NAMESPACE_
+
+#endif // SHARDEDHASHTABLE_HPP
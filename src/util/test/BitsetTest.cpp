@@ -3,6 +3,8 @@
  */
 //---------------------------------------------------------------------------
 
+#include <bitset>
+#include <cstdlib>
 #include <boost/test/auto_unit_test.hpp>
 
 #include "Bitset.hpp"
@@ -288,6 +290,78 @@ BOOST_AUTO_TEST_CASE(Bitset_FindSingleton)
     BOOST_CHECK_EQUAL(BitsetUtil::FindSetBit(b), BITSETSIZE-1);
 }
 
+/** Checks the word kernels of benzene_bitset<N> against std::bitset
+    on random sparse and dense bitsets. */
+template<size_t N>
+void CheckKernelsAgainstStl()
+{
+    srand(42);
+    for (int trial = 0; trial < 1000; ++trial)
+    {
+        benzene_bitset<N> a, b;
+        std::bitset<N> sa, sb;
+        const int density = 1 + trial % 64;
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (rand() % 64 < density)
+            {
+                a.set(i);
+                sa.set(i);
+            }
+            if (rand() % 64 < density)
+            {
+                b.set(i);
+                sb.set(i);
+            }
+        }
+        if (trial % 5 == 0)
+        {
+            b |= a;
+            sb |= sa;
+        }
+        BOOST_CHECK_EQUAL(a.count(), sa.count());
+        BOOST_CHECK_EQUAL(a.any(), sa.any());
+        BOOST_CHECK_EQUAL((a == b), (sa == sb));
+        BOOST_CHECK_EQUAL(a.is_subset_of(b), ((sa & sb) == sa));
+        BOOST_CHECK_EQUAL(b.is_subset_of(a), ((sa & sb) == sb));
+        BOOST_CHECK(!(a.is_less_than(b) && b.is_less_than(a)));
+        BOOST_CHECK_EQUAL(a.is_less_than(b) || b.is_less_than(a),
+                          (sa != sb));
+        benzene_bitset<N> c = a & b;
+        BOOST_CHECK_EQUAL(c.count(), (sa & sb).count());
+        c = a | b;
+        BOOST_CHECK_EQUAL(c.count(), (sa | sb).count());
+        c = a;
+        c -= b;
+        std::bitset<N> sc = sa & ~sb;
+        BOOST_CHECK_EQUAL(c.count(), sc.count());
+        size_t j = 0;
+        for (size_t i = c._Find_first(); i < N; i = c._Find_next(i), ++j)
+        {
+            while (j < N && !sc.test(j))
+                ++j;
+            BOOST_REQUIRE_EQUAL(i, j);
+        }
+        while (j < N && !sc.test(j))
+            ++j;
+        BOOST_CHECK_EQUAL(j, N);
+    }
+    benzene_bitset<N> e;
+    BOOST_CHECK_EQUAL(e._Find_first(), N);
+    e.set(N - 1);
+    BOOST_CHECK_EQUAL(e._Find_first(), N - 1);
+    BOOST_CHECK_EQUAL(e._Find_next(N - 1), N);
+    BOOST_CHECK(e.any());
+}
+
+BOOST_AUTO_TEST_CASE(Bitset_KernelsMatchStl)
+{
+    CheckKernelsAgainstStl<192>();
+    CheckKernelsAgainstStl<224>();
+    CheckKernelsAgainstStl<384>();
+    CheckKernelsAgainstStl<100>();
+}
+
 }
 
 //---------------------------------------------------------------------------
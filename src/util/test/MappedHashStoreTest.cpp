@@ -0,0 +1,185 @@
+//---------------------------------------------------------------------------
+/** @file MappedHashStoreTest.cpp */
+//---------------------------------------------------------------------------
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/test/auto_unit_test.hpp>
+
+#include "SgSystem.h"
+#include "HashDB.hpp"
+#include "MappedHashStore.hpp"
+
+using namespace benzene;
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+const std::string FILENAME = "MappedHashStoreTest.db";
+
+void RemoveFiles(const std::string& filename)
+{
+    std::remove(filename.c_str());
+    std::remove((filename + ".idx").c_str());
+    std::remove((filename + ".idx.tmp").c_str());
+}
+
+std::vector<byte> Bytes(int value, std::size_t size)
+{
+    return std::vector<byte>(size, byte(value));
+}
+
+struct Data
+{
+    int m_value;
+
+    Data()
+        : m_value(0)
+    { }
+
+    explicit Data(int value)
+        : m_value(value)
+    { }
+
+    int PackedSize() const { return sizeof(m_value); }
+
+    byte* Pack(byte* data) const
+    {
+        *reinterpret_cast<int*>(data) = m_value;
+        return data + sizeof(m_value);
+    }
+
+    void Unpack(const byte* data)
+    {
+        m_value = *reinterpret_cast<const int*>(data);
+    }
+
+    bool ReplaceBy(const Data& data) const { return data.m_value > m_value; }
+};
+
+struct Collect
+{
+    std::map<SgHashCode, std::size_t> m_sizes;
+
+    void operator()(SgHashCode hash, const byte*, std::size_t size)
+    {
+        m_sizes[hash] = size;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(MappedHashStore_PutGetReopen)
+{
+    RemoveFiles(FILENAME);
+    {
+        MappedHashStore store(FILENAME, "test");
+        std::vector<byte> data;
+        BOOST_CHECK(!store.Get(SgHashCode(1), data));
+        // Enough puts to grow the index and the log mapping
+        for (int i = 0; i < 3000; ++i)
+        {
+            std::vector<byte> bytes = Bytes(i, 1 + i % 500);
+            store.Put(SgHashCode(i + 1), &bytes[0], bytes.size());
+        }
+        std::vector<byte> bytes = Bytes(7, 3);
+        store.Put(SgHashCode(5), &bytes[0], bytes.size());
+        BOOST_CHECK_EQUAL(store.Size(), 3000u);
+        BOOST_CHECK(store.Get(SgHashCode(5), data));
+        BOOST_CHECK(data == bytes);
+        Collect collect;
+        store.ForEach(collect);
+        BOOST_CHECK_EQUAL(collect.m_sizes.size(), 3000u);
+        BOOST_CHECK_EQUAL(collect.m_sizes[SgHashCode(5)], 3u);
+    }
+    BOOST_CHECK(MappedHashStore::IsMappedFile(FILENAME));
+    {
+        MappedHashStore store(FILENAME, "test");
+        BOOST_CHECK_EQUAL(store.Size(), 3000u);
+        std::vector<byte> data;
+        BOOST_CHECK(store.Get(SgHashCode(5), data));
+        BOOST_CHECK(data == Bytes(7, 3));
+        BOOST_CHECK(store.Get(SgHashCode(1000), data));
+        BOOST_CHECK(data == Bytes(999, 1 + 999 % 500));
+    }
+    BOOST_CHECK_THROW(MappedHashStore(FILENAME, "other"), BenzeneException);
+    RemoveFiles(FILENAME);
+}
+
+BOOST_AUTO_TEST_CASE(MappedHashStore_RecoverTornRecord)
+{
+    RemoveFiles(FILENAME);
+    {
+        MappedHashStore store(FILENAME, "test");
+        std::vector<byte> bytes = Bytes(1, 10);
+        store.Put(SgHashCode(1), &bytes[0], bytes.size());
+        store.Put(SgHashCode(2), &bytes[0], bytes.size());
+    }
+    // Simulate a crash in the middle of appending a record: a partial
+    // record at the end and an index that was not closed cleanly
+    {
+        std::ofstream os(FILENAME.c_str(), std::ios::binary | std::ios::app);
+        os.write("garbage", 7);
+    }
+    std::remove((FILENAME + ".idx").c_str());
+    {
+        MappedHashStore store(FILENAME, "test");
+        BOOST_CHECK_EQUAL(store.Size(), 2u);
+        std::vector<byte> data;
+        BOOST_CHECK(store.Get(SgHashCode(2), data));
+        BOOST_CHECK(data == Bytes(1, 10));
+        std::vector<byte> bytes = Bytes(3, 5);
+        store.Put(SgHashCode(3), &bytes[0], bytes.size());
+    }
+    {
+        MappedHashStore store(FILENAME, "test");
+        BOOST_CHECK_EQUAL(store.Size(), 3u);
+    }
+    RemoveFiles(FILENAME);
+}
+
+BOOST_AUTO_TEST_CASE(MappedHashStore_HashDBDumpRestoreMerge)
+{
+    const std::string other = "MappedHashStoreTest2.db";
+    const std::string dump = "MappedHashStoreTest.dump";
+    RemoveFiles(FILENAME);
+    RemoveFiles(other);
+    {
+        HashDB<Data> db(FILENAME, "test", HASHDB_MAPPED);
+        BOOST_CHECK_EQUAL(db.Backend(), HASHDB_MAPPED);
+        db.Put(SgHashCode(1), Data(10));
+        db.Put(SgHashCode(2), Data(20));
+        std::ofstream os(dump.c_str(), std::ios::binary);
+        db.Dump(os);
+    }
+    {
+        // The header, not the argument, picks the backend
+        HashDB<Data> db(FILENAME, "test", HASHDB_BERKELEY);
+        BOOST_CHECK_EQUAL(db.Backend(), HASHDB_MAPPED);
+        HashDB<Data> restored(other, "test", HASHDB_MAPPED);
+        std::ifstream is(dump.c_str(), std::ios::binary);
+        restored.Restore(is);
+        Data data;
+        BOOST_CHECK(restored.Get(SgHashCode(2), data));
+        BOOST_CHECK_EQUAL(data.m_value, 20);
+        restored.Put(SgHashCode(1), Data(5));
+        restored.Put(SgHashCode(2), Data(30));
+        restored.Put(SgHashCode(3), Data(40));
+        db.Merge(restored);
+        BOOST_CHECK(db.Get(SgHashCode(1), data));
+        BOOST_CHECK_EQUAL(data.m_value, 10);
+        BOOST_CHECK(db.Get(SgHashCode(2), data));
+        BOOST_CHECK_EQUAL(data.m_value, 30);
+        BOOST_CHECK(db.Get(SgHashCode(3), data));
+        BOOST_CHECK_EQUAL(data.m_value, 40);
+    }
+    std::remove(dump.c_str());
+    RemoveFiles(FILENAME);
+    RemoveFiles(other);
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------
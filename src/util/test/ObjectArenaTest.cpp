@@ -0,0 +1,88 @@
+//---------------------------------------------------------------------------
+/** @file ObjectArenaTest.cpp
+ */
+//---------------------------------------------------------------------------
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <set>
+#include <vector>
+#include "ObjectArena.hpp"
+
+using namespace benzene;
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+struct Item
+{
+    std::vector<int> data;
+
+    void Clear()
+    {
+        data.clear();
+    }
+};
+
+BOOST_AUTO_TEST_CASE(ObjectArena_NewDelete)
+{
+    ObjectArena<Item, 4> arena;
+    std::set<Item*> items;
+    for (int i = 0; i < 10; ++i)
+    {
+        Item* item = arena.New();
+        BOOST_CHECK(item->data.empty());
+        item->data.push_back(i);
+        items.insert(item);
+    }
+    BOOST_CHECK_EQUAL(items.size(), 10u);
+    ObjectArena<Item, 4>::Statistics stats = arena.GetStatistics();
+    BOOST_CHECK_EQUAL(stats.slabs, 3u);
+    BOOST_CHECK_EQUAL(stats.capacity, 12u);
+    BOOST_CHECK_EQUAL(stats.in_use, 10u);
+    BOOST_CHECK_EQUAL(stats.peak, 10u);
+
+    // A deleted object is handed out again, cleared but with its
+    // buffer intact.
+    Item* item = *items.begin();
+    std::size_t capacity = item->data.capacity();
+    arena.Delete(item);
+    BOOST_CHECK_EQUAL(arena.GetStatistics().in_use, 9u);
+    Item* reused = arena.New();
+    BOOST_CHECK_EQUAL(reused, item);
+    BOOST_CHECK(reused->data.empty());
+    BOOST_CHECK_EQUAL(reused->data.capacity(), capacity);
+}
+
+BOOST_AUTO_TEST_CASE(ObjectArena_DeleteAll)
+{
+    ObjectArena<Item, 4> arena;
+    std::vector<Item*> first;
+    for (int i = 0; i < 6; ++i)
+    {
+        first.push_back(arena.New());
+        first.back()->data.assign(3, i);
+    }
+    arena.Delete(first[2]);
+    arena.DeleteAll();
+    BOOST_CHECK_EQUAL(arena.GetStatistics().in_use, 0u);
+
+    // Objects come back in slab order and no new slab is needed.
+    for (int i = 0; i < 6; ++i)
+    {
+        Item* item = arena.New();
+        BOOST_CHECK_EQUAL(item, first[i]);
+        BOOST_CHECK(item->data.empty());
+    }
+    ObjectArena<Item, 4>::Statistics stats = arena.GetStatistics();
+    BOOST_CHECK_EQUAL(stats.slabs, 2u);
+    BOOST_CHECK_EQUAL(stats.in_use, 6u);
+    BOOST_CHECK_EQUAL(stats.peak, 6u);
+}
+
+//---------------------------------------------------------------------------
+
+} // namespace
+
+//---------------------------------------------------------------------------
@@ -0,0 +1,147 @@
+//---------------------------------------------------------------------------
+/** @file ShardedHashTableTest.cpp */
+//---------------------------------------------------------------------------
+
+#include <algorithm>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "SgSystem.h"
+#include "ShardedHashTable.hpp"
+
+using namespace benzene;
+
+//---------------------------------------------------------------------------
+
+namespace {
+
+struct Data
+{
+    int m_value;
+
+    int m_work;
+
+    bool m_isValid;
+
+    Data()
+        : m_value(0), m_work(0), m_isValid(false)
+    { }
+
+    Data(int value, int work)
+        : m_value(value), m_work(work), m_isValid(true)
+    { }
+
+    bool IsValid() const { return m_isValid; }
+
+    void Invalidate() { m_isValid = false; }
+
+    bool IsBetterThan(const Data& data) const { return m_work > data.m_work; }
+};
+
+struct KeepNegative
+{
+    bool operator()(const Data& data) const { return data.m_value < 0; }
+};
+
+struct Collect
+{
+    std::vector<int>& m_values;
+
+    Collect(std::vector<int>& values)
+        : m_values(values)
+    { }
+
+    void operator()(const SgHashCode&, const Data& data,
+                    const NoColdData&) const
+    {
+        m_values.push_back(data.m_value);
+    }
+};
+
+void StoreRange(ShardedHashTable<Data, 4>* table, int first, int last)
+{
+    for (int i = first; i < last; ++i)
+        table->Store(SgHashCode(i + 1), Data(i, i));
+}
+
+BOOST_AUTO_TEST_CASE(ShardedHashTable_StoreLookup)
+{
+    ShardedHashTable<Data, 4> table(16);
+    BOOST_CHECK_EQUAL(table.MaxHash(), 16);
+    Data data;
+    BOOST_CHECK(!table.Lookup(SgHashCode(1), &data));
+    BOOST_CHECK(table.Store(SgHashCode(1), Data(5, 1)));
+    BOOST_CHECK(table.Lookup(SgHashCode(1), &data));
+    BOOST_CHECK_EQUAL(data.m_value, 5);
+    // Store overwrites the entry with the same code
+    table.Store(SgHashCode(1), Data(6, 0));
+    BOOST_CHECK(table.Lookup(SgHashCode(1), &data));
+    BOOST_CHECK_EQUAL(data.m_value, 6);
+    BOOST_CHECK_EQUAL(table.NuStores(), 2u);
+    BOOST_CHECK_EQUAL(table.NuLookups(), 3u);
+    BOOST_CHECK_EQUAL(table.NuFound(), 2u);
+    table.Clear();
+    BOOST_CHECK(!table.Lookup(SgHashCode(1), &data));
+    BOOST_CHECK_EQUAL(table.NuLookups(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(ShardedHashTable_Replacement)
+{
+    // One bucket: the fifth code replaces the entry with least work
+    ShardedHashTable<Data, 4> table(4);
+    for (int i = 0; i < 4; ++i)
+        table.Store(SgHashCode(i + 1), Data(i, i == 2 ? 0 : 10));
+    table.Store(SgHashCode(5), Data(4, 5));
+    BOOST_CHECK_EQUAL(table.NuCollisions(), 1u);
+    Data data;
+    BOOST_CHECK(!table.Lookup(SgHashCode(3), &data));
+    BOOST_CHECK(table.Lookup(SgHashCode(5), &data));
+    BOOST_CHECK(table.Lookup(SgHashCode(1), &data));
+}
+
+BOOST_AUTO_TEST_CASE(ShardedHashTable_Keep)
+{
+    ShardedHashTable<Data, 4> table(16);
+    Data data(3, 0);
+    BOOST_CHECK(table.StoreUnless(SgHashCode(1), data, KeepNegative()));
+    data = Data(-1, 0);
+    BOOST_CHECK(table.StoreUnless(SgHashCode(1), data, KeepNegative()));
+    // The kept entry is returned in data
+    data = Data(7, 0);
+    BOOST_CHECK(!table.StoreUnless(SgHashCode(1), data, KeepNegative()));
+    BOOST_CHECK_EQUAL(data.m_value, -1);
+    Data stored;
+    BOOST_CHECK(table.Lookup(SgHashCode(1), &stored));
+    BOOST_CHECK_EQUAL(stored.m_value, -1);
+}
+
+BOOST_AUTO_TEST_CASE(ShardedHashTable_ConcurrentStoreAndForEach)
+{
+    const int NUM_THREADS = 4;
+    const int PER_THREAD = 500;
+    ShardedHashTable<Data, 4> table(1 << 14);
+    boost::thread_group threads;
+    for (int i = 0; i < NUM_THREADS; ++i)
+        threads.create_thread(boost::bind(StoreRange, &table, i * PER_THREAD,
+                                          (i + 1) * PER_THREAD));
+    threads.join_all();
+    BOOST_CHECK_EQUAL(table.NuStores(), std::size_t(NUM_THREADS * PER_THREAD));
+    std::vector<int> values;
+    table.ForEach(Collect(values));
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    BOOST_CHECK_EQUAL(values.size() + table.NuCollisions(),
+                      std::size_t(NUM_THREADS * PER_THREAD));
+    for (int i = 0; i < NUM_THREADS * PER_THREAD; ++i)
+    {
+        Data data;
+        if (table.Lookup(SgHashCode(i + 1), &data))
+            BOOST_CHECK_EQUAL(data.m_value, i);
+    }
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------